@@ -38,7 +38,6 @@
  *
  */
 #include "sdk_common.h"
-#define APP_USBD_MIDI_ENABLED 1
 #if NRF_MODULE_ENABLED(APP_USBD_MIDI)
 
 #include "app_usbd_midi.h"
@@ -53,17 +52,124 @@
 
 
 #define USBD_MIDI_EVENT_SIZE 4
+#define USBD_MIDI_TX_PACKET_SIZE NRF_DRV_USBD_EPSIZE /**< Maximum size of a single IN transfer */
+#define USBD_MIDI_FRAMECNT_MASK 0x7FF /**< USB frame number is 11 bits wide */
 
 #define APP_USBD_AUDIO_CONTROL_IFACE_IDX    0 /**< Audio class control interface index */
 #define APP_USBD_MIDI_STREAMING_IFACE_IDX   1 /**< Midi class midi streaming interface index */
+#define APP_USBD_MIDI_STREAMING_EP_IN_IDX   0 /**< Midi streaming bulk endpoint in index */
 #define APP_USBD_MIDI_STREAMING_EP_OUT_IDX  1 /**< Midi streaming bulk endpoint out index */
-#define APP_USBD_MIDI_STREAMING_EP_IN_IDX   2 /**< Midi streaming bulk endpoint in index */
+#define APP_USBD_MIDI_STREAMING_ALT_UMP     1 /**< Alternate setting of USB-MIDI 2.0 */
+#define USBD_MIDI_CS_GR_TRM_BLOCK        0x26 /**< Descriptor type of Group Terminal Blocks */
 
+#if APP_USBD_MIDI_CONFIG_TRACE_SIZE
 /**
- * @brief Midi rx buffer
+ * @brief Trace ring buffer, shared by all instances.
  */
-static uint8_t m_rx_buffer[USBD_MIDI_EVENT_SIZE];
-NRF_DRV_USBD_TRANSFER_OUT(rx_transfer, m_rx_buffer, USBD_MIDI_EVENT_SIZE);
+app_usbd_midi_trace_t app_usbd_midi_trace = {
+    .magic = APP_USBD_MIDI_TRACE_MAGIC,
+    .size  = APP_USBD_MIDI_CONFIG_TRACE_SIZE,
+};
+
+/**
+ * @brief Write a trace record.
+ *
+ * Lock free, may be called from any context.
+ *
+ * @param[in] id        Trace point.
+ * @param[in] payload   Trace point specific value.
+ */
+static inline void midi_trace(app_usbd_midi_trace_id_t id, uint32_t payload)
+{
+    uint32_t                    idx   = nrf_atomic_u32_fetch_add(&app_usbd_midi_trace.idx, 1);
+    app_usbd_midi_trace_rec_t * p_rec = &app_usbd_midi_trace.rec[idx & (APP_USBD_MIDI_CONFIG_TRACE_SIZE - 1)];
+
+    p_rec->cycles  = DWT->CYCCNT;
+    p_rec->id      = (uint16_t)id;
+    p_rec->payload = (uint16_t)payload;
+}
+
+#define MIDI_TRACE(id, payload) midi_trace(APP_USBD_MIDI_TRACE_##id, (payload))
+#else
+#define MIDI_TRACE(id, payload) do { } while (0)
+#endif
+
+/**
+ * @brief Role of an event packet, see @ref m_midi_cin_info.
+ */
+#define MIDI_CIN_ROLE_NONE      0 /**< Reserved Code Index Number, event is ignored */
+#define MIDI_CIN_ROLE_MSG       1 /**< Complete midi message */
+#define MIDI_CIN_ROLE_SYSEX     2 /**< System exclusive start or continuation */
+#define MIDI_CIN_ROLE_SYSEX_END 3 /**< System exclusive end, or single byte system common for CIN 0x5 */
+
+#define MIDI_CIN_INFO(role, len)    (uint8_t)(((role) << 4) | (len))
+#define MIDI_CIN_INFO_ROLE(info)    ((info) >> 4)
+#define MIDI_CIN_INFO_LEN(info)     ((info) & 0x0F)
+
+/**
+ * @brief Code Index Number to event packet role and number of midi bytes.
+ */
+static const uint8_t m_midi_cin_info[16] =
+{
+    [APP_USBD_MIDI_CIN_MISC]             = MIDI_CIN_INFO(MIDI_CIN_ROLE_NONE,      0),
+    [APP_USBD_MIDI_CIN_CABLE_EVENT]      = MIDI_CIN_INFO(MIDI_CIN_ROLE_NONE,      0),
+    [APP_USBD_MIDI_CIN_SYSCOMMON_2]      = MIDI_CIN_INFO(MIDI_CIN_ROLE_MSG,       2),
+    [APP_USBD_MIDI_CIN_SYSCOMMON_3]      = MIDI_CIN_INFO(MIDI_CIN_ROLE_MSG,       3),
+    [APP_USBD_MIDI_CIN_SYSEX]            = MIDI_CIN_INFO(MIDI_CIN_ROLE_SYSEX,     3),
+    [APP_USBD_MIDI_CIN_SYSEX_END_1]      = MIDI_CIN_INFO(MIDI_CIN_ROLE_SYSEX_END, 1),
+    [APP_USBD_MIDI_CIN_SYSEX_END_2]      = MIDI_CIN_INFO(MIDI_CIN_ROLE_SYSEX_END, 2),
+    [APP_USBD_MIDI_CIN_SYSEX_END_3]      = MIDI_CIN_INFO(MIDI_CIN_ROLE_SYSEX_END, 3),
+    [APP_USBD_MIDI_CIN_NOTE_OFF]         = MIDI_CIN_INFO(MIDI_CIN_ROLE_MSG,       3),
+    [APP_USBD_MIDI_CIN_NOTE_ON]          = MIDI_CIN_INFO(MIDI_CIN_ROLE_MSG,       3),
+    [APP_USBD_MIDI_CIN_POLY_PRESSURE]    = MIDI_CIN_INFO(MIDI_CIN_ROLE_MSG,       3),
+    [APP_USBD_MIDI_CIN_CONTROL_CHANGE]   = MIDI_CIN_INFO(MIDI_CIN_ROLE_MSG,       3),
+    [APP_USBD_MIDI_CIN_PROGRAM_CHANGE]   = MIDI_CIN_INFO(MIDI_CIN_ROLE_MSG,       2),
+    [APP_USBD_MIDI_CIN_CHANNEL_PRESSURE] = MIDI_CIN_INFO(MIDI_CIN_ROLE_MSG,       2),
+    [APP_USBD_MIDI_CIN_PITCH_BEND]       = MIDI_CIN_INFO(MIDI_CIN_ROLE_MSG,       3),
+    [APP_USBD_MIDI_CIN_SINGLE_BYTE]      = MIDI_CIN_INFO(MIDI_CIN_ROLE_MSG,       1),
+};
+
+#define MIDI_STATUS_INFO(cin, len)      (uint8_t)(((len) << 4) | (cin))
+#define MIDI_STATUS_INFO_CIN(info)      ((info) & 0x0F)
+#define MIDI_STATUS_INFO_LEN(info)      ((info) >> 4)
+
+#define MIDI_STATUS_ROW_4(info)     info, info, info, info
+#define MIDI_STATUS_ROW_16(info)    MIDI_STATUS_ROW_4(info), MIDI_STATUS_ROW_4(info), \
+                                    MIDI_STATUS_ROW_4(info), MIDI_STATUS_ROW_4(info)
+
+/**
+ * @brief Status byte to Code Index Number and message length.
+ *
+ * Length is 0 for data bytes, system exclusive and undefined status bytes.
+ */
+static const uint8_t m_midi_status_info[256] =
+{
+    /* 0x00 - 0x7F: data bytes */
+    MIDI_STATUS_ROW_16(0), MIDI_STATUS_ROW_16(0), MIDI_STATUS_ROW_16(0), MIDI_STATUS_ROW_16(0),
+    MIDI_STATUS_ROW_16(0), MIDI_STATUS_ROW_16(0), MIDI_STATUS_ROW_16(0), MIDI_STATUS_ROW_16(0),
+    /* 0x80 - 0xEF: channel messages */
+    MIDI_STATUS_ROW_16(MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_NOTE_OFF,         3)),
+    MIDI_STATUS_ROW_16(MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_NOTE_ON,          3)),
+    MIDI_STATUS_ROW_16(MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_POLY_PRESSURE,    3)),
+    MIDI_STATUS_ROW_16(MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_CONTROL_CHANGE,   3)),
+    MIDI_STATUS_ROW_16(MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_PROGRAM_CHANGE,   2)),
+    MIDI_STATUS_ROW_16(MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_CHANNEL_PRESSURE, 2)),
+    MIDI_STATUS_ROW_16(MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_PITCH_BEND,       3)),
+    /* 0xF0 - 0xF7: system exclusive and system common messages */
+    MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SYSEX,       0), /* 0xF0 System exclusive        */
+    MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SYSCOMMON_2, 2), /* 0xF1 MTC quarter frame       */
+    MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SYSCOMMON_3, 3), /* 0xF2 Song position pointer   */
+    MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SYSCOMMON_2, 2), /* 0xF3 Song select             */
+    MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SYSEX_END_1, 0), /* 0xF4 Undefined               */
+    MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SYSEX_END_1, 0), /* 0xF5 Undefined               */
+    MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SYSEX_END_1, 1), /* 0xF6 Tune request            */
+    MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SYSEX_END_1, 0), /* 0xF7 End of exclusive        */
+    /* 0xF8 - 0xFF: real-time messages */
+    MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SINGLE_BYTE, 1), MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SINGLE_BYTE, 1),
+    MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SINGLE_BYTE, 1), MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SINGLE_BYTE, 1),
+    MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SINGLE_BYTE, 1), MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SINGLE_BYTE, 1),
+    MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SINGLE_BYTE, 1), MIDI_STATUS_INFO(APP_USBD_MIDI_CIN_SINGLE_BYTE, 1),
+};
 
 /**
  * @brief Auxiliary function to access midi class instance data.
@@ -91,6 +197,21 @@ static inline app_usbd_midi_ctx_t * midi_ctx_get(app_usbd_midi_t const * p_midi)
     return &p_midi->specific.p_data->ctx;
 }
 
+/**
+ * @brief Check if the streaming interface carries Universal MIDI Packets.
+ *
+ * @param[in] p_midi_ctx Midi class context data.
+ */
+static inline bool midi_ump_active(app_usbd_midi_ctx_t const * p_midi_ctx)
+{
+#if APP_USBD_MIDI_CONFIG_UMP
+    return p_midi_ctx->alt_setting == APP_USBD_MIDI_STREAMING_ALT_UMP;
+#else
+    UNUSED_PARAMETER(p_midi_ctx);
+    return false;
+#endif
+}
+
 
 /**
  * @brief User event handler.
@@ -106,7 +227,9 @@ static inline void user_event_handler(
 
     if (p_midi->specific.inst.user_ev_handler != NULL)
     {
+        MIDI_TRACE(EV_CB_ENTER, event);
         p_midi->specific.inst.user_ev_handler(p_inst, event);
+        MIDI_TRACE(EV_CB_EXIT, event);
     }
 }
 
@@ -123,33 +246,299 @@ static inline void user_rx_handler(app_usbd_class_inst_t const * p_inst,
 {
     app_usbd_midi_t const * p_midi = midi_get(p_inst);
 
+#if APP_USBD_MIDI_CONFIG_STATS
+    if (event == APP_USBD_MIDI_SYSEX_BUF_REQ)
+    {
+        midi_ctx_get(p_midi)->stats.sysex_buf_req++;
+    }
+#endif
     if (p_midi->specific.inst.user_rx_handler != NULL)
     {
+        MIDI_TRACE(RX_CB_ENTER, event);
         p_midi->specific.inst.user_rx_handler(p_inst, event, cable, rx);
+        MIDI_TRACE(RX_CB_EXIT, event);
+    }
+}
+
+/**
+ * @brief Auxiliary function to access midi out endpoint address.
+ *
+ * @param[in] p_inst Class instance data.
+ *
+ * @return OUT endpoint address.
+ */
+static inline nrf_drv_usbd_ep_t ep_out_addr_get(app_usbd_class_inst_t const * p_inst)
+{
+    app_usbd_class_iface_conf_t const * class_iface;
+    class_iface = app_usbd_class_iface_get(p_inst, APP_USBD_MIDI_STREAMING_IFACE_IDX);
+
+    app_usbd_class_ep_conf_t const * ep_cfg;
+    ep_cfg = app_usbd_class_iface_ep_get(class_iface, APP_USBD_MIDI_STREAMING_EP_OUT_IDX);
+
+    return app_usbd_class_ep_address_get(ep_cfg);
+}
+
+/**
+ * @brief Auxiliary function to access midi in endpoint address.
+ *
+ * @param[in] p_inst Class instance data.
+ *
+ * @return IN endpoint address.
+ */
+static inline nrf_drv_usbd_ep_t ep_in_addr_get(app_usbd_class_inst_t const * p_inst)
+{
+    app_usbd_class_iface_conf_t const * class_iface;
+    class_iface = app_usbd_class_iface_get(p_inst, APP_USBD_MIDI_STREAMING_IFACE_IDX);
+
+    app_usbd_class_ep_conf_t const * ep_cfg;
+    ep_cfg = app_usbd_class_iface_ep_get(class_iface, APP_USBD_MIDI_STREAMING_EP_IN_IDX);
+
+    return app_usbd_class_ep_address_get(ep_cfg);
+}
+
+#if APP_USBD_MIDI_CONFIG_TIMESTAMP
+/**
+ * @brief Take the time reference at SOF.
+ *
+ * The new reference is written to the unused entry of
+ * @ref app_usbd_midi_ctx_t::sof_ref and published by switching the index, so readers
+ * in any context get a consistent pair without masking interrupts.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] framecnt  USB frame number.
+ */
+static void midi_sof_event(app_usbd_midi_t const * p_midi, uint16_t framecnt)
+{
+    app_usbd_midi_ctx_t     * p_midi_ctx = midi_ctx_get(p_midi);
+    uint8_t                   idx        = p_midi_ctx->sof_ref_idx;
+    app_usbd_midi_sof_ref_t * p_ref      = &p_midi_ctx->sof_ref[idx ^ 1];
+
+    p_ref->ticks  = (p_midi_ctx->time_get != NULL) ? p_midi_ctx->time_get() : 0;
+    p_ref->frames = p_midi_ctx->sof_ref[idx].frames +
+                    ((uint16_t)(framecnt - p_midi_ctx->sof_framecnt) & USBD_MIDI_FRAMECNT_MASK);
+    p_midi_ctx->sof_framecnt = framecnt;
+    __DMB();
+    p_midi_ctx->sof_ref_idx = idx ^ 1;
+}
+
+/**
+ * @brief Time in microseconds since the last SOF.
+ *
+ * Limited to the frame, 0 without a sub-frame time source.
+ *
+ * @param[in] p_midi_ctx    Midi class context.
+ * @param[in] ticks         Time source ticks at the last SOF.
+ */
+static inline uint32_t midi_frame_time_get(app_usbd_midi_ctx_t const * p_midi_ctx, uint32_t ticks)
+{
+    uint32_t delta;
+
+    if ((p_midi_ctx->time_get == NULL) || (p_midi_ctx->ticks_per_ms == 0))
+    {
+        return 0;
     }
+    delta = MIN(p_midi_ctx->time_get() - ticks, p_midi_ctx->ticks_per_ms - 1);
+    return (delta * 1000) / p_midi_ctx->ticks_per_ms;
+}
+
+/**
+ * @brief Current time in microseconds.
+ *
+ * Frames counted at SOF plus the time source ticks since the last SOF. The sub-frame
+ * part is limited to the frame, so the time never goes back when SOF is late.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static uint32_t midi_timestamp_get(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t           * p_midi_ctx = midi_ctx_get(p_midi);
+    app_usbd_midi_sof_ref_t const * p_ref      = &p_midi_ctx->sof_ref[p_midi_ctx->sof_ref_idx];
+    uint32_t                        frames     = p_ref->frames;
+
+    return (frames * 1000) + midi_frame_time_get(p_midi_ctx, p_ref->ticks);
 }
+#endif
 
+/**
+ * @brief OUT endpoint consumer.
+ *
+ * Places received packets one after another in the RX buffer owned by the ongoing transfer.
+ * The transfer finishes on a short packet or when the buffer cannot hold another packet.
+ *
+ * @ref nrf_drv_usbd_consumer_t
+ */
 static bool midi_consumer(nrf_drv_usbd_ep_transfer_t * p_next,
                              void *                       p_context,
                              size_t                       ep_size,
                              size_t                       data_size)
 {
-    app_usbd_midi_ctx_t  * p_midi_ctx = (app_usbd_midi_ctx_t *) p_context;
-    
-    p_next->size = data_size;
-    static uint8_t buffer = 0;
+    app_usbd_midi_t const        * p_midi     = (app_usbd_midi_t const *)p_context;
+    app_usbd_midi_ctx_t          * p_midi_ctx = midi_ctx_get(p_midi);
+    app_usbd_midi_rx_buf_t const * p_rx_buf   = p_midi->specific.inst.p_rx_buf;
+    uint8_t                        idx        = p_midi_ctx->rx_wr & (p_rx_buf->count - 1);
+
+    ASSERT(p_midi_ctx->rx_fill + data_size <= p_rx_buf->size);
+
+    p_next->p_data.rx = p_rx_buf->p_data + (idx * p_rx_buf->size) + p_midi_ctx->rx_fill;
+    p_next->size      = data_size;
+    p_midi_ctx->rx_fill += data_size;
+    MIDI_TRACE(RX_PACKET, data_size);
+
+    return (data_size == ep_size) && (p_rx_buf->size - p_midi_ctx->rx_fill >= ep_size);
+}
+
+/**
+ * @brief Number of RX buffers received and not released yet.
+ *
+ * @param[in] p_midi_ctx Midi class context.
+ */
+static inline uint8_t midi_rx_queued(app_usbd_midi_ctx_t const * p_midi_ctx)
+{
+    return (uint8_t)(p_midi_ctx->rx_wr - p_midi_ctx->rx_free);
+}
 
-    p_midi_ctx->rx_buf = buffer;
-    p_next->p_data.rx = p_midi_ctx->rx_transfer[buffer].data;
-    p_midi_ctx->rx_transfer[buffer].len = data_size;
+/**
+ * @brief Start OUT transfer to the next free RX buffer.
+ *
+ * If all RX buffers are waiting to be parsed the endpoint is left unarmed and the host
+ * gets NAKs until a buffer is released.
+ *
+ * The endpoint is claimed with the atomic @ref app_usbd_midi_ctx_t::rx_armed flag, so the
+ * function may be called both from the transfer completion handler and from the context
+ * releasing RX buffers. The loop closes the race where a buffer is released just after
+ * the flag owner found all of them in use.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_rx_arm(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t          * p_midi_ctx = midi_ctx_get(p_midi);
+    app_usbd_midi_rx_buf_t const * p_rx_buf   = p_midi->specific.inst.p_rx_buf;
 
-    if (buffer == 0) {
-        buffer = 1;
-    } else {
-        buffer = 0;
+    while ((midi_rx_queued(p_midi_ctx) < p_rx_buf->count) &&
+           (nrf_atomic_flag_set_fetch(&p_midi_ctx->rx_armed) == 0))
+    {
+        if (midi_rx_queued(p_midi_ctx) < p_rx_buf->count)
+        {
+            nrf_drv_usbd_handler_desc_t handler_desc = {
+                .handler.consumer = midi_consumer,
+                .p_context        = (void *)p_midi
+            };
+
+            p_midi_ctx->rx_fill = 0;
+            if (app_usbd_ep_handled_transfer(ep_out_addr_get(app_usbd_midi_class_inst_get(p_midi)),
+                                             &handler_desc) != NRF_SUCCESS)
+            {
+                UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->rx_armed));
+                return;
+            }
+            MIDI_TRACE(RX_ARM, p_midi_ctx->rx_wr & (p_rx_buf->count - 1));
+            return;
+        }
+        UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->rx_armed));
     }
+}
 
-    return false;
+/**
+ * @brief Release parsed RX buffers that hold no pinned sysex spans and rearm the endpoint.
+ *
+ * Buffers are released in order, so a pinned buffer holds back the buffers after it.
+ * Called from the parsing context and from @ref app_usbd_midi_sysex_release, the
+ * atomic @ref app_usbd_midi_ctx_t::rx_reclaiming flag makes sure only one of them
+ * moves @ref app_usbd_midi_ctx_t::rx_free at a time.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_rx_reclaim(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t          * p_midi_ctx = midi_ctx_get(p_midi);
+    app_usbd_midi_rx_buf_t const * p_rx_buf   = p_midi->specific.inst.p_rx_buf;
+
+    while (nrf_atomic_flag_set_fetch(&p_midi_ctx->rx_reclaiming) == 0)
+    {
+        while ((p_midi_ctx->rx_free != p_midi_ctx->rx_rd) &&
+               (p_rx_buf->p_pins[p_midi_ctx->rx_free & (p_rx_buf->count - 1)] == 0))
+        {
+            p_midi_ctx->rx_free++;
+        }
+        UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->rx_reclaiming));
+
+        if ((p_midi_ctx->rx_free == p_midi_ctx->rx_rd) ||
+            (p_rx_buf->p_pins[p_midi_ctx->rx_free & (p_rx_buf->count - 1)] != 0))
+        {
+            break;
+        }
+    }
+
+    midi_rx_arm(p_midi);
+}
+
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL
+/**
+ * @brief Return a chain of sysex blocks to the pool.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] p_block   First block of the chain, may be NULL.
+ */
+static void midi_sysex_chain_free(app_usbd_midi_t const * p_midi, app_usbd_midi_sysex_block_t * p_block)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+    while (p_block != NULL)
+    {
+        app_usbd_midi_sysex_block_t * p_next = p_block->p_next;
+
+        nrf_balloc_free(p_midi->specific.inst.p_sysex_pool, p_block);
+        UNUSED_RETURN_VALUE(nrf_atomic_u32_sub(&p_midi_ctx->sysex_pool_stats.used, 1));
+        p_block = p_next;
+    }
+}
+#endif
+
+/**
+ * @brief Drop the rest of the message queued by @ref app_usbd_midi_sysex_send.
+ *
+ * Raises @ref APP_USBD_MIDI_USER_EVT_SYSEX_TX_ABORTED, so the application knows the
+ * buffer of the message is no longer used.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_sysex_send_abort(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+    if (p_midi_ctx->sysex_src_left == 0)
+    {
+        return;
+    }
+    p_midi_ctx->sysex_src_left = 0;
+    user_event_handler(app_usbd_midi_class_inst_get(p_midi), APP_USBD_MIDI_USER_EVT_SYSEX_TX_ABORTED);
+}
+
+/**
+ * @brief Disable an endpoint of the streaming interface.
+ *
+ * With the app_usbd event queue the ABORTED event of a transfer in flight is delivered
+ * after the endpoint has been enabled and armed again. It is counted here, so
+ * @ref midi_endpoint_ev does not release the transfer of the new setting.
+ *
+ * @param[in] p_midi_ctx    Midi class context.
+ * @param[in] ep_addr       Endpoint address.
+ */
+static void midi_ep_disable(app_usbd_midi_ctx_t * p_midi_ctx, nrf_drv_usbd_ep_t ep_addr)
+{
+    if (nrf_drv_usbd_ep_is_busy(ep_addr))
+    {
+        if (NRF_USBD_EPIN_CHECK(ep_addr))
+        {
+            p_midi_ctx->in_aborts++;
+        }
+        else
+        {
+            p_midi_ctx->out_aborts++;
+        }
+    }
+    app_usbd_ep_disable(ep_addr);
 }
 
 /**
@@ -176,7 +565,15 @@ static ret_code_t iface_select(
         }
         app_usbd_midi_t const * p_midi     = midi_get(p_inst);
         app_usbd_midi_ctx_t   * p_midi_ctx = midi_ctx_get(p_midi);
-        p_midi_ctx->streaming = (alternate == 0);
+        bool                    was_open   = p_midi_ctx->streaming;
+        bool                    open       = (alternate == 0);
+
+#if APP_USBD_MIDI_CONFIG_UMP
+        /* Alternate setting 1 carries Universal MIDI Packets if it is offered. */
+        open = open || (p_midi_ctx->p_ump_dsc != NULL);
+#endif
+        p_midi_ctx->streaming   = open;
+        p_midi_ctx->alt_setting = alternate;
 
         uint8_t i;
 
@@ -184,30 +581,86 @@ static ret_code_t iface_select(
         {
             nrf_drv_usbd_ep_t ep_addr =
                 app_usbd_class_ep_address_get(app_usbd_class_iface_ep_get(p_iface, i));
-            if (alternate == 0)
+            if (open)
             {
+                if (was_open)
+                {
+                    /* Switching between MIDI 1.0 and UMP, drop transfers of the previous setting. */
+                    midi_ep_disable(p_midi_ctx, ep_addr);
+                }
                 app_usbd_ep_enable(ep_addr);
-                if (ep_addr == NRF_DRV_USBD_EPOUT1)
+                if (NRF_USBD_EPOUT_CHECK(ep_addr))
                 {
-                    nrf_drv_usbd_handler_desc_t handler_desc = {
-                        .handler.consumer = midi_consumer,
-                        .p_context        = p_midi_ctx
-                    };
-
-                    app_usbd_ep_handled_transfer(NRF_DRV_USBD_EPOUT1, &handler_desc);
-
+                    p_midi_ctx->rx_wr    = 0;
+                    p_midi_ctx->rx_rd    = 0;
+                    p_midi_ctx->rx_free  = 0;
+                    p_midi_ctx->rx_pos   = 0;
+                    p_midi_ctx->rx_armed = 0;
+                    p_midi_ctx->rx_reclaiming = 0;
+                    p_midi_ctx->thru_held     = 0;
+                    p_midi_ctx->rx_span_open  = false;
+#if APP_USBD_MIDI_CONFIG_UMP
+                    p_midi_ctx->rx_ump_fill   = 0;
+#endif
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL
+                    for (uint8_t cable = 0; cable < ARRAY_SIZE(p_midi_ctx->sysex_chain); cable++)
+                    {
+                        midi_sysex_chain_free(p_midi, p_midi_ctx->sysex_chain[cable].p_first);
+                    }
+                    memset(p_midi_ctx->sysex_chain, 0, sizeof(p_midi_ctx->sysex_chain));
+#endif
+                    memset((void *)p_midi->specific.inst.p_rx_buf->p_pins, 0,
+                           p_midi->specific.inst.p_rx_buf->count * sizeof(nrf_atomic_u32_t));
+                    midi_rx_arm(p_midi);
 
                     user_event_handler(p_inst,
                         APP_USBD_MIDI_USER_EVT_PORT_OPEN);
                 }
-                if (ep_addr == NRF_DRV_USBD_EPIN1)
+                if (NRF_USBD_EPIN_CHECK(ep_addr))
                 {
                     nrf_ringbuf_init(p_midi->specific.inst.p_in_buf);
+                    p_midi_ctx->sending = 0;
+                    p_midi_ctx->tx_len  = 0;
+                    p_midi_ctx->sysex_src_lock = 0;
+#if APP_USBD_MIDI_TX_EDIT
+                    p_midi_ctx->tx_compact  = 0;
+                    p_midi_ctx->tx_claiming = false;
+#endif
+#if APP_USBD_MIDI_CONFIG_TX_ADMISSION
+                    p_midi_ctx->tx_wm_above = 0;
+#endif
+#if APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+                    p_midi_ctx->rt_wr   = 0;
+                    p_midi_ctx->rt_rd   = 0;
+                    p_midi_ctx->rt_len  = 0;
+                    p_midi_ctx->rt_lock = 0;
+#endif
+#if APP_USBD_MIDI_CONFIG_CC_SLOTS
+                    memset(p_midi_ctx->cc_slot, 0, sizeof(p_midi_ctx->cc_slot));
+#endif
+#if APP_USBD_MIDI_LANE_STATS
+                    p_midi_ctx->probe_armed = false;
+                    p_midi_ctx->probe_lock  = 0;
+#endif
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE
+                    p_midi_ctx->tx_load   = 0;
+                    p_midi_ctx->tx_sof_wr = 0;
+#endif
+#if APP_USBD_MIDI_CONFIG_SCHED_SIZE
+                    p_midi_ctx->sched_count   = 0;
+                    p_midi_ctx->sched_lock    = 0;
+                    p_midi_ctx->sched_pending = 0;
+#endif
+                    memset(p_midi_ctx->tx_stream, 0, sizeof(p_midi_ctx->tx_stream));
+
+                    /* The TX buffer has been emptied, a message being sent is incomplete. */
+                    midi_sysex_send_abort(p_midi);
                 }
             }
             else
             {
-                app_usbd_ep_disable(ep_addr);
+                midi_ep_disable(p_midi_ctx, ep_addr);
+                midi_sysex_send_abort(p_midi);
                 user_event_handler(p_inst,
                     APP_USBD_MIDI_USER_EVT_PORT_CLOSE);
             }
@@ -229,7 +682,9 @@ static void iface_deselect(
     {
         app_usbd_midi_t const * p_midi     = midi_get(p_inst);
         app_usbd_midi_ctx_t   * p_midi_ctx = midi_ctx_get(p_midi);
-        p_midi_ctx->streaming = false;
+        p_midi_ctx->streaming   = false;
+        p_midi_ctx->alt_setting = 0;
+        midi_sysex_send_abort(p_midi);
         user_event_handler(p_inst,
                     APP_USBD_MIDI_USER_EVT_PORT_CLOSE);
     }
@@ -248,7 +703,7 @@ static uint8_t iface_selection_get(
     {
         app_usbd_midi_t const * p_midi     = midi_get(p_inst);
         app_usbd_midi_ctx_t   * p_midi_ctx = midi_ctx_get(p_midi);
-        return (p_midi_ctx->streaming) ? 1 : 0;
+        return p_midi_ctx->alt_setting;
     }
     return 0;
 }
@@ -277,6 +732,23 @@ static ret_code_t setup_req_std_in(app_usbd_class_inst_t const * p_inst,
 
         uint8_t * p_trans_buff = app_usbd_core_setup_transfer_buff_get(&max_size);
 
+#if APP_USBD_MIDI_CONFIG_UMP
+        app_usbd_midi_ctx_t               * p_midi_ctx     = midi_ctx_get(midi_get(p_inst));
+        app_usbd_class_iface_conf_t const * p_stream_iface =
+            app_usbd_class_iface_get(p_inst, APP_USBD_MIDI_STREAMING_IFACE_IDX);
+
+        /* Group Terminal Blocks are not part of the configuration descriptor. */
+        if ((p_setup_ev->setup.wValue.hb == USBD_MIDI_CS_GR_TRM_BLOCK) &&
+            (p_setup_ev->setup.wValue.lb == APP_USBD_MIDI_STREAMING_ALT_UMP) &&
+            (p_setup_ev->setup.wIndex.lb == app_usbd_class_iface_number_get(p_stream_iface)) &&
+            (p_midi_ctx->p_gtb_dsc != NULL))
+        {
+            dsc_len = MIN(p_midi_ctx->p_gtb_dsc->size, max_size);
+            memcpy(p_trans_buff, p_midi_ctx->p_gtb_dsc->p_data, dsc_len);
+            return app_usbd_core_setup_rsp(&(p_setup_ev->setup), p_trans_buff, dsc_len);
+        }
+#endif
+
         /* Try to find descriptor in class internals*/
         ret_code_t ret = app_usbd_class_descriptor_find(
             p_inst,
@@ -482,516 +954,3507 @@ static ret_code_t setup_event_handler(
     return NRF_ERROR_NOT_SUPPORTED;
 }
 
+/*
+ * The TX path looks into nrf_ringbuf_cb_t only through the helpers below. They rely on
+ * the free running indexes of nrf_ringbuf, which always keep
+ * rd_idx <= tmp_rd_idx <= wr_idx <= tmp_wr_idx in modulo 2^32 arithmetic:
+ * - [rd_idx, tmp_rd_idx) is claimed by nrf_ringbuf_get and read by the ongoing IN transfer,
+ * - [tmp_rd_idx, wr_idx) is committed and not claimed yet,
+ * - [wr_idx, tmp_wr_idx) is allocated by the producer holding wr_flag.
+ * A producer may change committed data only while it holds wr_flag with nothing allocated
+ * and claims are held off, see midi_tx_edit_begin. The claimed data is never changed.
+ */
+
 /**
- * @brief Auxiliary function to access midi out endpoint address.
- *
- * @param[in] p_inst Class instance data.
+ * @brief Number of bytes queued in a ring buffer and not yet released by the consumer.
  *
- * @return OUT endpoint address.
+ * @param[in] p_buf Ring buffer.
  */
-static inline nrf_drv_usbd_ep_t ep_out_addr_get(app_usbd_class_inst_t const * p_inst)
+static inline size_t midi_ringbuf_pending(nrf_ringbuf_t const * p_buf)
 {
-    app_usbd_class_iface_conf_t const * class_iface;
-    class_iface = app_usbd_class_iface_get(p_inst, APP_USBD_MIDI_STREAMING_IFACE_IDX);
-
-    app_usbd_class_ep_conf_t const * ep_cfg;
-    ep_cfg = app_usbd_class_iface_ep_get(class_iface, APP_USBD_MIDI_STREAMING_EP_OUT_IDX);
-
-    return app_usbd_class_ep_address_get(ep_cfg);
+    return p_buf->p_cb->wr_idx - p_buf->p_cb->rd_idx;
 }
 
 /**
- * @brief Auxiliary function to access midi in endpoint address.
- *
- * @param[in] p_inst Class instance data.
+ * @brief Index after the last committed byte of a ring buffer.
  *
- * @return IN endpoint address.
+ * @param[in] p_buf Ring buffer.
  */
-static inline nrf_drv_usbd_ep_t ep_in_addr_get(app_usbd_class_inst_t const * p_inst)
+static inline uint32_t midi_ringbuf_wr_idx(nrf_ringbuf_t const * p_buf)
 {
-    app_usbd_class_iface_conf_t const * class_iface;
-    class_iface = app_usbd_class_iface_get(p_inst, APP_USBD_MIDI_STREAMING_IFACE_IDX);
+    return p_buf->p_cb->wr_idx;
+}
 
-    app_usbd_class_ep_conf_t const * ep_cfg;
-    ep_cfg = app_usbd_class_iface_ep_get(class_iface, APP_USBD_MIDI_STREAMING_EP_IN_IDX);
+/**
+ * @brief Index of the oldest byte of a ring buffer not released by the consumer.
+ *
+ * @param[in] p_buf Ring buffer.
+ */
+static inline uint32_t midi_ringbuf_rd_idx(nrf_ringbuf_t const * p_buf)
+{
+    return p_buf->p_cb->rd_idx;
+}
 
-    return app_usbd_class_ep_address_get(ep_cfg);
+/**
+ * @brief Index of the oldest committed byte of a ring buffer not claimed by the consumer.
+ *
+ * @param[in] p_buf Ring buffer.
+ */
+static inline uint32_t midi_ringbuf_unclaimed_idx(nrf_ringbuf_t const * p_buf)
+{
+    return p_buf->p_cb->tmp_rd_idx;
 }
 
+/**
+ * @brief Get the byte of a ring buffer at a free running index.
+ *
+ * @param[in] p_buf Ring buffer.
+ * @param[in] idx   Index.
+ */
+static inline uint8_t * midi_ringbuf_at(nrf_ringbuf_t const * p_buf, uint32_t idx)
+{
+    return &p_buf->p_buffer[idx & p_buf->bufsize_mask];
+}
 
-size_t midi_buffer_get(app_usbd_midi_t const *p_midi, uint8_t **p_buf)
+/**
+ * @brief Take the write lock of a ring buffer without allocating anything.
+ *
+ * @param[in] p_buf Ring buffer.
+ *
+ * @retval true     Lock taken, release it with @ref midi_ringbuf_unlock.
+ * @retval false    Another context writes to the ring buffer.
+ */
+static inline bool midi_ringbuf_lock(nrf_ringbuf_t const * p_buf)
 {
-    size_t len = 4;
-    size_t len_total = 0;
-    uint8_t buf[64];
-    while ((len != 0) && (len_total < 64))
-    {
-        nrf_ringbuf_cpy_get(p_midi->specific.inst.p_in_buf, 
-        (buf + len_total), &len);
+    return nrf_atomic_flag_set_fetch(&p_buf->p_cb->wr_flag) == 0;
+}
 
-        len_total += len;
-    }
-    *p_buf = buf;
-    return len_total;
-    
+/**
+ * @brief Release the write lock taken by @ref midi_ringbuf_lock.
+ *
+ * @param[in] p_buf Ring buffer.
+ */
+static inline void midi_ringbuf_unlock(nrf_ringbuf_t const * p_buf)
+{
+    UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_buf->p_cb->wr_flag));
 }
 
 /**
- * @brief Class specific endpoint transfer handler.
+ * @brief Drop committed data of a ring buffer from an index up to the write index.
  *
- * @param[in] p_inst        Generic class instance.
- * @param[in] p_setup_ev    Setup event.
+ * Must be called with the write lock taken by @ref midi_ringbuf_lock and claims held off,
+ * with @p idx between @ref midi_ringbuf_unclaimed_idx and @ref midi_ringbuf_wr_idx.
  *
- * @return Standard error code.
+ * @param[in] p_buf Ring buffer.
+ * @param[in] idx   New write index.
  */
-static ret_code_t midi_endpoint_ev(app_usbd_class_inst_t const *  p_inst,
-                                   app_usbd_complex_evt_t const * p_event)
+static inline void midi_ringbuf_truncate(nrf_ringbuf_t const * p_buf, uint32_t idx)
 {
-    app_usbd_midi_t const * p_midi     = midi_get(p_inst);
-    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
-    ret_code_t ret = NRF_ERROR_NOT_SUPPORTED;
+    ASSERT((p_buf->p_cb->wr_idx - idx) <= (p_buf->p_cb->wr_idx - p_buf->p_cb->tmp_rd_idx));
+    p_buf->p_cb->wr_idx     = idx;
+    p_buf->p_cb->tmp_wr_idx = idx;
+}
 
+/**
+ * @brief Number of free bytes in a ring buffer.
+ *
+ * Safe lower bound for the only producer of the ring buffer.
+ *
+ * @param[in] p_buf Ring buffer.
+ */
+static inline size_t midi_ringbuf_free_space(nrf_ringbuf_t const * p_buf)
+{
+    return p_buf->bufsize_mask + 1 - midi_ringbuf_pending(p_buf);
+}
 
-    if (NRF_USBD_EPIN_CHECK(p_event->drv_evt.data.eptransfer.ep))
-    {
-        switch (p_event->drv_evt.data.eptransfer.status)
+#if APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+/**
+ * @brief Number of real-time event packets queued and not yet released.
+ *
+ * @param[in] p_midi_ctx Midi class context.
+ */
+static inline uint8_t midi_rt_pending(app_usbd_midi_ctx_t const * p_midi_ctx)
+{
+    return (uint8_t)(p_midi_ctx->rt_wr - p_midi_ctx->rt_rd);
+}
+#endif
+
+/**
+ * @brief Check if any lane has data that is not sent yet.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static inline bool midi_tx_pending(app_usbd_midi_t const * p_midi)
+{
+#if APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+    if (midi_rt_pending(midi_ctx_get(p_midi)) != 0)
+    {
+        return true;
+    }
+#endif
+    return midi_ringbuf_pending(p_midi->specific.inst.p_in_buf) != 0;
+}
+
+#if APP_USBD_MIDI_LANE_STATS
+/**
+ * @brief Add a measured queueing delay to lane statistics.
+ *
+ * Called only from the IN transfer completion handler.
+ *
+ * @param[in,out] p_stats   Lane statistics.
+ * @param[in]     delay     Delay in microseconds.
+ */
+static void midi_lane_stats_add(app_usbd_midi_lane_stats_t * p_stats, uint32_t delay)
+{
+    p_stats->count++;
+    p_stats->total_us += delay;
+    p_stats->max_us    = MAX(p_stats->max_us, delay);
+}
+
+/**
+ * @brief Start measuring the last event packet written to the normal lane.
+ *
+ * Only one event packet is measured at a time, the normal lane is sampled.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_probe_start(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    nrf_ringbuf_t const * p_in_buf   = p_midi->specific.inst.p_in_buf;
+
+#if APP_USBD_MIDI_TX_EDIT
+    if (p_midi_ctx->tx_compact != 0)
+    {
+        /* The write index may move back, see @ref midi_tx_compact_rebase. */
+        return;
+    }
+#endif
+    if (p_midi_ctx->probe_armed || (midi_ringbuf_pending(p_in_buf) == 0) ||
+        (nrf_atomic_flag_set_fetch(&p_midi_ctx->probe_lock) != 0))
+    {
+        return;
+    }
+    p_midi_ctx->probe_idx  = midi_ringbuf_wr_idx(p_in_buf);
+    p_midi_ctx->probe_time = midi_timestamp_get(p_midi);
+    __DMB();
+    p_midi_ctx->probe_armed = true;
+}
+
+/**
+ * @brief Finish measuring an event packet of the normal lane if it was sent.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_probe_check(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+    if (!p_midi_ctx->probe_armed ||
+        ((int32_t)(midi_ringbuf_rd_idx(p_midi->specific.inst.p_in_buf) - p_midi_ctx->probe_idx) < 0))
+    {
+        return;
+    }
+    midi_lane_stats_add(&p_midi_ctx->lane_stats[APP_USBD_MIDI_LANE_NORMAL],
+                        midi_timestamp_get(p_midi) - p_midi_ctx->probe_time);
+    p_midi_ctx->probe_armed = false;
+    __DMB();
+    UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->probe_lock));
+}
+#endif
+
+#if APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+/**
+ * @brief Start IN transfer of queued real-time event packets.
+ *
+ * The packets are sent in place from @ref app_usbd_midi_ctx_t::rt_queue, up to the end
+ * of the queue array.
+ *
+ * Must be called only by the owner of @ref app_usbd_midi_ctx_t::sending.
+ *
+ * @param[in] p_midi Midi class instance.
+ *
+ * @retval NRF_SUCCESS          Transfer started.
+ * @retval NRF_ERROR_NOT_FOUND  There is nothing to send.
+ * @return Other error code returned by @ref app_usbd_ep_transfer.
+ */
+static ret_code_t midi_rt_start(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    uint8_t               idx        = p_midi_ctx->rt_rd & (APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE - 1);
+    size_t                count      = midi_rt_pending(p_midi_ctx);
+
+    if (count == 0)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    count = MIN(count, (size_t)APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE - idx);
+    count = MIN(count, USBD_MIDI_TX_PACKET_SIZE / USBD_MIDI_EVENT_SIZE);
+
+    NRF_DRV_USBD_TRANSFER_IN(transfer, &p_midi_ctx->rt_queue[idx], count * USBD_MIDI_EVENT_SIZE);
+    ret_code_t ret = app_usbd_ep_transfer(ep_in_addr_get(app_usbd_midi_class_inst_get(p_midi)),
+                                          &transfer);
+    if (ret != NRF_SUCCESS)
+    {
+        return ret;
+    }
+
+    p_midi_ctx->rt_len = (uint8_t)count;
+    return NRF_SUCCESS;
+}
+#endif
+
+#if APP_USBD_MIDI_CONFIG_UMP
+/**
+ * @brief Get the size of the TX buffer blocks Universal MIDI Packets are kept in.
+ *
+ * The TX buffer is split in blocks of one endpoint packet, or a single block if the buffer
+ * is smaller. No packet crosses a block boundary, see @ref midi_ump_pad_get, and no IN
+ * transfer does either, so every IN transfer carries whole packets only.
+ *
+ * @param[in] p_buf TX ring buffer.
+ */
+static inline size_t midi_ump_block_get(nrf_ringbuf_t const * p_buf)
+{
+    return MIN(USBD_MIDI_TX_PACKET_SIZE, p_buf->bufsize_mask + 1);
+}
+
+/**
+ * @brief Get the padding that keeps a Universal MIDI Packet inside a TX buffer block.
+ *
+ * @param[in] p_buf TX ring buffer.
+ * @param[in] idx   Ring buffer index the packet would be written at.
+ * @param[in] size  Size of the packet in bytes.
+ *
+ * @return Number of bytes to fill with NOOP utility messages before the packet.
+ */
+static inline size_t midi_ump_pad_get(nrf_ringbuf_t const * p_buf, uint32_t idx, size_t size)
+{
+    size_t block = midi_ump_block_get(p_buf);
+    size_t off   = idx & (block - 1);
+
+    ASSERT(size <= block);
+    return (off + size > block) ? (block - off) : 0;
+}
+#endif
+
+/**
+ * @brief Start IN transfer of queued event packets.
+ *
+ * Real-time event packets go first. Otherwise claims up to one endpoint packet of
+ * contiguous data from the TX ring buffer and hands it to the USBD DMA as is. With
+ * USB-MIDI 2.0 the claim ends at a block boundary, see @ref midi_ump_block_get.
+ * The claimed span stays in the ring buffer until the transfer is finished and is
+ * released in @ref midi_tx_release.
+ *
+ * Must be called only by the owner of @ref app_usbd_midi_ctx_t::sending.
+ *
+ * @param[in] p_midi Midi class instance.
+ *
+ * @retval NRF_SUCCESS          Transfer started.
+ * @retval NRF_ERROR_NOT_FOUND  There is nothing to send.
+ * @return Other error code returned by @ref app_usbd_ep_transfer.
+ */
+static ret_code_t midi_tx_start(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    nrf_ringbuf_t const * p_in_buf   = p_midi->specific.inst.p_in_buf;
+    uint8_t *             p_data;
+    size_t                len        = USBD_MIDI_TX_PACKET_SIZE;
+    ret_code_t            ret;
+
+#if APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+    ret = midi_rt_start(p_midi);
+    if (ret != NRF_ERROR_NOT_FOUND)
+    {
+        return ret;
+    }
+#endif
+
+#if APP_USBD_MIDI_CONFIG_UMP
+    if (midi_ump_active(p_midi_ctx))
+    {
+        /* Stop at the end of the block, see @ref midi_ump_block_get. */
+        size_t block = midi_ump_block_get(p_in_buf);
+
+        len = block - (midi_ringbuf_unclaimed_idx(p_in_buf) & (block - 1));
+    }
+#endif
+
+#if APP_USBD_MIDI_TX_EDIT
+    /* Do not claim data while a producer edits it, see @ref midi_tx_edit_begin. */
+    p_midi_ctx->tx_claiming = true;
+    __DMB();
+    if (p_midi_ctx->tx_compact != 0)
+    {
+        p_midi_ctx->tx_claiming = false;
+        return NRF_ERROR_BUSY;
+    }
+    ret = nrf_ringbuf_get(p_in_buf, &p_data, &len, true);
+    p_midi_ctx->tx_claiming = false;
+#else
+    ret = nrf_ringbuf_get(p_in_buf, &p_data, &len, true);
+#endif
+    if ((ret != NRF_SUCCESS) || (len == 0))
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    NRF_DRV_USBD_TRANSFER_IN(transfer, p_data, len);
+    ret = app_usbd_ep_transfer(ep_in_addr_get(app_usbd_midi_class_inst_get(p_midi)), &transfer);
+    if (ret != NRF_SUCCESS)
+    {
+        UNUSED_RETURN_VALUE(nrf_ringbuf_free(p_in_buf, 0));
+        return ret;
+    }
+
+    p_midi_ctx->tx_len = len;
+    MIDI_TRACE(TX_START, len);
+#if APP_USBD_MIDI_CONFIG_STATS
+    p_midi_ctx->p_tx_data = p_data;
+#endif
+    return NRF_SUCCESS;
+}
+
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE
+/**
+ * @brief Check if queued event packets should wait for more data.
+ *
+ * While the average load is above @ref app_usbd_midi_ctx_t::tx_coalesce a packet is
+ * sent only when it is full, when its data was queued before the last SOF or, with a
+ * sub-frame time source, after @ref APP_USBD_MIDI_CONFIG_TX_DEADLINE_US in the frame.
+ * Under lighter load every packet is sent right away.
+ *
+ * @param[in] p_midi Midi class instance.
+ *
+ * @retval true     Leave the data in the TX buffer.
+ * @retval false    Send the data now.
+ */
+static bool midi_tx_hold(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    nrf_ringbuf_t const * p_in_buf   = p_midi->specific.inst.p_in_buf;
+
+    if ((p_midi_ctx->tx_load / 8) < p_midi_ctx->tx_coalesce)
+    {
+        return false;
+    }
+#if APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+    if (midi_rt_pending(p_midi_ctx) != 0)
+    {
+        return false;
+    }
+#endif
+    if ((midi_ringbuf_pending(p_in_buf) - p_midi_ctx->tx_len) >= USBD_MIDI_TX_PACKET_SIZE)
+    {
+        return false;
+    }
+    /* Data committed before the last SOF has waited long enough. */
+    if ((int32_t)(p_midi_ctx->tx_sof_wr - midi_ringbuf_unclaimed_idx(p_in_buf)) > 0)
+    {
+        return false;
+    }
+#if APP_USBD_MIDI_CONFIG_TIMESTAMP
+    {
+        app_usbd_midi_sof_ref_t const * p_ref = &p_midi_ctx->sof_ref[p_midi_ctx->sof_ref_idx];
+
+        if ((p_midi_ctx->time_get != NULL) &&
+            (midi_frame_time_get(p_midi_ctx, p_ref->ticks) >= APP_USBD_MIDI_CONFIG_TX_DEADLINE_US))
+        {
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+#endif
+
+#if APP_USBD_MIDI_CONFIG_TX_ADMISSION
+/**
+ * @brief Raise watermark events when the TX buffer fill level crosses a watermark.
+ *
+ * Called after data is queued and after IN transfers finish, so the events come from the
+ * context of a write or from the USBD interrupt.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_tx_wm_update(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    size_t                pending    = midi_ringbuf_pending(p_midi->specific.inst.p_in_buf);
+
+    if (p_midi_ctx->tx_wm_high == 0)
+    {
+        return;
+    }
+    if (pending >= p_midi_ctx->tx_wm_high)
+    {
+        if (nrf_atomic_flag_set_fetch(&p_midi_ctx->tx_wm_above) == 0)
+        {
+            user_event_handler(app_usbd_midi_class_inst_get(p_midi),
+                               APP_USBD_MIDI_USER_EVT_TX_HIGH_WATERMARK);
+        }
+    }
+    else if (pending <= p_midi_ctx->tx_wm_low)
+    {
+        if (nrf_atomic_flag_clear_fetch(&p_midi_ctx->tx_wm_above) != 0)
+        {
+            user_event_handler(app_usbd_midi_class_inst_get(p_midi),
+                               APP_USBD_MIDI_USER_EVT_TX_LOW_WATERMARK);
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Make sure queued event packets are on their way to the host.
+ *
+ * Ownership of the IN endpoint is passed between producers and the transfer completion
+ * handler by the atomic @ref app_usbd_midi_ctx_t::sending flag, so this function may be
+ * called from any interrupt priority without masking interrupts. The loop closes the race
+ * where data is committed just after the current owner found the ring buffer empty.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_tx_kick(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+#if APP_USBD_MIDI_LANE_STATS
+    midi_probe_start(p_midi);
+#endif
+#if APP_USBD_MIDI_CONFIG_TX_ADMISSION
+    midi_tx_wm_update(p_midi);
+#endif
+#if APP_USBD_MIDI_CONFIG_STATS
+    p_midi_ctx->stats.tx_high_water = MAX(p_midi_ctx->stats.tx_high_water,
+                                          midi_ringbuf_pending(p_midi->specific.inst.p_in_buf));
+#endif
+    while (midi_tx_pending(p_midi) &&
+           (nrf_atomic_flag_set_fetch(&p_midi_ctx->sending) == 0))
+    {
+        ret_code_t ret;
+
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE
+        if (midi_tx_hold(p_midi))
+        {
+            /* Data is sent by a later producer or at SOF. */
+            UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->sending));
+            return;
+        }
+#endif
+        ret = midi_tx_start(p_midi);
+        if (ret == NRF_SUCCESS)
+        {
+            return;
+        }
+
+        UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->sending));
+        if (ret != NRF_ERROR_NOT_FOUND)
+        {
+            return;
+        }
+    }
+}
+
+#if APP_USBD_MIDI_CONFIG_STATS
+/**
+ * @brief Count event packets sent by the finished IN transfer.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_tx_stats(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t   * p_midi_ctx = midi_ctx_get(p_midi);
+    app_usbd_midi_stats_t * p_stats    = &p_midi_ctx->stats;
+    uint8_t const         * p_data     = p_midi_ctx->p_tx_data;
+    size_t                  len        = p_midi_ctx->tx_len;
+
+#if APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+    if (p_midi_ctx->rt_len != 0)
+    {
+        p_data = (uint8_t const *)&p_midi_ctx->rt_queue[p_midi_ctx->rt_rd & (APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE - 1)];
+        len    = p_midi_ctx->rt_len * USBD_MIDI_EVENT_SIZE;
+    }
+#endif
+
+    for (size_t i = 0; i < len; i += USBD_MIDI_EVENT_SIZE)
+    {
+#if APP_USBD_MIDI_CONFIG_UMP
+        if (midi_ump_active(p_midi_ctx))
+        {
+            uint32_t word;
+
+            memcpy(&word, &p_data[i], sizeof(word));
+            p_stats->tx_events[APP_USBD_MIDI_UMP_GROUP_GET(word)]++;
+            p_stats->tx_cin[APP_USBD_MIDI_UMP_MT_GET(word)]++;
+            i += (app_usbd_midi_ump_words_get(word) - 1) * sizeof(word);
+            continue;
+        }
+#endif
+        p_stats->tx_events[p_data[i] >> 4]++;
+        p_stats->tx_cin[p_data[i] & 0x0F]++;
+    }
+    p_stats->tx_bytes += len;
+    p_stats->tx_packets++;
+}
+#endif
+
+/**
+ * @brief Release the ring buffer span sent by the finished IN transfer.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_tx_release(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+#if APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+    if (p_midi_ctx->rt_len != 0)
+    {
+#if APP_USBD_MIDI_LANE_STATS
+        uint32_t now = midi_timestamp_get(p_midi);
+
+        for (uint8_t i = 0; i < p_midi_ctx->rt_len; i++)
+        {
+            uint8_t idx = (p_midi_ctx->rt_rd + i) & (APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE - 1);
+
+            midi_lane_stats_add(&p_midi_ctx->lane_stats[APP_USBD_MIDI_LANE_RT],
+                                now - p_midi_ctx->rt_stamp[idx]);
+        }
+#endif
+        p_midi_ctx->rt_rd += p_midi_ctx->rt_len;
+        p_midi_ctx->rt_len = 0;
+        return;
+    }
+#endif
+    UNUSED_RETURN_VALUE(nrf_ringbuf_free(p_midi->specific.inst.p_in_buf, p_midi_ctx->tx_len));
+    p_midi_ctx->tx_len = 0;
+#if APP_USBD_MIDI_LANE_STATS
+    midi_probe_check(p_midi);
+#endif
+}
+
+/**
+ * @brief Hand over the IN endpoint after a finished transfer.
+ *
+ * The next packet is started right away while the endpoint is still owned by
+ * the completion handler. Ownership is given up only if the ring buffer is empty.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_tx_continue(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+    midi_tx_release(p_midi);
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE
+    if (midi_tx_hold(p_midi))
+    {
+        UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->sending));
+        midi_tx_kick(p_midi);
+        return;
+    }
+#endif
+    if (midi_tx_start(p_midi) != NRF_SUCCESS)
+    {
+        UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->sending));
+        midi_tx_kick(p_midi);
+    }
+}
+
+#if APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+/**
+ * @brief Queue a real-time message in the real-time lane.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] cable     Cable number.
+ * @param[in] status    Real-time status byte.
+ *
+ * @retval NRF_SUCCESS      Message queued.
+ * @retval NRF_ERROR_NO_MEM Queue is full.
+ * @retval NRF_ERROR_BUSY   Queue is being written in another context.
+ */
+static ret_code_t midi_rt_put(app_usbd_midi_t const * p_midi, uint8_t cable, uint8_t status)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    ret_code_t            ret        = NRF_SUCCESS;
+
+    if (nrf_atomic_flag_set_fetch(&p_midi_ctx->rt_lock) != 0)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    if (midi_rt_pending(p_midi_ctx) < APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE)
+    {
+        uint8_t   idx  = p_midi_ctx->rt_wr & (APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE - 1);
+        uint8_t * p_ev = (uint8_t *)&p_midi_ctx->rt_queue[idx];
+
+        p_ev[0] = (uint8_t)(cable << 4) | APP_USBD_MIDI_CIN_SINGLE_BYTE;
+        p_ev[1] = status;
+        p_ev[2] = 0;
+        p_ev[3] = 0;
+#if APP_USBD_MIDI_LANE_STATS
+        p_midi_ctx->rt_stamp[idx] = midi_timestamp_get(p_midi);
+#endif
+        /* Event packet has to be visible before it is published. */
+        __DMB();
+        p_midi_ctx->rt_wr++;
+    }
+    else
+    {
+        ret = NRF_ERROR_NO_MEM;
+    }
+    UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->rt_lock));
+
+    if (ret == NRF_SUCCESS)
+    {
+        midi_tx_kick(p_midi);
+    }
+    return ret;
+}
+#endif
+
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE
+/**
+ * @brief Update the TX load and flush held packets at SOF.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_tx_sof(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    uint32_t              wr_idx     = midi_ringbuf_wr_idx(p_midi->specific.inst.p_in_buf);
+
+    /* Exponential average over 8 frames. The write index moves back when the overflow
+     * policy drops data, see @ref midi_tx_compact_rebase, count no load then. */
+    p_midi_ctx->tx_load  -= p_midi_ctx->tx_load / 8;
+    if ((int32_t)(wr_idx - p_midi_ctx->tx_sof_wr) > 0)
+    {
+        p_midi_ctx->tx_load += wr_idx - p_midi_ctx->tx_sof_wr;
+    }
+    p_midi_ctx->tx_sof_wr = wr_idx;
+    midi_tx_kick(p_midi);
+}
+#endif
+
+/**
+ * @brief Move the pending sysex source of @ref app_usbd_midi_sysex_send to the TX buffer.
+ *
+ * Called when the source is set and after every finished IN transfer, so the message is
+ * encoded straight into the TX buffer as space frees up. The atomic
+ * @ref app_usbd_midi_ctx_t::sysex_src_lock flag keeps the two callers apart. A caller that
+ * loses the flag has nothing to do, the owner either fills the TX buffer or stops on
+ * a busy TX buffer whose writer starts another transfer.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_sysex_pump(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    size_t                consumed   = 0;
+    bool                  done       = false;
+
+    if ((p_midi_ctx->sysex_src_left == 0) ||
+        (nrf_atomic_flag_set_fetch(&p_midi_ctx->sysex_src_lock) != 0))
+    {
+        return;
+    }
+
+    if (p_midi_ctx->sysex_src_left != 0)
+    {
+        UNUSED_RETURN_VALUE(app_usbd_midi_stream_write(p_midi,
+                                                       p_midi_ctx->sysex_src_cable,
+                                                       p_midi_ctx->p_sysex_src,
+                                                       p_midi_ctx->sysex_src_left,
+                                                       &consumed));
+        p_midi_ctx->p_sysex_src    += consumed;
+        p_midi_ctx->sysex_src_left -= consumed;
+        done = (consumed != 0) && (p_midi_ctx->sysex_src_left == 0);
+    }
+    UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->sysex_src_lock));
+
+    if (done)
+    {
+        user_event_handler(app_usbd_midi_class_inst_get(p_midi), APP_USBD_MIDI_USER_EVT_SYSEX_TX_DONE);
+    }
+}
+
+/**
+ * @brief Reservation of TX ring buffer space.
+ *
+ * Space is reserved with a single @ref nrf_ringbuf_alloc call sequence and may be split
+ * in two spans when it wraps around the end of the ring buffer. The ring buffer size is
+ * a power of two, so event packets never straddle the two spans.
+ */
+typedef struct
+{
+    uint8_t * p_span[2];                    //!< Reserved contiguous spans.
+    size_t    span_len[2];                  //!< Lengths of the reserved spans.
+    size_t    pos;                          //!< Number of bytes written to the reservation.
+    uint32_t  idx;                          //!< Ring buffer index of the reservation.
+    uint8_t   spill[USBD_MIDI_EVENT_SIZE];  //!< Sink for event packets past the end of the reservation.
+} midi_tx_rsv_t;
+
+/**
+ * @brief Reserve space for event packets in the TX ring buffer.
+ *
+ * The reservation is all or nothing. It has to be finished by @ref midi_tx_commit
+ * or @ref midi_tx_cancel.
+ *
+ * @param[in]  p_buf    Ring buffer.
+ * @param[out] p_rsv    Reservation.
+ * @param[in]  size     Number of bytes to reserve, multiple of @ref USBD_MIDI_EVENT_SIZE.
+ *
+ * @retval NRF_SUCCESS      Space reserved.
+ * @retval NRF_ERROR_BUSY   Another context is writing to the ring buffer.
+ * @retval NRF_ERROR_NO_MEM Not enough free space.
+ */
+static ret_code_t midi_tx_reserve(nrf_ringbuf_t const * p_buf, midi_tx_rsv_t * p_rsv, size_t size)
+{
+    p_rsv->pos         = 0;
+    p_rsv->span_len[0] = size;
+    p_rsv->span_len[1] = 0;
+
+    ret_code_t ret = nrf_ringbuf_alloc(p_buf, &p_rsv->p_span[0], &p_rsv->span_len[0], true);
+    if (ret != NRF_SUCCESS)
+    {
+        return ret;
+    }
+    if (p_rsv->span_len[0] == 0)
+    {
+        /* Ring buffer is full, the write lock has already been released. */
+        return NRF_ERROR_NO_MEM;
+    }
+
+    if (p_rsv->span_len[0] < size)
+    {
+        p_rsv->span_len[1] = size - p_rsv->span_len[0];
+        UNUSED_RETURN_VALUE(nrf_ringbuf_alloc(p_buf, &p_rsv->p_span[1], &p_rsv->span_len[1], false));
+        if (p_rsv->span_len[0] + p_rsv->span_len[1] < size)
+        {
+            UNUSED_RETURN_VALUE(nrf_ringbuf_put(p_buf, 0));
+            return NRF_ERROR_NO_MEM;
+        }
+    }
+
+    /* Stable while the write lock is held. */
+    p_rsv->idx = midi_ringbuf_wr_idx(p_buf);
+    return NRF_SUCCESS;
+}
+
+/**
+ * @brief Get the size of a reservation.
+ *
+ * @param[in] p_rsv Reservation.
+ */
+static inline size_t midi_tx_rsv_size(midi_tx_rsv_t const * p_rsv)
+{
+    return p_rsv->span_len[0] + p_rsv->span_len[1];
+}
+
+/**
+ * @brief Get the next event packet slot of a reservation.
+ *
+ * The bound is checked in all builds. A full reservation hands out
+ * @ref midi_tx_rsv_t::spill, so a writer that miscounted loses event packets instead of
+ * overwriting queued data, and the commit still releases the ring buffer write lock.
+ *
+ * @param[in,out] p_rsv Reservation.
+ *
+ * @return Pointer to @ref USBD_MIDI_EVENT_SIZE bytes inside the ring buffer.
+ */
+static inline uint8_t * midi_tx_rsv_event(midi_tx_rsv_t * p_rsv)
+{
+    uint8_t * p_ev;
+
+    if (p_rsv->pos < p_rsv->span_len[0])
+    {
+        p_ev = p_rsv->p_span[0] + p_rsv->pos;
+    }
+    else if (p_rsv->pos < midi_tx_rsv_size(p_rsv))
+    {
+        p_ev = p_rsv->p_span[1] + (p_rsv->pos - p_rsv->span_len[0]);
+    }
+    else
+    {
+        ASSERT(false);
+        return p_rsv->spill;
+    }
+    p_rsv->pos += USBD_MIDI_EVENT_SIZE;
+    return p_ev;
+}
+
+static void midi_thru_retry(app_usbd_midi_t const * p_midi);
+
+/**
+ * @brief Commit the written part of a reservation and start sending.
+ *
+ * An RX buffer held back by thru while the write lock was taken is forwarded now.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] p_rsv     Reservation.
+ */
+static void midi_tx_commit(app_usbd_midi_t const * p_midi, midi_tx_rsv_t const * p_rsv)
+{
+    /* Never more than reserved, @ref nrf_ringbuf_put would keep the write lock. */
+    UNUSED_RETURN_VALUE(nrf_ringbuf_put(p_midi->specific.inst.p_in_buf,
+                                        MIN(p_rsv->pos, midi_tx_rsv_size(p_rsv))));
+    midi_tx_kick(p_midi);
+    midi_thru_retry(p_midi);
+}
+
+/**
+ * @brief Drop a reservation without writing anything to the ring buffer.
+ *
+ * @param[in] p_midi    Midi class instance.
+ */
+static void midi_tx_cancel(app_usbd_midi_t const * p_midi)
+{
+    UNUSED_RETURN_VALUE(nrf_ringbuf_put(p_midi->specific.inst.p_in_buf, 0));
+    midi_thru_retry(p_midi);
+}
+
+#if APP_USBD_MIDI_TX_EDIT
+/**
+ * @brief Take the TX buffer to edit unsent data in place.
+ *
+ * Takes @ref app_usbd_midi_ctx_t::tx_compact and then the ring buffer write lock. The
+ * flag pairs with @ref app_usbd_midi_ctx_t::tx_claiming in @ref midi_tx_start: while it
+ * is held no IN transfer claims data, so the claimed part of the ring buffer does not
+ * grow and nothing from @c tmp_rd_idx on is read by the USBD DMA.
+ *
+ * @param[in] p_midi Midi class instance.
+ *
+ * @retval true     TX buffer taken, release it with @ref midi_tx_edit_end.
+ * @retval false    TX buffer is written, edited or claimed in another context.
+ */
+static bool midi_tx_edit_begin(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+    if (nrf_atomic_flag_set_fetch(&p_midi_ctx->tx_compact) != 0)
+    {
+        return false;
+    }
+    __DMB();
+    if (!p_midi_ctx->tx_claiming && midi_ringbuf_lock(p_midi->specific.inst.p_in_buf))
+    {
+        return true;
+    }
+    UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->tx_compact));
+
+    /* IN transfer may have been held off meanwhile. */
+    midi_tx_kick(p_midi);
+    return false;
+}
+
+/**
+ * @brief Give back the TX buffer taken by @ref midi_tx_edit_begin.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_tx_edit_end(app_usbd_midi_t const * p_midi)
+{
+    midi_ringbuf_unlock(p_midi->specific.inst.p_in_buf);
+    UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&midi_ctx_get(p_midi)->tx_compact));
+
+    /* IN transfer may have been held off meanwhile. */
+    midi_tx_kick(p_midi);
+    midi_thru_retry(p_midi);
+}
+#endif
+
+#if APP_USBD_MIDI_CONFIG_TX_ADMISSION
+/**
+ * @brief Check if an event packet may be dropped by @ref APP_USBD_MIDI_OVERFLOW_DROP_LOW.
+ *
+ * @param[in] p_ev Event packet.
+ */
+static inline bool midi_ev_low_priority(uint8_t const * p_ev)
+{
+    switch (p_ev[0] & 0x0F)
+    {
+        case APP_USBD_MIDI_CIN_POLY_PRESSURE:
+        case APP_USBD_MIDI_CIN_CONTROL_CHANGE:
+        case APP_USBD_MIDI_CIN_CHANNEL_PRESSURE:
+        case APP_USBD_MIDI_CIN_PITCH_BEND:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Follow an event packet moved by @ref midi_tx_compact with the indexes kept in the context.
+ *
+ * The SOF write index of @ref midi_tx_sof and the lane probe index of
+ * @ref midi_probe_start point just past an event packet, that is at the next one. They
+ * have to stay at or below the write index, which moves back by the dropped bytes.
+ * Sources are visited in increasing order, so a moved index is never moved twice.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] src       Old index of the event packet, or the old write index.
+ * @param[in] dst       New index.
+ */
+static void midi_tx_compact_rebase(app_usbd_midi_t const * p_midi, uint32_t src, uint32_t dst)
+{
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE || APP_USBD_MIDI_LANE_STATS
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+#else
+    UNUSED_PARAMETER(p_midi);
+#endif
+
+    if (src == dst)
+    {
+        return;
+    }
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE
+    if (p_midi_ctx->tx_sof_wr == src)
+    {
+        p_midi_ctx->tx_sof_wr = dst;
+    }
+#endif
+#if APP_USBD_MIDI_LANE_STATS
+    if (p_midi_ctx->probe_idx == src)
+    {
+        p_midi_ctx->probe_idx = dst;
+    }
+#endif
+}
+
+/**
+ * @brief Role of a queued event packet in a message sent in several event packets.
+ */
+typedef enum
+{
+    MIDI_TX_RUN_SINGLE, //!< Whole message
+    MIDI_TX_RUN_START,  //!< First part of a message
+    MIDI_TX_RUN_CONT,   //!< Middle part of a message
+    MIDI_TX_RUN_END,    //!< Last part of a message
+} midi_tx_run_t;
+
+/**
+ * @brief Queued unit of data as seen by the overflow policy.
+ */
+typedef struct
+{
+    size_t        size; //!< Size in bytes
+    midi_tx_run_t run;  //!< Role in a message sent in several units
+    uint8_t       key;  //!< Stream of the message, the cable
+    bool          keep; //!< Never dropped
+    bool          low;  //!< May be dropped by @ref APP_USBD_MIDI_OVERFLOW_DROP_LOW
+    bool          pad;  //!< NOOP filler of @ref midi_ump_pad_get, always dropped
+} midi_tx_unit_t;
+
+/**
+ * @brief Classify a queued unit for the overflow policy.
+ *
+ * A system exclusive message is a run of event packets from the one starting with 0xF0
+ * to the one ending with 0xF7, on the same cable. Note off, including note on with
+ * velocity 0, is never dropped so no note is left hanging.
+ *
+ * @param[in]  p_data   Queued unit.
+ * @param[out] p_unit   Classification.
+ */
+static void midi_tx_unit_get(uint8_t const * p_data, midi_tx_unit_t * p_unit)
+{
+    uint8_t cin = p_data[0] & 0x0F;
+
+    p_unit->size = USBD_MIDI_EVENT_SIZE;
+    p_unit->run  = MIDI_TX_RUN_SINGLE;
+    p_unit->key  = p_data[0] >> 4;
+    p_unit->keep = (cin == APP_USBD_MIDI_CIN_NOTE_OFF) ||
+                   ((cin == APP_USBD_MIDI_CIN_NOTE_ON) && (p_data[3] == 0));
+    p_unit->low  = midi_ev_low_priority(p_data);
+    p_unit->pad  = false;
+
+    switch (cin)
+    {
+        case APP_USBD_MIDI_CIN_SYSEX:
+            p_unit->run = (p_data[1] == 0xF0) ? MIDI_TX_RUN_START : MIDI_TX_RUN_CONT;
+            break;
+
+        case APP_USBD_MIDI_CIN_SYSEX_END_1:
+            /* Otherwise a single-byte system common message. */
+            if (p_data[1] == 0xF7)
+            {
+                p_unit->run = MIDI_TX_RUN_END;
+            }
+            break;
+
+        case APP_USBD_MIDI_CIN_SYSEX_END_2:
+        case APP_USBD_MIDI_CIN_SYSEX_END_3:
+            /* Otherwise a whole message in one event packet. */
+            if (p_data[1] != 0xF0)
+            {
+                p_unit->run = MIDI_TX_RUN_END;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+#if APP_USBD_MIDI_CONFIG_UMP
+/**
+ * @brief Classify a queued Universal MIDI Packet for the overflow policy.
+ *
+ * Data messages and UMP stream messages are runs of packets marked complete, start,
+ * continue and end. Runs are kept apart by group, with separate groups for each message
+ * type. Note off, and MIDI 1.0 note on with velocity 0, is never dropped.
+ *
+ * @param[in]  p_data   Queued packet.
+ * @param[out] p_unit   Classification.
+ */
+static void midi_tx_ump_unit_get(uint8_t const * p_data, midi_tx_unit_t * p_unit)
+{
+    uint32_t word;
+    uint8_t  mt;
+    uint8_t  status;
+    uint8_t  form = 0;
+
+    memcpy(&word, p_data, sizeof(word));
+    mt     = APP_USBD_MIDI_UMP_MT_GET(word);
+    status = (uint8_t)((word >> 20) & 0x0F);
+
+    p_unit->size = app_usbd_midi_ump_words_get(word) * sizeof(word);
+    p_unit->key  = APP_USBD_MIDI_UMP_GROUP_GET(word);
+    p_unit->pad  = (word == 0);
+    p_unit->keep = false;
+    p_unit->low  = false;
+
+    switch (mt)
+    {
+        case APP_USBD_MIDI_UMP_MT_MIDI1_CV:
+            p_unit->keep = (status == APP_USBD_MIDI_UMP_CV2_NOTE_OFF) ||
+                           ((status == APP_USBD_MIDI_UMP_CV2_NOTE_ON) && ((word & 0x7F) == 0));
+            p_unit->low  = (status == APP_USBD_MIDI_UMP_CV2_POLY_PRESSURE) ||
+                           (status == APP_USBD_MIDI_UMP_CV2_CONTROL_CHANGE) ||
+                           (status == APP_USBD_MIDI_UMP_CV2_CHANNEL_PRESSURE) ||
+                           (status == APP_USBD_MIDI_UMP_CV2_PITCH_BEND);
+            break;
+
+        case APP_USBD_MIDI_UMP_MT_MIDI2_CV:
+            p_unit->keep = (status == APP_USBD_MIDI_UMP_CV2_NOTE_OFF);
+            p_unit->low  = (status <= APP_USBD_MIDI_UMP_CV2_NRPN) ||
+                           (status == APP_USBD_MIDI_UMP_CV2_PER_NOTE_BEND) ||
+                           (status == APP_USBD_MIDI_UMP_CV2_POLY_PRESSURE) ||
+                           (status == APP_USBD_MIDI_UMP_CV2_CONTROL_CHANGE) ||
+                           (status == APP_USBD_MIDI_UMP_CV2_CHANNEL_PRESSURE) ||
+                           (status == APP_USBD_MIDI_UMP_CV2_PITCH_BEND);
+            break;
+
+        case APP_USBD_MIDI_UMP_MT_DATA64:
+            form = status;
+            break;
+
+        case APP_USBD_MIDI_UMP_MT_DATA128:
+            form = status;
+            p_unit->key += 16;
+            break;
+
+        case APP_USBD_MIDI_UMP_MT_FLEX_DATA:
+            form = (uint8_t)((word >> 22) & 0x03);
+            p_unit->key += 32;
+            break;
+
+        case APP_USBD_MIDI_UMP_MT_STREAM:
+            form = (uint8_t)((word >> 26) & 0x03);
+            p_unit->key = 48;
+            break;
+
+        default:
+            break;
+    }
+
+    /* Complete, start, continue and end, in the order of @ref midi_tx_run_t. */
+    p_unit->run = (form <= MIDI_TX_RUN_END) ? (midi_tx_run_t)form : MIDI_TX_RUN_SINGLE;
+}
+#endif
+
+/**
+ * @brief Classify a queued unit of the selected protocol for the overflow policy.
+ *
+ * @param[in]  ump      USB-MIDI 2.0 is selected.
+ * @param[in]  p_data   Queued unit.
+ * @param[out] p_unit   Classification.
+ */
+static inline void midi_tx_any_unit_get(bool ump, uint8_t const * p_data, midi_tx_unit_t * p_unit)
+{
+#if APP_USBD_MIDI_CONFIG_UMP
+    if (ump)
+    {
+        midi_tx_ump_unit_get(p_data, p_unit);
+        return;
+    }
+#else
+    UNUSED_PARAMETER(ump);
+#endif
+    midi_tx_unit_get(p_data, p_unit);
+}
+
+/**
+ * @brief Check if the end of a run is queued, so the whole run can be dropped.
+ *
+ * @param[in] p_in_buf  TX ring buffer.
+ * @param[in] ump       USB-MIDI 2.0 is selected.
+ * @param[in] idx       Index of the unit after the start of the run.
+ * @param[in] wr_idx    Write index.
+ * @param[in] key       Stream of the run.
+ */
+static bool midi_tx_run_queued(nrf_ringbuf_t const * p_in_buf,
+                               bool                  ump,
+                               uint32_t              idx,
+                               uint32_t              wr_idx,
+                               uint8_t               key)
+{
+    midi_tx_unit_t unit;
+
+    for (; idx != wr_idx; idx += unit.size)
+    {
+        midi_tx_any_unit_get(ump, midi_ringbuf_at(p_in_buf, idx), &unit);
+        if ((unit.key == key) && (unit.run == MIDI_TX_RUN_END))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Drop unsent messages from the TX buffer.
+ *
+ * Units not claimed by an IN transfer are walked from the oldest one, dropped ones are
+ * skipped and the rest are moved down, so the room is made at the write end of the ring
+ * buffer. A run is dropped whole or not at all, so it is dropped only from its start and
+ * only when its end is queued too. Universal MIDI Packets are dropped whole and NOOP
+ * padding is rebuilt for the moved ones. Must be called between @ref midi_tx_edit_begin
+ * and @ref midi_tx_edit_end.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] need      Number of bytes to free.
+ * @param[in] low_only  Drop only units of @ref midi_tx_unit_t::low.
+ *
+ * @return Number of bytes freed.
+ */
+static size_t midi_tx_compact(app_usbd_midi_t const * p_midi, size_t need, bool low_only)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    nrf_ringbuf_t const * p_in_buf   = p_midi->specific.inst.p_in_buf;
+    uint32_t              wr_idx     = midi_ringbuf_wr_idx(p_in_buf);
+    uint32_t              dst        = midi_ringbuf_unclaimed_idx(p_in_buf);
+    bool                  ump        = midi_ump_active(p_midi_ctx);
+    uint64_t              dropping   = 0;
+    midi_tx_unit_t        unit;
+
+    for (uint32_t src = dst; src != wr_idx; src += unit.size)
+    {
+        uint8_t * p_src = midi_ringbuf_at(p_in_buf, src);
+        bool      drop;
+
+        midi_tx_compact_rebase(p_midi, src, dst);
+        midi_tx_any_unit_get(ump, p_src, &unit);
+
+        if (unit.pad)
+        {
+            continue;
+        }
+        if ((unit.run != MIDI_TX_RUN_SINGLE) && ((dropping & (1ULL << unit.key)) != 0))
+        {
+            /* Rest of a run whose start was dropped. */
+            drop = true;
+            if (unit.run == MIDI_TX_RUN_END)
+            {
+                dropping &= ~(1ULL << unit.key);
+            }
+        }
+        else if (((src - dst) >= need) || unit.keep || (low_only && !unit.low) ||
+                 (unit.run == MIDI_TX_RUN_CONT) || (unit.run == MIDI_TX_RUN_END))
+        {
+            drop = false;
+        }
+        else if (unit.run == MIDI_TX_RUN_START)
+        {
+            drop = midi_tx_run_queued(p_in_buf, ump, src + unit.size, wr_idx, unit.key);
+            if (drop)
+            {
+                dropping |= 1ULL << unit.key;
+            }
+        }
+        else
+        {
+            drop = true;
+        }
+
+        if (drop)
+        {
+            p_midi_ctx->tx_dropped++;
+            continue;
+        }
+#if APP_USBD_MIDI_CONFIG_UMP
+        if (ump)
+        {
+            /* Moved packets must stay inside a block too. Padding ends below src, as the
+             * packet was inside a block at src. */
+            for (size_t pad = midi_ump_pad_get(p_in_buf, dst, unit.size);
+                 pad != 0;
+                 pad -= sizeof(uint32_t))
+            {
+                memset(midi_ringbuf_at(p_in_buf, dst), 0, sizeof(uint32_t));
+                dst += sizeof(uint32_t);
+            }
+        }
+#endif
+        if (dst != src)
+        {
+            memmove(midi_ringbuf_at(p_in_buf, dst), p_src, unit.size);
+        }
+        dst += unit.size;
+    }
+
+    midi_ringbuf_truncate(p_in_buf, dst);
+    midi_tx_compact_rebase(p_midi, wr_idx, dst);
+#if APP_USBD_MIDI_CONFIG_CC_SLOTS
+    /* Queued controllers have moved. */
+    memset(p_midi_ctx->cc_slot, 0, sizeof(p_midi_ctx->cc_slot));
+#endif
+    return wr_idx - dst;
+}
+
+/**
+ * @brief Make room in the TX buffer according to the overflow policy.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] size      Number of bytes that have to fit.
+ *
+ * @retval NRF_SUCCESS      Room made.
+ * @retval NRF_ERROR_NO_MEM Not enough data could be dropped.
+ * @retval NRF_ERROR_BUSY   TX buffer is being written or claimed in another context.
+ */
+static ret_code_t midi_tx_make_room(app_usbd_midi_t const * p_midi, size_t size)
+{
+    nrf_ringbuf_t const * p_in_buf = p_midi->specific.inst.p_in_buf;
+    bool                  low_only = midi_ctx_get(p_midi)->tx_overflow == APP_USBD_MIDI_OVERFLOW_DROP_LOW;
+    size_t                free;
+
+    if (!midi_tx_edit_begin(p_midi))
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    /* Loop until nothing more can be freed. */
+    for (free = midi_ringbuf_free_space(p_in_buf);
+         (free < size) && (midi_tx_compact(p_midi, size - free, low_only) != 0);
+         free = midi_ringbuf_free_space(p_in_buf))
+    {
+    }
+
+    midi_tx_edit_end(p_midi);
+    return (free >= size) ? NRF_SUCCESS : NRF_ERROR_NO_MEM;
+}
+#endif
+
+/**
+ * @brief Reserve space in the TX buffer for a write, applying the overflow policy.
+ *
+ * @param[in]  p_midi   Midi class instance.
+ * @param[out] p_rsv    Reservation.
+ * @param[in]  size     Number of bytes, a multiple of @ref USBD_MIDI_EVENT_SIZE.
+ *
+ * @return Standard error code, see @ref midi_tx_reserve.
+ */
+static ret_code_t midi_tx_admit(app_usbd_midi_t const * p_midi, midi_tx_rsv_t * p_rsv, size_t size)
+{
+    nrf_ringbuf_t const * p_in_buf = p_midi->specific.inst.p_in_buf;
+    ret_code_t            ret      = midi_tx_reserve(p_in_buf, p_rsv, size);
+
+#if APP_USBD_MIDI_CONFIG_TX_ADMISSION
+    if ((ret == NRF_ERROR_NO_MEM) &&
+        (midi_ctx_get(p_midi)->tx_overflow != APP_USBD_MIDI_OVERFLOW_REJECT) &&
+        (size <= p_in_buf->bufsize_mask + 1) &&
+        (midi_tx_make_room(p_midi, size) == NRF_SUCCESS))
+    {
+        ret = midi_tx_reserve(p_in_buf, p_rsv, size);
+    }
+#endif
+#if APP_USBD_MIDI_CONFIG_STATS
+    if (ret == NRF_ERROR_NO_MEM)
+    {
+        midi_ctx_get(p_midi)->stats.tx_rejected++;
+    }
+#endif
+    return ret;
+}
+
+#if APP_USBD_MIDI_CONFIG_CC_SLOTS
+/**
+ * @brief Get the coalescing key of an event packet.
+ *
+ * Control change, pitch bend, channel and polyphonic pressure carry the latest value of
+ * a continuous control. Controllers whose meaning depends on the order of messages, like
+ * bank select, data entry, (N)RPN selection, switches and channel mode messages, are
+ * never coalesced. Neither are the LSB controllers 32 to 63: a receiver resets the LSB
+ * when the MSB arrives, so an LSB must stay behind the MSB it was sent after, see
+ * @ref midi_cc_lsb_put.
+ *
+ * @param[in]  p_ev     Event packet.
+ * @param[out] p_key    Key of the controlled value.
+ *
+ * @retval true     Only the latest value of the event packet matters.
+ * @retval false    Event packet has to be sent as is.
+ */
+static bool midi_cc_key_get(uint8_t const * p_ev, uint32_t * p_key)
+{
+    uint32_t key = p_ev[0] | ((uint32_t)p_ev[1] << 8) | (1UL << 24);
+
+    switch (p_ev[1] & 0xF0)
+    {
+        case 0xB0:
+            if ((p_ev[2] == 0)  || (p_ev[2] == 6)  ||
+                ((p_ev[2] >= 32) && (p_ev[2] <= 69)) ||
+                ((p_ev[2] >= 96) && (p_ev[2] <= 101)) ||
+                (p_ev[2] >= 120))
+            {
+                return false;
+            }
+            /* fall through */
+        case 0xA0:
+            key |= (uint32_t)p_ev[2] << 16;
+            break;
+
+        case 0xD0:
+        case 0xE0:
+            break;
+
+        default:
+            return false;
+    }
+
+    *p_key = key;
+    return true;
+}
+
+/**
+ * @brief Get the slot of a coalescing key.
+ *
+ * @param[in] p_midi_ctx    Midi class context.
+ * @param[in] key           Key returned by @ref midi_cc_key_get.
+ */
+static inline app_usbd_midi_cc_slot_t * midi_cc_slot_get(app_usbd_midi_ctx_t * p_midi_ctx, uint32_t key)
+{
+    return &p_midi_ctx->cc_slot[(key ^ (key >> 7) ^ (key >> 15)) & (APP_USBD_MIDI_CONFIG_CC_SLOTS - 1)];
+}
+
+/**
+ * @brief Keep the next value of an MSB controller behind an LSB event packet.
+ *
+ * Controllers 1 to 31 have their LSB in controllers 33 to 63. Once an LSB is queued, a new
+ * MSB value may not overwrite the MSB queued before it: the host would get the new MSB
+ * first and then the old LSB, while it resets the LSB on every MSB. The slot of the MSB is
+ * forgotten, so its next value is queued behind the LSB.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] p_ev      Event packet about to be queued.
+ */
+static void midi_cc_lsb_put(app_usbd_midi_t const * p_midi, uint8_t const * p_ev)
+{
+    app_usbd_midi_cc_slot_t * p_slot;
+    uint32_t                  key;
+
+    if (((p_ev[1] & 0xF0) != 0xB0) || (p_ev[2] <= 32) || (p_ev[2] > 63))
+    {
+        return;
+    }
+    key    = p_ev[0] | ((uint32_t)p_ev[1] << 8) | ((uint32_t)(p_ev[2] - 32) << 16) | (1UL << 24);
+    p_slot = midi_cc_slot_get(midi_ctx_get(p_midi), key);
+    if (p_slot->key == key)
+    {
+        p_slot->key = 0;
+    }
+}
+
+/**
+ * @brief Queue a continuous controller event packet, latest value wins.
+ *
+ * If the previous event packet of the same controller is still waiting in the TX buffer,
+ * its value is overwritten in place. Otherwise the event packet is queued and remembered
+ * in @ref app_usbd_midi_ctx_t::cc_slot. The overwrite is done between
+ * @ref midi_tx_edit_begin and @ref midi_tx_edit_end, so no IN transfer claims the event
+ * packet while it is half written and no producer moves it.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] p_ev      Event packet.
+ * @param[in] key       Key returned by @ref midi_cc_key_get.
+ *
+ * @return Standard error code.
+ */
+static ret_code_t midi_cc_put(app_usbd_midi_t const * p_midi, uint8_t const * p_ev, uint32_t key)
+{
+    app_usbd_midi_ctx_t     * p_midi_ctx = midi_ctx_get(p_midi);
+    nrf_ringbuf_t const     * p_in_buf   = p_midi->specific.inst.p_in_buf;
+    app_usbd_midi_cc_slot_t * p_slot;
+    midi_tx_rsv_t             rsv;
+
+    p_slot = midi_cc_slot_get(p_midi_ctx, key);
+
+    if (midi_tx_edit_begin(p_midi))
+    {
+        /* Data before tmp_rd_idx is claimed by an IN transfer and may be sent already. */
+        bool queued = (p_slot->key == key) &&
+                      ((int32_t)(p_slot->pos - midi_ringbuf_unclaimed_idx(p_in_buf)) >= 0) &&
+                      ((int32_t)(midi_ringbuf_wr_idx(p_in_buf) - p_slot->pos) > 0);
+
+        if (queued)
+        {
+            memcpy(midi_ringbuf_at(p_in_buf, p_slot->pos), p_ev, USBD_MIDI_EVENT_SIZE);
+            p_midi_ctx->cc_coalesced++;
+        }
+        midi_tx_edit_end(p_midi);
+        if (queued)
+        {
+            return NRF_SUCCESS;
+        }
+    }
+
+    ret_code_t ret = midi_tx_admit(p_midi, &rsv, USBD_MIDI_EVENT_SIZE);
+    if (ret != NRF_SUCCESS)
+    {
+        return ret;
+    }
+    p_slot->key = key;
+    p_slot->pos = midi_ringbuf_wr_idx(p_in_buf);
+    memcpy(midi_tx_rsv_event(&rsv), p_ev, USBD_MIDI_EVENT_SIZE);
+    midi_tx_commit(p_midi, &rsv);
+    return NRF_SUCCESS;
+}
+#endif
+
+/**
+ * @brief Report event packets that thru could not forward.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] count     Number of dropped event packets.
+ */
+static void midi_thru_dropped(app_usbd_midi_t const * p_midi, size_t count)
+{
+#if APP_USBD_MIDI_CONFIG_STATS
+    midi_ctx_get(p_midi)->stats.thru_dropped += count;
+#else
+    UNUSED_PARAMETER(count);
+#endif
+    user_event_handler(app_usbd_midi_class_inst_get(p_midi), APP_USBD_MIDI_USER_EVT_THRU_DROPPED);
+}
+
+/**
+ * @brief Forward a received OUT packet to the TX buffer.
+ *
+ * The event packets of mapped cables are forwarded all together or not at all.
+ * If the TX buffer has no room for them they are dropped and reported.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] p_buf     Received event packets.
+ * @param[in] len       Number of received bytes.
+ *
+ * @retval NRF_SUCCESS      Event packets forwarded or dropped.
+ * @retval NRF_ERROR_BUSY   TX buffer is written in another context, nothing was forwarded.
+ */
+static ret_code_t midi_thru_buffer(app_usbd_midi_t const * p_midi, uint8_t const * p_buf, size_t len)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    midi_tx_rsv_t         rsv;
+    size_t                size       = len & ~(size_t)(USBD_MIDI_EVENT_SIZE - 1);
+    size_t                count      = size / USBD_MIDI_EVENT_SIZE;
+
+    if (!p_midi_ctx->thru_identity)
+    {
+        count = 0;
+        for (size_t pos = 0; pos < size; pos += USBD_MIDI_EVENT_SIZE)
+        {
+            if (p_midi_ctx->thru_map[p_buf[pos] >> 4] != APP_USBD_MIDI_THRU_NONE)
+            {
+                count++;
+            }
+        }
+    }
+    if (count == 0)
+    {
+        return NRF_SUCCESS;
+    }
+
+    ret_code_t ret = midi_tx_reserve(p_midi->specific.inst.p_in_buf, &rsv, count * USBD_MIDI_EVENT_SIZE);
+    if (ret == NRF_ERROR_BUSY)
+    {
+        return ret;
+    }
+    if (ret != NRF_SUCCESS)
+    {
+        midi_thru_dropped(p_midi, count);
+        return NRF_SUCCESS;
+    }
+
+    if (p_midi_ctx->thru_identity)
+    {
+        memcpy(rsv.p_span[0], p_buf, rsv.span_len[0]);
+        if (rsv.span_len[1] != 0)
+        {
+            memcpy(rsv.p_span[1], p_buf + rsv.span_len[0], rsv.span_len[1]);
+        }
+        rsv.pos = size;
+    }
+    else
+    {
+        for (size_t pos = 0; pos < size; pos += USBD_MIDI_EVENT_SIZE)
+        {
+            uint8_t cable = p_midi_ctx->thru_map[p_buf[pos] >> 4];
+
+            if (cable != APP_USBD_MIDI_THRU_NONE)
+            {
+                uint8_t * p_ev = midi_tx_rsv_event(&rsv);
+
+                p_ev[0] = (uint8_t)(cable << 4) | (p_buf[pos] & 0x0F);
+                p_ev[1] = p_buf[pos + 1];
+                p_ev[2] = p_buf[pos + 2];
+                p_ev[3] = p_buf[pos + 3];
+            }
+        }
+    }
+
+    midi_tx_commit(p_midi, &rsv);
+    return NRF_SUCCESS;
+}
+
+/**
+ * @brief Forward the RX buffer held back by thru.
+ *
+ * While an RX buffer is held it stays pinned and the OUT endpoint stays claimed, so the
+ * host gets NAKs and the order of forwarded event packets is kept. Called whenever a
+ * writer gives back the TX buffer write lock and on IN transfer completion.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_thru_retry(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t          * p_midi_ctx = midi_ctx_get(p_midi);
+    app_usbd_midi_rx_buf_t const * p_rx_buf   = p_midi->specific.inst.p_rx_buf;
+
+    if ((p_midi_ctx->thru_held == 0) || (nrf_atomic_flag_clear_fetch(&p_midi_ctx->thru_held) == 0))
+    {
+        return;
+    }
+
+    uint8_t idx = p_midi_ctx->thru_held_idx;
+
+    if (p_midi_ctx->thru_enabled &&
+        (midi_thru_buffer(p_midi, p_rx_buf->p_data + (idx * p_rx_buf->size), p_rx_buf->p_len[idx])
+         == NRF_ERROR_BUSY))
+    {
+        UNUSED_RETURN_VALUE(nrf_atomic_flag_set(&p_midi_ctx->thru_held));
+        return;
+    }
+
+    UNUSED_RETURN_VALUE(nrf_atomic_u32_sub(&p_rx_buf->p_pins[idx], 1));
+    UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->rx_armed));
+    midi_rx_reclaim(p_midi);
+}
+
+/**
+ * @brief Thru events queued while an RX buffer is parsed.
+ *
+ * Forwarded event packets are written to a single reservation of the TX buffer which is
+ * committed when the RX buffer is done, or before any user code is called.
+ */
+typedef struct
+{
+    midi_tx_rsv_t rsv;      //!< Reservation of the TX buffer
+    bool          open;     //!< Reservation is held
+    size_t        left;     //!< Bytes left in the RX buffer, size hint of the next reservation
+    size_t        dropped;  //!< Event packets dropped since the last flush
+} midi_thru_t;
+
+/**
+ * @brief Commit queued thru events and report the dropped ones.
+ *
+ * @param[in]     p_midi Midi class instance.
+ * @param[in,out] p_thru Thru events.
+ */
+static inline void midi_thru_flush(app_usbd_midi_t const * p_midi, midi_thru_t * p_thru)
+{
+    if (p_thru->open)
+    {
+        p_thru->open = false;
+        midi_tx_commit(p_midi, &p_thru->rsv);
+    }
+    if (p_thru->dropped != 0)
+    {
+        midi_thru_dropped(p_midi, p_thru->dropped);
+        p_thru->dropped = 0;
+    }
+}
+
+#if APP_USBD_MIDI_CONFIG_ROUTES
+/**
+ * @brief Forward an event packet to another cable.
+ *
+ * The event packet is dropped if the TX buffer is full or written by another context.
+ * Dropped event packets are reported by @ref midi_thru_flush.
+ *
+ * @param[in]     p_midi    Midi class instance.
+ * @param[in,out] p_thru    Thru events.
+ * @param[in]     p_ev      Received event packet.
+ * @param[in]     cable     Destination cable.
+ */
+static void midi_thru_put(app_usbd_midi_t const * p_midi,
+                          midi_thru_t *           p_thru,
+                          uint8_t const *         p_ev,
+                          uint8_t                 cable)
+{
+    if (p_thru->open && (p_thru->rsv.pos == midi_tx_rsv_size(&p_thru->rsv)))
+    {
+        /* More than one thru route for some event packets. */
+        midi_thru_flush(p_midi, p_thru);
+    }
+
+    if (!p_thru->open)
+    {
+        nrf_ringbuf_t const * p_in_buf = p_midi->specific.inst.p_in_buf;
+        size_t                size     = MIN(p_thru->left, midi_ringbuf_free_space(p_in_buf));
+
+        /* The rest of the RX buffer is a size hint, the event packet needs one slot. */
+        size &= ~(size_t)(USBD_MIDI_EVENT_SIZE - 1);
+        size  = MAX(size, USBD_MIDI_EVENT_SIZE);
+        if (midi_tx_reserve(p_in_buf, &p_thru->rsv, size) != NRF_SUCCESS)
+        {
+            p_thru->dropped++;
+            return;
+        }
+        p_thru->open = true;
+    }
+
+    uint8_t * p_out = midi_tx_rsv_event(&p_thru->rsv);
+
+    p_out[0] = (uint8_t)(cable << 4) | (p_ev[0] & 0x0F);
+    p_out[1] = p_ev[1];
+    p_out[2] = p_ev[2];
+    p_out[3] = p_ev[3];
+}
+
+/**
+ * @brief Pass a received event packet to matching routes.
+ *
+ * @param[in]     p_midi    Midi class instance.
+ * @param[in,out] p_thru    Thru events.
+ * @param[in]     p_ev      Event packet.
+ *
+ * @retval true  Event packet taken by at least one route.
+ * @retval false No route matches the event packet.
+ */
+static bool midi_rx_route(app_usbd_midi_t const * p_midi, midi_thru_t * p_thru, uint8_t * p_ev)
+{
+    app_usbd_midi_ctx_t *         p_midi_ctx = midi_ctx_get(p_midi);
+    uint8_t                       cin        = p_ev[0] & 0x0F;
+    uint8_t                       cable      = p_ev[0] >> 4;
+    uint8_t                       info       = m_midi_cin_info[cin];
+    app_usbd_midi_route_mask_t    routes     = p_midi_ctx->route_map[cable][cin];
+    app_usbd_midi_route_t const * p_route    = p_midi_ctx->p_routes;
+    uint16_t                      channel    = APP_USBD_MIDI_ROUTE_ALL;
+    bool                          is_msg;
+    bool                          routed     = false;
+
+    if (routes == 0)
+    {
+        return false;
+    }
+
+    if ((cin >= APP_USBD_MIDI_CIN_NOTE_OFF) && (cin <= APP_USBD_MIDI_CIN_PITCH_BEND))
+    {
+        channel = APP_USBD_MIDI_ROUTE_CHANNEL(p_ev[1] & 0x0F);
+    }
+    is_msg = (MIDI_CIN_INFO_ROLE(info) == MIDI_CIN_ROLE_MSG) ||
+             ((cin == APP_USBD_MIDI_CIN_SYSEX_END_1) && (p_ev[1] != 0xF7));
+
+    for (; routes != 0; routes >>= 1, p_route++)
+    {
+        if (((routes & 1) == 0) || ((p_route->channels & channel) == 0))
+        {
+            continue;
+        }
+
+        if (p_route->handler == NULL)
+        {
+            midi_thru_put(p_midi, p_thru, p_ev, p_route->thru_cable);
+            routed = true;
+        }
+        else if (is_msg)
+        {
+            app_usbd_midi_msg_t msg;
+
+            msg.p_data    = p_ev + 1;
+            msg.len       = MIDI_CIN_INFO_LEN(info);
+            msg.p_chain   = NULL;
+            msg.timestamp = p_midi_ctx->rx_stamp;
+
+            midi_thru_flush(p_midi, p_thru);
+            p_route->handler(app_usbd_midi_class_inst_get(p_midi), APP_USBD_MIDI_RX_DONE, cable, &msg);
+            routed = true;
+        }
+    }
+
+    return routed;
+}
+#endif
+
+/**
+ * @brief Pass the collected sysex span to the application.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_rx_span_flush(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t          * p_midi_ctx = midi_ctx_get(p_midi);
+    nrf_atomic_u32_t             * p_pins;
+
+    if (!p_midi_ctx->rx_span_open)
+    {
+        return;
+    }
+    p_midi_ctx->rx_span_open = false;
+
+    /* Pin before the call, the handler may release the span right away. */
+    p_pins = &p_midi->specific.inst.p_rx_buf->p_pins[p_midi_ctx->rx_span.buf];
+    UNUSED_RETURN_VALUE(nrf_atomic_u32_add(p_pins, 1));
+    if (!p_midi_ctx->sysex_span_handler(app_usbd_midi_class_inst_get(p_midi),
+                                        p_midi_ctx->rx_span_cable,
+                                        &p_midi_ctx->rx_span))
+    {
+        UNUSED_RETURN_VALUE(nrf_atomic_u32_sub(p_pins, 1));
+    }
+}
+
+/**
+ * @brief Add a sysex event packet to the span being collected.
+ *
+ * Consecutive sysex event packets of one cable are collected in a single span.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] p_ev      Event packet.
+ * @param[in] len       Number of sysex bytes in the event packet.
+ * @param[in] end       Event packet ends the system exclusive message.
+ */
+static void midi_rx_span_add(app_usbd_midi_t const * p_midi, uint8_t * p_ev, uint8_t len, bool end)
+{
+    app_usbd_midi_ctx_t          * p_midi_ctx = midi_ctx_get(p_midi);
+    app_usbd_midi_rx_buf_t const * p_rx_buf   = p_midi->specific.inst.p_rx_buf;
+    app_usbd_midi_sysex_span_t   * p_span     = &p_midi_ctx->rx_span;
+
+    if (!p_midi_ctx->rx_span_open)
+    {
+        p_span->p_ev  = p_ev;
+        p_span->count = 0;
+        p_span->len   = 0;
+        p_span->buf   = p_midi_ctx->rx_rd & (p_rx_buf->count - 1);
+        p_midi_ctx->rx_span_cable = p_ev[0] >> 4;
+        p_midi_ctx->rx_span_open  = true;
+    }
+
+    p_span->count++;
+    p_span->len += len;
+    p_span->end  = end;
+
+    if (end)
+    {
+        midi_rx_span_flush(p_midi);
+    }
+}
+
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL
+/**
+ * @brief Take a sysex block from the pool.
+ *
+ * @param[in] p_midi Midi class instance.
+ *
+ * @return Empty block or NULL if the pool is exhausted.
+ */
+static app_usbd_midi_sysex_block_t * midi_sysex_block_alloc(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t              * p_midi_ctx = midi_ctx_get(p_midi);
+    app_usbd_midi_sysex_pool_stats_t * p_stats    = &p_midi_ctx->sysex_pool_stats;
+    app_usbd_midi_sysex_block_t      * p_block    = nrf_balloc_alloc(p_midi->specific.inst.p_sysex_pool);
+
+    if (p_block == NULL)
+    {
+        p_stats->exhausted++;
+        return NULL;
+    }
+
+    uint32_t used = nrf_atomic_u32_add(&p_stats->used, 1);
+    if (used > p_stats->peak)
+    {
+        p_stats->peak = used;
+    }
+
+    p_block->p_next = NULL;
+    p_block->len    = 0;
+    return p_block;
+}
+
+/**
+ * @brief Append received sysex bytes to the pooled message of a cable.
+ *
+ * The complete message is passed to the rx handler as @ref APP_USBD_MIDI_SYSEX_RX_DONE
+ * with its chain of blocks. If the pool runs out the message is dropped.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] cable     Cable number.
+ * @param[in] p_data    Sysex bytes of the event packet.
+ * @param[in] len       Number of sysex bytes.
+ * @param[in] end       Event packet ends the message.
+ */
+static void midi_rx_sysex_pool(app_usbd_midi_t const * p_midi,
+                               uint8_t                 cable,
+                               uint8_t *               p_data,
+                               uint8_t                 len,
+                               bool                    end)
+{
+    app_usbd_midi_ctx_t         * p_midi_ctx = midi_ctx_get(p_midi);
+    app_usbd_midi_sysex_chain_t * p_chain    = &p_midi_ctx->sysex_chain[cable];
+
+    if (p_data[0] == 0xF0)
+    {
+        /* New message, drop the unterminated one. */
+        midi_sysex_chain_free(p_midi, p_chain->p_first);
+        memset(p_chain, 0, sizeof(*p_chain));
+    }
+
+    while ((len != 0) && !p_chain->drop)
+    {
+        app_usbd_midi_sysex_block_t * p_block = p_chain->p_last;
+
+        if ((p_block == NULL) || (p_block->len == sizeof(p_block->data)))
+        {
+            p_block = midi_sysex_block_alloc(p_midi);
+            if (p_block == NULL)
+            {
+                midi_sysex_chain_free(p_midi, p_chain->p_first);
+                p_chain->p_first = NULL;
+                p_chain->p_last  = NULL;
+                p_chain->drop    = true;
+                p_midi_ctx->sysex_pool_stats.dropped++;
+                break;
+            }
+
+            if (p_chain->p_last == NULL)
+            {
+                p_chain->p_first = p_block;
+            }
+            else
+            {
+                p_chain->p_last->p_next = p_block;
+            }
+            p_chain->p_last = p_block;
+        }
+
+        uint8_t n = (uint8_t)MIN(len, sizeof(p_block->data) - p_block->len);
+
+        memcpy(p_block->data + p_block->len, p_data, n);
+        p_block->len += n;
+        p_chain->len += n;
+        p_data       += n;
+        len          -= n;
+    }
+
+    if (end)
+    {
+        if (p_chain->p_first != NULL)
+        {
+            app_usbd_midi_msg_t msg;
+
+            msg.p_data    = p_chain->p_first->data;
+            msg.len       = p_chain->len;
+            msg.p_chain   = p_chain->p_first;
+            msg.timestamp = p_midi_ctx->rx_stamp;
+            user_rx_handler(app_usbd_midi_class_inst_get(p_midi), APP_USBD_MIDI_SYSEX_RX_DONE, cable, &msg);
+        }
+        memset(p_chain, 0, sizeof(*p_chain));
+    }
+}
+#endif
+
+#if APP_USBD_MIDI_CONFIG_SCHED_SIZE
+/**
+ * @brief Check if a scheduled event goes before another one.
+ *
+ * Times and sequence numbers are compared modulo 2^32.
+ */
+static inline bool midi_sched_before(app_usbd_midi_sched_ev_t const * p_a,
+                                     app_usbd_midi_sched_ev_t const * p_b)
+{
+    if (p_a->time != p_b->time)
+    {
+        return (int32_t)(p_a->time - p_b->time) < 0;
+    }
+    return (int32_t)(p_a->seq - p_b->seq) < 0;
+}
+
+/**
+ * @brief Add an event to the scheduler heap.
+ *
+ * Must be called by the owner of @ref app_usbd_midi_ctx_t::sched_lock.
+ *
+ * @param[in] p_midi_ctx    Midi class context.
+ * @param[in] p_ev          Event, @ref app_usbd_midi_sched_ev_t::seq is set here.
+ */
+static void midi_sched_push(app_usbd_midi_ctx_t * p_midi_ctx, app_usbd_midi_sched_ev_t * p_ev)
+{
+    app_usbd_midi_sched_ev_t * p_heap = p_midi_ctx->sched;
+    size_t                     pos    = p_midi_ctx->sched_count++;
+
+    p_ev->seq = p_midi_ctx->sched_seq++;
+    while (pos > 0)
+    {
+        size_t parent = (pos - 1) / 2;
+
+        if (!midi_sched_before(p_ev, &p_heap[parent]))
+        {
+            break;
+        }
+        p_heap[pos] = p_heap[parent];
+        pos         = parent;
+    }
+    p_heap[pos] = *p_ev;
+}
+
+/**
+ * @brief Remove the earliest event from the scheduler heap.
+ *
+ * Must be called by the owner of @ref app_usbd_midi_ctx_t::sched_lock.
+ *
+ * @param[in] p_midi_ctx Midi class context.
+ */
+static void midi_sched_pop(app_usbd_midi_ctx_t * p_midi_ctx)
+{
+    app_usbd_midi_sched_ev_t * p_heap = p_midi_ctx->sched;
+    size_t                     count  = --p_midi_ctx->sched_count;
+    app_usbd_midi_sched_ev_t * p_last = &p_heap[count];
+    size_t                     pos    = 0;
+
+    for (;;)
+    {
+        size_t child = (2 * pos) + 1;
+
+        if (child >= count)
+        {
+            break;
+        }
+        if ((child + 1 < count) && midi_sched_before(&p_heap[child + 1], &p_heap[child]))
+        {
+            child++;
+        }
+        if (!midi_sched_before(&p_heap[child], p_last))
+        {
+            break;
+        }
+        p_heap[pos] = p_heap[child];
+        pos         = child;
+    }
+    p_heap[pos] = *p_last;
+}
+
+/**
+ * @brief Move due scheduled events to the TX buffer.
+ *
+ * Events due before the next frame, see @ref APP_USBD_MIDI_CONFIG_SCHED_LEAD_US, are
+ * written with a single reservation. Events that do not fit stay for the next SOF.
+ *
+ * Must be called by the owner of @ref app_usbd_midi_ctx_t::sched_lock.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_sched_flush(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    nrf_ringbuf_t const * p_in_buf   = p_midi->specific.inst.p_in_buf;
+    uint32_t              limit      = midi_timestamp_get(p_midi) + APP_USBD_MIDI_CONFIG_SCHED_LEAD_US;
+    midi_tx_rsv_t         rsv;
+    size_t                size;
+
+    if ((p_midi_ctx->sched_count == 0) || ((int32_t)(p_midi_ctx->sched[0].time - limit) >= 0))
+    {
+        return;
+    }
+
+    size = MIN(p_midi_ctx->sched_count, midi_ringbuf_free_space(p_in_buf) / USBD_MIDI_EVENT_SIZE);
+    if ((size == 0) ||
+        (midi_tx_reserve(p_in_buf, &rsv, size * USBD_MIDI_EVENT_SIZE) != NRF_SUCCESS))
+    {
+        return;
+    }
+
+    while ((rsv.pos < size * USBD_MIDI_EVENT_SIZE) &&
+           (p_midi_ctx->sched_count != 0) &&
+           ((int32_t)(p_midi_ctx->sched[0].time - limit) < 0))
+    {
+        memcpy(midi_tx_rsv_event(&rsv), p_midi_ctx->sched[0].ev, USBD_MIDI_EVENT_SIZE);
+        midi_sched_pop(p_midi_ctx);
+    }
+
+    midi_tx_commit(p_midi, &rsv);
+}
+
+/**
+ * @brief Request release of due scheduled events.
+ *
+ * Called at SOF and after new events are scheduled. If the heap is being modified in
+ * another context the request is left in @ref app_usbd_midi_ctx_t::sched_pending and
+ * served by the owner of the heap when it is done.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static void midi_sched_release(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+    UNUSED_RETURN_VALUE(nrf_atomic_flag_set(&p_midi_ctx->sched_pending));
+    while ((p_midi_ctx->sched_pending != 0) &&
+           (nrf_atomic_flag_set_fetch(&p_midi_ctx->sched_lock) == 0))
+    {
+        UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->sched_pending));
+        midi_sched_flush(p_midi);
+        UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->sched_lock));
+    }
+}
+#endif
+
+/**
+ * @brief Parse a received event packet and pass it to the user.
+ *
+ * @param[in]     p_midi    Midi class instance.
+ * @param[in,out] p_thru    Thru events.
+ * @param[in]     p_ev      Event packet.
+ */
+static void midi_rx_event(app_usbd_midi_t const * p_midi, midi_thru_t * p_thru, uint8_t * p_ev)
+{
+    app_usbd_class_inst_t const * p_inst     = app_usbd_midi_class_inst_get(p_midi);
+    app_usbd_midi_ctx_t       * p_midi_ctx = midi_ctx_get(p_midi);
+    uint8_t                     cin        = p_ev[0] & 0x0F;
+    uint8_t                     cable      = p_ev[0] >> 4;
+    uint8_t                     info       = m_midi_cin_info[cin];
+    uint8_t                     len        = MIDI_CIN_INFO_LEN(info);
+    app_usbd_midi_sysex_buf_t * p_sysex    = &p_midi_ctx->sysex[cable];
+    app_usbd_midi_msg_t         msg        = { .p_chain = NULL, .timestamp = p_midi_ctx->rx_stamp };
+    bool                        is_sysex   = (MIDI_CIN_INFO_ROLE(info) == MIDI_CIN_ROLE_SYSEX) ||
+                                             ((MIDI_CIN_INFO_ROLE(info) == MIDI_CIN_ROLE_SYSEX_END) &&
+                                              ((cin != APP_USBD_MIDI_CIN_SYSEX_END_1) || (p_ev[1] == 0xF7)));
+
+#if APP_USBD_MIDI_CONFIG_STATS
+    p_midi_ctx->stats.rx_events[cable]++;
+    p_midi_ctx->stats.rx_cin[cin]++;
+#endif
+
+    if (p_midi_ctx->rx_span_open && (!is_sysex || (cable != p_midi_ctx->rx_span_cable)))
+    {
+        midi_rx_span_flush(p_midi);
+    }
+
+#if APP_USBD_MIDI_CONFIG_ROUTES
+    if (midi_rx_route(p_midi, p_thru, p_ev))
+    {
+        return;
+    }
+#endif
+    midi_thru_flush(p_midi, p_thru);
+
+    if (is_sysex && (p_midi_ctx->sysex_span_handler != NULL))
+    {
+        midi_rx_span_add(p_midi, p_ev, len, MIDI_CIN_INFO_ROLE(info) == MIDI_CIN_ROLE_SYSEX_END);
+        return;
+    }
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL
+    if (is_sysex)
+    {
+        midi_rx_sysex_pool(p_midi, cable, p_ev + 1, len, MIDI_CIN_INFO_ROLE(info) == MIDI_CIN_ROLE_SYSEX_END);
+        return;
+    }
+#endif
+
+    switch (MIDI_CIN_INFO_ROLE(info))
+    {
+        case MIDI_CIN_ROLE_SYSEX:
+            if (((p_sysex->left < len) && (p_sysex->p_data != NULL)) ||
+                ((p_ev[1] == 0xF0) && (p_sysex->p_data == NULL)))
+            {
+                msg.p_data = p_sysex->p_data;
+                msg.len    = p_sysex->pos;
+
+                user_rx_handler(p_inst, APP_USBD_MIDI_SYSEX_BUF_REQ, cable, &msg);
+
+                p_sysex->pos    = 0;
+                p_sysex->left   = msg.len;
+                p_sysex->p_data = msg.p_data;
+            }
+
+            if (p_sysex->p_data != NULL)
+            {
+                memcpy(p_sysex->p_data + p_sysex->pos, p_ev + 1, len);
+                p_sysex->pos  += len;
+                p_sysex->left -= len;
+            }
+            break;
+
+        case MIDI_CIN_ROLE_SYSEX_END:
+            if ((cin == APP_USBD_MIDI_CIN_SYSEX_END_1) && (p_ev[1] != 0xF7))
+            {
+                /* Single byte system common message. */
+                msg.p_data = p_ev + 1;
+                msg.len    = len;
+                user_rx_handler(p_inst, APP_USBD_MIDI_RX_DONE, cable, &msg);
+                break;
+            }
+
+            if ((p_sysex->left < len) && (p_sysex->p_data != NULL))
+            {
+                msg.p_data = p_sysex->p_data;
+                msg.len    = p_sysex->pos;
+
+                user_rx_handler(p_inst, APP_USBD_MIDI_SYSEX_BUF_REQ, cable, &msg);
+
+                p_sysex->pos    = 0;
+                p_sysex->left   = msg.len;
+                p_sysex->p_data = msg.p_data;
+            }
+
+            if (p_sysex->p_data != NULL)
+            {
+                memcpy(p_sysex->p_data + p_sysex->pos, p_ev + 1, len);
+                p_sysex->pos += len;
+
+                msg.p_data = p_sysex->p_data;
+                msg.len    = p_sysex->pos;
+
+                user_rx_handler(p_inst, APP_USBD_MIDI_SYSEX_RX_DONE, cable, &msg);
+
+                p_sysex->pos    = 0;
+                p_sysex->left   = 0;
+                p_sysex->p_data = NULL;
+            }
+            break;
+
+        case MIDI_CIN_ROLE_MSG:
+            msg.p_data = p_ev + 1;
+            msg.len    = len;
+            user_rx_handler(p_inst, APP_USBD_MIDI_RX_DONE, cable, &msg);
+            break;
+
+        default:
+            break;
+    }
+}
+
+#if APP_USBD_MIDI_CONFIG_UMP
+/**
+ * @brief Collect a received Universal MIDI Packet and pass it to the user.
+ *
+ * A packet split between two RX buffers is completed from the next one.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] p_buf     Received data at the parse position.
+ * @param[in] left      Number of bytes left in the RX buffer, at least one word.
+ *
+ * @return Number of bytes used.
+ */
+static size_t midi_rx_ump(app_usbd_midi_t const * p_midi, uint8_t const * p_buf, size_t left)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    uint32_t            * p_ump      = p_midi_ctx->rx_ump;
+    size_t                used       = 0;
+    size_t                size;
+    uint8_t               words;
+
+    if (p_midi_ctx->rx_ump_fill == 0)
+    {
+        memcpy(&p_ump[0], p_buf, sizeof(p_ump[0]));
+        p_midi_ctx->rx_ump_fill = 1;
+        used = sizeof(p_ump[0]);
+    }
+
+    words = app_usbd_midi_ump_words_get(p_ump[0]);
+    size  = MIN((words - p_midi_ctx->rx_ump_fill) * sizeof(p_ump[0]),
+                (left - used) & ~(sizeof(p_ump[0]) - 1));
+    memcpy(&p_ump[p_midi_ctx->rx_ump_fill], p_buf + used, size);
+    p_midi_ctx->rx_ump_fill += size / sizeof(p_ump[0]);
+    used += size;
+
+    if (p_midi_ctx->rx_ump_fill == words)
+    {
+        p_midi_ctx->rx_ump_fill = 0;
+#if APP_USBD_MIDI_CONFIG_STATS
+        p_midi_ctx->stats.rx_events[APP_USBD_MIDI_UMP_GROUP_GET(p_ump[0])]++;
+        p_midi_ctx->stats.rx_cin[APP_USBD_MIDI_UMP_MT_GET(p_ump[0])]++;
+#endif
+        if (p_midi_ctx->ump_handler != NULL)
+        {
+            MIDI_TRACE(RX_CB_ENTER, words);
+            p_midi_ctx->ump_handler(app_usbd_midi_class_inst_get(p_midi), p_ump, words, p_midi_ctx->rx_stamp);
+            MIDI_TRACE(RX_CB_EXIT, words);
+        }
+    }
+    return used;
+}
+#endif
+
+/**
+ * @brief Parse received RX buffers and release them.
+ *
+ * @param[in] p_midi Midi class instance.
+ * @param[in] budget Maximum number of event packets to parse.
+ *
+ * @retval true  Budget exhausted while there are event packets left to parse.
+ * @retval false All received event packets parsed.
+ */
+static bool midi_rx_process(app_usbd_midi_t const * p_midi, size_t budget)
+{
+    app_usbd_midi_ctx_t          * p_midi_ctx = midi_ctx_get(p_midi);
+    app_usbd_midi_rx_buf_t const * p_rx_buf   = p_midi->specific.inst.p_rx_buf;
+    midi_thru_t                    thru       = { .open = false, .dropped = 0 };
+
+    while (p_midi_ctx->rx_rd != p_midi_ctx->rx_wr)
+    {
+        uint8_t   idx   = p_midi_ctx->rx_rd & (p_rx_buf->count - 1);
+        uint8_t * p_buf = p_rx_buf->p_data + (idx * p_rx_buf->size);
+        size_t    len   = p_rx_buf->p_len[idx];
+
+        p_midi_ctx->rx_stamp = p_rx_buf->p_stamp[idx];
+        while (p_midi_ctx->rx_pos + USBD_MIDI_EVENT_SIZE <= len)
+        {
+            if (budget == 0)
+            {
+                midi_thru_flush(p_midi, &thru);
+                midi_rx_span_flush(p_midi);
+                return true;
+            }
+            budget--;
+
+#if APP_USBD_MIDI_CONFIG_UMP
+            if (midi_ump_active(p_midi_ctx))
+            {
+                p_midi_ctx->rx_pos += midi_rx_ump(p_midi, p_buf + p_midi_ctx->rx_pos, len - p_midi_ctx->rx_pos);
+                continue;
+            }
+#endif
+            thru.left = len - p_midi_ctx->rx_pos;
+            midi_rx_event(p_midi, &thru, p_buf + p_midi_ctx->rx_pos);
+            p_midi_ctx->rx_pos += USBD_MIDI_EVENT_SIZE;
+        }
+
+        midi_thru_flush(p_midi, &thru);
+        midi_rx_span_flush(p_midi);
+        p_midi_ctx->rx_pos = 0;
+        p_midi_ctx->rx_rd++;
+        midi_rx_reclaim(p_midi);
+    }
+    return false;
+}
+
+/**
+ * @brief Class specific endpoint transfer handler.
+ *
+ * @param[in] p_inst        Generic class instance.
+ * @param[in] p_setup_ev    Setup event.
+ *
+ * @return Standard error code.
+ */
+static ret_code_t midi_endpoint_ev(app_usbd_class_inst_t const *  p_inst,
+                                   app_usbd_complex_evt_t const * p_event)
+{
+    app_usbd_midi_t const * p_midi     = midi_get(p_inst);
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    ret_code_t ret = NRF_ERROR_NOT_SUPPORTED;
+
+
+    if (NRF_USBD_EPIN_CHECK(p_event->drv_evt.data.eptransfer.ep))
+    {
+        MIDI_TRACE(IN_DONE, p_event->drv_evt.data.eptransfer.status);
+        switch (p_event->drv_evt.data.eptransfer.status)
+        {
+            case NRF_USBD_EP_OK:
+#if APP_USBD_MIDI_CONFIG_STATS
+                midi_tx_stats(p_midi);
+#endif
+                midi_tx_continue(p_midi);
+#if APP_USBD_MIDI_CONFIG_TX_ADMISSION
+                midi_tx_wm_update(p_midi);
+#endif
+                midi_sysex_pump(p_midi);
+                midi_thru_retry(p_midi);
+                user_event_handler(p_inst, APP_USBD_MIDI_USER_EVT_TX_DONE);
+                return NRF_SUCCESS;
+
+            case NRF_USBD_EP_ABORTED:
+#if APP_USBD_MIDI_CONFIG_STATS
+                p_midi_ctx->stats.tx_aborted++;
+#endif
+                if (p_midi_ctx->in_aborts != 0)
+                {
+                    /* Transfer of a previous setting, see @ref midi_ep_disable. */
+                    p_midi_ctx->in_aborts--;
+                    return NRF_SUCCESS;
+                }
+                midi_tx_release(p_midi);
+                UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->sending));
+                return NRF_SUCCESS;
+            default:
+                return NRF_ERROR_INTERNAL;
+        }
+    }
+
+    if (NRF_USBD_EPOUT_CHECK(p_event->drv_evt.data.eptransfer.ep))
+    {
+        switch (p_event->drv_evt.data.eptransfer.status)
         {
             case NRF_USBD_EP_OK:
             {
-                size_t len = 4;
-                size_t len_total = 0;
-                uint8_t p_buffer[64];
+                app_usbd_midi_rx_buf_t const * p_rx_buf = p_midi->specific.inst.p_rx_buf;
+                uint8_t                        idx      = p_midi_ctx->rx_wr & (p_rx_buf->count - 1);
+
+                bool                           held     = false;
+
+#if APP_USBD_MIDI_CONFIG_TIMESTAMP
+                p_rx_buf->p_stamp[idx] = midi_timestamp_get(p_midi);
+#endif
+
+                MIDI_TRACE(OUT_DONE, p_midi_ctx->rx_fill);
+                p_rx_buf->p_len[idx] = p_midi_ctx->rx_fill;
+#if APP_USBD_MIDI_CONFIG_STATS
+                p_midi_ctx->stats.rx_bytes += p_midi_ctx->rx_fill;
+                p_midi_ctx->stats.rx_transfers++;
+#endif
+                if (p_midi_ctx->thru_enabled && !midi_ump_active(p_midi_ctx) &&
+                    (midi_thru_buffer(p_midi, p_rx_buf->p_data + (idx * p_rx_buf->size), p_midi_ctx->rx_fill)
+                     == NRF_ERROR_BUSY))
+                {
+                    /* A writer holds the TX buffer. Keep the buffer and the endpoint until
+                     * the writer is done, see @ref midi_thru_retry. */
+                    UNUSED_RETURN_VALUE(nrf_atomic_u32_add(&p_rx_buf->p_pins[idx], 1));
+                    p_midi_ctx->thru_held_idx = idx;
+                    held = true;
+                }
+
+                /* Length has to be visible before the buffer is published. */
+                __DMB();
+                p_midi_ctx->rx_wr++;
+                if (held)
+                {
+                    UNUSED_RETURN_VALUE(nrf_atomic_flag_set(&p_midi_ctx->thru_held));
+                }
+                else
+                {
+                    UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->rx_armed));
+
+                    /* Let the DMA fill the next buffer while this one is parsed. */
+                    midi_rx_arm(p_midi);
+                }
+#if (APP_USBD_MIDI_CONFIG_RX_DEFERRED == 0)
+                UNUSED_RETURN_VALUE(midi_rx_process(p_midi, SIZE_MAX));
+#endif
+                return NRF_SUCCESS;
+            }
+            case NRF_USBD_EP_ABORTED:
+#if APP_USBD_MIDI_CONFIG_STATS
+                p_midi_ctx->stats.rx_aborted++;
+#endif
+                if (p_midi_ctx->out_aborts != 0)
+                {
+                    p_midi_ctx->out_aborts--;
+                    return NRF_SUCCESS;
+                }
+                UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->rx_armed));
+                return NRF_SUCCESS;
+            case NRF_USBD_EP_WAITING:
+                return NRF_SUCCESS;
+            default:
+                return NRF_ERROR_INTERNAL;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief @ref app_usbd_class_methods_t::event_handler
+ */
+static ret_code_t midi_event_handler(
+    app_usbd_class_inst_t const  * p_inst,
+    app_usbd_complex_evt_t const * p_event)
+{
+    ASSERT(p_inst != NULL);
+    ASSERT(p_event != NULL);
+
+    ret_code_t ret = NRF_SUCCESS;
+    switch (p_event->app_evt.type)
+    {
+#if APP_USBD_MIDI_SOF_USED
+        case APP_USBD_EVT_DRV_SOF:
+#if APP_USBD_MIDI_CONFIG_TIMESTAMP
+            midi_sof_event(midi_get(p_inst), p_event->drv_evt.data.sof.framecnt);
+#endif
+#if APP_USBD_MIDI_CONFIG_SCHED_SIZE
+            midi_sched_release(midi_get(p_inst));
+#endif
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE
+            midi_tx_sof(midi_get(p_inst));
+#endif
+            break;
+#endif
+
+        case APP_USBD_EVT_DRV_RESET:
+            break;
+
+        case APP_USBD_EVT_DRV_SETUP:
+            ret = setup_event_handler(p_inst, (app_usbd_setup_evt_t const *)p_event);
+            break;
+
+        case APP_USBD_EVT_DRV_EPTRANSFER:
+            ret = midi_endpoint_ev(p_inst, p_event);
+            break;
+
+        case APP_USBD_EVT_DRV_SUSPEND:
+            break;
+
+        case APP_USBD_EVT_DRV_RESUME:
+            break;
+
+        case APP_USBD_EVT_INST_APPEND:
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL
+            ret = nrf_balloc_init(midi_get(p_inst)->specific.inst.p_sysex_pool);
+#endif
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE
+            midi_ctx_get(midi_get(p_inst))->tx_coalesce = APP_USBD_MIDI_CONFIG_TX_COALESCE_THRESHOLD;
+#endif
+#if APP_USBD_MIDI_CONFIG_TRACE_SIZE
+            /* Start the cycle counter used by trace records. */
+            CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+            DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+#if APP_USBD_MIDI_CONFIG_TX_ADMISSION
+            midi_ctx_get(midi_get(p_inst))->tx_overflow =
+                (app_usbd_midi_overflow_t)APP_USBD_MIDI_CONFIG_TX_OVERFLOW;
+#endif
+#if APP_USBD_MIDI_SOF_USED
+            if (ret == NRF_SUCCESS)
+            {
+                ret = app_usbd_class_sof_register(p_inst);
+            }
+#endif
+            break;
+
+        case APP_USBD_EVT_INST_REMOVE:
+            break;
+
+        case APP_USBD_EVT_STARTED:
+            break;
+
+        case APP_USBD_EVT_STOPPED:
+            break;
+
+        case APP_USBD_EVT_STATE_CHANGED:
+            break;
+
+        default:
+            ret = NRF_ERROR_NOT_SUPPORTED;
+            break;
+    }
 
-                while ((len != 0) && (len_total < 64))
-                {
-                    nrf_ringbuf_cpy_get(p_midi->specific.inst.p_in_buf, 
-                    (p_buffer + len_total), &len);
+    return ret;
+}
 
-                    len_total += len;
-                }
+static size_t midi_get_descriptor_size(app_usbd_midi_subclass_desc_t const * p_dsc)
+{
+    if (p_dsc == NULL)
+    {
+        return 0;
+    }
 
-                if (len_total) {
-                    NRF_DRV_USBD_TRANSFER_IN(transfer, p_buffer, len_total);
-                    app_usbd_ep_transfer(NRF_DRV_USBD_EPIN1, &transfer);                
-                } else {
-                    p_midi_ctx->sending = false;
-                }
+    return p_dsc->size;
+}
 
-                user_event_handler(p_inst, APP_USBD_MIDI_USER_EVT_TX_DONE);
-                return NRF_SUCCESS;
-            }
+/**
+ * @brief Get a byte of the midi streaming descriptors.
+ *
+ * Endpoint addresses in the standard endpoint descriptors are replaced by the endpoints
+ * of the instance, so one descriptor may be shared by several instances.
+ *
+ * @param[in] p_inst    Generic class instance.
+ * @param[in] p_dsc     Descriptors of one alternate setting.
+ * @param[in] cur_byte  Offset of the byte.
+ *
+ * @return Descriptor byte.
+ */
+static uint8_t midi_get_descriptor_data(app_usbd_class_inst_t const *         p_inst,
+                                        app_usbd_midi_subclass_desc_t const * p_dsc,
+                                        uint32_t                              cur_byte)
+{
+    uint8_t const * p_data = p_dsc->p_data;
+    uint32_t        start  = 0;
 
-                
-            case NRF_USBD_EP_ABORTED:
-                return NRF_SUCCESS;
-            default:
-                return NRF_ERROR_INTERNAL;
+    /* Find the descriptor containing the byte. */
+    while ((p_data[start] != 0) && (start + p_data[start] <= cur_byte))
+    {
+        start += p_data[start];
+    }
+
+    if ((cur_byte == start + 2) && (p_data[start + 1] == APP_USBD_DESCRIPTOR_ENDPOINT))
+    {
+        return NRF_USBD_EPIN_CHECK(p_data[cur_byte]) ? ep_in_addr_get(p_inst) :
+                                                       ep_out_addr_get(p_inst);
+    }
+
+    return p_data[cur_byte];
+}
+
+/**
+ * @brief @ref app_usbd_class_methods_t::feed_descriptors
+ */
+static bool midi_feed_descriptors(app_usbd_class_descriptor_ctx_t * p_ctx,
+                                   app_usbd_class_inst_t const     * p_inst,
+                                   uint8_t                         * p_buff,
+                                   size_t                            max_size)
+{
+    app_usbd_midi_t const *             p_midi         = midi_get(p_inst);
+    app_usbd_midi_ctx_t *               p_midi_ctx     = midi_ctx_get(p_midi);
+    app_usbd_class_iface_conf_t const * p_ctrl_iface   =
+        app_usbd_class_iface_get(p_inst, APP_USBD_AUDIO_CONTROL_IFACE_IDX);
+    app_usbd_class_iface_conf_t const * p_stream_iface =
+        app_usbd_class_iface_get(p_inst, APP_USBD_MIDI_STREAMING_IFACE_IDX);
+
+    ASSERT(app_usbd_class_iface_count_get(p_inst) == 2);
+
+    APP_USBD_CLASS_DESCRIPTOR_BEGIN(p_ctx, p_buff, max_size);
+
+    /* CONTROL INTERFACE DESCRIPTOR */
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x09); // bLength
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_DESCRIPTOR_INTERFACE); // bDescriptorType = Interface
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(app_usbd_class_iface_number_get(p_ctrl_iface)); // bInterfaceNumber
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x00); // bAlternateSetting
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(app_usbd_class_iface_ep_count_get(p_ctrl_iface)); // bNumEndpoints
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_CLASS); // bInterfaceClass = Audio
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_SUBCLASS_AUDIOCONTROL); // bInterfaceSubclass (Audio Control)
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_CLASS_PROTOCOL_UNDEFINED); // bInterfaceProtocol
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x00); // iInterface
+
+    /* HEADER INTERFACE */
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x09); // bLength
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_DESCRIPTOR_INTERFACE); // bDescriptorType = Audio Interfaces
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_AC_IFACE_SUBTYPE_HEADER); // bDescriptorSubtype = Header
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(LSB_16(0x0100)); // bcdADC LSB
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(MSB_16(0x0100)); // bcdADC MSB
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(LSB_16(9)); // wTotalLength LSB, header only
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(MSB_16(9)); // wTotalLength MSB
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x01); // bInCollection
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(app_usbd_class_iface_number_get(p_stream_iface)); // baInterfaceNr(1)
+
+    /* STREAM INTERFACE DESCRIPTOR ALT 0 */
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x09); // bLength
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_DESCRIPTOR_INTERFACE); // bDescriptorType = Interface
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(app_usbd_class_iface_number_get(p_stream_iface)); // bInterfaceNumber
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x00); // bAlternateSetting
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(app_usbd_class_iface_ep_count_get(p_stream_iface)); // bNumEndpoints
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_CLASS); // bInterfaceClass = Audio
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(p_midi->specific.inst.type_streaming); // bInterfaceSubclass (Audio Control)
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_CLASS_PROTOCOL_UNDEFINED); // bInterfaceProtocol
+    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x00); // iInterface
+
+    if (p_midi->specific.inst.type_streaming == APP_USBD_AUDIO_SUBCLASS_MIDISTREAMING)
+    {
+        /* The loop counter lives in the instance context, the feed may be resumed
+         * in the middle of the loop. */
+        for (p_midi_ctx->desc_pos = 0;
+             p_midi_ctx->desc_pos < midi_get_descriptor_size(p_midi->specific.inst.p_midi_dsc);
+             p_midi_ctx->desc_pos++)
+        {
+            APP_USBD_CLASS_DESCRIPTOR_WRITE(midi_get_descriptor_data(p_inst,
+                                                                     p_midi->specific.inst.p_midi_dsc,
+                                                                     p_midi_ctx->desc_pos));
         }
     }
 
-    if (NRF_USBD_EPOUT_CHECK(p_event->drv_evt.data.eptransfer.ep))
+#if APP_USBD_MIDI_CONFIG_UMP
+    if (p_midi_ctx->p_ump_dsc != NULL)
     {
-        switch (p_event->drv_evt.data.eptransfer.status)
+        /* STREAM INTERFACE DESCRIPTOR ALT 1, USB-MIDI 2.0 */
+        APP_USBD_CLASS_DESCRIPTOR_WRITE(0x09); // bLength
+        APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_DESCRIPTOR_INTERFACE); // bDescriptorType = Interface
+        APP_USBD_CLASS_DESCRIPTOR_WRITE(app_usbd_class_iface_number_get(p_stream_iface)); // bInterfaceNumber
+        APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_MIDI_STREAMING_ALT_UMP); // bAlternateSetting
+        APP_USBD_CLASS_DESCRIPTOR_WRITE(app_usbd_class_iface_ep_count_get(p_stream_iface)); // bNumEndpoints
+        APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_CLASS); // bInterfaceClass = Audio
+        APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_SUBCLASS_MIDISTREAMING); // bInterfaceSubclass
+        APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_CLASS_PROTOCOL_UNDEFINED); // bInterfaceProtocol
+        APP_USBD_CLASS_DESCRIPTOR_WRITE(0x00); // iInterface
+
+        for (p_midi_ctx->desc_pos = 0;
+             p_midi_ctx->desc_pos < midi_get_descriptor_size(p_midi_ctx->p_ump_dsc);
+             p_midi_ctx->desc_pos++)
         {
-            case NRF_USBD_EP_OK:
-            {   
-                uint8_t *buf;
-                uint8_t *buf_temp;
-                uint8_t len;
-                uint8_t cin;
-                uint8_t cable;
-                app_usbd_midi_msg_t msg;
-
-                nrf_drv_usbd_handler_desc_t handler_desc = {
-                    .handler.consumer = midi_consumer,
-                    .p_context        = p_midi_ctx
-                };
-
-                buf_temp = p_midi_ctx->rx_transfer[p_midi_ctx->rx_buf].data;
-                len = p_midi_ctx->rx_transfer[p_midi_ctx->rx_buf].len;
-                app_usbd_ep_handled_transfer(NRF_DRV_USBD_EPOUT1, &handler_desc);
-
-                for (size_t i = 0; i < len; i += 4)
-                {
-                    buf = buf_temp + i;
-                    cin = (*buf) & 0xF;
-                    cable = (*buf) >> 4;
+            APP_USBD_CLASS_DESCRIPTOR_WRITE(midi_get_descriptor_data(p_inst,
+                                                                     p_midi_ctx->p_ump_dsc,
+                                                                     p_midi_ctx->desc_pos));
+        }
+    }
+#endif
 
-                    switch (cin)
-                    {
-                    case 0x4:
-                    {
-                        msg.p_data = p_midi_ctx->sysex[cable].p_data,
-                        msg.len = p_midi_ctx->sysex[cable].pos;
-                        
-                        if (((p_midi_ctx->sysex[cable].left < 3) && msg.p_data != NULL) || 
-                            (*(buf + 1) == 0xF0 && msg.p_data == NULL)) 
-                        {
-                            user_rx_handler(p_inst,
-                                    APP_USBD_MIDI_SYSEX_BUF_REQ,
-                                    cable, 
-                                    &msg);
-  
-                            p_midi_ctx->sysex[cable].pos = 0;
-                            p_midi_ctx->sysex[cable].left = msg.len;
-                            p_midi_ctx->sysex[cable].p_data = msg.p_data;
-                        }
-
-                        if (p_midi_ctx->sysex[cable].p_data != NULL)
-                        {
-                            memcpy(p_midi_ctx->sysex[cable].p_data + p_midi_ctx->sysex[cable].pos, buf + 1, 3); 
-                            p_midi_ctx->sysex[cable].pos += 3;
-                            p_midi_ctx->sysex[cable].left -= 3;
-                        }
-                        break;
-                    }
-                    case 0x5:
-                        if (*(buf + 1) == 0xF6)
-                        {
-                            msg.p_data = buf + 1;
-                            msg.len = 1;
-                            user_rx_handler(p_inst, APP_USBD_MIDI_RX_DONE, cable, &msg);
-                            break;
-                        }
-                    case 0x6:
-                    case 0x7:
-                        if (p_midi_ctx->sysex[cable].left < cin-4 && p_midi_ctx->sysex[cable].p_data != NULL) 
-                        {
-                            msg.p_data = p_midi_ctx->sysex[cable].p_data,
-                            msg.len = p_midi_ctx->sysex[cable].pos;
-
-                            user_rx_handler(p_inst, APP_USBD_MIDI_SYSEX_BUF_REQ, cable, &msg);
-
-                            p_midi_ctx->sysex[cable].pos = 0;
-                            p_midi_ctx->sysex[cable].left = msg.len;
-                            p_midi_ctx->sysex[cable].p_data = msg.p_data;
-                        }
-
-                        if (p_midi_ctx->sysex[cable].p_data != NULL)
-                        {
-                            memcpy(p_midi_ctx->sysex[cable].p_data + p_midi_ctx->sysex[cable].pos, buf + 1, cin-4);
-                            p_midi_ctx->sysex[cable].pos += cin-4;
-
-                            msg.p_data = p_midi_ctx->sysex[cable].p_data,
-                            msg.len = p_midi_ctx->sysex[cable].pos;
-
-                            user_rx_handler(p_inst, APP_USBD_MIDI_SYSEX_RX_DONE, cable, &msg);
-
-                            p_midi_ctx->sysex[cable].pos = 0;
-                            p_midi_ctx->sysex[cable].left = 0;
-                            p_midi_ctx->sysex[cable].p_data = NULL;
-                        }
-                        break;
-                    case 0xF:
-                        msg.p_data = buf + 1;
-                        msg.len = 1;
-                        user_rx_handler(p_inst, APP_USBD_MIDI_RX_DONE, cable, &msg);
-                        break;
-                    case 0x2:
-                    case 0xC:
-                    case 0xD:
-                        msg.p_data = buf + 1;
-                        msg.len = 2;
-                        user_rx_handler(p_inst, APP_USBD_MIDI_RX_DONE, cable, &msg);
-                        break;
-                    default:
-                        msg.p_data = buf + 1;
-                        msg.len = 3;
-                        user_rx_handler(p_inst, APP_USBD_MIDI_RX_DONE, cable, &msg);
-                        break;
-                    }
-                }
-                return NRF_SUCCESS;
-                
+    APP_USBD_CLASS_DESCRIPTOR_END();
+}
+
+const app_usbd_class_methods_t app_usbd_midi_class_methods = {
+    .event_handler       = midi_event_handler,
+    .feed_descriptors    = midi_feed_descriptors,
+    .iface_select        = iface_select,
+    .iface_deselect      = iface_deselect,
+    .iface_selection_get = iface_selection_get,
+};
+
+/**
+ * @brief Get Code Index Number of a complete midi message.
+ *
+ * @param[in] status Status byte of the message.
+ *
+ * @return Code Index Number.
+ */
+static inline uint8_t midi_cin_get(uint8_t status)
+{
+    return MIDI_STATUS_INFO_CIN(m_midi_status_info[status]);
+}
+
+/**
+ * @brief Get length of a midi message from its status byte.
+ *
+ * @param[in] status Status byte of the message.
+ *
+ * @return Length of the message including status byte, 0 for system exclusive
+ *         and undefined status bytes.
+ */
+static inline uint8_t midi_msg_len_get(uint8_t status)
+{
+    return MIDI_STATUS_INFO_LEN(m_midi_status_info[status]);
+}
+
+/**
+ * @brief Pack a complete midi message into an event packet.
+ *
+ * @param[out] p_ev     Event packet, @ref USBD_MIDI_EVENT_SIZE bytes.
+ * @param[in]  cable    Cable number.
+ * @param[in]  p_msg    Midi message.
+ * @param[in]  len      Length of the message, 1 to 3 bytes.
+ */
+static inline void midi_event_pack(uint8_t *       p_ev,
+                                   uint8_t         cable,
+                                   uint8_t const * p_msg,
+                                   size_t          len)
+{
+    p_ev[0] = (uint8_t)(cable << 4) | midi_cin_get(p_msg[0]);
+    p_ev[1] = p_msg[0];
+    p_ev[2] = (len > 1) ? p_msg[1] : 0;
+    p_ev[3] = (len > 2) ? p_msg[2] : 0;
+}
+
+/**
+ * @brief Write an event packet built from a byte stream to a reservation.
+ *
+ * @param[in,out] p_rsv     Reservation.
+ * @param[in]     cable     Cable number.
+ * @param[in]     cin       Code Index Number.
+ * @param[in]     p_data    Midi bytes of the event.
+ * @param[in]     len       Number of midi bytes, 1 to 3.
+ */
+static void midi_stream_emit(midi_tx_rsv_t * p_rsv,
+                             uint8_t         cable,
+                             uint8_t         cin,
+                             uint8_t const * p_data,
+                             uint8_t         len)
+{
+    uint8_t * p_ev = midi_tx_rsv_event(p_rsv);
+
+    p_ev[0] = (uint8_t)(cable << 4) | cin;
+    p_ev[1] = p_data[0];
+    p_ev[2] = (len > 1) ? p_data[1] : 0;
+    p_ev[3] = (len > 2) ? p_data[2] : 0;
+}
+
+/**
+ * @brief Check if the stream encoder holds sysex bytes that are not in an event packet yet.
+ *
+ * @param[in] p_st Stream encoder state of a cable.
+ */
+static inline bool midi_stream_sysex_pending(app_usbd_midi_stream_t const * p_st)
+{
+    return (p_st->status == 0xF0) && (p_st->pos > 0);
+}
+
+/**
+ * @brief Feed one byte of a midi byte stream to the stream encoder.
+ *
+ * Every byte produces at most one event packet, except a tune request ending a system
+ * exclusive message with pending bytes, see @ref midi_stream_sysex_pending, which
+ * produces the sysex end and its own event packet. The pending bytes produced nothing
+ * when they were fed, so a run of n bytes produces at most n event packets, plus one if
+ * sysex bytes were pending before the run.
+ *
+ * @param[in,out] p_st      Stream encoder state of the cable.
+ * @param[in,out] p_rsv     Reservation the event packets are written to.
+ * @param[in]     cable     Cable number.
+ * @param[in]     byte      Next byte of the stream.
+ */
+static void midi_stream_byte(app_usbd_midi_t const  * p_midi,
+                             app_usbd_midi_stream_t * p_st,
+                             midi_tx_rsv_t          * p_rsv,
+                             uint8_t                  cable,
+                             uint8_t                  byte)
+{
+    if (byte >= 0xF8)
+    {
+        /* Real-time messages may appear anywhere and do not affect the stream state. */
+#if APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+        if (midi_rt_put(p_midi, cable, byte) == NRF_SUCCESS)
+        {
+            return;
+        }
+#else
+        UNUSED_PARAMETER(p_midi);
+#endif
+        midi_stream_emit(p_rsv, cable, APP_USBD_MIDI_CIN_SINGLE_BYTE, &byte, 1);
+        return;
+    }
+
+    if (byte & 0x80)
+    {
+        if (p_st->status == 0xF0)
+        {
+            /* Any status byte terminates system exclusive message. */
+            if (byte == 0xF7)
+            {
+                p_st->data[p_st->pos++] = byte;
             }
-            case NRF_USBD_EP_WAITING:
-            case NRF_USBD_EP_ABORTED:
-                return NRF_SUCCESS;
-            default:
-                return NRF_ERROR_INTERNAL;
+            if (p_st->pos > 0)
+            {
+                midi_stream_emit(p_rsv, cable, APP_USBD_MIDI_CIN_SYSEX + p_st->pos, p_st->data, p_st->pos);
+            }
+            p_st->status = 0;
+            p_st->pos    = 0;
+            if (byte == 0xF7)
+            {
+                return;
+            }
+        }
+
+        p_st->data[0] = byte;
+        p_st->pos     = 1;
+        p_st->status  = byte;
+        p_st->len     = midi_msg_len_get(byte);
+
+        if (byte == 0xF0)
+        {
+            return;
+        }
+        if (p_st->len == 1)
+        {
+            midi_stream_emit(p_rsv, cable, midi_cin_get(byte), &byte, 1);
+        }
+        if (p_st->len <= 1)
+        {
+            /* Complete or undefined system common message clears running status. */
+            p_st->status = 0;
+            p_st->pos    = 0;
         }
+        return;
+    }
+
+    if (p_st->status == 0)
+    {
+        /* Data byte without running status. */
+        return;
+    }
+
+    p_st->data[p_st->pos++] = byte;
+
+    if (p_st->status == 0xF0)
+    {
+        if (p_st->pos == 3)
+        {
+            midi_stream_emit(p_rsv, cable, APP_USBD_MIDI_CIN_SYSEX, p_st->data, 3);
+            p_st->pos = 0;
+        }
+    }
+    else if (p_st->pos == p_st->len)
+    {
+        midi_stream_emit(p_rsv, cable, midi_cin_get(p_st->status), p_st->data, p_st->len);
+        if (p_st->status < 0xF0)
+        {
+            /* Keep running status of channel messages. */
+            p_st->pos = 1;
+        }
+        else
+        {
+            p_st->status = 0;
+            p_st->pos    = 0;
+        }
+    }
+}
+
+bool app_usbd_midi_process(app_usbd_midi_t const * p_midi, size_t budget)
+{
+#if APP_USBD_MIDI_CONFIG_RX_DEFERRED
+    return midi_rx_process(p_midi, budget);
+#else
+    UNUSED_PARAMETER(p_midi);
+    UNUSED_PARAMETER(budget);
+    return false;
+#endif
+}
+
+void app_usbd_midi_sysex_span_handler_set(app_usbd_midi_t const *            p_midi,
+                                          app_usbd_midi_sysex_span_handler_t handler)
+{
+    midi_ctx_get(p_midi)->sysex_span_handler = handler;
+}
+
+void app_usbd_midi_sysex_release(app_usbd_midi_t const *            p_midi,
+                                 app_usbd_midi_sysex_span_t const * p_span)
+{
+    nrf_atomic_u32_t * p_pins = &p_midi->specific.inst.p_rx_buf->p_pins[p_span->buf];
+
+    ASSERT(*p_pins != 0);
+    UNUSED_RETURN_VALUE(nrf_atomic_u32_sub(p_pins, 1));
+    midi_rx_reclaim(p_midi);
+}
+
+size_t app_usbd_midi_sysex_span_copy(app_usbd_midi_sysex_span_t const * p_span, uint8_t * p_dst)
+{
+    uint8_t const * p_ev = p_span->p_ev;
+    size_t          left = p_span->len;
+
+    while (left != 0)
+    {
+        size_t len = MIN(left, USBD_MIDI_EVENT_SIZE - 1);
+
+        memcpy(p_dst, p_ev + 1, len);
+        p_dst += len;
+        p_ev  += USBD_MIDI_EVENT_SIZE;
+        left  -= len;
+    }
+
+    return p_span->len;
+}
+
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL
+void app_usbd_midi_sysex_free(app_usbd_midi_t const * p_midi, app_usbd_midi_sysex_block_t * p_chain)
+{
+    midi_sysex_chain_free(p_midi, p_chain);
+}
+
+void app_usbd_midi_sysex_pool_stats_get(app_usbd_midi_t const *            p_midi,
+                                        app_usbd_midi_sysex_pool_stats_t * p_stats)
+{
+    *p_stats = midi_ctx_get(p_midi)->sysex_pool_stats;
+}
+#endif
+
+#if APP_USBD_MIDI_CONFIG_TIMESTAMP
+void app_usbd_midi_time_source_set(app_usbd_midi_t const *  p_midi,
+                                   app_usbd_midi_time_get_t time_get,
+                                   uint32_t                 ticks_per_ms)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+    p_midi_ctx->time_get     = NULL;
+    __DMB();
+    p_midi_ctx->ticks_per_ms = ticks_per_ms;
+    __DMB();
+    p_midi_ctx->time_get     = time_get;
+}
+
+uint32_t app_usbd_midi_time_get(app_usbd_midi_t const * p_midi)
+{
+    return midi_timestamp_get(p_midi);
+}
+#endif
+
+#if APP_USBD_MIDI_CONFIG_STATS
+void app_usbd_midi_stats_get(app_usbd_midi_t const * p_midi, app_usbd_midi_stats_t * p_stats)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+    *p_stats = p_midi_ctx->stats;
+#if APP_USBD_MIDI_CONFIG_TX_ADMISSION
+    p_stats->tx_dropped = p_midi_ctx->tx_dropped;
+#endif
+#if APP_USBD_MIDI_CONFIG_CC_SLOTS
+    p_stats->tx_coalesced = p_midi_ctx->cc_coalesced;
+#endif
+#if APP_USBD_MIDI_LANE_STATS
+    memcpy(p_stats->delay, p_midi_ctx->lane_stats, sizeof(p_stats->delay));
+#endif
+}
+
+void app_usbd_midi_stats_reset(app_usbd_midi_t const * p_midi)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+    memset(&p_midi_ctx->stats, 0, sizeof(p_midi_ctx->stats));
+#if APP_USBD_MIDI_CONFIG_TX_ADMISSION
+    p_midi_ctx->tx_dropped = 0;
+#endif
+#if APP_USBD_MIDI_CONFIG_CC_SLOTS
+    p_midi_ctx->cc_coalesced = 0;
+#endif
+#if APP_USBD_MIDI_LANE_STATS
+    memset(p_midi_ctx->lane_stats, 0, sizeof(p_midi_ctx->lane_stats));
+#endif
+}
+#endif
+
+#if APP_USBD_MIDI_CONFIG_TX_ADMISSION
+void app_usbd_midi_overflow_set(app_usbd_midi_t const * p_midi, app_usbd_midi_overflow_t policy)
+{
+    midi_ctx_get(p_midi)->tx_overflow = policy;
+}
+
+ret_code_t app_usbd_midi_watermarks_set(app_usbd_midi_t const * p_midi, size_t low, size_t high)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+    if ((high != 0) && ((low >= high) || (high > p_midi->specific.inst.p_in_buf->bufsize_mask + 1)))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_midi_ctx->tx_wm_high = 0;
+    __DMB();
+    p_midi_ctx->tx_wm_low  = low;
+    UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->tx_wm_above));
+    __DMB();
+    p_midi_ctx->tx_wm_high = high;
+    return NRF_SUCCESS;
+}
+#endif
+
+#if APP_USBD_MIDI_LANE_STATS
+ret_code_t app_usbd_midi_lane_stats_get(app_usbd_midi_t const *      p_midi,
+                                        app_usbd_midi_lane_t         lane,
+                                        app_usbd_midi_lane_stats_t * p_stats)
+{
+    if (lane >= APP_USBD_MIDI_LANE_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    *p_stats = midi_ctx_get(p_midi)->lane_stats[lane];
+    return NRF_SUCCESS;
+}
+#endif
+
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE
+void app_usbd_midi_tx_coalesce_set(app_usbd_midi_t const * p_midi, uint16_t threshold)
+{
+    midi_ctx_get(p_midi)->tx_coalesce = threshold;
+}
+#endif
+
+#if APP_USBD_MIDI_CONFIG_SCHED_SIZE
+ret_code_t app_usbd_midi_schedule(app_usbd_midi_t const * p_midi,
+                                  uint32_t                time,
+                                  uint8_t                 cable,
+                                  uint8_t const *         p_msg,
+                                  size_t                  len)
+{
+    app_usbd_midi_ctx_t    * p_midi_ctx = midi_ctx_get(p_midi);
+    app_usbd_midi_sched_ev_t ev;
+    ret_code_t               ret        = NRF_SUCCESS;
+
+    if ((len == 0) || (len > 3) || (midi_msg_len_get(p_msg[0]) != len))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+    if (cable > 15)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (midi_ump_active(p_midi_ctx))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    ev.time = time;
+    midi_event_pack(ev.ev, cable, p_msg, len);
+
+    if (nrf_atomic_flag_set_fetch(&p_midi_ctx->sched_lock) != 0)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    if (p_midi_ctx->sched_count < ARRAY_SIZE(p_midi_ctx->sched))
+    {
+        midi_sched_push(p_midi_ctx, &ev);
+    }
+    else
+    {
+        ret = NRF_ERROR_NO_MEM;
     }
+    UNUSED_RETURN_VALUE(nrf_atomic_flag_clear(&p_midi_ctx->sched_lock));
 
+    /* Serve a release missed while the heap was locked, or send an event that is due. */
+    midi_sched_release(p_midi);
     return ret;
 }
+#endif
 
-/**
- * @brief @ref app_usbd_class_methods_t::event_handler
- */
-static ret_code_t midi_event_handler(
-    app_usbd_class_inst_t const  * p_inst,
-    app_usbd_complex_evt_t const * p_event)
+ret_code_t app_usbd_midi_thru_set(app_usbd_midi_t const * p_midi, uint8_t const * p_cable_map)
 {
-    ASSERT(p_inst != NULL);
-    ASSERT(p_event != NULL);
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    bool                  identity   = true;
 
-    ret_code_t ret = NRF_SUCCESS;
-    switch (p_event->app_evt.type)
+    if (p_cable_map != NULL)
     {
-        case APP_USBD_EVT_DRV_RESET:
-            break;
-
-        case APP_USBD_EVT_DRV_SETUP:
-            ret = setup_event_handler(p_inst, (app_usbd_setup_evt_t const *)p_event);
-            break;
+        for (uint8_t cable = 0; cable < 16; cable++)
+        {
+            if ((p_cable_map[cable] > 15) && (p_cable_map[cable] != APP_USBD_MIDI_THRU_NONE))
+            {
+                return NRF_ERROR_INVALID_PARAM;
+            }
+            identity = identity && (p_cable_map[cable] == cable);
+        }
+    }
 
-        case APP_USBD_EVT_DRV_EPTRANSFER:
-            ret = midi_endpoint_ev(p_inst, p_event);
-            break;
+    p_midi_ctx->thru_enabled = false;
+    if (p_cable_map != NULL)
+    {
+        memcpy(p_midi_ctx->thru_map, p_cable_map, sizeof(p_midi_ctx->thru_map));
+        p_midi_ctx->thru_identity = identity;
+        __DMB();
+        p_midi_ctx->thru_enabled = true;
+    }
 
-        case APP_USBD_EVT_DRV_SUSPEND:
-            break;
+    /* An RX buffer held back by the previous setting is forwarded with the new one. */
+    midi_thru_retry(p_midi);
+    return NRF_SUCCESS;
+}
 
-        case APP_USBD_EVT_DRV_RESUME:
-            break;
+#if APP_USBD_MIDI_CONFIG_ROUTES
+ret_code_t app_usbd_midi_routes_set(app_usbd_midi_t const *       p_midi,
+                                    app_usbd_midi_route_t const * p_routes,
+                                    size_t                        count)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
 
-        case APP_USBD_EVT_INST_APPEND:
-            break;
+    if (count > APP_USBD_MIDI_CONFIG_ROUTES)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
 
-        case APP_USBD_EVT_INST_REMOVE:
-            break;
+    for (size_t i = 0; i < count; i++)
+    {
+        if ((p_routes[i].handler == NULL) ? (p_routes[i].thru_cable > 15) :
+            ((p_routes[i].cins & (APP_USBD_MIDI_ROUTE_CIN_SYSEX &
+                                  ~APP_USBD_MIDI_ROUTE_CIN(APP_USBD_MIDI_CIN_SYSEX_END_1))) != 0))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+    }
 
-        case APP_USBD_EVT_STARTED:
-            break;
+    memset(p_midi_ctx->route_map, 0, sizeof(p_midi_ctx->route_map));
+    for (size_t i = 0; i < count; i++)
+    {
+        for (uint8_t cable = 0; cable < 16; cable++)
+        {
+            if ((p_routes[i].cables & (1u << cable)) == 0)
+            {
+                continue;
+            }
+            for (uint8_t cin = 0; cin < 16; cin++)
+            {
+                if ((p_routes[i].cins & (1u << cin)) != 0)
+                {
+                    p_midi_ctx->route_map[cable][cin] |= (app_usbd_midi_route_mask_t)(1u << i);
+                }
+            }
+        }
+    }
+    p_midi_ctx->p_routes = p_routes;
 
-        case APP_USBD_EVT_STOPPED:
-            break;
+    return NRF_SUCCESS;
+}
+#endif
 
-        case APP_USBD_EVT_STATE_CHANGED:
-            break;
+ret_code_t app_usbd_midi_send_raw(app_usbd_midi_t const * p_midi,
+                                  const void *        p_buf,
+                                  size_t              len)
+{
+    uint8_t const * p_data = p_buf;
+    midi_tx_rsv_t   rsv;
+    ret_code_t      ret    = NRF_ERROR_INVALID_LENGTH;
 
-        default:
-            ret = NRF_ERROR_NOT_SUPPORTED;
-            break;
+    MIDI_TRACE(SEND_RAW_ENTER, len);
+    if (midi_ump_active(midi_ctx_get(p_midi)))
+    {
+        ret = NRF_ERROR_INVALID_STATE;
     }
-
+    else if ((len != 0) && ((len % USBD_MIDI_EVENT_SIZE) == 0))
+    {
+        ret = midi_tx_admit(p_midi, &rsv, len);
+    }
+    if (ret == NRF_SUCCESS)
+    {
+        for (size_t i = 0; i < len; i += USBD_MIDI_EVENT_SIZE)
+        {
+            memcpy(midi_tx_rsv_event(&rsv), &p_data[i], USBD_MIDI_EVENT_SIZE);
+        }
+        midi_tx_commit(p_midi, &rsv);
+    }
+    MIDI_TRACE(SEND_RAW_EXIT, ret);
     return ret;
 }
 
-static size_t midi_get_descriptor_size(app_usbd_class_inst_t const * p_inst)
+ret_code_t app_usbd_midi_write(app_usbd_midi_t const *  p_midi,
+                               uint8_t                  cable, 
+                               uint8_t *                p_buf,
+                               size_t                   len)
 {
-    app_usbd_midi_t const * p_midi = midi_get(p_inst);
+    uint8_t m_tx_buffer[USBD_MIDI_EVENT_SIZE];
 
-    if (p_midi->specific.inst.p_midi_dsc == NULL)
+    if (cable >= ARRAY_SIZE(midi_ctx_get(p_midi)->tx_stream))
     {
-        return 0;
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((len == 0) || (len > 3)) {
+        return NRF_ERROR_INVALID_DATA;
+    }
+    if (midi_ump_active(midi_ctx_get(p_midi)))
+    {
+        return NRF_ERROR_INVALID_STATE;
     }
 
-    return p_midi->specific.inst.p_midi_dsc->size;
-}
+#if APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+    if ((len == 1) && (p_buf[0] >= 0xF8) &&
+        (midi_rt_put(p_midi, cable, p_buf[0]) == NRF_SUCCESS))
+    {
+        return NRF_SUCCESS;
+    }
+#endif
 
-static size_t midi_get_descriptor_data(app_usbd_class_inst_t const * p_inst,
-                                               uint32_t                      cur_byte)
-{
-    app_usbd_midi_t const * p_midi = midi_get(p_inst);
+    midi_event_pack(m_tx_buffer, cable, p_buf, len);
+
+#if APP_USBD_MIDI_CONFIG_CC_SLOTS
+    uint32_t key;
 
-    return p_midi->specific.inst.p_midi_dsc->p_data[cur_byte];
+    if (midi_cc_key_get(m_tx_buffer, &key))
+    {
+        return midi_cc_put(p_midi, m_tx_buffer, key);
+    }
+    midi_cc_lsb_put(p_midi, m_tx_buffer);
+#endif
+    return app_usbd_midi_send_raw(p_midi, m_tx_buffer, USBD_MIDI_EVENT_SIZE);
 }
 
-/**
- * @brief @ref app_usbd_class_methods_t::feed_descriptors
- */
-static bool midi_feed_descriptors(app_usbd_class_descriptor_ctx_t * p_ctx,
-                                   app_usbd_class_inst_t const     * p_inst,
-                                   uint8_t                         * p_buff,
-                                   size_t                            max_size)
+ret_code_t app_usbd_midi_write_batch(app_usbd_midi_t const *     p_midi,
+                                     uint8_t                     cable,
+                                     app_usbd_midi_msg_t const * p_msgs,
+                                     size_t                      count)
 {
-    static uint8_t ifaces   = 0;
-    ifaces = app_usbd_class_iface_count_get(p_inst);
-    ASSERT(ifaces == 2);
-    app_usbd_midi_t const * p_midi = midi_get(p_inst);
-
-    APP_USBD_CLASS_DESCRIPTOR_BEGIN(p_ctx, p_buff, max_size);
-
-    /* CONTROL INTERFACE DESCRIPTOR */
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x09); // bLength
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_DESCRIPTOR_INTERFACE); // bDescriptorType = Interface
+    midi_tx_rsv_t rsv;
 
-    static app_usbd_class_iface_conf_t const * p_cur_iface = NULL;
-    p_cur_iface = app_usbd_class_iface_get(p_inst, 0);
+    if (cable >= ARRAY_SIZE(midi_ctx_get(p_midi)->tx_stream))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (midi_ump_active(midi_ctx_get(p_midi)))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (count == 0)
+    {
+        return NRF_SUCCESS;
+    }
 
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(app_usbd_class_iface_number_get(p_cur_iface)); // bInterfaceNumber
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x00); // bAlternateSetting
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(app_usbd_class_iface_ep_count_get(p_cur_iface)); // bNumEndpoints
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_CLASS); // bInterfaceClass = Audio
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_SUBCLASS_AUDIOCONTROL); // bInterfaceSubclass (Audio Control)
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_CLASS_PROTOCOL_UNDEFINED); // bInterfaceProtocol
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x00); // iInterface
+    ret_code_t ret = midi_tx_admit(p_midi, &rsv, count * USBD_MIDI_EVENT_SIZE);
+    if (ret != NRF_SUCCESS)
+    {
+        return ret;
+    }
 
-    /* HEADER INTERFACE */
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x09); // bLength
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_DESCRIPTOR_INTERFACE); // bDescriptorType = Audio Interfaces
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_AC_IFACE_SUBTYPE_HEADER); // bDescriptorSubtype = Header
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(LSB_16(0x0100)); // bcdADC LSB
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(MSB_16(0x0100)); // bcdADC MSB
+    for (size_t i = 0; i < count; i++)
+    {
+        if ((p_msgs[i].len == 0) || (p_msgs[i].len > 3))
+        {
+            midi_tx_cancel(p_midi);
+            return NRF_ERROR_INVALID_DATA;
+        }
+        midi_event_pack(midi_tx_rsv_event(&rsv), cable, p_msgs[i].p_data, p_msgs[i].len);
+    }
 
-    static uint16_t header_desc_len = 0;
-    header_desc_len = 9;  //!! decriptor size
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(LSB_16(header_desc_len)); // wTotalLength LSB
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(MSB_16(header_desc_len)); // wTotalLength MSB
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x01);                    // bInCollection
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(1); // baInterfaceNr(1) //!! interface number hardcoded
+    midi_tx_commit(p_midi, &rsv);
+    return NRF_SUCCESS;
+}
 
-    // /* INPUT TERMINAL DESCRIPTOR */
-    static uint32_t cur_byte        = 0;
+ret_code_t app_usbd_midi_stream_write(app_usbd_midi_t const * p_midi,
+                                      uint8_t                 cable,
+                                      uint8_t const *         p_buf,
+                                      size_t                  len,
+                                      size_t *                p_consumed)
+{
+    app_usbd_midi_ctx_t    * p_midi_ctx = midi_ctx_get(p_midi);
+    nrf_ringbuf_t const    * p_in_buf   = p_midi->specific.inst.p_in_buf;
+    app_usbd_midi_stream_t * p_st;
+    size_t                   pos        = 0;
+    ret_code_t               ret        = NRF_SUCCESS;
 
+    if (cable >= ARRAY_SIZE(p_midi_ctx->tx_stream))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (midi_ump_active(p_midi_ctx))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    p_st = &p_midi_ctx->tx_stream[cable];
 
-    p_cur_iface++;
+    while (pos < len)
+    {
+        midi_tx_rsv_t rsv;
+        size_t        extra = midi_stream_sysex_pending(p_st) ? 1 : 0;
+        size_t        chunk = midi_ringbuf_free_space(p_in_buf) / USBD_MIDI_EVENT_SIZE;
 
-    /* STREAM INTERFACE DESCRIPTOR ALT 0 */
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x09); // bLength
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_DESCRIPTOR_INTERFACE); // bDescriptorType = Interface
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(1); // bInterfaceNumber //!! Hardcoded
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x00); // bAlternateSetting
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(app_usbd_class_iface_ep_count_get(p_cur_iface)); // bNumEndpoints
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_CLASS); // bInterfaceClass = Audio
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(p_midi->specific.inst.type_streaming); // bInterfaceSubclass (Audio Control)
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(APP_USBD_AUDIO_CLASS_PROTOCOL_UNDEFINED); // bInterfaceProtocol
-    APP_USBD_CLASS_DESCRIPTOR_WRITE(0x00); // iInterface
+        /* Reserve for the worst case of @ref midi_stream_byte and commit what was
+         * actually produced. */
+        if (chunk <= extra)
+        {
+            ret = NRF_ERROR_NO_MEM;
+            break;
+        }
+        chunk = MIN(len - pos, chunk - extra);
 
-    if (p_midi->specific.inst.type_streaming == APP_USBD_AUDIO_SUBCLASS_MIDISTREAMING) {
-            static size_t midi_desc_size = 0;
-        midi_desc_size = midi_get_descriptor_size(p_inst);
+        ret = midi_tx_reserve(p_in_buf, &rsv, (chunk + extra) * USBD_MIDI_EVENT_SIZE);
+        if (ret != NRF_SUCCESS)
+        {
+            break;
+        }
 
-        for (cur_byte = 0; cur_byte < midi_desc_size; cur_byte++)
+        for (size_t i = 0; i < chunk; i++)
         {
-            APP_USBD_CLASS_DESCRIPTOR_WRITE(midi_get_descriptor_data(p_inst, cur_byte));
+            midi_stream_byte(p_midi, p_st, &rsv, cable, p_buf[pos + i]);
         }
+        pos += chunk;
+
+        midi_tx_commit(p_midi, &rsv);
     }
 
-    APP_USBD_CLASS_DESCRIPTOR_END();
+    if (p_consumed != NULL)
+    {
+        *p_consumed = pos;
+    }
+    return ret;
 }
 
-const app_usbd_class_methods_t app_usbd_midi_class_methods = {
-    .event_handler       = midi_event_handler,
-    .feed_descriptors    = midi_feed_descriptors,
-    .iface_select        = iface_select,
-    .iface_deselect      = iface_deselect,
-    .iface_selection_get = iface_selection_get,
-};
-
-ret_code_t app_usbd_midi_send_raw(app_usbd_midi_t const * p_midi,
-                                  const void *        p_buf,
-                                  size_t              len)
+ret_code_t app_usbd_midi_sysex_write(app_usbd_midi_t const *  p_midi,
+                                     uint8_t                  cable,
+                                     uint8_t const *          p_buf,
+                                     size_t                   len)
 {
     app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    midi_tx_rsv_t         rsv;
+    size_t                events     = (len + 2) / 3 + 1;
 
-    #if (APP_USBD_CONFIG_EVENT_QUEUE_ENABLE == 0)
-    CRITICAL_REGION_ENTER();
-    #endif // (APP_USBD_CONFIG_EVENT_QUEUE_ENABLE == 0)
-
-    nrf_ringbuf_cpy_put(p_midi->specific.inst.p_in_buf, p_buf, &len);
+    if (cable >= ARRAY_SIZE(p_midi_ctx->tx_stream))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (midi_ump_active(p_midi_ctx))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
 
-    if(!p_midi_ctx->sending) 
+    /* Every status byte adds at most one event packet to the sysex data. */
+    for (size_t i = 0; i < len; i++)
     {
-        p_midi_ctx->sending = true;
-        len = 4;
-        size_t len_total = 0;
-        uint8_t p_buffer[64];
-        
-        while ((len != 0) && (len_total < 64))
+        if (p_buf[i] & 0x80)
         {
-            nrf_ringbuf_cpy_get(p_midi->specific.inst.p_in_buf, 
-            (p_buffer + len_total), &len);
-
-            len_total += len;
+            if ((p_buf[i] < 0xF8) && (p_buf[i] != 0xF0) && (p_buf[i] != 0xF7))
+            {
+                return NRF_ERROR_INVALID_DATA;
+            }
+            events++;
         }
+    }
+    if ((p_midi_ctx->tx_stream[cable].status != 0) && (p_midi_ctx->tx_stream[cable].status != 0xF0))
+    {
+        /* Leading data bytes continue the running status, up to one event packet each. */
+        events = MAX(events, len + 1);
+    }
 
-        if (len_total) 
-        {
-            NRF_DRV_USBD_TRANSFER_IN(transfer, p_buffer, len_total);
-            app_usbd_ep_transfer(NRF_DRV_USBD_EPIN1, &transfer);        
-        } 
-        else 
-        {
-            p_midi_ctx->sending = false;
-        }
-    }  
+    ret_code_t ret = midi_tx_admit(p_midi, &rsv, events * USBD_MIDI_EVENT_SIZE);
+    if (ret != NRF_SUCCESS)
+    {
+        return ret;
+    }
 
-    #if (APP_USBD_CONFIG_EVENT_QUEUE_ENABLE == 0)
-    CRITICAL_REGION_EXIT();
-    #endif // (APP_USBD_CONFIG_EVENT_QUEUE_ENABLE == 0)
+    for (size_t i = 0; i < len; i++)
+    {
+        midi_stream_byte(p_midi, &p_midi_ctx->tx_stream[cable], &rsv, cable, p_buf[i]);
+    }
 
+    midi_tx_commit(p_midi, &rsv);
     return NRF_SUCCESS;
 }
 
-ret_code_t app_usbd_midi_write(app_usbd_midi_t const *  p_midi,
-                               uint8_t                  cable, 
-                               uint8_t *                p_buf,
-                               size_t                   len)
+ret_code_t app_usbd_midi_sysex_send(app_usbd_midi_t const * p_midi,
+                                    uint8_t                 cable,
+                                    uint8_t const *         p_buf,
+                                    size_t                  len)
 {
-    uint8_t status = *p_buf;
-    uint8_t cin;
-    uint8_t m_tx_buffer[4];
-
-    if (len > 3) {
-        return NRF_ERROR_INVALID_DATA;
-    }
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
 
-    if (status >> 5 == 0b110) 
+    if (cable >= ARRAY_SIZE(p_midi_ctx->tx_stream))
     {
-        cin = 0x2;
-    } 
-    else if (status == 0b11110010) 
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (len == 0)
     {
-        cin = 0x3;
-    } 
-    else if ((status >> 2) == 0b111101) 
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (midi_ump_active(p_midi_ctx))
     {
-       cin = 0x5;
+        return NRF_ERROR_INVALID_STATE;
     }
-    else 
+    if (p_midi_ctx->sysex_src_left != 0)
     {
-        cin = status >> 4;
+        return NRF_ERROR_BUSY;
     }
 
-    m_tx_buffer[0] = (cable << 4) + cin;
-    for (size_t i = 0; i < len; i++)
+    p_midi_ctx->p_sysex_src     = p_buf;
+    p_midi_ctx->sysex_src_cable = cable;
+    /* Source has to be visible before it is published to the transfer handler. */
+    __DMB();
+    p_midi_ctx->sysex_src_left  = len;
+
+    midi_sysex_pump(p_midi);
+    return NRF_SUCCESS;
+}
+
+#if APP_USBD_MIDI_CONFIG_UMP
+void app_usbd_midi_ump_descriptors_set(app_usbd_midi_t const *               p_midi,
+                                       app_usbd_midi_subclass_desc_t const * p_ump_dsc,
+                                       app_usbd_midi_subclass_desc_t const * p_gtb_dsc)
+{
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+
+    p_midi_ctx->p_ump_dsc = p_ump_dsc;
+    p_midi_ctx->p_gtb_dsc = p_gtb_dsc;
+}
+
+void app_usbd_midi_ump_handler_set(app_usbd_midi_t const *     p_midi,
+                                   app_usbd_midi_ump_handler_t handler)
+{
+    midi_ctx_get(p_midi)->ump_handler = handler;
+}
+
+bool app_usbd_midi_ump_active(app_usbd_midi_t const * p_midi)
+{
+    return midi_ump_active(midi_ctx_get(p_midi));
+}
+
+/**
+ * @brief Get the NOOP padding needed by Universal MIDI Packets written from an index on.
+ *
+ * @param[in] p_buf TX ring buffer.
+ * @param[in] idx   Ring buffer index of the first packet.
+ * @param[in] p_ump Packets.
+ * @param[in] words Number of words in @p p_ump.
+ *
+ * @return Number of padding bytes.
+ */
+static size_t midi_ump_pad_total_get(nrf_ringbuf_t const * p_buf,
+                                     uint32_t              idx,
+                                     uint32_t const *      p_ump,
+                                     size_t                words)
+{
+    size_t total = 0;
+    size_t len;
+
+    for (size_t pos = 0; pos < words; pos += len)
     {
-        m_tx_buffer[i+1] = *(p_buf + i);
+        len    = app_usbd_midi_ump_words_get(p_ump[pos]);
+        total += midi_ump_pad_get(p_buf, idx + total + pos * sizeof(uint32_t), len * sizeof(uint32_t));
     }
-
-    return app_usbd_midi_send_raw(p_midi, m_tx_buffer, 4);
+    return total;
 }
 
-ret_code_t app_usbd_midi_sysex_write(app_usbd_midi_t const *  p_midi,
-                               uint8_t                  cable, 
-                               uint8_t *                p_buf,
-                               size_t                   len)
+ret_code_t app_usbd_midi_ump_write(app_usbd_midi_t const * p_midi,
+                                   uint32_t const *        p_ump,
+                                   size_t                  words)
 {
-    uint8_t sysex_buf[64];
-    size_t sysex_pos = 0;
-    size_t pos = 0;
-    uint8_t left_to_send = 0;
+    app_usbd_midi_ctx_t * p_midi_ctx = midi_ctx_get(p_midi);
+    nrf_ringbuf_t const * p_in_buf   = p_midi->specific.inst.p_in_buf;
+    size_t                size       = words * sizeof(uint32_t);
+    size_t                pad;
+    size_t                pos;
+    size_t                len;
+    uint32_t              idx;
+    midi_tx_rsv_t         rsv;
+    ret_code_t            ret;
+
+    if (!midi_ump_active(p_midi_ctx))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    for (pos = 0; pos < words; pos += app_usbd_midi_ump_words_get(p_ump[pos]))
+    {
+    }
+    if ((words == 0) || (pos != words))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
 
-    while (pos < len)
+    MIDI_TRACE(SEND_RAW_ENTER, size);
+    /* The padding depends on the write index, which another producer or the overflow
+     * policy may move before the reservation is made. Then try once more. */
+    idx = midi_ringbuf_wr_idx(p_in_buf);
+    for (bool retry = false; ; retry = true)
     {
-        left_to_send =  (len - pos);
-        
-        if (left_to_send > 3) 
+        pad = midi_ump_pad_total_get(p_in_buf, idx, p_ump, words);
+        ret = midi_tx_admit(p_midi, &rsv, size + pad);
+        if ((ret != NRF_SUCCESS) || (midi_ump_pad_total_get(p_in_buf, rsv.idx, p_ump, words) <= pad))
         {
-            sysex_buf[sysex_pos] = 0x4;
-        } 
-        else 
+            break;
+        }
+        midi_tx_cancel(p_midi);
+        idx = rsv.idx;
+        if (retry)
         {
-            sysex_buf[sysex_pos] = 4 + left_to_send;
+            ret = NRF_ERROR_BUSY;
+            break;
         }
-        sysex_pos++;
-        for (size_t i = 0; i < left_to_send; i++)
+    }
+    if (ret == NRF_SUCCESS)
+    {
+        for (pos = 0; pos < words; pos += len)
         {
-            sysex_buf[sysex_pos] = *(p_buf + pos);
-            pos ++;
-            sysex_pos ++;
-            
-            if(i == 2) 
+            len = app_usbd_midi_ump_words_get(p_ump[pos]);
+
+            /* Fill the end of the block with NOOP utility messages. */
+            for (pad = midi_ump_pad_get(p_in_buf, rsv.idx + rsv.pos, len * sizeof(uint32_t));
+                 pad != 0;
+                 pad -= sizeof(uint32_t))
             {
-                break;
+                memset(midi_tx_rsv_event(&rsv), 0, sizeof(uint32_t));
+            }
+            for (size_t i = 0; i < len; i++)
+            {
+                memcpy(midi_tx_rsv_event(&rsv), &p_ump[pos + i], sizeof(uint32_t));
             }
         }
+        midi_tx_commit(p_midi, &rsv);
     }
-    sysex_pos += 3-left_to_send;
-    return app_usbd_midi_send_raw(p_midi, sysex_buf, sysex_pos);
+    MIDI_TRACE(SEND_RAW_EXIT, ret);
+    return ret;
 }
+#endif
 
 /** @} */
 
@@ -64,7 +64,14 @@ extern "C" {
  *
  * @brief @tagAPI52840 Module with types, definitions, and API used by USB Midi class.
  *
- * @details Reference specifications:
+ * @details The write functions do not mask interrupts. A write that preempts another write
+ * to the same instance, including thru and routed data queued by the class itself, returns
+ * @ref NRF_ERROR_BUSY and queues nothing. Retrying at the same priority never succeeds, as
+ * the preempted write cannot finish in the meantime: keep the message and retry it from the
+ * main loop, or write from a single context only. @ref NRF_ERROR_NO_MEM is retried the same
+ * way once the host has read data. See the USB MIDI example.
+ *
+ * Reference specifications:
  *
  * @{
  */
@@ -119,6 +126,11 @@ typedef enum app_usbd_midi_user_event_e {
 
     APP_USBD_MIDI_USER_EVT_PORT_OPEN,   /**< User event PORT_OPEN.  */
     APP_USBD_MIDI_USER_EVT_PORT_CLOSE,  /**< User event PORT_CLOSE. */
+    APP_USBD_MIDI_USER_EVT_SYSEX_TX_DONE, /**< Message of @ref app_usbd_midi_sysex_send queued completely. */
+    APP_USBD_MIDI_USER_EVT_TX_HIGH_WATERMARK, /**< TX buffer filled up to the high watermark. */
+    APP_USBD_MIDI_USER_EVT_TX_LOW_WATERMARK,  /**< TX buffer drained down to the low watermark. */
+    APP_USBD_MIDI_USER_EVT_THRU_DROPPED,      /**< Thru could not forward received event packets, see @ref app_usbd_midi_thru_set. */
+    APP_USBD_MIDI_USER_EVT_SYSEX_TX_ABORTED,  /**< Message of @ref app_usbd_midi_sysex_send dropped unfinished, the port closed or restarted. */
 } app_usbd_midi_user_event_t;
 
 
@@ -137,6 +149,10 @@ typedef enum app_usbd_midi_rx_event_e {
  * @param interfaces_configs        Interfaces configurations.
  * @param user_ev_handler           User event handler.
  * @param midi_descriptor           Midi class Format descriptor.
+ * @param in_buf_size               Size of TX ring buffer. Must be a power of two.
+ * @param rx_buf_count              Number of RX buffers. Must be a power of two.
+ * @param rx_buf_size               Size of one RX buffer, the largest OUT transfer.
+ *                                  Must be a multiple of the endpoint size.
  *
  * @note This macro is just simplified version of @ref APP_USBD_MIDI_GLOBAL_DEF_INTERNAL
  *
@@ -146,13 +162,17 @@ typedef enum app_usbd_midi_rx_event_e {
                                   user_ev_handler,          \
                                   rx_handler,               \
                                   midi_descriptor,          \
-                                  in_buf_size)              \
+                                  in_buf_size,              \
+                                  rx_buf_count,             \
+                                  rx_buf_size)              \
     APP_USBD_MIDI_GLOBAL_DEF_INTERNAL(instance_name,        \
                                        interfaces_configs,  \
                                        user_ev_handler,     \
                                        rx_handler,          \
                                        midi_descriptor,     \
-                                       in_buf_size)         \
+                                       in_buf_size,         \
+                                       rx_buf_count,        \
+                                       rx_buf_size)         \
 
 /**
  * @brief Initializer of Midi descriptor.
@@ -202,6 +222,31 @@ app_usbd_audio_class_get(app_usbd_class_inst_t const * p_inst)
  * 
  * Data has to be a single, complete midi message in order for transfer to be correctly formatted.
  *
+ * With @ref APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE enabled, real-time messages go to the real-time
+ * lane and are sent before anything queued in the TX buffer. If the real-time queue is full
+ * or written in another context they are queued in the TX buffer.
+ *
+ * With @ref APP_USBD_MIDI_CONFIG_CC_SLOTS enabled, a control change, pitch bend or pressure
+ * message replaces the value of the previous message of the same controller if that one
+ * is still waiting in the TX buffer. Controllers whose meaning depends on the order of
+ * messages, the LSB controllers 32 to 63 included, are never replaced, and an MSB value
+ * is never moved ahead of an LSB written after the previous MSB. Other messages keep
+ * their order.
+ *
+ * Returns @ref NRF_ERROR_INVALID_STATE while USB-MIDI 2.0 is selected, like every
+ * MIDI 1.0 write function, see @ref app_usbd_midi_ump_write.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] cable     Cable number, 0 to 15.
+ * @param[in] p_buf     Midi message.
+ * @param[in] len       Length of the message, 1 to 3 bytes.
+ *
+ * @retval NRF_SUCCESS              Message queued.
+ * @retval NRF_ERROR_NO_MEM         Not enough room in the TX buffer, see @ref app_usbd_midi_overflow_set.
+ * @retval NRF_ERROR_BUSY           Another context is writing to the TX buffer.
+ * @retval NRF_ERROR_INVALID_PARAM  Invalid cable number.
+ * @retval NRF_ERROR_INVALID_DATA   Message has invalid length.
+ * @retval NRF_ERROR_INVALID_STATE  USB-MIDI 2.0 is selected, see @ref app_usbd_midi_ump_active.
  */
 ret_code_t app_usbd_midi_write(app_usbd_midi_t const *  p_midi,
                                uint8_t                  cable, 
@@ -209,32 +254,565 @@ ret_code_t app_usbd_midi_write(app_usbd_midi_t const *  p_midi,
                                size_t                   len);
 
 
+/**
+ * @brief Write a batch of midi messages to TX buffer and start sending.
+ *
+ * Every message has to be a single, complete midi message, as for @ref app_usbd_midi_write.
+ * All messages are packed into event packets in one pass and committed to the TX buffer
+ * at once, so either the whole batch is queued or nothing is.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] cable     Cable number, 0 to 15.
+ * @param[in] p_msgs    Array of messages.
+ * @param[in] count     Number of messages in the array.
+ *
+ * @retval NRF_SUCCESS              All messages queued.
+ * @retval NRF_ERROR_NO_MEM         Not enough space in TX buffer for the whole batch.
+ * @retval NRF_ERROR_BUSY           Another context is writing to the TX buffer.
+ * @retval NRF_ERROR_INVALID_PARAM  Invalid cable number.
+ * @retval NRF_ERROR_INVALID_DATA   One of the messages has invalid length.
+ * @retval NRF_ERROR_INVALID_STATE  USB-MIDI 2.0 is selected, see @ref app_usbd_midi_ump_active.
+ */
+ret_code_t app_usbd_midi_write_batch(app_usbd_midi_t const *     p_midi,
+                                     uint8_t                     cable,
+                                     app_usbd_midi_msg_t const * p_msgs,
+                                     size_t                      count);
+
+
+/**
+ * @brief Write a chunk of a midi 1.0 byte stream to TX buffer and start sending.
+ *
+ * The stream may be split at any byte. State of the encoder is kept per cable
+ * across calls: running status is expanded, real-time bytes are sent as soon as they
+ * arrive, also in the middle of other messages and system exclusive, and data bytes
+ * without status are dropped.
+ *
+ * @param[in]  p_midi       Midi class instance.
+ * @param[in]  cable        Cable number.
+ * @param[in]  p_buf        Stream bytes.
+ * @param[in]  len          Number of bytes.
+ * @param[out] p_consumed   Number of bytes consumed by the encoder. May be NULL.
+ *
+ * @retval NRF_SUCCESS              All bytes consumed.
+ * @retval NRF_ERROR_NO_MEM         TX buffer is full, only @p p_consumed bytes were consumed.
+ * @retval NRF_ERROR_BUSY           Another context is writing to the TX buffer.
+ * @retval NRF_ERROR_INVALID_PARAM  Invalid cable number.
+ * @retval NRF_ERROR_INVALID_STATE  USB-MIDI 2.0 is selected, see @ref app_usbd_midi_ump_active.
+ */
+ret_code_t app_usbd_midi_stream_write(app_usbd_midi_t const * p_midi,
+                                      uint8_t                 cable,
+                                      uint8_t const *         p_buf,
+                                      size_t                  len,
+                                      size_t *                p_consumed);
+
+
 /**
  * @brief Write midi sysex data to TX buffer and start sending.
- * 
- * The complete sysex message may be sent using multiple calls to this function.
- * If multiple calls are used, len has to be a multiple of three until the last 
- * fragment of the sysex message, wich may be any length.
- * This makes it possible to store a single sysex message in multiple buffers, 
- * thus enabling support for infinite length sysex messages.
  *
+ * The complete sysex message, from 0xF0 to 0xF7, may be sent using multiple calls to
+ * this function split at any byte. The data is encoded by the byte stream encoder of
+ * the cable, which keeps the message state across calls. Real-time bytes may be mixed
+ * with the sysex data.
+ *
+ * The fragment is queued all at once or not at all. Use @ref app_usbd_midi_sysex_send
+ * for messages larger than the TX buffer.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] cable     Cable number.
+ * @param[in] p_buf     Sysex bytes.
+ * @param[in] len       Number of bytes.
+ *
+ * @retval NRF_SUCCESS              Fragment queued.
+ * @retval NRF_ERROR_NO_MEM         Not enough space in TX buffer for the fragment.
+ * @retval NRF_ERROR_BUSY           Another context is writing to the TX buffer.
+ * @retval NRF_ERROR_INVALID_PARAM  Invalid cable number.
+ * @retval NRF_ERROR_INVALID_DATA   Fragment contains status bytes other than sysex and real-time.
+ * @retval NRF_ERROR_INVALID_STATE  USB-MIDI 2.0 is selected, see @ref app_usbd_midi_ump_active.
  */
 ret_code_t app_usbd_midi_sysex_write(app_usbd_midi_t const *  p_midi,
-                               uint8_t                  cable, 
-                               uint8_t *                p_buf,
-                               size_t                   len);
+                                     uint8_t                  cable,
+                                     uint8_t const *          p_buf,
+                                     size_t                   len);
+
+/**
+ * @brief Send a sysex message of any length.
+ *
+ * The message is encoded straight into the TX buffer, in chunks as IN transfers free up
+ * space, so a message much larger than the TX buffer is sent at full bulk rate without
+ * blocking. @ref APP_USBD_MIDI_USER_EVT_SYSEX_TX_DONE is raised when all of it is queued.
+ * One message may be pending per instance.
+ *
+ * The buffer must stay valid until @ref APP_USBD_MIDI_USER_EVT_SYSEX_TX_DONE. Do not write
+ * to the byte stream encoder of the same cable with @ref app_usbd_midi_stream_write or
+ * @ref app_usbd_midi_sysex_write in the meantime.
+ *
+ * If the host closes or restarts the port before the message is queued completely, the rest
+ * of it is dropped together with the TX buffer and
+ * @ref APP_USBD_MIDI_USER_EVT_SYSEX_TX_ABORTED is raised instead. The buffer is released then.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] cable     Cable number.
+ * @param[in] p_buf     Complete sysex message, from 0xF0 to 0xF7.
+ * @param[in] len       Length of the message.
+ *
+ * @retval NRF_SUCCESS              Message queued for sending.
+ * @retval NRF_ERROR_BUSY           Another message is being sent.
+ * @retval NRF_ERROR_INVALID_PARAM  Invalid cable number.
+ * @retval NRF_ERROR_INVALID_LENGTH Empty message.
+ * @retval NRF_ERROR_INVALID_STATE  USB-MIDI 2.0 is selected, see @ref app_usbd_midi_ump_active.
+ */
+ret_code_t app_usbd_midi_sysex_send(app_usbd_midi_t const * p_midi,
+                                    uint8_t                 cable,
+                                    uint8_t const *         p_buf,
+                                    size_t                  len);
 
 /**
  * @brief Write raw usb midi data to TX buffer and start sending.
  * 
  * Data passed to this function has to be formated into USB-midi event packets. 
  *
+ * The TX buffer is a single producer queue. The function does not mask interrupts and may be
+ * called from any interrupt priority. A call preempting another write to the instance returns
+ * @ref NRF_ERROR_BUSY, see @ref app_usbd_midi for how to retry.
+ *
+ * All event packets are queued or none of them is, so the stream of event packets in the
+ * TX buffer is never misaligned. The cable number is the upper nibble of the first byte of
+ * each event packet, so it cannot be out of range here.
+ *
+ * @retval NRF_SUCCESS              Data queued.
+ * @retval NRF_ERROR_BUSY           Another context is writing to the TX buffer.
+ * @retval NRF_ERROR_NO_MEM         Not enough room in the TX buffer, see @ref app_usbd_midi_overflow_set.
+ * @retval NRF_ERROR_INVALID_LENGTH Length is not a multiple of the event packet size.
+ * @retval NRF_ERROR_INVALID_STATE  USB-MIDI 2.0 is selected, see @ref app_usbd_midi_ump_active.
  */
 ret_code_t app_usbd_midi_send_raw(app_usbd_midi_t const * p_midi,
                                   const void *        p_buf,
                                   size_t              len);
 
 
+/**
+ * @brief Parse received midi data.
+ *
+ * With @ref APP_USBD_MIDI_CONFIG_RX_DEFERRED enabled the OUT endpoint handler only queues
+ * received packets in the RX buffers. This function parses them and calls the rx handler,
+ * so it should be called from the main loop or a low priority interrupt.
+ * Without deferred processing the packets are parsed in the USB event handler and
+ * this function does nothing.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] budget    Maximum number of event packets to parse in this call.
+ *
+ * @retval true  Budget exhausted while there are event packets left to parse.
+ * @retval false All received event packets parsed.
+ */
+bool app_usbd_midi_process(app_usbd_midi_t const * p_midi, size_t budget);
+
+/**
+ * @brief Receive system exclusive without copying.
+ *
+ * With a span handler set, received sysex is not assembled with
+ * @ref APP_USBD_MIDI_SYSEX_BUF_REQ and @ref APP_USBD_MIDI_SYSEX_RX_DONE. Instead, runs of
+ * consecutive sysex event packets of one cable are passed to the handler as spans that
+ * reference the RX buffers in place. A span ends at the end of an RX buffer, at the end
+ * of the message or at any other event packet. The first span of a message starts with
+ * the 0xF0 byte.
+ *
+ * An RX buffer holding a span kept by the application is not reused until the span is
+ * released. RX buffers are reused in order, so the OUT endpoint is NAKed once all of them
+ * wait for a release. Spans become invalid when the port is closed.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] handler   Span handler, NULL to assemble sysex with the rx handler.
+ */
+void app_usbd_midi_sysex_span_handler_set(app_usbd_midi_t const *            p_midi,
+                                          app_usbd_midi_sysex_span_handler_t handler);
+
+/**
+ * @brief Release a sysex span kept by the span handler.
+ *
+ * May be called from any context.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] p_span    Span passed to the span handler.
+ */
+void app_usbd_midi_sysex_release(app_usbd_midi_t const *            p_midi,
+                                 app_usbd_midi_sysex_span_t const * p_span);
+
+/**
+ * @brief Copy sysex bytes of a span to a linear buffer.
+ *
+ * Fallback for applications that need the data in one piece. The span may be released
+ * afterwards, or not kept at all.
+ *
+ * @param[in]  p_span   Sysex span.
+ * @param[out] p_dst    Destination buffer of at least @ref app_usbd_midi_sysex_span_t::len bytes.
+ *
+ * @return Number of bytes copied.
+ */
+size_t app_usbd_midi_sysex_span_copy(app_usbd_midi_sysex_span_t const * p_span, uint8_t * p_dst);
+
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL || defined(__SDK_DOXYGEN__)
+/**
+ * @brief Free a received sysex message.
+ *
+ * With @ref APP_USBD_MIDI_CONFIG_SYSEX_POOL enabled, received sysex messages are stored in
+ * blocks of the instance pool instead of buffers requested with
+ * @ref APP_USBD_MIDI_SYSEX_BUF_REQ. @ref APP_USBD_MIDI_SYSEX_RX_DONE passes the whole message
+ * as a chain of blocks in @ref app_usbd_midi_msg_t::p_chain, @ref app_usbd_midi_msg_t::len
+ * is the length of the whole message. The blocks belong to the application until they
+ * are freed. May be called from any context.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] p_chain   First block of the message.
+ */
+void app_usbd_midi_sysex_free(app_usbd_midi_t const * p_midi, app_usbd_midi_sysex_block_t * p_chain);
+
+/**
+ * @brief Get sysex pool statistics.
+ *
+ * @param[in]  p_midi   Midi class instance.
+ * @param[out] p_stats  Statistics.
+ */
+void app_usbd_midi_sysex_pool_stats_get(app_usbd_midi_t const *            p_midi,
+                                        app_usbd_midi_sysex_pool_stats_t * p_stats);
+#endif
+
+#if APP_USBD_MIDI_CONFIG_TIMESTAMP || defined(__SDK_DOXYGEN__)
+/**
+ * @brief Set the sub-frame time source of timestamps.
+ *
+ * With @ref APP_USBD_MIDI_CONFIG_TIMESTAMP enabled every received message carries
+ * @ref app_usbd_midi_msg_t::timestamp, the time its OUT transfer was handled. The time
+ * counts USB frames since the first SOF and adds the ticks of the time source since
+ * the last SOF. Without a time source the resolution is one frame, 1 ms.
+ *
+ * Timestamps are in microseconds and wrap around after about 71 minutes.
+ *
+ * @param[in] p_midi        Midi class instance.
+ * @param[in] time_get      Free-running counter, NULL to use frames only.
+ * @param[in] ticks_per_ms  Counter ticks per millisecond.
+ */
+void app_usbd_midi_time_source_set(app_usbd_midi_t const *  p_midi,
+                                   app_usbd_midi_time_get_t time_get,
+                                   uint32_t                 ticks_per_ms);
+
+/**
+ * @brief Get current time on the timestamp time base.
+ *
+ * May be called from any context.
+ *
+ * @param[in] p_midi Midi class instance.
+ *
+ * @return Time in microseconds.
+ */
+uint32_t app_usbd_midi_time_get(app_usbd_midi_t const * p_midi);
+#endif
+
+#if APP_USBD_MIDI_CONFIG_STATS || defined(__SDK_DOXYGEN__)
+/**
+ * @brief Get instance statistics.
+ *
+ * Counters are updated on the hot path with plain increments, a snapshot taken while
+ * data flows may be slightly inconsistent. Queueing delays need
+ * @ref APP_USBD_MIDI_CONFIG_TIMESTAMP, the normal lane is sampled.
+ *
+ * @param[in]  p_midi   Midi class instance.
+ * @param[out] p_stats  Statistics.
+ */
+void app_usbd_midi_stats_get(app_usbd_midi_t const * p_midi, app_usbd_midi_stats_t * p_stats);
+
+/**
+ * @brief Clear instance statistics.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+void app_usbd_midi_stats_reset(app_usbd_midi_t const * p_midi);
+#endif
+
+#if APP_USBD_MIDI_CONFIG_TX_ADMISSION || defined(__SDK_DOXYGEN__)
+/**
+ * @brief Set what writes do when the TX buffer is full.
+ *
+ * Applies to @ref app_usbd_midi_send_raw, @ref app_usbd_midi_write,
+ * @ref app_usbd_midi_write_batch, @ref app_usbd_midi_sysex_write and
+ * @ref app_usbd_midi_ump_write. Data already claimed by an IN transfer is never dropped.
+ * A write is either queued completely or fails. Messages are dropped whole: a system
+ * exclusive message, or a multi-packet UMP message, goes with all of its packets, and only
+ * once its end is queued. Note off is never dropped.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] policy    Overflow policy, defaults to @ref APP_USBD_MIDI_CONFIG_TX_OVERFLOW.
+ */
+void app_usbd_midi_overflow_set(app_usbd_midi_t const * p_midi, app_usbd_midi_overflow_t policy);
+
+/**
+ * @brief Set TX buffer watermarks.
+ *
+ * @ref APP_USBD_MIDI_USER_EVT_TX_HIGH_WATERMARK is raised when the data queued in the TX buffer
+ * reaches @p high. @ref APP_USBD_MIDI_USER_EVT_TX_LOW_WATERMARK is raised when it drains down
+ * to @p low afterwards. Producers can pause between the two events.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] low       Low watermark in bytes.
+ * @param[in] high      High watermark in bytes, 0 to disable the events.
+ *
+ * @retval NRF_SUCCESS              Watermarks set.
+ * @retval NRF_ERROR_INVALID_PARAM  @p low is not below @p high or @p high exceeds the TX buffer.
+ */
+ret_code_t app_usbd_midi_watermarks_set(app_usbd_midi_t const * p_midi, size_t low, size_t high);
+#endif
+
+#if APP_USBD_MIDI_LANE_STATS || defined(__SDK_DOXYGEN__)
+/**
+ * @brief Get queueing delay statistics of a TX lane.
+ *
+ * Every real-time event packet is measured. Event packets of the normal lane are sampled,
+ * one at a time. Statistics are updated by the IN transfer completion handler and are
+ * cumulative since the instance was appended.
+ *
+ * @param[in]  p_midi   Midi class instance.
+ * @param[in]  lane     Lane.
+ * @param[out] p_stats  Statistics.
+ *
+ * @retval NRF_SUCCESS              Statistics copied.
+ * @retval NRF_ERROR_INVALID_PARAM  Invalid lane.
+ */
+ret_code_t app_usbd_midi_lane_stats_get(app_usbd_midi_t const *      p_midi,
+                                        app_usbd_midi_lane_t         lane,
+                                        app_usbd_midi_lane_stats_t * p_stats);
+#endif
+
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE || defined(__SDK_DOXYGEN__)
+/**
+ * @brief Set the load above which IN packets are coalesced.
+ *
+ * The load is the number of bytes queued per USB frame, averaged over about 8 frames at SOF.
+ * Below the threshold every write starts a transfer right away for the lowest latency.
+ * Above it data waits until a full packet is queued, until the next SOF or, with a
+ * sub-frame time source, until @ref APP_USBD_MIDI_CONFIG_TX_DEADLINE_US in the frame.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] threshold Load in bytes per frame. 0 always coalesces, UINT16_MAX never does.
+ *                      Defaults to @ref APP_USBD_MIDI_CONFIG_TX_COALESCE_THRESHOLD.
+ */
+void app_usbd_midi_tx_coalesce_set(app_usbd_midi_t const * p_midi, uint16_t threshold);
+#endif
+
+#if APP_USBD_MIDI_CONFIG_SCHED_SIZE || defined(__SDK_DOXYGEN__)
+/**
+ * @brief Schedule a midi message for transmission at a given time.
+ *
+ * Scheduled messages are kept in a binary heap of @ref APP_USBD_MIDI_CONFIG_SCHED_SIZE
+ * entries in the instance context. At every SOF the messages due before the next frame
+ * are moved to the TX buffer in one pass, so they go out in the frame they belong to.
+ * Messages with the same time are sent in the order they were scheduled. Messages already
+ * due are sent right away.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] time      Transmission time, see @ref app_usbd_midi_time_get.
+ * @param[in] cable     Cable number.
+ * @param[in] p_msg     Complete midi message.
+ * @param[in] len       Length of the message.
+ *
+ * @retval NRF_SUCCESS              Message scheduled.
+ * @retval NRF_ERROR_NO_MEM         Scheduler is full.
+ * @retval NRF_ERROR_BUSY           Scheduler is being modified in another context.
+ * @retval NRF_ERROR_INVALID_DATA   Invalid message.
+ * @retval NRF_ERROR_INVALID_PARAM  Invalid cable number.
+ * @retval NRF_ERROR_INVALID_STATE  USB-MIDI 2.0 is selected, see @ref app_usbd_midi_ump_active.
+ */
+ret_code_t app_usbd_midi_schedule(app_usbd_midi_t const * p_midi,
+                                  uint32_t                time,
+                                  uint8_t                 cable,
+                                  uint8_t const *         p_msg,
+                                  size_t                  len);
+#endif
+
+/**
+ * @brief Cable map entry of a cable that is not forwarded by @ref app_usbd_midi_thru_set.
+ */
+#define APP_USBD_MIDI_THRU_NONE 0xFF
+
+/**
+ * @brief Forward received event packets to the TX buffer.
+ *
+ * Every received OUT packet is copied to the TX buffer in the USB event handler, before
+ * it is parsed, so the thru latency does not depend on @ref APP_USBD_MIDI_CONFIG_RX_DEFERRED.
+ * Event packets keep their Code Index Number and only the cable number is replaced.
+ * If every cable is mapped to itself the whole packet is copied with a single memcpy.
+ *
+ * Forwarded event packets are still passed to the routes and the rx handler.
+ * The event packets of an OUT packet are forwarded all together or not at all. If the
+ * TX buffer is written by another context the OUT packet is held back and the host gets
+ * NAKs until the writer is done, it is forwarded when the writer gives back the TX buffer
+ * or when the next IN transfer completes. If the TX buffer has no room for the event
+ * packets they are dropped, counted in @ref app_usbd_midi_stats_t::thru_dropped and
+ * @ref APP_USBD_MIDI_USER_EVT_THRU_DROPPED is raised, from the USB event handler or from
+ * the context of the writer.
+ *
+ * @param[in] p_midi        Midi class instance.
+ * @param[in] p_cable_map   Destination cable of each of the 16 source cables,
+ *                          or @ref APP_USBD_MIDI_THRU_NONE. NULL disables thru.
+ *
+ * @retval NRF_SUCCESS              Thru set.
+ * @retval NRF_ERROR_INVALID_PARAM  Invalid destination cable.
+ */
+ret_code_t app_usbd_midi_thru_set(app_usbd_midi_t const * p_midi, uint8_t const * p_cable_map);
+
+#if APP_USBD_MIDI_CONFIG_ROUTES || defined(__SDK_DOXYGEN__)
+/**
+ * @brief Route masks of @ref app_usbd_midi_route_t.
+ * @{
+ */
+#define APP_USBD_MIDI_ROUTE_ALL         0xFFFF          /**< All cables, Code Index Numbers or channels. */
+#define APP_USBD_MIDI_ROUTE_CABLE(n)    (1u << (n))     /**< Single cable. */
+#define APP_USBD_MIDI_ROUTE_CHANNEL(n)  (1u << (n))     /**< Single channel. */
+#define APP_USBD_MIDI_ROUTE_CIN(cin)    (1u << (cin))   /**< Single Code Index Number, @ref app_usbd_midi_cin_t. */
+#define APP_USBD_MIDI_ROUTE_CIN_VOICE   0x7F00          /**< Channel voice messages, CIN 0x8 to 0xE. */
+#define APP_USBD_MIDI_ROUTE_CIN_COMMON  0x002C          /**< System common messages, CIN 0x2, 0x3 and 0x5. */
+#define APP_USBD_MIDI_ROUTE_CIN_SYSEX   0x00F0          /**< System exclusive, CIN 0x4 to 0x7. */
+#define APP_USBD_MIDI_ROUTE_CIN_RT      0x8000          /**< Real-time messages, CIN 0xF. */
+/** @} */
+
+/**
+ * @brief Set routes of received midi messages.
+ *
+ * A dispatch table of matching routes per cable and Code Index Number is built once here,
+ * so every received event packet is routed with a single table lookup.
+ *
+ * Each event packet is passed to all matching routes in array order:
+ * - a route with a handler gets complete messages as @ref APP_USBD_MIDI_RX_DONE,
+ * - a route without handler forwards the event packet to @ref app_usbd_midi_route_t::thru_cable
+ *   of the TX buffer as is. System exclusive can be routed this way only.
+ *
+ * Event packets matching no route are passed to the rx handler of the instance.
+ * Thru events of one RX buffer are queued in the TX buffer in bulk, so other contexts
+ * may get @ref NRF_ERROR_BUSY from the write functions while received data is parsed.
+ * Event packets that find no room are dropped, counted in
+ * @ref app_usbd_midi_stats_t::thru_dropped and reported by
+ * @ref APP_USBD_MIDI_USER_EVT_THRU_DROPPED.
+ *
+ * The routes are not copied and must stay valid until replaced. Set them before the port
+ * is opened, routes must not be changed while received data is being parsed.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] p_routes  Array of routes. May be NULL if @p count is 0.
+ * @param[in] count     Number of routes, up to @ref APP_USBD_MIDI_CONFIG_ROUTES.
+ *
+ * @retval NRF_SUCCESS              Routes set.
+ * @retval NRF_ERROR_NO_MEM         Too many routes.
+ * @retval NRF_ERROR_INVALID_PARAM  Invalid thru cable or a handler route of system exclusive.
+ */
+ret_code_t app_usbd_midi_routes_set(app_usbd_midi_t const *       p_midi,
+                                    app_usbd_midi_route_t const * p_routes,
+                                    size_t                        count);
+#endif
+
+#if APP_USBD_MIDI_CONFIG_UMP || defined(__SDK_DOXYGEN__)
+/**
+ * @brief Number of words of a Universal MIDI Packet.
+ *
+ * @param[in] word First word of the packet.
+ *
+ * @return Packet size in 32-bit words, 1 to 4, set by its message type.
+ */
+static inline uint8_t app_usbd_midi_ump_words_get(uint32_t word)
+{
+    /* Size minus one of each message type, two bits per type. */
+    return (uint8_t)(((0xFE950D40UL >> (2 * APP_USBD_MIDI_UMP_MT_GET(word))) & 0x3) + 1);
+}
+
+/**
+ * @brief Pack a MIDI 2.0 channel voice message.
+ *
+ * @param[out] p_ump    Packet, 2 words.
+ * @param[in]  group    Group, 0 to 15.
+ * @param[in]  status   Status, see @ref app_usbd_midi_ump_cv2_t.
+ * @param[in]  channel  Channel, 0 to 15.
+ * @param[in]  index    Bytes 3 and 4 of the message, for example note number and attribute
+ *                      type, or bank and index of a controller.
+ * @param[in]  data     Data word, for example a 32-bit controller value.
+ */
+static inline void app_usbd_midi_ump_cv2_pack(uint32_t * p_ump,
+                                              uint8_t    group,
+                                              uint8_t    status,
+                                              uint8_t    channel,
+                                              uint16_t   index,
+                                              uint32_t   data)
+{
+    p_ump[0] = ((uint32_t)APP_USBD_MIDI_UMP_MT_MIDI2_CV << 28) |
+               ((uint32_t)(group & 0x0F) << 24)                |
+               ((uint32_t)(status & 0x0F) << 20)               |
+               ((uint32_t)(channel & 0x0F) << 16)              |
+               index;
+    p_ump[1] = data;
+}
+
+/**
+ * @brief Offer USB-MIDI 2.0 on alternate setting 1 of the streaming interface.
+ *
+ * Alternate setting 0 carries USB-MIDI 1.0 event packets. A host that supports
+ * USB-MIDI 2.0 selects alternate setting 1, where the same bulk endpoints carry
+ * Universal MIDI Packets of 32 to 128 bits. The host reads @p p_gtb_dsc with a
+ * GET_DESCRIPTOR request of the Group Terminal Blocks.
+ *
+ * Endpoint addresses in @p p_ump_dsc are replaced by the endpoints of the instance,
+ * like in the descriptors of alternate setting 0. Call before the class is appended.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] p_ump_dsc Class-specific and endpoint descriptors of alternate setting 1,
+ *                      see @ref APP_USBD_MIDI_DESCRIPTOR. NULL to offer MIDI 1.0 only.
+ * @param[in] p_gtb_dsc Group Terminal Block header and blocks.
+ */
+void app_usbd_midi_ump_descriptors_set(app_usbd_midi_t const *               p_midi,
+                                       app_usbd_midi_subclass_desc_t const * p_ump_dsc,
+                                       app_usbd_midi_subclass_desc_t const * p_gtb_dsc);
+
+/**
+ * @brief Set the handler of received Universal MIDI Packets.
+ *
+ * On alternate setting 1 received packets are passed to this handler instead of
+ * the rx handler. Thru and routes apply to alternate setting 0 only.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] handler   Packet handler, NULL to drop received packets.
+ */
+void app_usbd_midi_ump_handler_set(app_usbd_midi_t const *     p_midi,
+                                   app_usbd_midi_ump_handler_t handler);
+
+/**
+ * @brief Check if the host selected USB-MIDI 2.0.
+ *
+ * @param[in] p_midi Midi class instance.
+ *
+ * @retval true  Alternate setting 1 is selected, use @ref app_usbd_midi_ump_write.
+ * @retval false Alternate setting 0 is selected, use the MIDI 1.0 write functions.
+ */
+bool app_usbd_midi_ump_active(app_usbd_midi_t const * p_midi);
+
+/**
+ * @brief Write Universal MIDI Packets.
+ *
+ * Packets are queued in the TX buffer, all of them or none, subject to the overflow policy
+ * and the watermarks like the MIDI 1.0 writes. IN transfers carry whole packets only: a
+ * packet that would cross an endpoint packet boundary is preceded by NOOP utility messages
+ * up to that boundary instead.
+ *
+ * @param[in] p_midi    Midi class instance.
+ * @param[in] p_ump     Packets, words in host byte order.
+ * @param[in] words     Number of words in @p p_ump.
+ *
+ * @retval NRF_SUCCESS              Packets queued.
+ * @retval NRF_ERROR_INVALID_STATE  Alternate setting 1 is not selected.
+ * @retval NRF_ERROR_INVALID_LENGTH @p words is 0 or ends inside a packet.
+ * @retval NRF_ERROR_NO_MEM         Not enough space in the TX buffer.
+ * @retval NRF_ERROR_BUSY           TX buffer is being written in another context.
+ */
+ret_code_t app_usbd_midi_ump_write(app_usbd_midi_t const * p_midi,
+                                   uint32_t const *        p_ump,
+                                   size_t                  words);
+#endif
+
 /** @} */
 
 #ifdef __cplusplus
@@ -89,6 +89,31 @@ extern "C" {
 #define APP_USBD_AUDIO_MIDI_BULK_IN_ENDPOINT_DSC \
             USBD_MIDI_CLASS_SPECIFIC_BULK_IN_ENDPOINT_DESCRIPTOR
 
+
+#define APP_USBD_AUDIO_MIDI2_CS_MIDI_STREAMING_INTERFACE_DSC \
+            USBD_MIDI2_CLASS_SPECIFIC_MIDI_STREAMING_INTERFACE_DESCRIPTOR
+
+
+#define APP_USBD_AUDIO_MIDI2_STANDARD_BULK_OUT_ENDPOINT_DSC \
+            USBD_MIDI2_STANDARD_BULK_OUT_ENDPOINT_DESCRIPTOR
+
+#define APP_USBD_AUDIO_MIDI2_BULK_OUT_ENDPOINT_DSC \
+            USBD_MIDI2_CLASS_SPECIFIC_BULK_OUT_ENDPOINT_DESCRIPTOR
+
+
+#define APP_USBD_AUDIO_MIDI2_STANDARD_BULK_IN_ENDPOINT_DSC \
+            USBD_MIDI2_STANDARD_BULK_IN_ENDPOINT_DESCRIPTOR
+
+#define APP_USBD_AUDIO_MIDI2_BULK_IN_ENDPOINT_DSC \
+            USBD_MIDI2_CLASS_SPECIFIC_BULK_IN_ENDPOINT_DESCRIPTOR
+
+
+#define APP_USBD_AUDIO_MIDI2_GTB_HEADER_DSC \
+            USBD_MIDI2_GROUP_TERMINAL_BLOCK_HEADER_DESCRIPTOR
+
+#define APP_USBD_AUDIO_MIDI2_GTB_DSC \
+            USBD_MIDI2_GROUP_TERMINAL_BLOCK_DESCRIPTOR
+
             
 
 /** @} */
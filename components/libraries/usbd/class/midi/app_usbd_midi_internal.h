@@ -43,12 +43,123 @@
 #include "app_usbd_audio_types.h"
 #include "app_usbd_audio_internal.h"
 #include "nrf_ringbuf.h"
+#include "nrf_atomic.h"
+#include "nrf_balloc.h"
 #include "app_fifo.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#ifndef APP_USBD_MIDI_CONFIG_RX_DEFERRED
+#define APP_USBD_MIDI_CONFIG_RX_DEFERRED 0
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_ROUTES
+#define APP_USBD_MIDI_CONFIG_ROUTES 0
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_SYSEX_POOL
+#define APP_USBD_MIDI_CONFIG_SYSEX_POOL 0
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_SYSEX_BLOCK_SIZE
+#define APP_USBD_MIDI_CONFIG_SYSEX_BLOCK_SIZE 64
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_SYSEX_BLOCK_COUNT
+#define APP_USBD_MIDI_CONFIG_SYSEX_BLOCK_COUNT 16
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_TIMESTAMP
+#define APP_USBD_MIDI_CONFIG_TIMESTAMP 0
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_SCHED_SIZE
+#define APP_USBD_MIDI_CONFIG_SCHED_SIZE 0
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_SCHED_LEAD_US
+#define APP_USBD_MIDI_CONFIG_SCHED_LEAD_US 1000
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_TX_COALESCE
+#define APP_USBD_MIDI_CONFIG_TX_COALESCE 0
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_TX_COALESCE_THRESHOLD
+#define APP_USBD_MIDI_CONFIG_TX_COALESCE_THRESHOLD 32
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_TX_DEADLINE_US
+#define APP_USBD_MIDI_CONFIG_TX_DEADLINE_US 500
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+#define APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE 0
+#endif
+
+#if (APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE & (APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE - 1)) || \
+    (APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE > 128)
+#error "APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE must be a power of 2 not greater than 128"
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_CC_SLOTS
+#define APP_USBD_MIDI_CONFIG_CC_SLOTS 0
+#endif
+
+#if (APP_USBD_MIDI_CONFIG_CC_SLOTS & (APP_USBD_MIDI_CONFIG_CC_SLOTS - 1))
+#error "APP_USBD_MIDI_CONFIG_CC_SLOTS must be a power of 2"
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_TX_ADMISSION
+#define APP_USBD_MIDI_CONFIG_TX_ADMISSION 0
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_TX_OVERFLOW
+#define APP_USBD_MIDI_CONFIG_TX_OVERFLOW 0
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_STATS
+#define APP_USBD_MIDI_CONFIG_STATS 0
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_TRACE_SIZE
+#define APP_USBD_MIDI_CONFIG_TRACE_SIZE 0
+#endif
+
+#if (APP_USBD_MIDI_CONFIG_TRACE_SIZE & (APP_USBD_MIDI_CONFIG_TRACE_SIZE - 1))
+#error "APP_USBD_MIDI_CONFIG_TRACE_SIZE must be a power of 2"
+#endif
+
+#ifndef APP_USBD_MIDI_CONFIG_UMP
+#define APP_USBD_MIDI_CONFIG_UMP 0
+#endif
+
+/**
+ * @brief Queueing delay of each TX lane is measured.
+ */
+#define APP_USBD_MIDI_LANE_STATS ((APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE || APP_USBD_MIDI_CONFIG_STATS) && \
+                                  APP_USBD_MIDI_CONFIG_TIMESTAMP)
+
+/**
+ * @brief Producers edit unsent data of the TX buffer in place.
+ */
+#define APP_USBD_MIDI_TX_EDIT (APP_USBD_MIDI_CONFIG_TX_ADMISSION || APP_USBD_MIDI_CONFIG_CC_SLOTS)
+
+/**
+ * @brief The class needs SOF events.
+ */
+#define APP_USBD_MIDI_SOF_USED (APP_USBD_MIDI_CONFIG_TIMESTAMP || APP_USBD_MIDI_CONFIG_TX_COALESCE)
+
+#if (APP_USBD_MIDI_CONFIG_SCHED_SIZE > 0) && !APP_USBD_MIDI_CONFIG_TIMESTAMP
+#error "APP_USBD_MIDI_CONFIG_SCHED_SIZE requires APP_USBD_MIDI_CONFIG_TIMESTAMP"
+#endif
+
+#if (APP_USBD_MIDI_CONFIG_ROUTES > 32)
+#error "APP_USBD_MIDI_CONFIG_ROUTES must not exceed 32"
+#endif
+
 
 /**
  * @defgroup app_usbd_midi_internal USB midi internals
@@ -87,21 +198,163 @@ typedef void (*app_usbd_midi_user_ev_handler_t)(app_usbd_class_inst_t const *  p
 
 enum app_usbd_midi_rx_event_e;
 
+/**
+ * @brief Block of a received sysex message, see @ref APP_USBD_MIDI_CONFIG_SYSEX_POOL.
+ */
+typedef struct app_usbd_midi_sysex_block_s {
+    struct app_usbd_midi_sysex_block_s * p_next;    //!< Next block of the message, NULL in the last one
+    uint16_t len;                                   //!< Number of bytes in @ref data
+    uint8_t  data[APP_USBD_MIDI_CONFIG_SYSEX_BLOCK_SIZE]; //!< Message bytes
+} app_usbd_midi_sysex_block_t;
+
 typedef struct {
     uint8_t * p_data;
     size_t len;
+    app_usbd_midi_sysex_block_t * p_chain;  //!< Blocks of a pooled sysex message, NULL otherwise
+    uint32_t timestamp;                     //!< Reception time in microseconds, see @ref APP_USBD_MIDI_CONFIG_TIMESTAMP
 } app_usbd_midi_msg_t;
 
+/**
+ * @brief Sub-frame time source.
+ *
+ * @return Value of a free-running counter, for example a TIMER capture or the RTC
+ *         counter of app_timer.
+ */
+typedef uint32_t (*app_usbd_midi_time_get_t)(void);
+
+/**
+ * @brief Event packet scheduled for transmission.
+ */
+typedef struct {
+    uint32_t time;      //!< Transmission time in microseconds
+    uint32_t seq;       //!< Scheduling order of events with the same time
+    uint8_t  ev[4];     //!< Event packet
+} app_usbd_midi_sched_ev_t;
+
+/**
+ * @brief Time reference taken at SOF.
+ */
+typedef struct {
+    uint32_t frames;    //!< Frames counted since the first SOF
+    uint32_t ticks;     //!< Time source value at the SOF
+} app_usbd_midi_sof_ref_t;
+
+/**
+ * @brief Midi RX buffers.
+ *
+ * Ring of @ref count buffers of @ref size bytes each. One buffer is filled by the OUT
+ * transfer while received buffers wait to be parsed.
+ */
 typedef struct {
-    uint8_t data[64];
-    size_t  len;
+    uint8_t *          p_data;  //!< Memory of all buffers
+    size_t  *          p_len;   //!< Number of received bytes in each buffer
+    nrf_atomic_u32_t * p_pins;  //!< Number of sysex spans the application holds in each buffer
+    uint32_t *         p_stamp; //!< Reception time of each buffer
+    uint16_t           size;    //!< Size of one buffer, the largest OUT transfer
+    uint8_t            count;   //!< Number of buffers
 } app_usbd_midi_rx_buf_t;
 
+/**
+ * @brief Define midi RX buffers.
+ *
+ * @param name      Name of the buffers instance.
+ * @param buf_count Number of buffers. Must be a power of two, up to 128.
+ * @param buf_size  Size of one buffer. Must be a multiple of the endpoint size.
+ *
+ * @note OUT transfers larger than one packet finish only on a short packet. Use
+ *       buffers larger than the endpoint size only if the host ends its transfers
+ *       with a short packet, otherwise the data waits for the next transfer.
+ */
+#define APP_USBD_MIDI_RX_BUF_DEF(name, buf_count, buf_size)                         \
+    STATIC_ASSERT(IS_POWER_OF_TWO(buf_count) && ((buf_count) <= 128));              \
+    STATIC_ASSERT(((buf_size) != 0) && (((buf_size) % NRF_DRV_USBD_EPSIZE) == 0));  \
+    static uint8_t CONCAT_2(name, _data)[(buf_count) * (buf_size)];                 \
+    static size_t  CONCAT_2(name, _len)[(buf_count)];                               \
+    static nrf_atomic_u32_t CONCAT_2(name, _pins)[(buf_count)];                     \
+    static uint32_t CONCAT_2(name, _stamp)[(buf_count)];                            \
+    static const app_usbd_midi_rx_buf_t name = {                                    \
+        .p_data = CONCAT_2(name, _data),                                            \
+        .p_len  = CONCAT_2(name, _len),                                             \
+        .p_pins = CONCAT_2(name, _pins),                                            \
+        .p_stamp = CONCAT_2(name, _stamp),                                          \
+        .size   = (buf_size),                                                       \
+        .count  = (buf_count),                                                      \
+    }
+
 typedef void (*app_usbd_midi_rx_handler_t)(app_usbd_class_inst_t const * p_inst,
                                         enum app_usbd_midi_rx_event_e event,
                                         uint8_t cable,
                                         app_usbd_midi_msg_t *rx);
 
+/**
+ * @brief Span of system exclusive event packets inside an RX buffer.
+ *
+ * The span references the received event packets in place. Each event packet carries
+ * up to three sysex bytes after its header byte.
+ */
+typedef struct {
+    uint8_t const * p_ev;   //!< First event packet of the span
+    uint16_t        count;  //!< Number of event packets
+    uint16_t        len;    //!< Number of sysex bytes in the span
+    uint8_t         buf;    //!< Index of the RX buffer holding the span
+    bool            end;    //!< Span ends the system exclusive message
+} app_usbd_midi_sysex_span_t;
+
+/**
+ * @brief Sysex span handler.
+ *
+ * @param[in] p_inst    Class instance.
+ * @param[in] cable     Cable number.
+ * @param[in] p_span    Span of received system exclusive data.
+ *
+ * @retval true  The span is kept by the application and its RX buffer stays pinned until
+ *               @ref app_usbd_midi_sysex_release is called.
+ * @retval false The span is no longer used, the RX buffer may be reused right away.
+ */
+typedef bool (*app_usbd_midi_sysex_span_handler_t)(app_usbd_class_inst_t const *      p_inst,
+                                                   uint8_t                            cable,
+                                                   app_usbd_midi_sysex_span_t const * p_span);
+
+/**
+ * @brief Universal MIDI Packet handler.
+ *
+ * Called for every packet received on alternate setting 1 of the streaming interface.
+ *
+ * @param[in] p_inst    Class instance.
+ * @param[in] p_ump     Packet, 1 to 4 words in host byte order. Valid during the call only.
+ * @param[in] words     Number of words of the packet.
+ * @param[in] timestamp Reception time in microseconds, see @ref APP_USBD_MIDI_CONFIG_TIMESTAMP.
+ */
+typedef void (*app_usbd_midi_ump_handler_t)(app_usbd_class_inst_t const * p_inst,
+                                            uint32_t const *              p_ump,
+                                            uint8_t                       words,
+                                            uint32_t                      timestamp);
+
+/**
+ * @brief Midi route.
+ *
+ * Received event packets matching @ref cables, @ref cins and @ref channels are passed to
+ * @ref handler, or forwarded to @ref thru_cable of the TX buffer if there is no handler.
+ */
+typedef struct {
+    uint16_t                   cables;      //!< Bit mask of source cables
+    uint16_t                   cins;        //!< Bit mask of Code Index Numbers, see @ref app_usbd_midi_cin_t
+    uint16_t                   channels;    //!< Bit mask of channels, checked for channel messages only
+    app_usbd_midi_rx_handler_t handler;     //!< Handler of matching messages, NULL for a thru route
+    uint8_t                    thru_cable;  //!< Destination cable of a thru route
+} app_usbd_midi_route_t;
+
+/**
+ * @brief Bit mask of routes, one bit per entry of the route array.
+ */
+#if (APP_USBD_MIDI_CONFIG_ROUTES > 16)
+typedef uint32_t app_usbd_midi_route_mask_t;
+#elif (APP_USBD_MIDI_CONFIG_ROUTES > 8)
+typedef uint16_t app_usbd_midi_route_mask_t;
+#else
+typedef uint8_t app_usbd_midi_route_mask_t;
+#endif
+
 /**
  * @brief Midi subclass descriptor.
  */
@@ -118,6 +371,159 @@ typedef struct {
     size_t left; 
 } app_usbd_midi_sysex_buf_t;
 
+/**
+ * @brief Sysex message being received into pool blocks.
+ */
+typedef struct {
+    app_usbd_midi_sysex_block_t * p_first;  //!< First block of the message
+    app_usbd_midi_sysex_block_t * p_last;   //!< Block being filled
+    size_t                        len;      //!< Number of bytes received
+    bool                          drop;     //!< Pool ran out, the rest of the message is dropped
+} app_usbd_midi_sysex_chain_t;
+
+/**
+ * @brief Sysex pool statistics.
+ */
+typedef struct {
+    nrf_atomic_u32_t used; //!< Blocks held by the class and the application
+    uint32_t peak;      //!< Highest number of blocks used at once
+    uint32_t exhausted; //!< Number of failed block allocations
+    uint32_t dropped;   //!< Number of messages dropped because the pool ran out
+} app_usbd_midi_sysex_pool_stats_t;
+
+/**
+ * @brief What a write does when the TX buffer has no room for it.
+ */
+typedef enum {
+    APP_USBD_MIDI_OVERFLOW_REJECT,      //!< Write fails with NRF_ERROR_NO_MEM
+    APP_USBD_MIDI_OVERFLOW_DROP_OLDEST, //!< Oldest unsent messages are dropped, system exclusive as a whole, note off never
+    APP_USBD_MIDI_OVERFLOW_DROP_LOW,    //!< Oldest unsent controller and pressure event packets are dropped
+} app_usbd_midi_overflow_t;
+
+/**
+ * @brief Last queued event packet of a continuous controller.
+ */
+typedef struct {
+    uint32_t key; //!< Cable, status and controller of the event packet, 0 if unused
+    uint32_t pos; //!< TX ring buffer index of the event packet
+} app_usbd_midi_cc_slot_t;
+
+/**
+ * @brief TX lanes.
+ */
+typedef enum {
+    APP_USBD_MIDI_LANE_NORMAL, //!< TX buffer of all other event packets
+    APP_USBD_MIDI_LANE_RT,     //!< Queue of real-time messages, always sent first
+    APP_USBD_MIDI_LANE_COUNT   //!< Number of lanes
+} app_usbd_midi_lane_t;
+
+/**
+ * @brief Queueing delay statistics of a TX lane.
+ *
+ * Delay is measured from writing an event packet to the end of the IN transfer
+ * that sent it.
+ */
+typedef struct {
+    uint32_t count;    //!< Number of measured event packets
+    uint32_t total_us; //!< Sum of measured delays in microseconds
+    uint32_t max_us;   //!< Longest measured delay in microseconds
+} app_usbd_midi_lane_stats_t;
+
+/**
+ * @brief Trace points, see @ref APP_USBD_MIDI_CONFIG_TRACE_SIZE.
+ *
+ * Values are part of the trace format read by the host decoder.
+ */
+typedef enum {
+    APP_USBD_MIDI_TRACE_SEND_RAW_ENTER = 1,  //!< @ref app_usbd_midi_send_raw called, payload: length
+    APP_USBD_MIDI_TRACE_SEND_RAW_EXIT  = 2,  //!< @ref app_usbd_midi_send_raw returns, payload: error code
+    APP_USBD_MIDI_TRACE_TX_START       = 3,  //!< IN transfer started, payload: length
+    APP_USBD_MIDI_TRACE_IN_DONE        = 4,  //!< IN transfer finished, payload: status
+    APP_USBD_MIDI_TRACE_OUT_DONE       = 5,  //!< OUT transfer finished, payload: length
+    APP_USBD_MIDI_TRACE_RX_ARM         = 6,  //!< OUT transfer armed, payload: RX buffer index
+    APP_USBD_MIDI_TRACE_RX_PACKET      = 7,  //!< OUT packet placed by the consumer, payload: length
+    APP_USBD_MIDI_TRACE_RX_CB_ENTER    = 8,  //!< Rx handler called, payload: event
+    APP_USBD_MIDI_TRACE_RX_CB_EXIT     = 9,  //!< Rx handler returns, payload: event
+    APP_USBD_MIDI_TRACE_EV_CB_ENTER    = 10, //!< User event handler called, payload: event
+    APP_USBD_MIDI_TRACE_EV_CB_EXIT     = 11, //!< User event handler returns, payload: event
+} app_usbd_midi_trace_id_t;
+
+/**
+ * @brief Trace record.
+ */
+typedef struct {
+    uint32_t cycles;  //!< DWT cycle counter
+    uint16_t id;      //!< Trace point, @ref app_usbd_midi_trace_id_t
+    uint16_t payload; //!< Trace point specific value
+} app_usbd_midi_trace_rec_t;
+
+/**
+ * @brief Trace ring buffer.
+ *
+ * Dumped from RAM as is and decoded on the host.
+ */
+typedef struct {
+    uint32_t                  magic; //!< @ref APP_USBD_MIDI_TRACE_MAGIC
+    uint32_t                  size;  //!< Number of records
+    nrf_atomic_u32_t          idx;   //!< Number of records written, the oldest one is overwritten
+    app_usbd_midi_trace_rec_t rec[APP_USBD_MIDI_CONFIG_TRACE_SIZE ? APP_USBD_MIDI_CONFIG_TRACE_SIZE : 1]; //!< Records
+} app_usbd_midi_trace_t;
+
+#define APP_USBD_MIDI_TRACE_MAGIC 0x4D545243UL /**< "CRTM", start of a trace dump */
+
+#if APP_USBD_MIDI_CONFIG_TRACE_SIZE
+/**
+ * @brief Trace ring buffer, dump @c sizeof(app_usbd_midi_trace) bytes from its address.
+ */
+extern app_usbd_midi_trace_t app_usbd_midi_trace;
+#endif
+
+/**
+ * @brief Instance statistics.
+ *
+ * Counters are updated without locking and wrap around.
+ */
+typedef struct {
+    uint32_t rx_events[16];  //!< Received event packets of each cable, or UMPs of each group
+    uint32_t rx_cin[16];     //!< Received event packets of each Code Index Number, or UMPs of each message type
+    uint32_t tx_events[16];  //!< Sent event packets of each cable, or UMPs of each group
+    uint32_t tx_cin[16];     //!< Sent event packets of each Code Index Number, or UMPs of each message type
+    uint32_t rx_bytes;       //!< Bytes received
+    uint32_t rx_transfers;   //!< Finished OUT transfers
+    uint32_t rx_aborted;     //!< Aborted OUT transfers
+    uint32_t tx_bytes;       //!< Bytes sent
+    uint32_t tx_packets;     //!< IN packets sent, the packing is the sum of @ref tx_events divided by this
+    uint32_t tx_aborted;     //!< Aborted IN transfers
+    uint32_t tx_high_water;  //!< Most bytes queued in the TX buffer at once
+    uint32_t tx_rejected;    //!< Writes failed for lack of room in the TX buffer
+    uint32_t tx_dropped;     //!< Event packets dropped by the overflow policy
+    uint32_t tx_coalesced;   //!< Controller values overwritten by newer ones in the TX buffer
+    uint32_t thru_dropped;   //!< Received event packets thru could not forward
+    uint32_t sysex_buf_req;  //!< Sysex buffer requests raised
+    app_usbd_midi_lane_stats_t delay[APP_USBD_MIDI_LANE_COUNT]; //!< Queueing delay, with timestamps enabled
+} app_usbd_midi_stats_t;
+
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL
+#define APP_USBD_MIDI_SYSEX_POOL_DEF(name)                              \
+    NRF_BALLOC_DEF(name,                                                \
+                   sizeof(app_usbd_midi_sysex_block_t),                 \
+                   APP_USBD_MIDI_CONFIG_SYSEX_BLOCK_COUNT);
+#define APP_USBD_MIDI_SYSEX_POOL_INIT(pool) .p_sysex_pool = (pool),
+#else
+#define APP_USBD_MIDI_SYSEX_POOL_DEF(name)
+#define APP_USBD_MIDI_SYSEX_POOL_INIT(pool)
+#endif
+
+/**
+ * @brief State of a midi byte stream encoder.
+ */
+typedef struct {
+    uint8_t status;     //!< Status of the message in progress, 0xF0 inside system exclusive, 0 if none.
+    uint8_t len;        //!< Expected length of the message in progress.
+    uint8_t pos;        //!< Number of bytes collected in @ref data.
+    uint8_t data[3];    //!< Bytes of the message in progress.
+} app_usbd_midi_stream_t;
+
 /**
  * @brief Midi class part of class instance data.
  */
@@ -130,6 +536,10 @@ typedef struct {
     app_usbd_audio_subclass_t       type_streaming;         //!< Streaming type MIDISTREAMING/AUDIOSTREAMING (@ref app_usbd_midi_subclass_t)
     nrf_ringbuf_t const *           p_in_buf;               //!< Out queue
     nrf_ringbuf_t const *           p_out_buf;              //!< Out queue
+    app_usbd_midi_rx_buf_t const *  p_rx_buf;               //!< RX buffers
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL
+    nrf_balloc_t const *            p_sysex_pool;           //!< Blocks of received sysex messages
+#endif
     app_usbd_midi_user_ev_handler_t user_ev_handler;        //!< User event handler
     app_usbd_midi_rx_handler_t      user_rx_handler;        //!< User event handler
 } app_usbd_midi_inst_t;
@@ -140,11 +550,106 @@ typedef struct {
  */
 typedef struct {
     app_usbd_audio_req_t        request;       //!< Audio class request.
-    bool                        sending;       //!< Sending flag
+    nrf_atomic_flag_t           sending;       //!< Sending flag, set while the IN endpoint is owned by a transfer
+    size_t                      tx_len;        //!< Length of the TX ring buffer span owned by the ongoing IN transfer
     bool                        streaming;     //!< Streaming flag
+    uint8_t                     alt_setting;   //!< Selected alternate setting of the streaming interface
+    uint8_t                     in_aborts;     //!< ABORTED events of the IN endpoint still queued for a previous setting
+    uint8_t                     out_aborts;    //!< ABORTED events of the OUT endpoint still queued for a previous setting
     app_usbd_midi_sysex_buf_t   sysex[16];
-    app_usbd_midi_rx_buf_t      rx_transfer[2];
-    uint8_t                     rx_buf;
+    app_usbd_midi_stream_t      tx_stream[16]; //!< Byte stream encoders, one per cable
+    uint8_t const *             p_sysex_src;   //!< Rest of the message queued by @ref app_usbd_midi_sysex_send
+    volatile size_t             sysex_src_left; //!< Bytes left in @ref p_sysex_src, 0 if idle
+    uint8_t                     sysex_src_cable; //!< Cable of @ref p_sysex_src
+    nrf_atomic_flag_t           sysex_src_lock; //!< @ref p_sysex_src is being encoded
+    size_t                      rx_fill;       //!< Bytes received by the ongoing OUT transfer
+    size_t                      rx_pos;        //!< Parse position in the oldest RX buffer
+    volatile uint8_t            rx_wr;         //!< Number of RX buffers received, modulo 256
+    volatile uint8_t            rx_rd;         //!< Number of RX buffers parsed, modulo 256
+    volatile uint8_t            rx_free;       //!< Number of RX buffers released, modulo 256
+    nrf_atomic_flag_t           rx_armed;      //!< OUT transfer is ongoing
+    nrf_atomic_flag_t           rx_reclaiming; //!< Parsed RX buffers are being released
+    app_usbd_midi_sysex_span_handler_t sysex_span_handler; //!< Zero-copy sysex handler, NULL to assemble sysex with the rx handler
+    app_usbd_midi_sysex_span_t  rx_span;       //!< Sysex span being collected
+    uint32_t                    rx_stamp;      //!< Reception time of the RX buffer being parsed
+#if APP_USBD_MIDI_CONFIG_TIMESTAMP
+    app_usbd_midi_time_get_t    time_get;      //!< Sub-frame time source, NULL for 1 ms resolution
+    uint32_t                    ticks_per_ms;  //!< Time source ticks per millisecond
+    app_usbd_midi_sof_ref_t     sof_ref[2];    //!< Time references of the last SOF, double buffered
+    volatile uint8_t            sof_ref_idx;   //!< Valid entry of @ref sof_ref
+    uint16_t                    sof_framecnt;  //!< USB frame number of the last SOF
+#endif
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE
+    uint16_t                    tx_coalesce;   //!< Load in bytes per frame above which packets are coalesced
+    uint32_t                    tx_load;       //!< Average load in bytes per frame, scaled by 8
+    uint32_t                    tx_sof_wr;     //!< TX ring buffer write index at the last SOF
+#endif
+#if APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+    uint32_t                    rt_queue[APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE]; //!< Real-time event packets, sent in place
+    volatile uint8_t            rt_wr;         //!< Number of real-time event packets queued, modulo 256
+    volatile uint8_t            rt_rd;         //!< Number of real-time event packets sent, modulo 256
+    uint8_t                     rt_len;        //!< Real-time event packets owned by the ongoing IN transfer
+    nrf_atomic_flag_t           rt_lock;       //!< Real-time queue is being written
+#endif
+#if APP_USBD_MIDI_LANE_STATS && APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+    uint32_t                    rt_stamp[APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE]; //!< Queueing time of real-time event packets
+#endif
+#if APP_USBD_MIDI_LANE_STATS
+    app_usbd_midi_lane_stats_t  lane_stats[APP_USBD_MIDI_LANE_COUNT]; //!< Queueing delay of each lane
+    uint32_t                    probe_idx;     //!< TX ring buffer write index of the measured event packet
+    uint32_t                    probe_time;    //!< Queueing time of the measured event packet
+    nrf_atomic_flag_t           probe_lock;    //!< Event packet of the normal lane is being measured
+    volatile bool               probe_armed;   //!< @ref probe_idx and @ref probe_time are valid
+#endif
+#if APP_USBD_MIDI_TX_EDIT
+    nrf_atomic_flag_t           tx_compact;    //!< Unsent data is being edited by a producer
+    volatile bool               tx_claiming;   //!< TX ring buffer is being claimed for an IN transfer
+#endif
+#if APP_USBD_MIDI_CONFIG_TX_ADMISSION
+    app_usbd_midi_overflow_t    tx_overflow;   //!< Overflow policy
+    uint32_t                    tx_dropped;    //!< Number of event packets dropped by the overflow policy
+    size_t                      tx_wm_low;     //!< Low watermark in bytes
+    size_t                      tx_wm_high;    //!< High watermark in bytes, 0 if disabled
+    nrf_atomic_flag_t           tx_wm_above;   //!< TX buffer went above the high watermark
+#endif
+#if APP_USBD_MIDI_CONFIG_STATS
+    app_usbd_midi_stats_t       stats;         //!< Statistics, see @ref app_usbd_midi_stats_get
+    uint8_t const *             p_tx_data;     //!< TX ring buffer span owned by the ongoing IN transfer
+#endif
+#if APP_USBD_MIDI_CONFIG_CC_SLOTS
+    app_usbd_midi_cc_slot_t     cc_slot[APP_USBD_MIDI_CONFIG_CC_SLOTS]; //!< Continuous controllers queued in the TX buffer
+    uint32_t                    cc_coalesced;  //!< Number of event packets overwritten by newer values
+#endif
+#if APP_USBD_MIDI_CONFIG_SCHED_SIZE
+    app_usbd_midi_sched_ev_t    sched[APP_USBD_MIDI_CONFIG_SCHED_SIZE]; //!< Binary heap of scheduled events, earliest first
+    size_t                      sched_count;   //!< Number of scheduled events
+    uint32_t                    sched_seq;     //!< Sequence number of the next scheduled event
+    nrf_atomic_flag_t           sched_lock;    //!< Heap is being modified
+    nrf_atomic_flag_t           sched_pending; //!< Release of due events requested
+#endif
+#if APP_USBD_MIDI_CONFIG_UMP
+    app_usbd_midi_subclass_desc_t const * p_ump_dsc; //!< Class-specific descriptors of alternate setting 1, NULL if not offered
+    app_usbd_midi_subclass_desc_t const * p_gtb_dsc; //!< Group Terminal Block descriptors
+    app_usbd_midi_ump_handler_t ump_handler;   //!< Handler of received Universal MIDI Packets
+    uint32_t                    rx_ump[4];     //!< Received packet being collected
+    uint8_t                     rx_ump_fill;   //!< Number of words in @ref rx_ump
+#endif
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL
+    app_usbd_midi_sysex_chain_t sysex_chain[16];    //!< Sysex messages being received, one per cable
+    app_usbd_midi_sysex_pool_stats_t sysex_pool_stats; //!< Sysex pool statistics
+#endif
+    uint8_t                     rx_span_cable; //!< Cable of @ref rx_span
+    bool                        rx_span_open;  //!< @ref rx_span holds event packets
+    uint8_t                     thru_map[16];  //!< Thru destination cable of each source cable
+    bool                        thru_enabled;  //!< Received event packets are forwarded to the TX buffer
+    bool                        thru_identity; //!< Thru maps every cable to itself
+    nrf_atomic_flag_t           thru_held;     //!< RX buffer @ref thru_held_idx waits for the TX buffer write lock
+    uint8_t                     thru_held_idx; //!< RX buffer held back by thru
+    uint32_t                    desc_pos;      //!< Position in the midi streaming descriptors while they are fed
+#if APP_USBD_MIDI_CONFIG_ROUTES
+    app_usbd_midi_route_t const * p_routes;    //!< Routes set by @ref app_usbd_midi_routes_set
+    app_usbd_midi_route_mask_t  route_map[16][16]; //!< Routes matching each cable and Code Index Number
+#endif
 } app_usbd_midi_ctx_t;
 
 /**
@@ -163,15 +668,31 @@ typedef struct {
 /**
  * @brief Midi configuration.
  *
+ * Every instance appended to a composite device needs its own interfaces and endpoints.
+ *
  * @param iface_control     Interface number of midi control.
- * @param iface_stream_in   Interface number of midi stream on IN endpoint.
+ * @param iface_stream      Interface number of midi stream.
+ * @param ep_in             Bulk IN endpoint of midi stream.
+ * @param ep_out            Bulk OUT endpoint of midi stream.
  */
-#define APP_USBD_MIDI_CONFIG_IN_OUT(iface_control, iface_stream_in_out)         \
-        (                                                                       \
-                (iface_control),                                                \
-                (iface_stream_in_out, NRF_DRV_USBD_EPIN1, NRF_DRV_USBD_EPOUT1)  \
+#define APP_USBD_MIDI_CONFIG(iface_control, iface_stream, ep_in, ep_out)   \
+        (                                                                   \
+                (iface_control),                                            \
+                (iface_stream, ep_in, ep_out)                               \
         )
 
+/**
+ * @brief Midi configuration with IN and OUT endpoints 1.
+ *
+ * @param iface_control         Interface number of midi control.
+ * @param iface_stream_in_out   Interface number of midi stream.
+ */
+#define APP_USBD_MIDI_CONFIG_IN_OUT(iface_control, iface_stream_in_out)         \
+        APP_USBD_MIDI_CONFIG(iface_control,                                     \
+                             iface_stream_in_out,                               \
+                             NRF_DRV_USBD_EPIN1,                                \
+                             NRF_DRV_USBD_EPOUT1)
+
 /**
  * @brief Specific class constant data for midi class.
  *
@@ -186,13 +707,18 @@ typedef struct {
  * @param midi_descriptor           Midi class descriptor.
  * @param ep_siz                    Endpoint size.
  * @param type_str                  Streaming type MIDISTREAMING/AUDIOSTREAMING.
+ * @param in_buf                    TX ring buffer.
+ * @param rx_buf                    RX buffers.
+ * @param sysex_pool                Sysex block pool.
  */
  #define APP_USBD_MIDI_INST_CONFIG(user_event_handler,              \
                                     rx_handler,                     \
                                     midi_descriptor,                \
                                     ep_siz,                         \
                                     type_str,                       \
-                                    in_buf)                         \
+                                    in_buf,                         \
+                                    rx_buf,                         \
+                                    sysex_pool)                     \
     .inst = {                                                       \
          .user_ev_handler = user_event_handler,                     \
          .user_rx_handler = rx_handler,                             \
@@ -200,6 +726,8 @@ typedef struct {
          .ep_size         = ep_siz,                                 \
          .type_streaming  = type_str,                               \
          .p_in_buf        = in_buf,                                 \
+         .p_rx_buf        = rx_buf,                                 \
+         APP_USBD_MIDI_SYSEX_POOL_INIT(sysex_pool)                  \
     }
 
 
@@ -228,8 +756,14 @@ extern const app_usbd_class_methods_t app_usbd_midi_class_methods;
                                     user_ev_handler,                \
                                     rx_handler,                     \
                                     midi_descriptor,                \
-                                    in_buf_size)                    \
+                                    in_buf_size,                    \
+                                    rx_buf_count,                   \
+                                    rx_buf_size)                    \
     NRF_RINGBUF_DEF(instance_name##_buf_in, in_buf_size);           \
+    APP_USBD_MIDI_RX_BUF_DEF(instance_name##_buf_rx,                \
+                             rx_buf_count,                          \
+                             rx_buf_size);                          \
+    APP_USBD_MIDI_SYSEX_POOL_DEF(instance_name##_sysex_pool)        \
     APP_USBD_CLASS_INST_GLOBAL_DEF(                                 \
         instance_name,                                              \
         app_usbd_midi,                                              \
@@ -240,7 +774,9 @@ extern const app_usbd_class_methods_t app_usbd_midi_class_methods;
                                     midi_descriptor,                \
                                     0,                              \
                                     APP_USBD_AUDIO_SUBCLASS_MIDISTREAMING, \
-                                    &instance_name##_buf_in))       \
+                                    &instance_name##_buf_in,        \
+                                    &instance_name##_buf_rx,        \
+                                    &instance_name##_sysex_pool))   \
     )
 
 
@@ -53,6 +53,82 @@ extern "C" {
  * @{
  */
 
+/**
+ * @brief Code Index Number of USB-MIDI event packet.
+ *
+ * See USB Device Class Definition for MIDI Devices, Release 1.0, table 4-1.
+ */
+typedef enum
+{
+    APP_USBD_MIDI_CIN_MISC              = 0x0, /**< Reserved for future extensions. */
+    APP_USBD_MIDI_CIN_CABLE_EVENT       = 0x1, /**< Reserved for future cable events. */
+    APP_USBD_MIDI_CIN_SYSCOMMON_2       = 0x2, /**< Two-byte system common message. */
+    APP_USBD_MIDI_CIN_SYSCOMMON_3       = 0x3, /**< Three-byte system common message. */
+    APP_USBD_MIDI_CIN_SYSEX             = 0x4, /**< System exclusive starts or continues. */
+    APP_USBD_MIDI_CIN_SYSEX_END_1       = 0x5, /**< Single-byte system common message or system exclusive ends with one byte. */
+    APP_USBD_MIDI_CIN_SYSEX_END_2       = 0x6, /**< System exclusive ends with two bytes. */
+    APP_USBD_MIDI_CIN_SYSEX_END_3       = 0x7, /**< System exclusive ends with three bytes. */
+    APP_USBD_MIDI_CIN_NOTE_OFF          = 0x8, /**< Note off. */
+    APP_USBD_MIDI_CIN_NOTE_ON           = 0x9, /**< Note on. */
+    APP_USBD_MIDI_CIN_POLY_PRESSURE     = 0xA, /**< Polyphonic key pressure. */
+    APP_USBD_MIDI_CIN_CONTROL_CHANGE    = 0xB, /**< Control change. */
+    APP_USBD_MIDI_CIN_PROGRAM_CHANGE    = 0xC, /**< Program change. */
+    APP_USBD_MIDI_CIN_CHANNEL_PRESSURE  = 0xD, /**< Channel pressure. */
+    APP_USBD_MIDI_CIN_PITCH_BEND        = 0xE, /**< Pitch bend change. */
+    APP_USBD_MIDI_CIN_SINGLE_BYTE       = 0xF, /**< Single byte, used for real-time messages. */
+} app_usbd_midi_cin_t;
+
+/**
+ * @brief Message Type of a Universal MIDI Packet.
+ *
+ * Stored in the top 4 bits of the first word of the packet, the message type sets the
+ * packet size. See Universal MIDI Packet (UMP) Format and MIDI 2.0 Protocol, table 4.
+ */
+typedef enum
+{
+    APP_USBD_MIDI_UMP_MT_UTILITY        = 0x0, /**< Utility message, 32 bits. */
+    APP_USBD_MIDI_UMP_MT_SYSTEM         = 0x1, /**< System real-time and system common message, 32 bits. */
+    APP_USBD_MIDI_UMP_MT_MIDI1_CV       = 0x2, /**< MIDI 1.0 channel voice message, 32 bits. */
+    APP_USBD_MIDI_UMP_MT_DATA64         = 0x3, /**< Data message including 7-bit system exclusive, 64 bits. */
+    APP_USBD_MIDI_UMP_MT_MIDI2_CV       = 0x4, /**< MIDI 2.0 channel voice message, 64 bits. */
+    APP_USBD_MIDI_UMP_MT_DATA128        = 0x5, /**< Data message including 8-bit system exclusive, 128 bits. */
+    APP_USBD_MIDI_UMP_MT_FLEX_DATA      = 0xD, /**< Flex data message, 128 bits. */
+    APP_USBD_MIDI_UMP_MT_STREAM         = 0xF, /**< UMP stream message, 128 bits. */
+} app_usbd_midi_ump_mt_t;
+
+/**
+ * @brief Status of a MIDI 2.0 channel voice message, upper nibble of its status byte.
+ */
+typedef enum
+{
+    APP_USBD_MIDI_UMP_CV2_REG_PER_NOTE  = 0x0, /**< Registered per-note controller. */
+    APP_USBD_MIDI_UMP_CV2_ASN_PER_NOTE  = 0x1, /**< Assignable per-note controller. */
+    APP_USBD_MIDI_UMP_CV2_RPN           = 0x2, /**< Registered controller, RPN. */
+    APP_USBD_MIDI_UMP_CV2_NRPN          = 0x3, /**< Assignable controller, NRPN. */
+    APP_USBD_MIDI_UMP_CV2_PER_NOTE_BEND = 0x6, /**< Per-note pitch bend. */
+    APP_USBD_MIDI_UMP_CV2_NOTE_OFF      = 0x8, /**< Note off. */
+    APP_USBD_MIDI_UMP_CV2_NOTE_ON       = 0x9, /**< Note on. */
+    APP_USBD_MIDI_UMP_CV2_POLY_PRESSURE = 0xA, /**< Polyphonic key pressure. */
+    APP_USBD_MIDI_UMP_CV2_CONTROL_CHANGE = 0xB, /**< Control change. */
+    APP_USBD_MIDI_UMP_CV2_PROGRAM_CHANGE = 0xC, /**< Program change. */
+    APP_USBD_MIDI_UMP_CV2_CHANNEL_PRESSURE = 0xD, /**< Channel pressure. */
+    APP_USBD_MIDI_UMP_CV2_PITCH_BEND    = 0xE, /**< Pitch bend. */
+} app_usbd_midi_ump_cv2_t;
+
+/**
+ * @brief Message type of a Universal MIDI Packet, see @ref app_usbd_midi_ump_mt_t.
+ *
+ * @param word First word of the packet.
+ */
+#define APP_USBD_MIDI_UMP_MT_GET(word)      ((uint8_t)((word) >> 28))
+
+/**
+ * @brief Group of a Universal MIDI Packet, 0 to 15.
+ *
+ * @param word First word of the packet.
+ */
+#define APP_USBD_MIDI_UMP_GROUP_GET(word)   ((uint8_t)(((word) >> 24) & 0x0F))
+
 /** @} */
 
 #ifdef __cplusplus
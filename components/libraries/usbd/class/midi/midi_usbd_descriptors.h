@@ -198,6 +198,69 @@
     0x01,         /* bNumEmbMIDIJack        | Number of embedded MIDI OUT Jacks */\
     0x03          /* BaAssocJackID(1)       | ID of the Embedded MIDI OUT Jack  */
 
+
+/*
+ * USB-MIDI 2.0 descriptors of alternate setting 1, see USB Device Class Definition for
+ * MIDI Devices, Release 2.0. Jacks are replaced by Group Terminal Blocks, which are read
+ * by the host with a separate GET_DESCRIPTOR request.
+ */
+
+#define USBD_MIDI2_CLASS_SPECIFIC_MIDI_STREAMING_INTERFACE_DESCRIPTOR             \
+    0x07,         /* bLength                | length of descriptor              */\
+    0x24,         /* bDescriptorType        | descriptor type (CS_INTERFACE)    */\
+    0x01,         /* bDescriptorSubtype     | MS_HEADER subtype                 */\
+    0x00, 0x02,   /* bcdMSC                 | Revision of class spec (2.0)      */\
+    0x07, 0x00    /* wTotalLength           | Header only                       */
+
+#define USBD_MIDI2_STANDARD_BULK_OUT_ENDPOINT_DESCRIPTOR                          \
+    0x07,         /* bLength                | length of descriptor              */\
+    0x05,         /* bDescriptorType        | descriptor type (ENDPOINT)        */\
+    0x01,         /* bEndpointAddress       | OUT Endpoint 1.                   */\
+    0x02,         /* bmAttributes           | Bulk, not shared.                 */\
+    0x40, 0x00,   /* wMaxPacketSize         | 64 bytes per packet               */\
+    0x00          /* bInterval              | Ignored for Bulk. Set to zero.    */
+
+#define USBD_MIDI2_CLASS_SPECIFIC_BULK_OUT_ENDPOINT_DESCRIPTOR                    \
+    0x05,         /* bLength                | length of descriptor              */\
+    0x25,         /* bDescriptorType        | descriptor type (CS_ENDPOINT)     */\
+    0x02,         /* bDescriptorSubtype     | MS_GENERAL_2_0 subtype            */\
+    0x01,         /* bNumGrpTrmBlock        | Number of Group Terminal Blocks   */\
+    0x01          /* baAssoGrpTrmBlkID(1)   | ID of the Group Terminal Block    */
+
+#define USBD_MIDI2_STANDARD_BULK_IN_ENDPOINT_DESCRIPTOR                           \
+    0x07,         /* bLength                | length of descriptor              */\
+    0x05,         /* bDescriptorType        | descriptor type (ENDPOINT)        */\
+    0x81,         /* bEndpointAddress       | IN Endpoint 1.                    */\
+    0x02,         /* bmAttributes           | Bulk, not shared.                 */\
+    0x40, 0x00,   /* wMaxPacketSize         | 64 bytes per packet               */\
+    0x00          /* bInterval              | Ignored for Bulk. Set to zero.    */
+
+#define USBD_MIDI2_CLASS_SPECIFIC_BULK_IN_ENDPOINT_DESCRIPTOR                     \
+    0x05,         /* bLength                | length of descriptor              */\
+    0x25,         /* bDescriptorType        | descriptor type (CS_ENDPOINT)     */\
+    0x02,         /* bDescriptorSubtype     | MS_GENERAL_2_0 subtype            */\
+    0x01,         /* bNumGrpTrmBlock        | Number of Group Terminal Blocks   */\
+    0x01          /* baAssoGrpTrmBlkID(1)   | ID of the Group Terminal Block    */
+
+#define USBD_MIDI2_GROUP_TERMINAL_BLOCK_HEADER_DESCRIPTOR                         \
+    0x05,         /* bLength                | length of descriptor              */\
+    0x26,         /* bDescriptorType        | descriptor type (CS_GR_TRM_BLOCK) */\
+    0x01,         /* bDescriptorSubtype     | GR_TRM_BLOCK_HEADER subtype       */\
+    0x12, 0x00    /* wTotalLength           | Header and one block              */
+
+#define USBD_MIDI2_GROUP_TERMINAL_BLOCK_DESCRIPTOR                                \
+    0x0D,         /* bLength                | length of descriptor              */\
+    0x26,         /* bDescriptorType        | descriptor type (CS_GR_TRM_BLOCK) */\
+    0x02,         /* bDescriptorSubtype     | GR_TRM_BLOCK subtype              */\
+    0x01,         /* bGrpTrmBlkID           | ID of this Group Terminal Block   */\
+    0x00,         /* bGrpTrmBlkType         | Bidirectional                     */\
+    0x00,         /* nGroupTrm              | First group, group 1              */\
+    0x01,         /* nNumGroupTrm           | Number of groups                  */\
+    0x00,         /* iBlockItem             | Unused.                           */\
+    0x11,         /* bMIDIProtocol          | MIDI 2.0 protocol                 */\
+    0x00, 0x00,   /* wMaxInputBandwidth     | Unknown                           */\
+    0x00, 0x00    /* wMaxOutputBandwidth    | Unknown                           */
+
      
      
      
\ No newline at end of file
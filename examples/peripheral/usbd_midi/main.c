@@ -57,6 +57,7 @@
 #include "boards.h"
 #include "bsp.h"
 #include "app_timer.h"
+#include "nrf_atomic.h"
 
 
 #include "nrf_log.h"
@@ -81,15 +82,27 @@
 #define BTN_MIDI_KEY_2_RELEASE  (bsp_event_t)(BSP_EVENT_KEY_LAST + 3)
 #define BTN_MIDI_KEY_3_RELEASE  (bsp_event_t)(BSP_EVENT_KEY_LAST + 4)
 
+/**
+ * @brief Button events waiting to be sent from the main loop, bit n is BSP_EVENT_KEY_0 + n.
+ */
+static nrf_atomic_u32_t m_key_pending;
+
 
 
 /**
  * @brief USB Midi buffer size
  */
 #define TX_BUFFER_SIZE 2048
-#define SYSEX_BUF_SIZE 74
+#define RX_BUFFER_COUNT 4
+#define RX_BUFFER_SIZE 64
+
+/**
+ * @brief Number of received midi events parsed per main loop pass
+ *
+ * Used only with APP_USBD_MIDI_CONFIG_RX_DEFERRED enabled.
+ */
+#define RX_PROCESS_BUDGET 32
 
-uint8_t m_sysex_buf[SYSEX_BUF_SIZE];
 /**
  * @brief Enable power USB detection
  *
@@ -126,6 +139,25 @@ APP_USBD_MIDI_DESCRIPTOR(m_midi_desc,
                          APP_USBD_AUDIO_MIDI_STANDARD_BULK_IN_ENDPOINT_DSC,
                          APP_USBD_AUDIO_MIDI_BULK_IN_ENDPOINT_DSC);
 
+#if APP_USBD_MIDI_CONFIG_UMP
+/**
+ * @brief   USB-MIDI 2.0 descriptors of alternate setting 1
+ */
+APP_USBD_MIDI_DESCRIPTOR(m_midi2_desc,
+                         APP_USBD_AUDIO_MIDI2_CS_MIDI_STREAMING_INTERFACE_DSC,
+                         APP_USBD_AUDIO_MIDI2_STANDARD_BULK_OUT_ENDPOINT_DSC,
+                         APP_USBD_AUDIO_MIDI2_BULK_OUT_ENDPOINT_DSC,
+                         APP_USBD_AUDIO_MIDI2_STANDARD_BULK_IN_ENDPOINT_DSC,
+                         APP_USBD_AUDIO_MIDI2_BULK_IN_ENDPOINT_DSC);
+
+/**
+ * @brief   Group Terminal Block of USB-MIDI 2.0, one bidirectional group
+ */
+APP_USBD_MIDI_DESCRIPTOR(m_midi2_gtb_desc,
+                         APP_USBD_AUDIO_MIDI2_GTB_HEADER_DSC,
+                         APP_USBD_AUDIO_MIDI2_GTB_DSC);
+#endif
+
 
 
 /**
@@ -143,10 +175,18 @@ APP_USBD_MIDI_GLOBAL_DEF(m_app_midi,
                           midi_user_ev_handler,
                           midi_user_rx_handler,
                           &m_midi_desc,
-                          TX_BUFFER_SIZE
+                          TX_BUFFER_SIZE,
+                          RX_BUFFER_COUNT,
+                          RX_BUFFER_SIZE
 );
 
 /*lint -restore*/
+
+/**
+ * @brief Thru cable map, every received message is echoed back on its own cable.
+ */
+static const uint8_t m_thru_map[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
 static void midi_user_rx_handler(app_usbd_class_inst_t const * p_inst,
                                     enum app_usbd_midi_rx_event_e event,
                                     uint8_t cable,
@@ -154,41 +194,20 @@ static void midi_user_rx_handler(app_usbd_class_inst_t const * p_inst,
     {
     switch (event)
     {
-    case APP_USBD_MIDI_SYSEX_BUF_REQ:
-        {
-            if (rx->p_data == NULL) 
-            {
-                /* requesting buffer for new sysex message */
-
-                size_t len = SYSEX_BUF_SIZE;
-                rx->p_data = m_sysex_buf;
-                rx->len = len;
-            }
-            else
-            {
-                /* requesting new buffer because current buffer is full */
-
-                // app_usbd_midi_sysex_write(&m_app_midi, 0, rx->p_data, rx->len);
-                // NRF_LOG_HEXDUMP_INFO(rx->p_data, rx->len);
-
-                size_t len = SYSEX_BUF_SIZE;
-                rx->p_data = m_sysex_buf;
-                rx->len = len;
-            }
-            return;
-        }
     case APP_USBD_MIDI_SYSEX_RX_DONE:
-        /* sysex message is completed */
+        /* sysex message is completed, stored in blocks of the class sysex pool */
 
-        // app_usbd_midi_sysex_write(&m_app_midi, 0, rx->p_data, rx->len);
-        // NRF_LOG_HEXDUMP_INFO(rx->p_data, rx->len);
+        // for (app_usbd_midi_sysex_block_t * p_block = rx->p_chain; p_block != NULL; p_block = p_block->p_next)
+        // {
+        //     NRF_LOG_HEXDUMP_INFO(p_block->data, p_block->len);
+        // }
+        app_usbd_midi_sysex_free(&m_app_midi, rx->p_chain);
 
         bsp_board_led_invert(LED_MIDI_RX);
         break;
     case APP_USBD_MIDI_RX_DONE:
-        /* received midi message */
+        /* received midi message, echoed back by the class thru */
 
-        app_usbd_midi_write(&m_app_midi, 0, rx->p_data, rx->len);
         // NRF_LOG_HEXDUMP_INFO(rx->p_data, rx->len);
 
         bsp_board_led_invert(LED_MIDI_RX);
@@ -198,6 +217,26 @@ static void midi_user_rx_handler(app_usbd_class_inst_t const * p_inst,
     }
 }
 
+#if APP_USBD_MIDI_CONFIG_UMP
+/**
+ * @brief Universal MIDI Packet handler @ref app_usbd_midi_ump_handler_t
+ */
+static void midi_ump_handler(app_usbd_class_inst_t const * p_inst,
+                             uint32_t const *              p_ump,
+                             uint8_t                       words,
+                             uint32_t                      timestamp)
+{
+    /* Echo back, thru is not available on USB-MIDI 2.0. There is no later pass to retry
+     * from, a packet the TX buffer cannot take is dropped. */
+    ret_code_t ret = app_usbd_midi_ump_write(&m_app_midi, p_ump, words);
+    if (ret != NRF_SUCCESS)
+    {
+        NRF_LOG_WARNING("UMP echo dropped: %d", ret);
+    }
+    bsp_board_led_invert(LED_MIDI_RX);
+}
+#endif
+
 /**
  * @brief User event handler @ref app_usbd_midi_user_ev_handler_t
  * */
@@ -222,6 +261,9 @@ static void midi_user_ev_handler(app_usbd_class_inst_t const * p_inst,
         case APP_USBD_MIDI_USER_EVT_TX_DONE:
             bsp_board_led_invert(LED_MIDI_TX);
             break;
+        case APP_USBD_MIDI_USER_EVT_THRU_DROPPED:
+            NRF_LOG_WARNING("MIDI thru dropped received events");
+            break;
 
         default:
             break;
@@ -272,43 +314,109 @@ static void usbd_user_ev_handler(app_usbd_event_type_t event)
     }
 }
 
-void bsp_event_callback(bsp_event_t ev)
+/**
+ * @brief Send the midi message of a button event.
+ *
+ * @param ev    Button event.
+ *
+ * @return Return code of the class write function.
+ */
+static ret_code_t midi_key_send(unsigned int ev)
 {
-
-    switch ((unsigned int)ev)
+    switch (ev)
     {
         case BSP_EVENT_KEY_0:
         {
+#if APP_USBD_MIDI_CONFIG_UMP
+            if (app_usbd_midi_ump_active(&m_app_midi))
+            {
+                /* Note on with 16-bit velocity in a single packet. */
+                uint32_t ump[2];
+                app_usbd_midi_ump_cv2_pack(ump, 0, APP_USBD_MIDI_UMP_CV2_NOTE_ON, 0, 48 << 8, 0x6400UL << 16);
+                return app_usbd_midi_ump_write(&m_app_midi, ump, ARRAY_SIZE(ump));
+            }
+#endif
             uint8_t message[3] = {0x90, 48, 50};
-            app_usbd_midi_write(&m_app_midi, 0, message, sizeof(message));
-            break;
+            return app_usbd_midi_write(&m_app_midi, 0, message, sizeof(message));
         }
         case BTN_MIDI_KEY_0_RELEASE:
         {
+#if APP_USBD_MIDI_CONFIG_UMP
+            if (app_usbd_midi_ump_active(&m_app_midi))
+            {
+                uint32_t ump[2];
+                app_usbd_midi_ump_cv2_pack(ump, 0, APP_USBD_MIDI_UMP_CV2_NOTE_OFF, 0, 48 << 8, 0x6400UL << 16);
+                return app_usbd_midi_ump_write(&m_app_midi, ump, ARRAY_SIZE(ump));
+            }
+#endif
             uint8_t message[3] = {0x80, 48, 50};
-            app_usbd_midi_write(&m_app_midi, 0, message, sizeof(message));
-            break;
+            return app_usbd_midi_write(&m_app_midi, 0, message, sizeof(message));
         }
         case BSP_EVENT_KEY_1:
         {
             uint8_t message[11] = {0xF0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 0xF7};
-            app_usbd_midi_sysex_write(&m_app_midi, 0, message, sizeof(message));
-            break;
+            return app_usbd_midi_sysex_write(&m_app_midi, 0, message, sizeof(message));
         }
         case BSP_EVENT_KEY_2:
         {
             uint8_t message[2] = {0xC0, 50};
-            app_usbd_midi_write(&m_app_midi, 0, message, sizeof(message));
-            break;
+            return app_usbd_midi_write(&m_app_midi, 0, message, sizeof(message));
         }
         case BSP_EVENT_KEY_3:
         {
             uint8_t message = 0xF6;
-            app_usbd_midi_write(&m_app_midi, 0, &message, sizeof(message));
-            break;
+            return app_usbd_midi_write(&m_app_midi, 0, &message, sizeof(message));
         }
         default:
-            return;
+            return NRF_SUCCESS;
+    }
+}
+
+/**
+ * @brief Send the messages of pending button events, lowest event first.
+ *
+ * A message the class could not queue stays pending, and so do the ones after it, so a
+ * key release is never sent ahead of its press.
+ *
+ * @return True if a write was preempted and should be retried right away.
+ */
+static bool midi_keys_process(void)
+{
+    uint32_t pending = nrf_atomic_u32_fetch_store(&m_key_pending, 0);
+
+    for (unsigned int bit = 0; pending != 0; bit++)
+    {
+        if ((pending & (1UL << bit)) == 0)
+        {
+            continue;
+        }
+
+        ret_code_t ret = midi_key_send(BSP_EVENT_KEY_0 + bit);
+        if ((ret == NRF_ERROR_BUSY) || (ret == NRF_ERROR_NO_MEM))
+        {
+            UNUSED_RETURN_VALUE(nrf_atomic_u32_or(&m_key_pending, pending));
+            return (ret == NRF_ERROR_BUSY);
+        }
+        if (ret != NRF_SUCCESS)
+        {
+            NRF_LOG_WARNING("Button message dropped: %d", ret);
+        }
+        pending &= ~(1UL << bit);
+    }
+    return false;
+}
+
+/**
+ * @brief Button event handler.
+ *
+ * Runs in interrupt context, where a write may preempt the class queuing thru data and
+ * fail with NRF_ERROR_BUSY. The messages are sent from the main loop instead.
+ */
+void bsp_event_callback(bsp_event_t ev)
+{
+    if (((unsigned int)ev >= BSP_EVENT_KEY_0) && ((unsigned int)ev <= BTN_MIDI_KEY_3_RELEASE))
+    {
+        UNUSED_RETURN_VALUE(nrf_atomic_u32_or(&m_key_pending, 1UL << (ev - BSP_EVENT_KEY_0)));
     }
 }
 
@@ -366,9 +474,17 @@ int main(void)
     app_usbd_class_inst_t const * class_inst_midi =
         app_usbd_midi_class_inst_get(&m_app_midi);
 
+#if APP_USBD_MIDI_CONFIG_UMP
+    app_usbd_midi_ump_descriptors_set(&m_app_midi, &m_midi2_desc, &m_midi2_gtb_desc);
+    app_usbd_midi_ump_handler_set(&m_app_midi, midi_ump_handler);
+#endif
+
     ret = app_usbd_class_append(class_inst_midi);
     APP_ERROR_CHECK(ret);
 
+    ret = app_usbd_midi_thru_set(&m_app_midi, m_thru_map);
+    APP_ERROR_CHECK(ret);
+
     if (USBD_POWER_DETECTION)
     {
         ret = app_usbd_power_events_enable();
@@ -386,9 +502,14 @@ int main(void)
         {
             /* Nothing to do */
         }
+        bool midi_rx_pending = app_usbd_midi_process(&m_app_midi, RX_PROCESS_BUDGET);
+        bool midi_tx_pending = midi_keys_process();
         UNUSED_RETURN_VALUE(NRF_LOG_PROCESS());
-        /* Sleep CPU only if there was no interrupt since last loop processing */
-        __WFE();
+        if (!midi_rx_pending && !midi_tx_pending)
+        {
+            /* Sleep CPU only if there was no interrupt since last loop processing */
+            __WFE();
+        }
     }
 }
 
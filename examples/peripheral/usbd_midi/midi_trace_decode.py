@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""Decode a trace dump of the USB midi class.
+
+Build with APP_USBD_MIDI_CONFIG_TRACE_SIZE set and dump the app_usbd_midi_trace
+object from RAM, for example:
+
+    nrfjprog --memrd <address of app_usbd_midi_trace> --n <size> > trace.txt
+    (gdb) dump binary memory trace.bin &app_usbd_midi_trace (&app_usbd_midi_trace)+1
+
+Both raw binary dumps and nrfjprog text dumps are accepted.
+
+    midi_trace_decode.py trace.bin                 timeline and per-stage latencies
+    midi_trace_decode.py --folded trace.bin        folded stacks for flamegraph.pl
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+MAGIC = 0x4D545243
+
+# Values of app_usbd_midi_trace_id_t.
+TRACE_IDS = {
+    1: "SEND_RAW_ENTER",
+    2: "SEND_RAW_EXIT",
+    3: "TX_START",
+    4: "IN_DONE",
+    5: "OUT_DONE",
+    6: "RX_ARM",
+    7: "RX_PACKET",
+    8: "RX_CB_ENTER",
+    9: "RX_CB_EXIT",
+    10: "EV_CB_ENTER",
+    11: "EV_CB_EXIT",
+}
+
+# Nested sections, entered and left by a pair of trace points.
+SECTIONS = {
+    "SEND_RAW_ENTER": ("send_raw", "SEND_RAW_EXIT"),
+    "RX_CB_ENTER": ("rx_handler", "RX_CB_EXIT"),
+    "EV_CB_ENTER": ("event_handler", "EV_CB_EXIT"),
+}
+
+# Latencies between stages of the data path, from the first point to the next second one.
+STAGES = [
+    ("send_raw -> tx_start", "SEND_RAW_EXIT", "TX_START"),
+    ("tx_start -> in_done", "TX_START", "IN_DONE"),
+    ("out_done -> rx_handler", "OUT_DONE", "RX_CB_ENTER"),
+    ("out_done -> rx_arm", "OUT_DONE", "RX_ARM"),
+]
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if not data.startswith(struct.pack("<I", MAGIC)):
+        # nrfjprog --memrd text output: "0x20001000: 4D545243 00000100 ..."
+        words = []
+        for line in data.decode("ascii", "replace").splitlines():
+            m = re.match(r"\s*0x[0-9A-Fa-f]+:\s*((?:[0-9A-Fa-f]{8}\s*)+)", line)
+            if m:
+                words += [int(w, 16) for w in m.group(1).split()]
+        data = struct.pack("<%dI" % len(words), *words)
+
+    magic, size, idx = struct.unpack_from("<III", data, 0)
+    if magic != MAGIC:
+        sys.exit("%s: not a midi trace dump" % path)
+
+    count = min(idx, size)
+    records = []
+    for n in range(idx - count, idx):
+        cycles, ev, payload = struct.unpack_from("<IHH", data, 12 + (n % size) * 8)
+        records.append((cycles, TRACE_IDS.get(ev, "ID_%d" % ev), payload))
+
+    # Unwrap the 32-bit cycle counter.
+    base, last, out = 0, None, []
+    for cycles, name, payload in records:
+        if last is not None and cycles < last:
+            base += 1 << 32
+        last = cycles
+        out.append((base + cycles, name, payload))
+    return out
+
+
+def us(cycles, hz):
+    return cycles * 1e6 / hz
+
+
+def print_timeline(records, hz):
+    t0 = records[0][0]
+    prev = t0
+    depth = 0
+    for cycles, name, payload in records:
+        if name.endswith("_EXIT"):
+            depth = max(depth - 1, 0)
+        print("%12.3f us %+10.3f  %s%-16s %d" % (us(cycles - t0, hz), us(cycles - prev, hz),
+                                                "  " * depth, name, payload))
+        if name.endswith("_ENTER"):
+            depth += 1
+        prev = cycles
+
+
+def print_summary(title, samples, hz):
+    if not samples:
+        return
+    samples = sorted(samples)
+    print("%-24s n=%-6d min=%9.3f avg=%9.3f p99=%9.3f max=%9.3f us" % (
+        title, len(samples), us(samples[0], hz), us(sum(samples) / len(samples), hz),
+        us(samples[min(len(samples) - 1, int(len(samples) * 0.99))], hz), us(samples[-1], hz)))
+
+
+def sections(records):
+    """Yield (stack, cycles) of time spent in each nesting of sections."""
+    stack = []
+    for cycles, name, _ in records:
+        if name in SECTIONS:
+            stack.append((SECTIONS[name][0], SECTIONS[name][1], cycles, 0))
+        elif stack and name == stack[-1][1]:
+            label, _, start, child = stack.pop()
+            total = cycles - start
+            yield [s[0] for s in stack] + [label], total - child
+            if stack:
+                outer = stack[-1]
+                stack[-1] = (outer[0], outer[1], outer[2], outer[3] + total)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", help="trace dump, binary or nrfjprog text")
+    parser.add_argument("--hz", type=float, default=64e6, help="CPU clock frequency, default 64 MHz")
+    parser.add_argument("--folded", action="store_true", help="print folded stacks for flamegraph.pl")
+    parser.add_argument("--no-timeline", action="store_true", help="print only the summary")
+    args = parser.parse_args()
+
+    records = load(args.dump)
+    if not records:
+        sys.exit("trace is empty")
+
+    if args.folded:
+        folded = {}
+        for stack, cycles in sections(records):
+            key = ";".join(stack)
+            folded[key] = folded.get(key, 0) + cycles
+        for key, cycles in sorted(folded.items()):
+            print("%s %d" % (key, cycles))
+        return
+
+    if not args.no_timeline:
+        print_timeline(records, args.hz)
+        print()
+
+    durations = {}
+    for stack, cycles in sections(records):
+        durations.setdefault(stack[-1], []).append(cycles)
+    for label in sorted(durations):
+        print_summary(label + " (self)", durations[label], args.hz)
+
+    for title, first, second in STAGES:
+        samples, start = [], None
+        for cycles, name, _ in records:
+            if name == first and start is None:
+                start = cycles
+            elif name == second and start is not None:
+                samples.append(cycles - start)
+                start = None
+        print_summary(title, samples, args.hz)
+
+
+if __name__ == "__main__":
+    main()
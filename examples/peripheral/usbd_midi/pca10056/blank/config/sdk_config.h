@@ -1100,6 +1100,167 @@
 #define APP_USBD_AUDIO_ENABLED 1
 #endif
 
+// <e> APP_USBD_MIDI_ENABLED - app_usbd_midi - USB MIDI class
+//==========================================================
+#ifndef APP_USBD_MIDI_ENABLED
+#define APP_USBD_MIDI_ENABLED 1
+#endif
+// <q> APP_USBD_MIDI_CONFIG_RX_DEFERRED  - Parse received data outside of the USB event handler.
+ 
+
+// <i> OUT transfers only queue received packets. Call app_usbd_midi_process
+// <i> from the main loop or a low priority interrupt to parse them.
+
+#ifndef APP_USBD_MIDI_CONFIG_RX_DEFERRED
+#define APP_USBD_MIDI_CONFIG_RX_DEFERRED 0
+#endif
+
+// <o> APP_USBD_MIDI_CONFIG_ROUTES - Maximum number of midi routes <0-32> 
+
+
+// <i> Size of the route array accepted by app_usbd_midi_routes_set.
+// <i> 0 disables routing, all received data goes to the rx handler.
+
+#ifndef APP_USBD_MIDI_CONFIG_ROUTES
+#define APP_USBD_MIDI_CONFIG_ROUTES 0
+#endif
+
+// <q> APP_USBD_MIDI_CONFIG_TIMESTAMP  - Timestamp received messages.
+ 
+
+// <i> Registers the class for SOF events. Received messages carry the time of their
+// <i> OUT transfer in microseconds, from USB frames and an optional sub-frame time source.
+
+#ifndef APP_USBD_MIDI_CONFIG_TIMESTAMP
+#define APP_USBD_MIDI_CONFIG_TIMESTAMP 0
+#endif
+
+// <o> APP_USBD_MIDI_CONFIG_SCHED_SIZE - Number of messages held by the TX scheduler. 
+// <i> Messages passed to app_usbd_midi_schedule are sent at SOF before their time.
+// <i> 0 disables the scheduler. Requires APP_USBD_MIDI_CONFIG_TIMESTAMP.
+
+#ifndef APP_USBD_MIDI_CONFIG_SCHED_SIZE
+#define APP_USBD_MIDI_CONFIG_SCHED_SIZE 0
+#endif
+
+// <o> APP_USBD_MIDI_CONFIG_SCHED_LEAD_US - Time in microseconds a scheduled message is released ahead of its time. 
+// <i> The default of one frame sends a message in the frame before its time.
+
+#ifndef APP_USBD_MIDI_CONFIG_SCHED_LEAD_US
+#define APP_USBD_MIDI_CONFIG_SCHED_LEAD_US 1000
+#endif
+
+// <o> APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE - Size of the real-time lane in messages. 
+// <i> Real-time messages are queued apart from other data and sent first.
+// <i> Must be a power of 2 not greater than 128. 0 disables the lane.
+
+#ifndef APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE
+#define APP_USBD_MIDI_CONFIG_RT_QUEUE_SIZE 16
+#endif
+
+// <o> APP_USBD_MIDI_CONFIG_CC_SLOTS - Number of continuous controllers tracked in the TX buffer. 
+// <i> A control change, pitch bend or pressure message written with app_usbd_midi_write
+// <i> overwrites the value of the same controller still waiting in the TX buffer.
+// <i> Must be a power of 2. 0 disables coalescing.
+
+#ifndef APP_USBD_MIDI_CONFIG_CC_SLOTS
+#define APP_USBD_MIDI_CONFIG_CC_SLOTS 0
+#endif
+
+// <e> APP_USBD_MIDI_CONFIG_TX_ADMISSION - TX overflow policy and watermarks.
+
+// <i> Lets writes drop unsent data when the TX buffer is full and raises
+// <i> TX_HIGH_WATERMARK/TX_LOW_WATERMARK events set with app_usbd_midi_watermarks_set.
+//==========================================================
+#ifndef APP_USBD_MIDI_CONFIG_TX_ADMISSION
+#define APP_USBD_MIDI_CONFIG_TX_ADMISSION 1
+#endif
+// <o> APP_USBD_MIDI_CONFIG_TX_OVERFLOW  - Default overflow policy.
+
+// <0=> Reject 
+// <1=> Drop oldest 
+// <2=> Drop controllers and pressure 
+
+#ifndef APP_USBD_MIDI_CONFIG_TX_OVERFLOW
+#define APP_USBD_MIDI_CONFIG_TX_OVERFLOW 0
+#endif
+
+// </e>
+
+// <q> APP_USBD_MIDI_CONFIG_STATS  - Collect instance statistics.
+ 
+
+// <i> Counts events, bytes, packets, drops and aborted transfers, see app_usbd_midi_stats_get.
+// <i> With APP_USBD_MIDI_CONFIG_TIMESTAMP also measures queueing delay.
+
+#ifndef APP_USBD_MIDI_CONFIG_STATS
+#define APP_USBD_MIDI_CONFIG_STATS 0
+#endif
+
+// <o> APP_USBD_MIDI_CONFIG_TRACE_SIZE - Number of records in the hot path trace. 
+// <i> Records hold the DWT cycle counter, a trace point and a payload, see app_usbd_midi_trace.
+// <i> Decode a RAM dump with midi_trace_decode.py. Must be a power of 2. 0 compiles tracing out.
+
+#ifndef APP_USBD_MIDI_CONFIG_TRACE_SIZE
+#define APP_USBD_MIDI_CONFIG_TRACE_SIZE 0
+#endif
+
+// <q> APP_USBD_MIDI_CONFIG_UMP  - USB-MIDI 2.0 on alternate setting 1.
+ 
+
+// <i> Universal MIDI Packets on the streaming endpoints once the host selects alternate setting 1.
+// <i> See app_usbd_midi_ump_descriptors_set and app_usbd_midi_ump_write.
+
+#ifndef APP_USBD_MIDI_CONFIG_UMP
+#define APP_USBD_MIDI_CONFIG_UMP 0
+#endif
+
+// <e> APP_USBD_MIDI_CONFIG_TX_COALESCE - Coalesce IN packets under load.
+
+// <i> Registers the class for SOF events and measures the TX load per frame.
+// <i> Under load, data waits for a full packet or the next SOF instead of going out one event at a time.
+//==========================================================
+#ifndef APP_USBD_MIDI_CONFIG_TX_COALESCE
+#define APP_USBD_MIDI_CONFIG_TX_COALESCE 0
+#endif
+// <o> APP_USBD_MIDI_CONFIG_TX_COALESCE_THRESHOLD - Load in bytes per frame above which packets are coalesced. <0-65535>
+// <i> Default of app_usbd_midi_tx_coalesce_set. 0 always coalesces.
+
+#ifndef APP_USBD_MIDI_CONFIG_TX_COALESCE_THRESHOLD
+#define APP_USBD_MIDI_CONFIG_TX_COALESCE_THRESHOLD 32
+#endif
+
+// <o> APP_USBD_MIDI_CONFIG_TX_DEADLINE_US - Time in the frame after which held data is sent. <0-1000>
+// <i> Used only with APP_USBD_MIDI_CONFIG_TIMESTAMP and a sub-frame time source.
+
+#ifndef APP_USBD_MIDI_CONFIG_TX_DEADLINE_US
+#define APP_USBD_MIDI_CONFIG_TX_DEADLINE_US 500
+#endif
+
+// </e>
+
+// <e> APP_USBD_MIDI_CONFIG_SYSEX_POOL - Receive sysex messages into blocks of a pool.
+
+// <i> Blocks are taken from a per-instance nrf_balloc pool and chained.
+// <i> The application gets the chain on SYSEX_RX_DONE and frees it with app_usbd_midi_sysex_free.
+//==========================================================
+#ifndef APP_USBD_MIDI_CONFIG_SYSEX_POOL
+#define APP_USBD_MIDI_CONFIG_SYSEX_POOL 1
+#endif
+// <o> APP_USBD_MIDI_CONFIG_SYSEX_BLOCK_SIZE - Size of a sysex block in bytes. 
+#ifndef APP_USBD_MIDI_CONFIG_SYSEX_BLOCK_SIZE
+#define APP_USBD_MIDI_CONFIG_SYSEX_BLOCK_SIZE 64
+#endif
+
+// <o> APP_USBD_MIDI_CONFIG_SYSEX_BLOCK_COUNT - Number of sysex blocks of each instance. 
+#ifndef APP_USBD_MIDI_CONFIG_SYSEX_BLOCK_COUNT
+#define APP_USBD_MIDI_CONFIG_SYSEX_BLOCK_COUNT 16
+#endif
+
+// </e>
+
+// </e>
+
 // <e> APP_USBD_ENABLED - app_usbd - USB Device library
 //==========================================================
 #ifndef APP_USBD_ENABLED
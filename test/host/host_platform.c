@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "sdk_common.h"
+#include "app_util_platform.h"
+#include "nrf.h"
+
+/*
+ * Platform parts of the host build: assertions, critical regions and the core
+ * debug registers.
+ */
+
+volatile uint32_t app_util_critical_nesting;
+
+CoreDebug_Type host_core_debug;
+
+static DWT_Type m_dwt;
+static uint64_t m_dwt_base_ns;  /**< Host time when the cycle counter was started. */
+
+void assert_nrf_callback(uint16_t line_num, const uint8_t * file_name)
+{
+    fprintf(stderr, "%s:%u: assertion failed\n", (char const *)file_name, line_num);
+    abort();
+}
+
+void app_util_critical_region_enter(uint8_t * p_nested)
+{
+    *p_nested = (app_util_critical_nesting != 0);
+    app_util_critical_nesting++;
+}
+
+void app_util_critical_region_exit(uint8_t nested)
+{
+    ASSERT(app_util_critical_nesting != 0);
+    app_util_critical_nesting--;
+    ASSERT((app_util_critical_nesting != 0) == (nested != 0));
+}
+
+static uint64_t host_time_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+DWT_Type * host_dwt_get(void)
+{
+    bool enabled = ((host_core_debug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk) != 0) &&
+                   ((m_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk) != 0);
+
+    if (!enabled)
+    {
+        m_dwt_base_ns = 0;
+    }
+    else if (m_dwt_base_ns == 0)
+    {
+        m_dwt_base_ns = host_time_ns();
+    }
+    else
+    {
+        /* The counter wraps at 32 bits like on target. */
+        m_dwt.CYCCNT = (uint32_t)(((host_time_ns() - m_dwt_base_ns) * (HOST_CPU_HZ / 1000000UL)) / 1000U);
+    }
+    return &m_dwt;
+}
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "latency.h"
+
+void latency_reset(latency_t * p_lat)
+{
+    p_lat->count    = 0;
+    p_lat->overflow = 0;
+    p_lat->sorted   = true;
+    memset(p_lat->buckets, 0, sizeof(p_lat->buckets));
+}
+
+void latency_add(latency_t * p_lat, uint32_t us)
+{
+    size_t bucket = 0;
+
+    while ((bucket < LATENCY_BUCKETS - 1) && (us >= (125U << bucket)))
+    {
+        bucket++;
+    }
+    p_lat->buckets[bucket]++;
+
+    if (p_lat->count < LATENCY_MAX_SAMPLES)
+    {
+        p_lat->samples[p_lat->count++] = us;
+        p_lat->sorted = false;
+    }
+    else
+    {
+        p_lat->overflow++;
+    }
+}
+
+static int sample_cmp(void const * p_a, void const * p_b)
+{
+    uint32_t a = *(uint32_t const *)p_a;
+    uint32_t b = *(uint32_t const *)p_b;
+
+    return (a > b) - (a < b);
+}
+
+uint32_t latency_percentile(latency_t * p_lat, uint32_t per_mille)
+{
+    size_t idx;
+
+    if (p_lat->count == 0)
+    {
+        return 0;
+    }
+    if (!p_lat->sorted)
+    {
+        qsort(p_lat->samples, p_lat->count, sizeof(p_lat->samples[0]), sample_cmp);
+        p_lat->sorted = true;
+    }
+    /* Nearest rank. */
+    idx = ((p_lat->count * per_mille) + 999) / 1000;
+    return p_lat->samples[(idx == 0) ? 0 : (idx - 1)];
+}
+
+void latency_print(char const * p_name, latency_t * p_lat)
+{
+    printf("%-40s %6zu samples  p50 %5u  p90 %5u  p99 %5u  p99.9 %5u  max %5u us\n",
+           p_name,
+           p_lat->count,
+           (unsigned)latency_percentile(p_lat, 500),
+           (unsigned)latency_percentile(p_lat, 900),
+           (unsigned)latency_percentile(p_lat, 990),
+           (unsigned)latency_percentile(p_lat, 999),
+           (unsigned)latency_percentile(p_lat, 1000));
+
+    printf("%-40s", "");
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++)
+    {
+        if (i < LATENCY_BUCKETS - 1)
+        {
+            printf(" <%u:%u", 125U << i, (unsigned)p_lat->buckets[i]);
+        }
+        else
+        {
+            printf(" >=%u:%u", 125U << (i - 1), (unsigned)p_lat->buckets[i]);
+        }
+    }
+    printf("\n");
+}
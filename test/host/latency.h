@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef LATENCY_H__
+#define LATENCY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup latency Latency recorder
+ * @brief Samples of a latency in microseconds with percentiles and a histogram.
+ * @{
+ */
+
+#define LATENCY_MAX_SAMPLES 65536   /**< Samples kept, later samples only count as overflow. */
+#define LATENCY_BUCKETS     9       /**< Histogram buckets, powers of two from 125 us up. */
+
+/**
+ * @brief Latency samples.
+ */
+typedef struct
+{
+    uint32_t samples[LATENCY_MAX_SAMPLES];  //!< Samples in microseconds
+    size_t   count;                         //!< Samples kept
+    uint32_t overflow;                      //!< Samples not kept
+    uint32_t buckets[LATENCY_BUCKETS];      //!< Histogram of all samples
+    bool     sorted;                        //!< Samples are in ascending order
+} latency_t;
+
+/**
+ * @brief Forget all samples.
+ */
+void latency_reset(latency_t * p_lat);
+
+/**
+ * @brief Add a sample.
+ *
+ * @param[in] us Latency in microseconds.
+ */
+void latency_add(latency_t * p_lat, uint32_t us);
+
+/**
+ * @brief Get a percentile of the kept samples.
+ *
+ * @param[in] per_mille Percentile in tenths of a percent, 0 to 1000.
+ *
+ * @return Latency in microseconds, 0 without samples.
+ */
+uint32_t latency_percentile(latency_t * p_lat, uint32_t per_mille);
+
+/**
+ * @brief Print percentiles and histogram on one line each.
+ *
+ * @param[in] p_name Name of the measurement.
+ */
+void latency_print(char const * p_name, latency_t * p_lat);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LATENCY_H__ */
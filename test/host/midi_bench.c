@@ -0,0 +1,281 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Throughput of the class on the host: events per second, nanoseconds per event and
+ * bytes copied per event for the TX write paths and for OUT packet handling.
+ *
+ * Bytes copied count the TX ring buffer bytes committed by the class plus the bytes
+ * moved by the simulated EasyDMA, the copies the same traffic costs on target.
+ *
+ *   midi_bench [--quick]
+ */
+#include "midi_host.h"
+
+#define TX_BUFFER_SIZE  2048
+#define RX_BUFFER_COUNT 4
+#define RX_BUFFER_SIZE  64
+
+#define SYSEX_LEN       48  /**< Length of the sysex messages, 0xF0 and 0xF7 included. */
+#define RAW_BATCH       16  /**< Event packets per @ref app_usbd_midi_send_raw call. */
+
+static uint32_t m_rx_events;
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+    if (event == APP_USBD_MIDI_RX_DONE)
+    {
+        m_rx_events++;
+    }
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, TX_BUFFER_SIZE, RX_BUFFER_COUNT, RX_BUFFER_SIZE);
+
+typedef struct
+{
+    char const * name;
+    uint64_t     events;
+    uint64_t     ns;
+    uint64_t     ring_bytes;
+    uint64_t     dma_bytes;
+} bench_result_t;
+
+static uint32_t ring_wr_idx(void)
+{
+    return m_midi.specific.inst.p_in_buf->p_cb->wr_idx;
+}
+
+/**
+ * @brief Let the host read everything queued.
+ */
+static void drain(void)
+{
+    static uint8_t buf[TX_BUFFER_SIZE];
+
+    for (uint8_t idle = 0; idle < 2; )
+    {
+        if (vhost_in(buf, sizeof(buf)) == 0)
+        {
+            idle++;
+            vhost_sof();
+        }
+        else
+        {
+            idle = 0;
+        }
+    }
+}
+
+static void result_print(bench_result_t const * p_res)
+{
+    double ns_per_event = (double)p_res->ns / (double)p_res->events;
+
+    printf("%-18s %10llu events %8.2f Mevents/s %8.1f ns/event %6.2f B copied/event\n",
+           p_res->name,
+           (unsigned long long)p_res->events,
+           1000.0 / ns_per_event,
+           ns_per_event,
+           (double)(p_res->ring_bytes + p_res->dma_bytes) / (double)p_res->events);
+}
+
+static void tx_begin(bench_result_t * p_res, char const * name, uint32_t * p_wr)
+{
+    memset(p_res, 0, sizeof(*p_res));
+    p_res->name = name;
+    drain();
+    usbd_sim_stats_reset();
+    *p_wr   = ring_wr_idx();
+    p_res->ns = midi_host_ns();
+}
+
+static void tx_end(bench_result_t * p_res, uint32_t wr)
+{
+    usbd_sim_stats_t stats;
+
+    drain();
+    p_res->ns = midi_host_ns() - p_res->ns;
+    usbd_sim_stats_get(&stats);
+    p_res->ring_bytes = ring_wr_idx() - wr;
+    p_res->dma_bytes  = stats.in_bytes;
+    MIDI_HOST_CHECK(p_res->ring_bytes == p_res->dma_bytes);
+}
+
+static void bench_write(uint64_t count)
+{
+    bench_result_t res;
+    uint32_t       wr;
+    uint8_t        msg[3] = { 0x90, 0x3C, 0x7F };
+
+    tx_begin(&res, "tx write", &wr);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        ret_code_t ret;
+
+        msg[1] = (uint8_t)(i & 0x7F);
+        while ((ret = app_usbd_midi_write(&m_midi, (uint8_t)(i & 0x0F), msg, sizeof(msg))) == NRF_ERROR_NO_MEM)
+        {
+            drain();
+        }
+        MIDI_HOST_CHECK(ret == NRF_SUCCESS);
+    }
+    res.events = count;
+    tx_end(&res, wr);
+    result_print(&res);
+}
+
+static void bench_sysex_write(uint64_t count)
+{
+    bench_result_t res;
+    uint32_t       wr;
+    uint8_t        msg[SYSEX_LEN];
+
+    msg[0] = 0xF0;
+    for (size_t i = 1; i < sizeof(msg) - 1; i++)
+    {
+        msg[i] = (uint8_t)(i & 0x7F);
+    }
+    msg[sizeof(msg) - 1] = 0xF7;
+
+    tx_begin(&res, "tx sysex_write", &wr);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        ret_code_t ret;
+
+        while ((ret = app_usbd_midi_sysex_write(&m_midi, 0, msg, sizeof(msg))) == NRF_ERROR_NO_MEM)
+        {
+            drain();
+        }
+        MIDI_HOST_CHECK(ret == NRF_SUCCESS);
+    }
+    res.events = count;
+    tx_end(&res, wr);
+    result_print(&res);
+}
+
+static void bench_send_raw(uint64_t count)
+{
+    bench_result_t res;
+    uint32_t       wr;
+    uint8_t        raw[RAW_BATCH * 4];
+
+    for (size_t i = 0; i < RAW_BATCH; i++)
+    {
+        raw[(i * 4) + 0] = 0x09;
+        raw[(i * 4) + 1] = 0x90;
+        raw[(i * 4) + 2] = (uint8_t)i;
+        raw[(i * 4) + 3] = 0x7F;
+    }
+
+    tx_begin(&res, "tx send_raw", &wr);
+    for (uint64_t i = 0; i < count; i += RAW_BATCH)
+    {
+        ret_code_t ret;
+
+        while ((ret = app_usbd_midi_send_raw(&m_midi, raw, sizeof(raw))) == NRF_ERROR_NO_MEM)
+        {
+            drain();
+        }
+        MIDI_HOST_CHECK(ret == NRF_SUCCESS);
+    }
+    res.events = (count / RAW_BATCH) * RAW_BATCH;
+    tx_end(&res, wr);
+    result_print(&res);
+}
+
+static void bench_rx(uint64_t count)
+{
+    bench_result_t   res = { .name = "rx endpoint" };
+    usbd_sim_stats_t stats;
+    uint8_t          packet[NRF_DRV_USBD_EPSIZE];
+
+    for (size_t i = 0; i < sizeof(packet); i += 4)
+    {
+        packet[i + 0] = 0x09;
+        packet[i + 1] = 0x90;
+        packet[i + 2] = (uint8_t)(i / 4);
+        packet[i + 3] = 0x7F;
+    }
+
+    m_rx_events = 0;
+    usbd_sim_stats_reset();
+    res.ns = midi_host_ns();
+    for (uint64_t i = 0; i < count; i += sizeof(packet) / 4)
+    {
+        while (vhost_out_packet(packet, sizeof(packet)) == USBD_SIM_NAK)
+        {
+            /* All RX buffers are waiting for the deferred parser. */
+            UNUSED_RETURN_VALUE(app_usbd_midi_process(&m_midi, SIZE_MAX));
+        }
+    }
+    while (app_usbd_midi_process(&m_midi, SIZE_MAX))
+    {
+    }
+    res.ns = midi_host_ns() - res.ns;
+    usbd_sim_stats_get(&stats);
+
+    res.events    = m_rx_events;
+    res.dma_bytes = stats.out_bytes;
+    MIDI_HOST_CHECK(res.events == (count / (sizeof(packet) / 4)) * (sizeof(packet) / 4));
+    result_print(&res);
+}
+
+int main(int argc, char * argv[])
+{
+    uint64_t count = 2000000;
+
+    if ((argc > 1) && (strcmp(argv[1], "--quick") == 0))
+    {
+        count = 20000;
+    }
+
+    midi_host_open(&m_midi);
+
+    bench_write(count);
+    bench_sysex_write(count / 8);
+    bench_send_raw(count);
+    bench_rx(count);
+    return 0;
+}
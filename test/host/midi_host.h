@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef MIDI_HOST_H__
+#define MIDI_HOST_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "app_usbd_midi.h"
+#include "vhost.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup midi_host Host test helpers
+ * @brief Instance definition and checks shared by the host tests and tools.
+ * @{
+ */
+
+/**
+ * @brief Define a MIDI instance with the descriptors of the usbd_midi example.
+ *
+ * @param name          Name of the instance.
+ * @param ev_handler    User event handler.
+ * @param rx_handler    User rx handler.
+ * @param tx_size       Size of the TX ring buffer.
+ * @param rx_count      Number of RX buffers.
+ * @param rx_size       Size of one RX buffer.
+ */
+#define MIDI_HOST_DEF(name, ev_handler, rx_handler, tx_size, rx_count, rx_size)    \
+    APP_USBD_MIDI_DESCRIPTOR(CONCAT_2(name, _desc),                                 \
+                             APP_USBD_AUDIO_MIDI_CS_MIDI_STREAMING_INTERFACE_DSC,   \
+                             APP_USBD_AUDIO_MIDI_EMBEDDED_IN_JACK_DSC,              \
+                             APP_USBD_AUDIO_MIDI_EXTERNAL_IN_JACK_DSC,              \
+                             APP_USBD_AUDIO_MIDI_EMBEDDED_OUT_JACK_DSC,             \
+                             APP_USBD_AUDIO_MIDI_EXTERNAL_OUT_JACK_DSC,             \
+                             APP_USBD_AUDIO_MIDI_STANDARD_BULK_OUT_ENDPOINT_DSC,    \
+                             APP_USBD_AUDIO_MIDI_BULK_OUT_ENDPOINT_DSC,             \
+                             APP_USBD_AUDIO_MIDI_STANDARD_BULK_IN_ENDPOINT_DSC,     \
+                             APP_USBD_AUDIO_MIDI_BULK_IN_ENDPOINT_DSC);             \
+    APP_USBD_MIDI_GLOBAL_DEF(name,                                                  \
+                             APP_USBD_MIDI_CONFIG_IN_OUT(0, 1),                     \
+                             ev_handler,                                            \
+                             rx_handler,                                            \
+                             &CONCAT_2(name, _desc),                                \
+                             tx_size,                                               \
+                             rx_count,                                              \
+                             rx_size)
+
+/**
+ * @brief Check a condition, report the failed expression and exit.
+ */
+#define MIDI_HOST_CHECK(expr)                                                       \
+    do                                                                              \
+    {                                                                               \
+        if (!(expr))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+            exit(1);                                                                \
+        }                                                                           \
+    } while (0)
+
+/**
+ * @brief Check that a call returns @ref NRF_SUCCESS.
+ */
+#define MIDI_HOST_CHECK_OK(call)                                                    \
+    do                                                                              \
+    {                                                                               \
+        ret_code_t ret__ = (call);                                                  \
+        if (ret__ != NRF_SUCCESS)                                                   \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: %s returned %u\n", __FILE__, __LINE__, #call,   \
+                    (unsigned)ret__);                                               \
+            exit(1);                                                                \
+        }                                                                           \
+    } while (0)
+
+/**
+ * @brief Host monotonic time in nanoseconds.
+ */
+static inline uint64_t midi_host_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Append an instance, enumerate and select alternate setting 0.
+ *
+ * @param[in] p_midi Midi class instance.
+ */
+static inline void midi_host_open(app_usbd_midi_t const * p_midi)
+{
+    MIDI_HOST_CHECK_OK(vhost_init(app_usbd_midi_class_inst_get(p_midi)));
+    MIDI_HOST_CHECK_OK(vhost_enumerate());
+    MIDI_HOST_CHECK_OK(vhost_alt_select(0));
+}
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MIDI_HOST_H__ */
@@ -0,0 +1,301 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Latency of the class under the frame timing of a full-speed host, see vhost_frame.
+ *
+ *   write->host  from app_usbd_midi_write to the end of the IN transaction that carries
+ *                the event to the host.
+ *   host->rx     from the host queuing an OUT transfer to the rx handler call.
+ *
+ * Times are simulated microseconds. Every event carries a sequence number in its note and
+ * velocity, so each one is matched with the time it was sent. Builds with TX coalescing
+ * run the TX workloads with coalescing off, adaptive and always on.
+ *
+ *   midi_latency [--quick]
+ */
+#include "midi_host.h"
+#include "latency.h"
+
+#define TX_BUFFER_SIZE  1024
+#define RX_BUFFER_COUNT 4
+#define RX_BUFFER_SIZE  64
+
+#define SEQ_COUNT       16384   /**< Sequence numbers carried by note and velocity. */
+#define DRAIN_FRAMES    64      /**< Frames run after a workload stops sending. */
+
+/**
+ * @brief Traffic pattern.
+ */
+typedef struct
+{
+    char const * name;
+    uint32_t     gap_min_us;    //!< Shortest time between bursts
+    uint32_t     gap_max_us;    //!< Longest time between bursts
+    uint8_t      burst;         //!< Events per burst, sent at once
+    uint8_t      other_packets; //!< Bulk packets other devices move every frame
+} workload_t;
+
+static const workload_t m_workloads[] =
+{
+    { "sparse",       300,  2700, 1,  0  },
+    { "stream 4k/s",  250,  250,  1,  0  },
+    { "burst 32/8ms", 8000, 8000, 32, 0  },
+    { "burst 128 shared", 8000, 8000, 128, 15 },
+};
+
+/**
+ * @brief State of a run.
+ */
+typedef struct
+{
+    workload_t const * p_load;
+    bool               rx;                  //!< Host sends, the device receives
+    bool               sending;             //!< Workload still running
+    uint32_t           next_us;             //!< Time of the next burst
+    uint32_t           rng;                 //!< State of the gap generator
+    uint32_t           sent;                //!< Events sent
+    uint32_t           received;            //!< Events arrived
+    uint32_t           drops;               //!< Events refused by the sender
+    uint32_t           sent_us[SEQ_COUNT];  //!< Send time by sequence number
+    latency_t          lat;
+} run_t;
+
+static run_t m_run;
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+static void arrived(uint32_t seq, uint32_t now_us)
+{
+    MIDI_HOST_CHECK(m_run.received < m_run.sent);
+    latency_add(&m_run.lat, now_us - m_run.sent_us[seq % SEQ_COUNT]);
+    m_run.received++;
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+    if ((event == APP_USBD_MIDI_RX_DONE) && (p_msg->len == 3) && (p_msg->p_data[0] == 0x90))
+    {
+        arrived(p_msg->p_data[1] | ((uint32_t)p_msg->p_data[2] << 7), usbd_sim_time_us());
+    }
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, TX_BUFFER_SIZE, RX_BUFFER_COUNT, RX_BUFFER_SIZE);
+
+static uint32_t gap_get(void)
+{
+    workload_t const * p_load = m_run.p_load;
+
+    m_run.rng = (m_run.rng * 1103515245U) + 12345U;
+    return p_load->gap_min_us + ((m_run.rng >> 8) % (p_load->gap_max_us - p_load->gap_min_us + 1));
+}
+
+static void burst_write(uint32_t now_us)
+{
+    for (uint8_t i = 0; i < m_run.p_load->burst; i++)
+    {
+        uint32_t seq    = m_run.sent % SEQ_COUNT;
+        uint8_t  msg[3] = { 0x90, (uint8_t)(seq & 0x7F), (uint8_t)(seq >> 7) };
+
+        if (app_usbd_midi_write(&m_midi, 0, msg, sizeof(msg)) != NRF_SUCCESS)
+        {
+            m_run.drops++;
+            continue;
+        }
+        m_run.sent_us[seq] = now_us;
+        m_run.sent++;
+    }
+}
+
+static void burst_out(uint32_t now_us)
+{
+    uint8_t  data[256 * 4];
+    size_t   len = 0;
+    uint32_t seq = m_run.sent;
+
+    for (uint8_t i = 0; i < m_run.p_load->burst; i++, seq++)
+    {
+        data[len++] = 0x09;
+        data[len++] = 0x90;
+        data[len++] = (uint8_t)(seq & 0x7F);
+        data[len++] = (uint8_t)((seq % SEQ_COUNT) >> 7);
+    }
+    if (vhost_out_queue(data, len) != NRF_SUCCESS)
+    {
+        m_run.drops += m_run.p_load->burst;
+        return;
+    }
+    for (seq = m_run.sent; seq != m_run.sent + m_run.p_load->burst; seq++)
+    {
+        m_run.sent_us[seq % SEQ_COUNT] = now_us;
+    }
+    m_run.sent += m_run.p_load->burst;
+}
+
+/**
+ * @brief Application main loop, runs before every bus transaction.
+ */
+static void app_tick(uint32_t now_us, void * p_context)
+{
+    UNUSED_RETURN_VALUE(app_usbd_midi_process(&m_midi, SIZE_MAX));
+    while (m_run.sending && ((int32_t)(now_us - m_run.next_us) >= 0))
+    {
+        if (m_run.rx)
+        {
+            burst_out(now_us);
+        }
+        else
+        {
+            burst_write(now_us);
+        }
+        m_run.next_us += gap_get();
+    }
+}
+
+static void host_in(uint8_t const * p_data, size_t len, uint32_t now_us, void * p_context)
+{
+    for (size_t i = 0; i + 4 <= len; i += 4)
+    {
+        if ((p_data[i] & 0x0F) == APP_USBD_MIDI_CIN_NOTE_ON)
+        {
+            arrived(p_data[i + 2] | ((uint32_t)p_data[i + 3] << 7), now_us);
+        }
+    }
+}
+
+/**
+ * @brief Run a workload and print its latency.
+ *
+ * @param[in] p_load    Traffic pattern.
+ * @param[in] rx        Host sends instead of the device.
+ * @param[in] p_mode    Name of the class setting, NULL if none.
+ * @param[in] frames    Frames the workload sends in.
+ *
+ * @return 99th percentile in microseconds.
+ */
+static uint32_t run(workload_t const * p_load, bool rx, char const * p_mode, uint32_t frames)
+{
+    static const vhost_frame_handlers_t handlers = { .app = app_tick, .in = host_in };
+    vhost_frame_cfg_t                   cfg      = VHOST_FRAME_CFG_DEFAULT;
+    vhost_frame_stats_t                 stats;
+    char                                name[64];
+
+    memset(&m_run, 0, offsetof(run_t, sent_us));
+    latency_reset(&m_run.lat);
+    m_run.p_load  = p_load;
+    m_run.rx      = rx;
+    m_run.rng     = 1;
+    m_run.next_us = usbd_sim_time_us() + 1000;
+
+    cfg.other_packets = p_load->other_packets;
+    vhost_frame_init(&cfg, &handlers);
+
+    m_run.sending = true;
+    for (uint32_t f = 0; f < frames + DRAIN_FRAMES; f++)
+    {
+        m_run.sending = (f < frames);
+        vhost_frame();
+    }
+    MIDI_HOST_CHECK(m_run.received == m_run.sent);
+    MIDI_HOST_CHECK(m_run.sent > 0);
+
+    vhost_frame_stats_get(&stats);
+    snprintf(name, sizeof(name), "%s %s%s%s%s",
+             rx ? "host->rx" : "write->host", p_load->name,
+             (p_mode != NULL) ? " [" : "", (p_mode != NULL) ? p_mode : "", (p_mode != NULL) ? "]" : "");
+    latency_print(name, &m_run.lat);
+    printf("%-40s %u dropped, %.1f IN NAKs/frame, %u capped frames\n", "",
+           (unsigned)m_run.drops,
+           (double)stats.in_naks / (double)stats.frames,
+           (unsigned)stats.capped_frames);
+    return latency_percentile(&m_run.lat, 990);
+}
+
+int main(int argc, char * argv[])
+{
+    uint32_t frames = 20000;
+
+    if ((argc > 1) && (strcmp(argv[1], "--quick") == 0))
+    {
+        frames = 2000;
+    }
+
+    midi_host_open(&m_midi);
+#if APP_USBD_MIDI_CONFIG_TIMESTAMP
+    app_usbd_midi_time_source_set(&m_midi, usbd_sim_ticks_get, 1000);
+#endif
+
+    for (size_t i = 0; i < ARRAY_SIZE(m_workloads); i++)
+    {
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE
+        static const struct
+        {
+            char const * name;
+            uint16_t     threshold;
+        } modes[] =
+        {
+            { "send now", UINT16_MAX },
+            { "adaptive", APP_USBD_MIDI_CONFIG_TX_COALESCE_THRESHOLD },
+            { "coalesce", 0 },
+        };
+
+        for (size_t m = 0; m < ARRAY_SIZE(modes); m++)
+        {
+            app_usbd_midi_tx_coalesce_set(&m_midi, modes[m].threshold);
+            UNUSED_RETURN_VALUE(run(&m_workloads[i], false, modes[m].name, frames));
+        }
+        app_usbd_midi_tx_coalesce_set(&m_midi, APP_USBD_MIDI_CONFIG_TX_COALESCE_THRESHOLD);
+#else
+        /* With the bus to itself the sending flag design ships a lone event in the next frame. */
+        uint32_t p99 = run(&m_workloads[i], false, NULL, frames);
+
+        MIDI_HOST_CHECK((m_workloads[i].burst > 1) || (p99 < 1000));
+#endif
+    }
+    for (size_t i = 0; i < ARRAY_SIZE(m_workloads); i++)
+    {
+        UNUSED_RETURN_VALUE(run(&m_workloads[i], true, NULL, frames));
+    }
+    return 0;
+}
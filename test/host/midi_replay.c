@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Replay a Linux usbmon capture of USB-MIDI bulk traffic against the class under the
+ * frame timing of a full-speed host, see replay.h. Prints throughput and latency of
+ * the replay and optionally saves it as a new capture.
+ *
+ * Captures come from usbmon, for example with Wireshark or
+ *
+ *   tcpdump -i usbmon1 -w capture.pcap
+ *
+ *   midi_replay [--dev BUS:DEV] capture.pcap [replay.pcap]
+ */
+#include "midi_host.h"
+#include "replay.h"
+
+#define TX_BUFFER_SIZE  1024
+#define RX_BUFFER_COUNT 4
+#define RX_BUFFER_SIZE  64
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, replay_rx_handler, TX_BUFFER_SIZE, RX_BUFFER_COUNT, RX_BUFFER_SIZE);
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: midi_replay [--dev BUS:DEV] capture.pcap [replay.pcap]\n");
+    exit(2);
+}
+
+int main(int argc, char * argv[])
+{
+    static replay_result_t res;
+    replay_cfg_t           cfg   = REPLAY_CFG_DEFAULT;
+    char const *           p_in  = NULL;
+    char const *           p_out = NULL;
+    ret_code_t             ret;
+    double                 secs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--dev") == 0)
+        {
+            if ((i + 1 >= argc) || (sscanf(argv[++i], "%d:%d", &cfg.busnum, &cfg.devnum) != 2))
+            {
+                usage();
+            }
+        }
+        else if (p_in == NULL)
+        {
+            p_in = argv[i];
+        }
+        else if (p_out == NULL)
+        {
+            p_out = argv[i];
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (p_in == NULL)
+    {
+        usage();
+    }
+
+    midi_host_open(&m_midi);
+    ret = replay_run(&m_midi, &cfg, p_in, p_out, &res);
+    if (ret != NRF_SUCCESS)
+    {
+        fprintf(stderr, "midi_replay: %s: replay failed with %u\n", p_in, (unsigned)ret);
+        return 1;
+    }
+
+    secs = (double)res.frames / 1000.0;
+    printf("device %u:%u, %.3f s captured, %.3f s replayed, %u records skipped\n",
+           (unsigned)res.busnum, (unsigned)res.devnum,
+           (double)res.capture_us / 1e6, secs, (unsigned)res.skipped);
+    printf("OUT %u transfers %u bytes %.1f B/s, %u messages to the rx handler\n",
+           (unsigned)res.out_urbs, (unsigned)res.out_bytes, (double)res.out_bytes / secs,
+           (unsigned)res.rx_messages);
+    printf("IN  %u transfers %u events %.1f B/s, %u events received\n",
+           (unsigned)res.in_urbs, (unsigned)res.in_events, (double)res.in_received * 4 / secs,
+           (unsigned)res.in_received);
+    latency_print("host OUT accepted", &res.out_lat);
+    latency_print("device IN received", &res.in_lat);
+    return (res.in_received == res.in_events) ? 0 : 1;
+}
@@ -0,0 +1,289 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Latency of received messages with parsing in the USB event handler or deferred to
+ * app_usbd_midi_process, see APP_USBD_MIDI_CONFIG_RX_DEFERRED, under bursty load.
+ *
+ * The host sends bursts of note events in one OUT transfer while the application
+ * writes one event every millisecond. The rx handler takes a fixed time per message.
+ * Inline, that time is spent in the USB interrupt, which holds off both endpoints and
+ * the main loop. Deferred, it is spent in the main loop calling app_usbd_midi_process
+ * with a budget of event packets per call.
+ *
+ *   host->rx  from the host queuing the OUT transfer to the rx handler call.
+ *   tx        from the time the application is due to write an event to the host
+ *             receiving it.
+ *
+ * The binary built with APP_USBD_MIDI_CONFIG_RX_DEFERRED reports the deferred mode,
+ * the other one the inline mode.
+ *
+ *   midi_rx_latency [--quick]
+ */
+#include "midi_host.h"
+#include "latency.h"
+
+#define TX_BUFFER_SIZE  1024
+#define RX_BUFFER_COUNT 4
+#define RX_BUFFER_SIZE  64
+
+#define SEQ_COUNT       16384   /**< Sequence numbers carried by note and velocity. */
+#define DRAIN_FRAMES    64      /**< Frames run after the workload stops. */
+#define BURST_PERIOD_US 8000    /**< Time between RX bursts. */
+#define TX_PERIOD_US    1000    /**< Time between TX events. */
+
+#if APP_USBD_MIDI_CONFIG_RX_DEFERRED
+#define RX_MODE "deferred"
+#else
+#define RX_MODE "inline"
+#endif
+
+/**
+ * @brief Sequence numbers and send times of one direction.
+ */
+typedef struct
+{
+    uint32_t  sent;
+    uint32_t  received;
+    uint32_t  sent_us[SEQ_COUNT];
+    latency_t lat;
+} flow_t;
+
+/**
+ * @brief State of a run.
+ */
+typedef struct
+{
+    uint8_t  burst;         //!< Events per RX burst
+    uint32_t cost_us;       //!< Time the rx handler takes per message
+    size_t   budget;        //!< Event packets per app_usbd_midi_process call
+    bool     sending;       //!< Workload still running
+    uint32_t next_rx_us;    //!< Time of the next RX burst
+    uint32_t next_tx_us;    //!< Time of the next TX event
+    uint32_t busy_until_us; //!< End of the main loop work in progress
+    flow_t   rx;
+    flow_t   tx;
+} run_t;
+
+static run_t m_run;
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+static void arrived(flow_t * p_flow, uint32_t seq, uint32_t now_us)
+{
+    MIDI_HOST_CHECK(p_flow->received < p_flow->sent);
+    latency_add(&p_flow->lat, now_us - p_flow->sent_us[seq % SEQ_COUNT]);
+    p_flow->received++;
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+    uint32_t start;
+
+    if ((event != APP_USBD_MIDI_RX_DONE) || (p_msg->len != 3) || (p_msg->p_data[0] != 0x90))
+    {
+        return;
+    }
+    if (usbd_sim_in_isr())
+    {
+        start = usbd_sim_isr_stall(m_run.cost_us);
+    }
+    else
+    {
+        start = usbd_sim_time_us();
+        if ((int32_t)(m_run.busy_until_us - start) > 0)
+        {
+            start = m_run.busy_until_us;
+        }
+        m_run.busy_until_us = start + m_run.cost_us;
+    }
+    arrived(&m_run.rx, p_msg->p_data[1] | ((uint32_t)p_msg->p_data[2] << 7), start);
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, TX_BUFFER_SIZE, RX_BUFFER_COUNT, RX_BUFFER_SIZE);
+
+static void rx_burst(uint32_t now_us)
+{
+    uint8_t  data[256 * 4];
+    size_t   len = 0;
+    uint32_t seq = m_run.rx.sent;
+
+    for (uint8_t i = 0; i < m_run.burst; i++, seq++)
+    {
+        data[len++] = 0x09;
+        data[len++] = 0x90;
+        data[len++] = (uint8_t)(seq & 0x7F);
+        data[len++] = (uint8_t)((seq % SEQ_COUNT) >> 7);
+        m_run.rx.sent_us[seq % SEQ_COUNT] = now_us;
+    }
+    MIDI_HOST_CHECK_OK(vhost_out_queue(data, len));
+    m_run.rx.sent = seq;
+}
+
+static void tx_event(void)
+{
+    uint32_t seq    = m_run.tx.sent % SEQ_COUNT;
+    uint8_t  msg[3] = { 0x90, (uint8_t)(seq & 0x7F), (uint8_t)(seq >> 7) };
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 0, msg, sizeof(msg)));
+    m_run.tx.sent_us[seq] = m_run.next_tx_us;
+    m_run.tx.sent++;
+}
+
+/**
+ * @brief Host traffic and the application main loop, before every bus transaction.
+ */
+static void app_tick(uint32_t now_us, void * p_context)
+{
+    while (m_run.sending && ((int32_t)(now_us - m_run.next_rx_us) >= 0))
+    {
+        rx_burst(now_us);
+        m_run.next_rx_us += BURST_PERIOD_US;
+    }
+
+    /* The main loop runs when neither the interrupt nor its own work keeps it busy. */
+    if (usbd_sim_isr_stalled() || ((int32_t)(m_run.busy_until_us - now_us) > 0))
+    {
+        return;
+    }
+    while (m_run.sending && ((int32_t)(now_us - m_run.next_tx_us) >= 0))
+    {
+        tx_event();
+        m_run.next_tx_us += TX_PERIOD_US;
+    }
+    UNUSED_RETURN_VALUE(app_usbd_midi_process(&m_midi, m_run.budget));
+}
+
+static void host_in(uint8_t const * p_data, size_t len, uint32_t now_us, void * p_context)
+{
+    for (size_t i = 0; i + 4 <= len; i += 4)
+    {
+        if ((p_data[i] & 0x0F) == APP_USBD_MIDI_CIN_NOTE_ON)
+        {
+            arrived(&m_run.tx, p_data[i + 2] | ((uint32_t)p_data[i + 3] << 7), now_us);
+        }
+    }
+}
+
+/**
+ * @brief Run the workload and print both latencies.
+ *
+ * @return 99th percentile of host->rx in microseconds.
+ */
+static uint32_t run(uint8_t burst, uint32_t cost_us, size_t budget, uint32_t frames)
+{
+    static const vhost_frame_handlers_t handlers = { .app = app_tick, .in = host_in };
+    vhost_frame_cfg_t                   cfg      = VHOST_FRAME_CFG_DEFAULT;
+    char                                name[48];
+    char                                budget_str[16];
+
+    memset(&m_run, 0, offsetof(run_t, rx));
+    m_run.rx.sent = m_run.rx.received = 0;
+    m_run.tx.sent = m_run.tx.received = 0;
+    latency_reset(&m_run.rx.lat);
+    latency_reset(&m_run.tx.lat);
+    m_run.burst      = burst;
+    m_run.cost_us    = cost_us;
+    m_run.budget     = budget;
+    m_run.next_rx_us = usbd_sim_time_us() + 1000;
+    m_run.next_tx_us = usbd_sim_time_us() + 1437;
+    vhost_frame_init(&cfg, &handlers);
+
+    for (uint32_t f = 0; f < frames + DRAIN_FRAMES; f++)
+    {
+        m_run.sending = (f < frames);
+        vhost_frame();
+    }
+    MIDI_HOST_CHECK((m_run.rx.sent > 0) && (m_run.rx.received == m_run.rx.sent));
+    MIDI_HOST_CHECK((m_run.tx.sent > 0) && (m_run.tx.received == m_run.tx.sent));
+
+    if (budget == SIZE_MAX)
+    {
+        snprintf(budget_str, sizeof(budget_str), "all");
+    }
+    else
+    {
+        snprintf(budget_str, sizeof(budget_str), "%u", (unsigned)budget);
+    }
+    snprintf(name, sizeof(name), "host->rx %s budget %s", RX_MODE, budget_str);
+    latency_print(name, &m_run.rx.lat);
+    snprintf(name, sizeof(name), "tx       %s budget %s", RX_MODE, budget_str);
+    latency_print(name, &m_run.tx.lat);
+    return latency_percentile(&m_run.rx.lat, 990);
+}
+
+int main(int argc, char * argv[])
+{
+    static const uint8_t  bursts[] = { 32, 128 };
+    static const uint32_t costs[]  = { 0, 10, 40 };
+#if APP_USBD_MIDI_CONFIG_RX_DEFERRED
+    static const size_t   budgets[] = { SIZE_MAX, 8 };
+#else
+    static const size_t   budgets[] = { SIZE_MAX };
+#endif
+    uint32_t frames = 16000;
+
+    if ((argc > 1) && (strcmp(argv[1], "--quick") == 0))
+    {
+        frames = 1600;
+    }
+
+    midi_host_open(&m_midi);
+    for (size_t b = 0; b < ARRAY_SIZE(bursts); b++)
+    {
+        for (size_t c = 0; c < ARRAY_SIZE(costs); c++)
+        {
+            printf("burst of %u events every %u ms, rx handler %u us per message\n",
+                   bursts[b], BURST_PERIOD_US / 1000, (unsigned)costs[c]);
+            for (size_t g = 0; g < ARRAY_SIZE(budgets); g++)
+            {
+                uint32_t p99 = run(bursts[b], costs[c], budgets[g], frames);
+
+                /* Without handler time a burst is parsed within a few frames either way. */
+                MIDI_HOST_CHECK((costs[c] != 0) || (p99 < 4000));
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,489 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdlib.h>
+
+#include "replay.h"
+
+#define REPLAY_EVENT_FIFO   4096    /**< Event packets written by the device and not yet received. */
+#define REPLAY_EINPROGRESS  (-115)  /**< Status of submitted URBs. */
+
+/**
+ * @brief Transfer of the capture to replay.
+ */
+typedef struct
+{
+    uint64_t ts_us;     //!< Capture time relative to the first replayed record
+    uint32_t offset;    //!< Start of the data in @ref replay_t::p_data
+    uint16_t len;       //!< Length of the data
+    bool     in;        //!< Written by the device
+} replay_urb_t;
+
+/**
+ * @brief Replay state.
+ */
+typedef struct
+{
+    app_usbd_midi_t const * p_midi;
+    replay_result_t *       p_res;
+    replay_urb_t *          p_urb;                          //!< Transfers in capture order
+    size_t                  urb_count;
+    size_t                  urb_cap;
+    uint8_t *               p_data;                         //!< Data of all transfers
+    size_t                  data_len;
+    size_t                  data_cap;
+    size_t                  next_out;                       //!< Next OUT transfer to queue
+    size_t                  next_in;                        //!< Next IN transfer to write
+    uint64_t                first_us;                       //!< Capture time of the first record
+    uint32_t                base_us;                        //!< Simulated time of the first record
+    uint8_t                 ep_in;                          //!< Captured IN endpoint
+    uint8_t                 ep_out;                         //!< Captured OUT endpoint
+    usbmon_file_t           file;                           //!< Capture the replay is saved in
+    bool                    saving;
+    ret_code_t              save_ret;                       //!< First error saving the replay
+    uint64_t                id;                             //!< Tag of the next saved URB
+    uint32_t                out_due[VHOST_OUT_QUEUE_SIZE];  //!< Capture times of queued OUT transfers
+    uint64_t                out_id[VHOST_OUT_QUEUE_SIZE];   //!< Tags of queued OUT transfers
+    size_t                  out_rd;
+    size_t                  out_wr;
+    uint32_t                in_due[REPLAY_EVENT_FIFO];      //!< Capture times of written event packets
+    size_t                  in_rd;
+    size_t                  in_wr;
+    uint8_t                 sysex_buf[256];
+} replay_t;
+
+static replay_t m_replay;
+
+static bool event_is_padding(uint8_t const * p_event)
+{
+    return (p_event[0] | p_event[1] | p_event[2] | p_event[3]) == 0;
+}
+
+/**
+ * @brief Append a transfer to the replay.
+ */
+static ret_code_t urb_add(usbmon_rec_t const * p_rec, bool in)
+{
+    replay_urb_t * p_urb;
+    size_t         len = 0;
+
+    if (m_replay.urb_count == m_replay.urb_cap)
+    {
+        size_t cap = MAX((size_t)1024, m_replay.urb_cap * 2);
+
+        p_urb = realloc(m_replay.p_urb, cap * sizeof(*p_urb));
+        if (p_urb == NULL)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+        m_replay.p_urb   = p_urb;
+        m_replay.urb_cap = cap;
+    }
+    if (m_replay.data_len + p_rec->len_cap > m_replay.data_cap)
+    {
+        size_t    cap    = MAX((size_t)65536, (m_replay.data_len + p_rec->len_cap) * 2);
+        uint8_t * p_data = realloc(m_replay.p_data, cap);
+
+        if (p_data == NULL)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+        m_replay.p_data   = p_data;
+        m_replay.data_cap = cap;
+    }
+
+    if (in)
+    {
+        /* Keep whole event packets and leave out the padding some devices send. */
+        for (size_t i = 0; i + 4 <= p_rec->len_cap; i += 4)
+        {
+            if (!event_is_padding(&p_rec->data[i]))
+            {
+                memcpy(&m_replay.p_data[m_replay.data_len + len], &p_rec->data[i], 4);
+                len += 4;
+            }
+        }
+        if (len == 0)
+        {
+            return NRF_ERROR_NOT_FOUND;
+        }
+    }
+    else
+    {
+        len = p_rec->len_cap;
+        memcpy(&m_replay.p_data[m_replay.data_len], p_rec->data, len);
+    }
+
+    if (m_replay.urb_count == 0)
+    {
+        m_replay.first_us = p_rec->ts_us;
+    }
+    p_urb         = &m_replay.p_urb[m_replay.urb_count++];
+    p_urb->ts_us  = p_rec->ts_us - m_replay.first_us;
+    p_urb->offset = (uint32_t)m_replay.data_len;
+    p_urb->len    = (uint16_t)len;
+    p_urb->in     = in;
+    m_replay.data_len += len;
+    return NRF_SUCCESS;
+}
+
+/**
+ * @brief Read the bulk transfers of the replayed device.
+ *
+ * OUT data is taken from the submissions, IN data from successful completions.
+ */
+static ret_code_t capture_load(replay_cfg_t const * p_cfg, char const * p_in)
+{
+    static usbmon_rec_t rec;
+    replay_result_t *   p_res = m_replay.p_res;
+    usbmon_file_t       file;
+    ret_code_t          ret   = usbmon_open(&file, p_in);
+    bool                found = false;
+
+    if (ret != NRF_SUCCESS)
+    {
+        return ret;
+    }
+    p_res->busnum = (uint16_t)p_cfg->busnum;
+    p_res->devnum = (uint8_t)p_cfg->devnum;
+
+    while ((ret = usbmon_read(&file, &rec)) == NRF_SUCCESS)
+    {
+        bool in   = (rec.ep & 0x80) != 0;
+        bool data = (rec.xfer_type == USBMON_XFER_BULK) && (rec.len_cap != 0) &&
+                    (in ? ((rec.type == USBMON_COMPLETE) && (rec.status == 0)) : (rec.type == USBMON_SUBMIT));
+
+        if (data && !found &&
+            ((p_cfg->busnum == REPLAY_DEV_ANY) || (p_cfg->busnum == rec.busnum)) &&
+            ((p_cfg->devnum == REPLAY_DEV_ANY) || (p_cfg->devnum == rec.devnum)))
+        {
+            found         = true;
+            p_res->busnum = rec.busnum;
+            p_res->devnum = rec.devnum;
+        }
+        if (!data || !found || (rec.busnum != p_res->busnum) || (rec.devnum != p_res->devnum))
+        {
+            p_res->skipped++;
+            continue;
+        }
+        if (in)
+        {
+            m_replay.ep_in = rec.ep;
+        }
+        else
+        {
+            m_replay.ep_out = rec.ep;
+        }
+
+        ret = urb_add(&rec, in);
+        if (ret == NRF_ERROR_NOT_FOUND)
+        {
+            p_res->skipped++;
+        }
+        else if (ret != NRF_SUCCESS)
+        {
+            break;
+        }
+    }
+    usbmon_close(&file);
+
+    if (ret != NRF_ERROR_NOT_FOUND)
+    {
+        return ret;
+    }
+    if (m_replay.urb_count == 0)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    p_res->capture_us = m_replay.p_urb[m_replay.urb_count - 1].ts_us;
+    return NRF_SUCCESS;
+}
+
+static size_t urb_next(size_t idx, bool in)
+{
+    while ((idx < m_replay.urb_count) && (m_replay.p_urb[idx].in != in))
+    {
+        idx++;
+    }
+    return idx;
+}
+
+/**
+ * @brief Save a record of the replay.
+ */
+static void save(uint8_t type, uint8_t ep, uint64_t id, uint8_t const * p_data, size_t len, uint32_t now_us)
+{
+    static usbmon_rec_t rec;
+    ret_code_t          ret;
+
+    if (!m_replay.saving)
+    {
+        return;
+    }
+    memset(&rec, 0, offsetof(usbmon_rec_t, data));
+    rec.id        = id;
+    rec.type      = type;
+    rec.xfer_type = USBMON_XFER_BULK;
+    rec.ep        = ep;
+    rec.devnum    = m_replay.p_res->devnum;
+    rec.busnum    = m_replay.p_res->busnum;
+    rec.status    = (type == USBMON_SUBMIT) ? REPLAY_EINPROGRESS : 0;
+    rec.length    = (uint32_t)len;
+    rec.ts_us     = m_replay.first_us + (uint32_t)(now_us - m_replay.base_us);
+    if (p_data != NULL)
+    {
+        rec.len_cap = (uint32_t)len;
+        memcpy(rec.data, p_data, len);
+    }
+    ret = usbmon_write(&m_replay.file, &rec);
+    if ((ret != NRF_SUCCESS) && (m_replay.save_ret == NRF_SUCCESS))
+    {
+        m_replay.save_ret = ret;
+    }
+}
+
+/**
+ * @brief Queue the OUT transfers that are due at the host.
+ */
+static void out_issue(uint64_t t_us, uint32_t now_us)
+{
+    size_t i;
+
+    for (i = m_replay.next_out;
+         (i < m_replay.urb_count) && (m_replay.p_urb[i].ts_us <= t_us);
+         i = urb_next(i + 1, false))
+    {
+        replay_urb_t const * p_urb = &m_replay.p_urb[i];
+
+        if (vhost_out_queue(&m_replay.p_data[p_urb->offset], p_urb->len) != NRF_SUCCESS)
+        {
+            break;
+        }
+        m_replay.out_due[m_replay.out_wr % VHOST_OUT_QUEUE_SIZE] = m_replay.base_us + (uint32_t)p_urb->ts_us;
+        m_replay.out_id[m_replay.out_wr % VHOST_OUT_QUEUE_SIZE]  = m_replay.id;
+        m_replay.out_wr++;
+        save(USBMON_SUBMIT, m_replay.ep_out, m_replay.id++, &m_replay.p_data[p_urb->offset], p_urb->len, now_us);
+        m_replay.p_res->out_urbs++;
+        m_replay.p_res->out_bytes += p_urb->len;
+    }
+    m_replay.next_out = i;
+}
+
+/**
+ * @brief Let the device write the IN transfers that are due.
+ */
+static void in_issue(uint64_t t_us)
+{
+    size_t i;
+
+    for (i = m_replay.next_in;
+         (i < m_replay.urb_count) && (m_replay.p_urb[i].ts_us <= t_us);
+         i = urb_next(i + 1, true))
+    {
+        replay_urb_t const * p_urb  = &m_replay.p_urb[i];
+        size_t               events = p_urb->len / 4;
+
+        if ((m_replay.in_wr - m_replay.in_rd + events > REPLAY_EVENT_FIFO) ||
+            (app_usbd_midi_send_raw(m_replay.p_midi, &m_replay.p_data[p_urb->offset], p_urb->len) != NRF_SUCCESS))
+        {
+            break;
+        }
+        for (size_t e = 0; e < events; e++)
+        {
+            m_replay.in_due[m_replay.in_wr++ % REPLAY_EVENT_FIFO] = m_replay.base_us + (uint32_t)p_urb->ts_us;
+        }
+        m_replay.p_res->in_urbs++;
+        m_replay.p_res->in_events += (uint32_t)events;
+    }
+    m_replay.next_in = i;
+}
+
+static void replay_tick(uint32_t now_us, void * p_context)
+{
+    int32_t t_us = (int32_t)(now_us - m_replay.base_us);
+
+    UNUSED_RETURN_VALUE(app_usbd_midi_process(m_replay.p_midi, SIZE_MAX));
+    if (t_us >= 0)
+    {
+        out_issue((uint64_t)t_us, now_us);
+        in_issue((uint64_t)t_us);
+    }
+}
+
+static void replay_in(uint8_t const * p_data, size_t len, uint32_t now_us, void * p_context)
+{
+    save(USBMON_COMPLETE, m_replay.ep_in, m_replay.id++, p_data, len, now_us);
+    for (size_t i = 0; i + 4 <= len; i += 4)
+    {
+        if (event_is_padding(&p_data[i]) || (m_replay.in_rd == m_replay.in_wr))
+        {
+            continue;
+        }
+        latency_add(&m_replay.p_res->in_lat, now_us - m_replay.in_due[m_replay.in_rd++ % REPLAY_EVENT_FIFO]);
+        m_replay.p_res->in_received++;
+    }
+}
+
+static void replay_out(size_t len, uint32_t now_us, void * p_context)
+{
+    size_t idx = m_replay.out_rd++ % VHOST_OUT_QUEUE_SIZE;
+
+    save(USBMON_COMPLETE, m_replay.ep_out, m_replay.out_id[idx], NULL, len, now_us);
+    latency_add(&m_replay.p_res->out_lat, now_us - m_replay.out_due[idx]);
+}
+
+static bool replay_done(void)
+{
+    return (m_replay.next_out == m_replay.urb_count) && (m_replay.next_in == m_replay.urb_count) &&
+           (m_replay.out_rd == m_replay.out_wr) && (m_replay.in_rd == m_replay.in_wr);
+}
+
+/**
+ * @brief Check if transfers are in flight or overdue.
+ */
+static bool replay_waiting(void)
+{
+    uint64_t t_us = (uint32_t)(usbd_sim_time_us() - m_replay.base_us);
+
+    return (m_replay.out_rd != m_replay.out_wr) || (m_replay.in_rd != m_replay.in_wr) ||
+           ((m_replay.next_out < m_replay.urb_count) && (m_replay.p_urb[m_replay.next_out].ts_us <= t_us)) ||
+           ((m_replay.next_in < m_replay.urb_count) && (m_replay.p_urb[m_replay.next_in].ts_us <= t_us));
+}
+
+ret_code_t replay_run(app_usbd_midi_t const * p_midi,
+                      replay_cfg_t const *    p_cfg,
+                      char const *            p_in,
+                      char const *            p_out,
+                      replay_result_t *       p_res)
+{
+    static const vhost_frame_handlers_t handlers =
+    {
+        .app = replay_tick,
+        .in  = replay_in,
+        .out = replay_out,
+    };
+    vhost_frame_cfg_t cfg      = VHOST_FRAME_CFG_DEFAULT;
+    size_t            progress = SIZE_MAX;
+    uint32_t          stalled  = 0;
+    ret_code_t        ret;
+
+    memset(&m_replay, 0, sizeof(m_replay));
+    memset(p_res, 0, offsetof(replay_result_t, out_lat));
+    latency_reset(&p_res->out_lat);
+    latency_reset(&p_res->in_lat);
+    m_replay.p_midi = p_midi;
+    m_replay.p_res  = p_res;
+
+    ret = capture_load(p_cfg, p_in);
+    if ((ret == NRF_SUCCESS) && (p_out != NULL))
+    {
+        ret = usbmon_create(&m_replay.file, p_out, USBMON_LINKTYPE_MMAPPED);
+        m_replay.saving = (ret == NRF_SUCCESS);
+    }
+
+    if (ret == NRF_SUCCESS)
+    {
+        vhost_frame_init(&cfg, &handlers);
+        m_replay.base_us  = usbd_sim_time_us() + 1000;
+        m_replay.next_out = urb_next(0, false);
+        m_replay.next_in  = urb_next(0, true);
+    }
+    while ((ret == NRF_SUCCESS) && !replay_done())
+    {
+        size_t now = m_replay.next_out + m_replay.next_in + m_replay.out_rd + m_replay.in_rd;
+
+        vhost_frame();
+        p_res->frames++;
+
+        /* Waiting for the next transfer of the capture is not a stall. */
+        stalled  = ((now == progress) && replay_waiting()) ? (stalled + 1) : 0;
+        progress = now;
+        if (stalled >= REPLAY_STALL_FRAMES)
+        {
+            ret = NRF_ERROR_TIMEOUT;
+        }
+    }
+
+    if (m_replay.saving)
+    {
+        usbmon_close(&m_replay.file);
+        if (ret == NRF_SUCCESS)
+        {
+            ret = m_replay.save_ret;
+        }
+    }
+    free(m_replay.p_urb);
+    free(m_replay.p_data);
+    m_replay.p_urb  = NULL;
+    m_replay.p_data = NULL;
+    m_replay.p_res  = NULL;
+    return ret;
+}
+
+void replay_rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+    switch (event)
+    {
+        case APP_USBD_MIDI_SYSEX_BUF_REQ:
+            p_msg->p_data = m_replay.sysex_buf;
+            p_msg->len    = sizeof(m_replay.sysex_buf);
+            return;
+
+        case APP_USBD_MIDI_SYSEX_RX_DONE:
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL
+            if (p_msg->p_chain != NULL)
+            {
+                app_usbd_midi_sysex_free(m_replay.p_midi, p_msg->p_chain);
+            }
+#endif
+            /* fall through */
+        case APP_USBD_MIDI_RX_DONE:
+            if (m_replay.p_res != NULL)
+            {
+                m_replay.p_res->rx_messages++;
+            }
+            return;
+
+        default:
+            return;
+    }
+}
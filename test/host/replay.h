@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef REPLAY_H__
+#define REPLAY_H__
+
+#include "app_usbd_midi.h"
+#include "latency.h"
+#include "usbmon.h"
+#include "vhost.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup replay Capture replay
+ * @brief Replay a usbmon capture of USB-MIDI bulk traffic against the class.
+ *
+ * Bulk OUT transfers of the captured device are queued at the virtual host at their
+ * original times, relative to the first replayed record, and sent under the frame timing
+ * of @ref vhost_frame. Bulk IN transfers of the capture are written by the device with
+ * @ref app_usbd_midi_send_raw at the time they completed in the capture, so the device
+ * side of the conversation is replayed as well. The replay can be saved as a new capture
+ * with the OUT submissions and completions and the IN packets the host received.
+ *
+ * The class instance must use @ref replay_rx_handler as its rx handler.
+ * @{
+ */
+
+#define REPLAY_DEV_ANY      (-1)    /**< Pick the first device with bulk traffic. */
+#define REPLAY_STALL_FRAMES 1000    /**< Frames without progress after which the replay stops. */
+
+/**
+ * @brief Replay settings.
+ */
+typedef struct
+{
+    int32_t busnum; //!< Bus of the device, @ref REPLAY_DEV_ANY for the first one with bulk traffic
+    int32_t devnum; //!< Address of the device, @ref REPLAY_DEV_ANY for the first one with bulk traffic
+} replay_cfg_t;
+
+/**
+ * @brief Replay results.
+ */
+typedef struct
+{
+    uint16_t  busnum;       //!< Bus of the replayed device
+    uint8_t   devnum;       //!< Address of the replayed device
+    uint32_t  skipped;      //!< Records not replayed: other devices, endpoints, transfer types and no data
+    uint32_t  out_urbs;     //!< OUT transfers sent by the host
+    uint32_t  out_bytes;    //!< Bytes of the OUT transfers
+    uint32_t  rx_messages;  //!< Messages passed to the rx handler
+    uint32_t  in_urbs;      //!< IN transfers of the capture written by the device
+    uint32_t  in_events;    //!< Event packets written, padding left out
+    uint32_t  in_received;  //!< Event packets received by the host
+    uint32_t  frames;       //!< Frames run
+    uint64_t  capture_us;   //!< Time from the first to the last replayed record of the capture
+    latency_t out_lat;      //!< From an OUT transfer's capture time to the device accepting all of it
+    latency_t in_lat;       //!< From an IN transfer's capture time to the host receiving each event
+} replay_result_t;
+
+/**
+ * @brief Default settings.
+ */
+#define REPLAY_CFG_DEFAULT                  \
+    {                                       \
+        .busnum = REPLAY_DEV_ANY,           \
+        .devnum = REPLAY_DEV_ANY,           \
+    }
+
+/**
+ * @brief Replay a capture.
+ *
+ * The instance must be enumerated with alternate setting 0 selected, see
+ * @ref vhost_enumerate. The frame scheduler is set up by the replay.
+ *
+ * @param[in]  p_midi   Midi class instance.
+ * @param[in]  p_cfg    Settings.
+ * @param[in]  p_in     Capture to replay.
+ * @param[in]  p_out    Capture to save the replay in, NULL for none.
+ * @param[out] p_res    Results.
+ *
+ * @retval NRF_SUCCESS          All transfers replayed.
+ * @retval NRF_ERROR_NOT_FOUND  No bulk traffic of the device in the capture.
+ * @retval NRF_ERROR_NO_MEM     Capture too large.
+ * @retval NRF_ERROR_TIMEOUT    Replay stopped making progress.
+ * @return Error code of @ref usbmon_open, @ref usbmon_read or @ref usbmon_create.
+ */
+ret_code_t replay_run(app_usbd_midi_t const * p_midi,
+                      replay_cfg_t const *    p_cfg,
+                      char const *            p_in,
+                      char const *            p_out,
+                      replay_result_t *       p_res);
+
+/**
+ * @brief Rx handler of the replayed instance.
+ */
+void replay_rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REPLAY_H__ */
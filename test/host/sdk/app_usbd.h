@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef APP_USBD_H__
+#define APP_USBD_H__
+
+#include "sdk_common.h"
+#include "nrf_drv_usbd.h"
+#include "app_usbd_types.h"
+#include "app_usbd_class_base.h"
+
+/*
+ * Device side of app_usbd as used by the classes, implemented on the simulated
+ * peripheral in usbd_sim.c. Events go to the classes through a queue, like with
+ * APP_USBD_CONFIG_EVENT_QUEUE_ENABLE.
+ */
+
+ret_code_t app_usbd_class_append(app_usbd_class_inst_t const * p_cinst);
+
+ret_code_t app_usbd_class_remove(app_usbd_class_inst_t const * p_cinst);
+
+ret_code_t app_usbd_class_sof_register(app_usbd_class_inst_t const * p_cinst);
+
+void app_usbd_ep_enable(nrf_drv_usbd_ep_t ep);
+
+void app_usbd_ep_disable(nrf_drv_usbd_ep_t ep);
+
+void app_usbd_ep_abort(nrf_drv_usbd_ep_t ep);
+
+ret_code_t app_usbd_ep_transfer(nrf_drv_usbd_ep_t                        ep,
+                                nrf_drv_usbd_ep_transfer_t const * const p_transfer);
+
+ret_code_t app_usbd_ep_handled_transfer(nrf_drv_usbd_ep_t                         ep,
+                                        nrf_drv_usbd_handler_desc_t const * const p_handler);
+
+bool app_usbd_event_queue_process(void);
+
+#endif /* APP_USBD_H__ */
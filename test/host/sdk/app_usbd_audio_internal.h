@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef APP_USBD_AUDIO_INTERNAL_H__
+#define APP_USBD_AUDIO_INTERNAL_H__
+
+#include "app_usbd_audio_types.h"
+
+typedef enum
+{
+    APP_USBD_AUDIO_CLASS_REQ_IN,    /**< Audio class request IN. */
+    APP_USBD_AUDIO_CLASS_REQ_OUT,   /**< Audio class request OUT. */
+    APP_USBD_AUDIO_EP_REQ_IN,       /**< Audio class endpoint request IN. */
+    APP_USBD_AUDIO_EP_REQ_OUT,      /**< Audio class endpoint request OUT. */
+} app_usbd_audio_class_req_target_t;
+
+typedef struct
+{
+    app_usbd_audio_class_req_target_t req_target; /**< Request target. */
+    app_usbd_audio_req_type_t         req_type;   /**< Request type. */
+
+    uint8_t  control;       /**< Request control field. */
+    uint8_t  channel;       /**< Channel. */
+    uint8_t  interface;     /**< Interface. */
+    uint8_t  entity;        /**< Entity. */
+    uint16_t length;        /**< Request payload length. */
+    uint8_t  payload[64];   /**< Request payload. */
+} app_usbd_audio_req_t;
+
+#endif /* APP_USBD_AUDIO_INTERNAL_H__ */
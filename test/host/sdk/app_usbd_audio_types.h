@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef APP_USBD_AUDIO_TYPES_H__
+#define APP_USBD_AUDIO_TYPES_H__
+
+#include "app_util.h"
+
+/* Audio class codes used by the MIDI class, values of USB Audio 1.0. */
+
+#define APP_USBD_AUDIO_CLASS                    0x01
+#define APP_USBD_AUDIO_CLASS_PROTOCOL_UNDEFINED 0x00
+
+typedef enum
+{
+    APP_USBD_AUDIO_SUBCLASS_UNDEFINED      = 0x00,
+    APP_USBD_AUDIO_SUBCLASS_AUDIOCONTROL   = 0x01,
+    APP_USBD_AUDIO_SUBCLASS_AUDIOSTREAMING = 0x02,
+    APP_USBD_AUDIO_SUBCLASS_MIDISTREAMING  = 0x03,
+} app_usbd_audio_subclass_t;
+
+#define APP_USBD_AUDIO_DESCRIPTOR_INTERFACE     0x24
+#define APP_USBD_AUDIO_DESCRIPTOR_ENDPOINT      0x25
+
+typedef enum
+{
+    APP_USBD_AUDIO_AC_IFACE_SUBTYPE_UNDEFINED = 0x00,
+    APP_USBD_AUDIO_AC_IFACE_SUBTYPE_HEADER    = 0x01,
+} app_usbd_audio_ac_iface_subtype_t;
+
+typedef enum
+{
+    APP_USBD_AUDIO_AS_IFACE_SUBTYPE_UNDEFINED = 0x00,
+    APP_USBD_AUDIO_AS_IFACE_SUBTYPE_GENERAL   = 0x01,
+} app_usbd_audio_as_iface_subtype_t;
+
+typedef enum
+{
+    APP_USBD_AUDIO_REQ_UNDEFINED = 0x00,
+    APP_USBD_AUDIO_REQ_SET_CUR   = 0x01,
+    APP_USBD_AUDIO_REQ_SET_MIN   = 0x02,
+    APP_USBD_AUDIO_REQ_SET_MAX   = 0x03,
+    APP_USBD_AUDIO_REQ_SET_RES   = 0x04,
+    APP_USBD_AUDIO_REQ_SET_MEM   = 0x05,
+    APP_USBD_AUDIO_REQ_GET_CUR   = 0x81,
+    APP_USBD_AUDIO_REQ_GET_MIN   = 0x82,
+    APP_USBD_AUDIO_REQ_GET_MAX   = 0x83,
+    APP_USBD_AUDIO_REQ_GET_RES   = 0x84,
+    APP_USBD_AUDIO_REQ_GET_MEM   = 0x85,
+    APP_USBD_AUDIO_REQ_GET_STAT  = 0xFF,
+} app_usbd_audio_req_type_t;
+
+#endif /* APP_USBD_AUDIO_TYPES_H__ */
@@ -0,0 +1,287 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef APP_USBD_CLASS_BASE_H__
+#define APP_USBD_CLASS_BASE_H__
+
+#include "sdk_common.h"
+#include "nrf_drv_usbd.h"
+#include "app_usbd_types.h"
+
+/*
+ * Class instance layout of app_usbd, reduced to what the classes reach through
+ * the accessors below. Interfaces live in a table next to the instance instead
+ * of a flexible array inside it.
+ */
+
+#define APP_USBD_CLASS_IFACE_EP_MAX 3 /**< Maximum number of endpoints of an interface. */
+
+typedef struct
+{
+    nrf_drv_usbd_ep_t address; /**< Endpoint address. */
+} app_usbd_class_ep_conf_t;
+
+typedef struct
+{
+    uint8_t                  number;    /**< Interface number. */
+    uint8_t                  ep_cnt;    /**< Number of endpoints. */
+    app_usbd_class_ep_conf_t ep[APP_USBD_CLASS_IFACE_EP_MAX]; /**< Endpoints. */
+} app_usbd_class_iface_conf_t;
+
+typedef struct app_usbd_class_inst_s app_usbd_class_inst_t;
+
+/**
+ * @brief Resume point of a descriptor feeding function.
+ *
+ * The function runs as a coroutine: a call stops when the buffer is full and the next
+ * call continues with the byte that did not fit.
+ */
+typedef struct
+{
+    uint32_t line;  /**< Source line of the next byte to write, 0 to start over. */
+    size_t   size;  /**< Number of bytes written by the last call. */
+} app_usbd_class_descriptor_ctx_t;
+
+#define APP_USBD_CLASS_DESCRIPTOR_INIT() { 0, 0 }
+
+typedef struct
+{
+    ret_code_t (* event_handler)(app_usbd_class_inst_t const  * const p_inst,
+                                 app_usbd_complex_evt_t const * const p_event);
+
+    bool (* feed_descriptors)(app_usbd_class_descriptor_ctx_t * p_ctx,
+                              app_usbd_class_inst_t const     * p_inst,
+                              uint8_t                         * p_buff,
+                              size_t                            max_size);
+
+    ret_code_t (* iface_select)(app_usbd_class_inst_t const * const p_inst,
+                                uint8_t                             iface_idx,
+                                uint8_t                             alternate);
+
+    void (* iface_deselect)(app_usbd_class_inst_t const * const p_inst,
+                            uint8_t                             iface_idx);
+
+    uint8_t (* iface_selection_get)(app_usbd_class_inst_t const * const p_inst,
+                                    uint8_t                             iface_idx);
+} app_usbd_class_methods_t;
+
+struct app_usbd_class_inst_s
+{
+    app_usbd_class_methods_t const    * p_class_methods; /**< Class methods. */
+    app_usbd_class_iface_conf_t const * p_iface;         /**< Interfaces of the instance. */
+    uint8_t                             iface_cnt;       /**< Number of interfaces. */
+};
+
+static inline uint8_t app_usbd_class_iface_count_get(app_usbd_class_inst_t const * const p_inst)
+{
+    return p_inst->iface_cnt;
+}
+
+static inline app_usbd_class_iface_conf_t const * app_usbd_class_iface_get(
+    app_usbd_class_inst_t const * const p_inst,
+    uint8_t                             iface_idx)
+{
+    ASSERT(iface_idx < p_inst->iface_cnt);
+    return &p_inst->p_iface[iface_idx];
+}
+
+static inline uint8_t app_usbd_class_iface_number_get(app_usbd_class_iface_conf_t const * const p_iface)
+{
+    return p_iface->number;
+}
+
+static inline uint8_t app_usbd_class_iface_ep_count_get(app_usbd_class_iface_conf_t const * const p_iface)
+{
+    return p_iface->ep_cnt;
+}
+
+static inline app_usbd_class_ep_conf_t const * app_usbd_class_iface_ep_get(
+    app_usbd_class_iface_conf_t const * const p_iface,
+    uint8_t                                   ep_idx)
+{
+    ASSERT(ep_idx < p_iface->ep_cnt);
+    return &p_iface->ep[ep_idx];
+}
+
+static inline nrf_drv_usbd_ep_t app_usbd_class_ep_address_get(app_usbd_class_ep_conf_t const * p_ep)
+{
+    return p_ep->address;
+}
+
+/**
+ * @brief Find a descriptor of a class instance, see usbd_sim.c.
+ *
+ * @param[in]     p_inst        Class instance.
+ * @param[in]     desc_type     Descriptor type.
+ * @param[in]     desc_index    Index of the descriptor among the ones of its type.
+ * @param[out]    p_desc        Buffer for the descriptor, NULL to get the size only.
+ * @param[in,out] p_desc_len    Size of the descriptor.
+ *
+ * @retval NRF_SUCCESS          Descriptor found.
+ * @retval NRF_ERROR_NOT_FOUND  No such descriptor.
+ */
+ret_code_t app_usbd_class_descriptor_find(app_usbd_class_inst_t const * const p_inst,
+                                          uint8_t                             desc_type,
+                                          uint8_t                             desc_index,
+                                          uint8_t                           * p_desc,
+                                          size_t                            * p_desc_len);
+
+#define APP_USBD_CLASS_DESCRIPTOR_BEGIN(p_ctx, p_buff, max_size)                \
+    app_usbd_class_descriptor_ctx_t * const p_desc_ctx__  = (p_ctx);            \
+    uint8_t                         * const p_desc_buff__ = (p_buff);           \
+    size_t                            const desc_max__    = (max_size);         \
+    size_t                                  desc_size__   = 0;                  \
+    switch (p_desc_ctx__->line)                                                 \
+    {                                                                           \
+        case 0:                                                                 \
+            ;
+
+#define APP_USBD_CLASS_DESCRIPTOR_WRITE(data)                                   \
+    do                                                                          \
+    {                                                                           \
+        p_desc_ctx__->line = __LINE__;                                          \
+        __attribute__((fallthrough));                                           \
+        case __LINE__:                                                          \
+        if (desc_size__ >= desc_max__)                                          \
+        {                                                                       \
+            p_desc_ctx__->size = desc_size__;                                   \
+            return true;                                                        \
+        }                                                                       \
+        if (p_desc_buff__ != NULL)                                              \
+        {                                                                       \
+            p_desc_buff__[desc_size__] = (uint8_t)(data);                       \
+        }                                                                       \
+        desc_size__++;                                                          \
+    } while (0)
+
+#define APP_USBD_CLASS_DESCRIPTOR_END()                                         \
+        default:                                                                \
+            break;                                                              \
+    }                                                                           \
+    p_desc_ctx__->line = 0;                                                     \
+    p_desc_ctx__->size = desc_size__;                                           \
+    return false
+
+/**
+ * @brief Forward declaration of a class instance type.
+ */
+#define APP_USBD_CLASS_FORWARD(type_name) typedef struct CONCAT_2(type_name, _s) CONCAT_2(type_name, _t)
+
+/**
+ * @brief Define the instance type of a class.
+ *
+ * The interface layout is taken from the instance definition, see
+ * @ref APP_USBD_CLASS_INST_GLOBAL_DEF.
+ */
+#define APP_USBD_CLASS_TYPEDEF(type_name, interface_configs, class_config_part, class_data_part) \
+    typedef struct                                                              \
+    {                                                                           \
+        class_data_part                                                         \
+    } CONCAT_2(type_name, _data_t);                                             \
+    struct CONCAT_2(type_name, _s)                                              \
+    {                                                                           \
+        app_usbd_class_inst_t base;                                             \
+        struct                                                                  \
+        {                                                                       \
+            CONCAT_2(type_name, _data_t) * p_data;                              \
+            class_config_part                                                   \
+        } specific;                                                             \
+    }
+
+#define APP_USBD_CLASS_STRIP(...) __VA_ARGS__
+
+/* Interface configuration (number, endpoints...) to an interface table entry. */
+#define APP_USBD_CLASS_IFACE_INIT(config) APP_USBD_CLASS_IFACE_INIT_ config
+#define APP_USBD_CLASS_IFACE_INIT_(...)                                         \
+    CONCAT_2(APP_USBD_CLASS_IFACE_INIT_, NUM_VA_ARGS(__VA_ARGS__))(__VA_ARGS__)
+#define APP_USBD_CLASS_IFACE_INIT_1(num) \
+    { .number = (num), .ep_cnt = 0 }
+#define APP_USBD_CLASS_IFACE_INIT_2(num, ep0) \
+    { .number = (num), .ep_cnt = 1, .ep = { { ep0 } } }
+#define APP_USBD_CLASS_IFACE_INIT_3(num, ep0, ep1) \
+    { .number = (num), .ep_cnt = 2, .ep = { { ep0 }, { ep1 } } }
+#define APP_USBD_CLASS_IFACE_INIT_4(num, ep0, ep1, ep2) \
+    { .number = (num), .ep_cnt = 3, .ep = { { ep0 }, { ep1 }, { ep2 } } }
+
+#define APP_USBD_CLASS_IFACES_INIT(...)                                         \
+    CONCAT_2(APP_USBD_CLASS_IFACES_INIT_, NUM_VA_ARGS(__VA_ARGS__))(__VA_ARGS__)
+#define APP_USBD_CLASS_IFACES_INIT_1(i0) \
+    APP_USBD_CLASS_IFACE_INIT(i0)
+#define APP_USBD_CLASS_IFACES_INIT_2(i0, i1) \
+    APP_USBD_CLASS_IFACE_INIT(i0), APP_USBD_CLASS_IFACE_INIT(i1)
+#define APP_USBD_CLASS_IFACES_INIT_3(i0, i1, i2) \
+    APP_USBD_CLASS_IFACES_INIT_2(i0, i1), APP_USBD_CLASS_IFACE_INIT(i2)
+#define APP_USBD_CLASS_IFACES_INIT_4(i0, i1, i2, i3) \
+    APP_USBD_CLASS_IFACES_INIT_3(i0, i1, i2), APP_USBD_CLASS_IFACE_INIT(i3)
+
+/**
+ * @brief Define a class instance.
+ *
+ * @param instance_name         Name of the instance.
+ * @param type_name             Class type, as given to @ref APP_USBD_CLASS_TYPEDEF.
+ * @param class_methods         Class methods.
+ * @param interfaces_configs    Interfaces, ((number, endpoints...), ...).
+ * @param class_config_data     Initializer of the class specific part, in parentheses.
+ */
+#define APP_USBD_CLASS_INST_GLOBAL_DEF(instance_name,                           \
+                                       type_name,                               \
+                                       class_methods,                           \
+                                       interfaces_configs,                      \
+                                       class_config_data)                       \
+    static CONCAT_2(type_name, _data_t) CONCAT_2(instance_name, _data);         \
+    static const app_usbd_class_iface_conf_t CONCAT_2(instance_name, _iface)[] = \
+    {                                                                           \
+        APP_USBD_CLASS_IFACES_INIT interfaces_configs                           \
+    };                                                                          \
+    static const CONCAT_2(type_name, _t) instance_name =                        \
+    {                                                                           \
+        .base =                                                                 \
+        {                                                                       \
+            .p_class_methods = (class_methods),                                 \
+            .p_iface         = CONCAT_2(instance_name, _iface),                 \
+            .iface_cnt       = ARRAY_SIZE(CONCAT_2(instance_name, _iface)),     \
+        },                                                                      \
+        .specific =                                                             \
+        {                                                                       \
+            .p_data = &CONCAT_2(instance_name, _data),                          \
+            APP_USBD_CLASS_STRIP class_config_data                              \
+        }                                                                       \
+    }
+
+#endif /* APP_USBD_CLASS_BASE_H__ */
@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef APP_USBD_REQUEST_H__
+#define APP_USBD_REQUEST_H__
+
+#include "app_usbd_types.h"
+
+#define APP_USBD_SETUP_STDREQ_GET_STATUS        0x00
+#define APP_USBD_SETUP_STDREQ_CLEAR_FEATURE     0x01
+#define APP_USBD_SETUP_STDREQ_SET_FEATURE       0x03
+#define APP_USBD_SETUP_STDREQ_SET_ADDRESS       0x05
+#define APP_USBD_SETUP_STDREQ_GET_DESCRIPTOR    0x06
+#define APP_USBD_SETUP_STDREQ_SET_DESCRIPTOR    0x07
+#define APP_USBD_SETUP_STDREQ_GET_CONFIGURATION 0x08
+#define APP_USBD_SETUP_STDREQ_SET_CONFIGURATION 0x09
+#define APP_USBD_SETUP_STDREQ_GET_INTERFACE     0x0A
+#define APP_USBD_SETUP_STDREQ_SET_INTERFACE     0x0B
+
+typedef enum
+{
+    APP_USBD_SETUP_REQREC_DEVICE    = 0x0,
+    APP_USBD_SETUP_REQREC_INTERFACE = 0x1,
+    APP_USBD_SETUP_REQREC_ENDPOINT  = 0x2,
+    APP_USBD_SETUP_REQREC_OTHER     = 0x3
+} app_usbd_setup_reqrec_t;
+
+typedef enum
+{
+    APP_USBD_SETUP_REQTYPE_STD      = 0x0,
+    APP_USBD_SETUP_REQTYPE_CLASS    = 0x1,
+    APP_USBD_SETUP_REQTYPE_VENDOR   = 0x2
+} app_usbd_setup_reqtype_t;
+
+typedef enum
+{
+    APP_USBD_SETUP_REQDIR_OUT = 0x0,
+    APP_USBD_SETUP_REQDIR_IN  = 0x80
+} app_usbd_setup_reqdir_t;
+
+static inline app_usbd_setup_reqrec_t app_usbd_setup_req_rec(uint8_t bmRequestType)
+{
+    return (app_usbd_setup_reqrec_t)(bmRequestType & 0x1F);
+}
+
+static inline app_usbd_setup_reqtype_t app_usbd_setup_req_typ(uint8_t bmRequestType)
+{
+    return (app_usbd_setup_reqtype_t)((bmRequestType >> 5) & 0x03);
+}
+
+static inline app_usbd_setup_reqdir_t app_usbd_setup_req_dir(uint8_t bmRequestType)
+{
+    return (app_usbd_setup_reqdir_t)(bmRequestType & 0x80);
+}
+
+static inline uint8_t app_usbd_setup_req_val(app_usbd_setup_reqrec_t  rec,
+                                             app_usbd_setup_reqtype_t typ,
+                                             app_usbd_setup_reqdir_t  dir)
+{
+    return (uint8_t)((uint8_t)rec | ((uint8_t)typ << 5) | (uint8_t)dir);
+}
+
+#endif /* APP_USBD_REQUEST_H__ */
@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef APP_USBD_TYPES_H__
+#define APP_USBD_TYPES_H__
+
+#include "sdk_common.h"
+#include "nrf_drv_usbd.h"
+
+typedef enum
+{
+    APP_USBD_EVT_DRV_SOF        = NRF_DRV_USBD_EVT_SOF,
+    APP_USBD_EVT_DRV_RESET      = NRF_DRV_USBD_EVT_RESET,
+    APP_USBD_EVT_DRV_SUSPEND    = NRF_DRV_USBD_EVT_SUSPEND,
+    APP_USBD_EVT_DRV_RESUME     = NRF_DRV_USBD_EVT_RESUME,
+    APP_USBD_EVT_DRV_WUREQ      = NRF_DRV_USBD_EVT_WUREQ,
+    APP_USBD_EVT_DRV_SETUP      = NRF_DRV_USBD_EVT_SETUP,
+    APP_USBD_EVT_DRV_EPTRANSFER = NRF_DRV_USBD_EVT_EPTRANSFER,
+
+    APP_USBD_EVT_FIRST_POWER,
+    APP_USBD_EVT_POWER_DETECTED = APP_USBD_EVT_FIRST_POWER,
+    APP_USBD_EVT_POWER_REMOVED,
+    APP_USBD_EVT_POWER_READY,
+
+    APP_USBD_EVT_FIRST_APP,
+    APP_USBD_EVT_INST_APPEND = APP_USBD_EVT_FIRST_APP,
+    APP_USBD_EVT_INST_REMOVE,
+    APP_USBD_EVT_STARTED,
+    APP_USBD_EVT_STOPPED,
+    APP_USBD_EVT_STATE_CHANGED,
+} app_usbd_event_type_t;
+
+typedef union
+{
+    struct
+    {
+        uint8_t lb; /**< Low byte */
+        uint8_t hb; /**< High byte */
+    };
+    uint16_t w;     /**< Word */
+} app_usbd_setup_w_t;
+
+typedef struct
+{
+    uint8_t            bmRequestType;
+    uint8_t            bRequest;
+    app_usbd_setup_w_t wValue;
+    app_usbd_setup_w_t wIndex;
+    app_usbd_setup_w_t wLength;
+} app_usbd_setup_t;
+
+typedef struct
+{
+    app_usbd_event_type_t type;
+} app_usbd_evt_t;
+
+typedef struct
+{
+    app_usbd_event_type_t type;
+    app_usbd_setup_t      setup;
+} app_usbd_setup_evt_t;
+
+typedef union
+{
+    app_usbd_evt_t       app_evt;   /**< Generic event, type only. */
+    nrf_drv_usbd_evt_t   drv_evt;   /**< Events passed from the driver. */
+    app_usbd_setup_evt_t setup_evt; /**< Setup events. */
+} app_usbd_complex_evt_t;
+
+#endif /* APP_USBD_TYPES_H__ */
@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "nrf_balloc.h"
+
+ret_code_t nrf_balloc_init(nrf_balloc_t const * p_pool)
+{
+    uint8_t pool_size;
+
+    ASSERT(p_pool);
+
+    pool_size = (uint8_t)(p_pool->p_stack_limit - p_pool->p_stack_base);
+    p_pool->p_cb->p_stack_pointer = p_pool->p_stack_base;
+    p_pool->p_cb->max_utilization = 0;
+    while (pool_size--)
+    {
+        *(p_pool->p_cb->p_stack_pointer)++ = pool_size;
+    }
+    return NRF_SUCCESS;
+}
+
+void * nrf_balloc_alloc(nrf_balloc_t const * p_pool)
+{
+    void * p_block = NULL;
+
+    ASSERT(p_pool);
+
+    if (p_pool->p_cb->p_stack_pointer > p_pool->p_stack_base)
+    {
+        uint8_t index = *(--p_pool->p_cb->p_stack_pointer);
+        uint8_t used  = (uint8_t)(p_pool->p_stack_limit - p_pool->p_cb->p_stack_pointer);
+
+        p_block = (uint8_t *)p_pool->p_memory_begin + ((size_t)index * p_pool->block_size);
+        p_pool->p_cb->max_utilization = MAX(p_pool->p_cb->max_utilization, used);
+    }
+    return p_block;
+}
+
+void nrf_balloc_free(nrf_balloc_t const * p_pool, void * p_element)
+{
+    size_t offset;
+
+    ASSERT(p_pool);
+    ASSERT(p_element);
+
+    offset = (size_t)((uint8_t *)p_element - (uint8_t *)p_pool->p_memory_begin);
+    ASSERT((offset % p_pool->block_size) == 0);
+    ASSERT(p_pool->p_cb->p_stack_pointer < p_pool->p_stack_limit);
+
+    *(p_pool->p_cb->p_stack_pointer)++ = (uint8_t)(offset / p_pool->block_size);
+}
+
+uint8_t nrf_balloc_max_utilization_get(nrf_balloc_t const * p_pool)
+{
+    return p_pool->p_cb->max_utilization;
+}
+
+uint8_t nrf_balloc_utilization_get(nrf_balloc_t const * p_pool)
+{
+    return (uint8_t)(p_pool->p_stack_limit - p_pool->p_cb->p_stack_pointer);
+}
@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef NRF_BALLOC_H__
+#define NRF_BALLOC_H__
+
+#include "sdk_common.h"
+
+/*
+ * Block allocator of the SDK without the debug options: a stack of free block
+ * indexes over a static pool, see nrf_balloc.c.
+ */
+
+typedef struct
+{
+    uint8_t * p_stack_pointer;  //!< Stack pointer.
+    uint8_t   max_utilization;  //!< Maximum utilization of the memory pool.
+} nrf_balloc_cb_t;
+
+typedef struct
+{
+    nrf_balloc_cb_t * p_cb;           //!< Pointer to the instance control block.
+    uint8_t         * p_stack_base;   //!< Base of the stack.
+    uint8_t         * p_stack_limit;  //!< Maximum possible value of the stack pointer.
+    void            * p_memory_begin; //!< Pointer to the start of the memory pool.
+    uint16_t          block_size;     //!< Size of one block.
+} nrf_balloc_t;
+
+#define NRF_BALLOC_DEF(_name, _element_size, _pool_size)                                        \
+    STATIC_ASSERT((_pool_size) <= UINT8_MAX);                                                   \
+    static uint8_t  CONCAT_2(_name, _nrf_balloc_pool_stack)[(_pool_size)];                      \
+    static uint32_t CONCAT_2(_name, _nrf_balloc_elements_pool)                                  \
+        [CEIL_DIV((_element_size), sizeof(uint32_t)) * (_pool_size)];                           \
+    static nrf_balloc_cb_t CONCAT_2(_name, _nrf_balloc_cb);                                     \
+    static const nrf_balloc_t _name =                                                           \
+    {                                                                                           \
+        .p_cb           = &CONCAT_2(_name, _nrf_balloc_cb),                                     \
+        .p_stack_base   = CONCAT_2(_name, _nrf_balloc_pool_stack),                              \
+        .p_stack_limit  = CONCAT_2(_name, _nrf_balloc_pool_stack) + (_pool_size),               \
+        .p_memory_begin = CONCAT_2(_name, _nrf_balloc_elements_pool),                           \
+        .block_size     = CEIL_DIV((_element_size), sizeof(uint32_t)) * sizeof(uint32_t),       \
+    }
+
+ret_code_t nrf_balloc_init(nrf_balloc_t const * p_pool);
+
+void * nrf_balloc_alloc(nrf_balloc_t const * p_pool);
+
+void nrf_balloc_free(nrf_balloc_t const * p_pool, void * p_element);
+
+uint8_t nrf_balloc_max_utilization_get(nrf_balloc_t const * p_pool);
+
+uint8_t nrf_balloc_utilization_get(nrf_balloc_t const * p_pool);
+
+#endif /* NRF_BALLOC_H__ */
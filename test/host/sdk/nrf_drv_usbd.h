@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef NRF_DRV_USBD_H__
+#define NRF_DRV_USBD_H__
+
+#include "sdk_common.h"
+
+/*
+ * Types of the legacy USBD driver layer used by the classes. The peripheral is
+ * simulated by usbd_sim.c.
+ */
+
+#define NRF_DRV_USBD_EPSIZE     64  /**< Size of a bulk endpoint packet. */
+#define NRF_USBD_EP_COUNT       8   /**< Number of bulk and interrupt endpoints in each direction. */
+
+#define NRF_USBD_EP_DIR_Msk     0x80
+#define NRF_USBD_EP_NR_Msk      0x0F
+#define NRF_USBD_EPIN(n)        ((uint8_t)(NRF_USBD_EP_DIR_Msk | (n)))
+#define NRF_USBD_EPOUT(n)       ((uint8_t)(n))
+#define NRF_USBD_EPIN_CHECK(ep) (((ep) & NRF_USBD_EP_DIR_Msk) != 0)
+#define NRF_USBD_EPOUT_CHECK(ep) (((ep) & NRF_USBD_EP_DIR_Msk) == 0)
+#define NRF_USBD_EP_NR_GET(ep)  ((uint8_t)((ep) & NRF_USBD_EP_NR_Msk))
+
+typedef enum
+{
+    NRF_DRV_USBD_EPOUT0 = NRF_USBD_EPOUT(0),
+    NRF_DRV_USBD_EPOUT1 = NRF_USBD_EPOUT(1),
+    NRF_DRV_USBD_EPOUT2 = NRF_USBD_EPOUT(2),
+    NRF_DRV_USBD_EPOUT3 = NRF_USBD_EPOUT(3),
+    NRF_DRV_USBD_EPOUT4 = NRF_USBD_EPOUT(4),
+    NRF_DRV_USBD_EPOUT5 = NRF_USBD_EPOUT(5),
+    NRF_DRV_USBD_EPOUT6 = NRF_USBD_EPOUT(6),
+    NRF_DRV_USBD_EPOUT7 = NRF_USBD_EPOUT(7),
+    NRF_DRV_USBD_EPIN0  = NRF_USBD_EPIN(0),
+    NRF_DRV_USBD_EPIN1  = NRF_USBD_EPIN(1),
+    NRF_DRV_USBD_EPIN2  = NRF_USBD_EPIN(2),
+    NRF_DRV_USBD_EPIN3  = NRF_USBD_EPIN(3),
+    NRF_DRV_USBD_EPIN4  = NRF_USBD_EPIN(4),
+    NRF_DRV_USBD_EPIN5  = NRF_USBD_EPIN(5),
+    NRF_DRV_USBD_EPIN6  = NRF_USBD_EPIN(6),
+    NRF_DRV_USBD_EPIN7  = NRF_USBD_EPIN(7),
+} nrf_drv_usbd_ep_t;
+
+typedef enum
+{
+    NRF_DRV_USBD_EVT_SOF,
+    NRF_DRV_USBD_EVT_RESET,
+    NRF_DRV_USBD_EVT_SUSPEND,
+    NRF_DRV_USBD_EVT_RESUME,
+    NRF_DRV_USBD_EVT_WUREQ,
+    NRF_DRV_USBD_EVT_SETUP,
+    NRF_DRV_USBD_EVT_EPTRANSFER,
+    NRF_DRV_USBD_EVT_CNT
+} nrf_drv_usbd_event_type_t;
+
+typedef enum
+{
+    NRF_USBD_EP_OK,         /**< No error. */
+    NRF_USBD_EP_WAITING,    /**< Data received, no buffer prepared already - waiting for configured transfer. */
+    NRF_USBD_EP_OVERLOAD,   /**< Received number of bytes cannot fit given buffer. */
+    NRF_USBD_EP_ABORTED,    /**< EP0 transfer can be aborted when new setup comes. */
+} nrf_drv_usbd_ep_status_t;
+
+typedef struct
+{
+    nrf_drv_usbd_event_type_t type;
+    union
+    {
+        struct
+        {
+            uint16_t framecnt;  /**< Number of frames received. */
+        } sof;
+        struct
+        {
+            nrf_drv_usbd_ep_t        ep;
+            nrf_drv_usbd_ep_status_t status;
+        } eptransfer;
+    } data;
+} nrf_drv_usbd_evt_t;
+
+typedef struct
+{
+    union
+    {
+        void const * tx;    /**< Constant TX buffer pointer. */
+        void *       rx;    /**< Writable RX buffer pointer. */
+        uint32_t     addr;  /**< Numeric value used internally by the driver. */
+    } p_data;
+    size_t  size;           /**< Size of the requested transfer. */
+    uint8_t flags;          /**< Transfer flags, see @ref NRF_DRV_USBD_TRANSFER_ZLP_FLAG. */
+} nrf_drv_usbd_ep_transfer_t;
+
+#define NRF_DRV_USBD_TRANSFER_ZLP_FLAG 1U /**< Finish an IN transfer of whole packets with a zero-length packet. */
+
+#define NRF_DRV_USBD_TRANSFER_IN(name, tx_buff, tx_size, ...)                   \
+    const nrf_drv_usbd_ep_transfer_t name = {                                   \
+        .p_data = { .tx = (tx_buff) },                                          \
+        .size   = (tx_size),                                                    \
+        .flags  = (uint8_t)(__VA_ARGS__ + 0)                                    \
+    }
+
+#define NRF_DRV_USBD_TRANSFER_OUT(name, rx_buff, rx_size)                       \
+    const nrf_drv_usbd_ep_transfer_t name = {                                   \
+        .p_data = { .rx = (rx_buff) },                                          \
+        .size   = (rx_size),                                                    \
+        .flags  = 0                                                             \
+    }
+
+/**
+ * @brief Feeder of an IN transfer, called for every packet.
+ *
+ * @return True if more packets follow the one set in @p p_next.
+ */
+typedef bool (*nrf_drv_usbd_feeder_t)(nrf_drv_usbd_ep_transfer_t * p_next,
+                                      void *                       p_context,
+                                      size_t                       ep_size);
+
+/**
+ * @brief Consumer of an OUT transfer, called for every packet received.
+ *
+ * @return True if the transfer continues after this packet.
+ */
+typedef bool (*nrf_drv_usbd_consumer_t)(nrf_drv_usbd_ep_transfer_t * p_next,
+                                        void *                       p_context,
+                                        size_t                       ep_size,
+                                        size_t                       data_size);
+
+typedef struct
+{
+    union
+    {
+        nrf_drv_usbd_feeder_t   feeder;
+        nrf_drv_usbd_consumer_t consumer;
+    } handler;
+    void * p_context;
+} nrf_drv_usbd_handler_desc_t;
+
+bool nrf_drv_usbd_is_enabled(void);
+
+uint32_t nrf_drv_usbd_framecntr_get(void);
+
+bool nrf_drv_usbd_ep_is_busy(nrf_drv_usbd_ep_t ep);
+
+#endif /* NRF_DRV_USBD_H__ */
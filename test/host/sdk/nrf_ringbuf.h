@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef NRF_RINGBUF_H
+#define NRF_RINGBUF_H
+
+#include "sdk_common.h"
+#include "nrf_atomic.h"
+
+/*
+ * Ring buffer of the SDK, same control block and the same semantics, see
+ * nrf_ringbuf.c. The class reads and edits the control block directly.
+ */
+
+typedef struct
+{
+    nrf_atomic_flag_t   wr_flag;    //!< Protection flag.
+    nrf_atomic_flag_t   rd_flag;    //!< Protection flag.
+    uint32_t            wr_idx;     //!< Write index (updated when putting).
+    uint32_t            tmp_wr_idx; //!< Temporary write index (updated when allocating).
+    uint32_t            rd_idx;     //!< Read index (updated when freeing).
+    uint32_t            tmp_rd_idx; //!< Temporary read index (updated when getting).
+} nrf_ringbuf_cb_t;
+
+typedef struct
+{
+    uint8_t          * p_buffer;     //!< Pointer to the memory used by the ring buffer.
+    uint32_t           bufsize_mask; //!< Buffer size mask (buffer size must be a power of 2).
+    nrf_ringbuf_cb_t * p_cb;         //!< Pointer to the instance control block.
+} nrf_ringbuf_t;
+
+#define NRF_RINGBUF_DEF(_name, _size)                                          \
+    STATIC_ASSERT(IS_POWER_OF_TWO(_size));                                     \
+    static uint8_t CONCAT_2(_name,_buf)[_size];                                \
+    static nrf_ringbuf_cb_t CONCAT_2(_name,_cb);                               \
+    static const nrf_ringbuf_t _name = {                                       \
+            .p_buffer = CONCAT_2(_name,_buf),                                  \
+            .bufsize_mask = _size - 1,                                         \
+            .p_cb         = &CONCAT_2(_name,_cb),                              \
+    }
+
+void nrf_ringbuf_init(nrf_ringbuf_t const * p_ringbuf);
+
+ret_code_t nrf_ringbuf_alloc(nrf_ringbuf_t const * p_ringbuf, uint8_t * * pp_data, size_t * p_length, bool start);
+
+ret_code_t nrf_ringbuf_put(nrf_ringbuf_t const * p_ringbuf, size_t length);
+
+ret_code_t nrf_ringbuf_cpy_put(nrf_ringbuf_t const * p_ringbuf,
+                               uint8_t const* p_data,
+                               size_t * p_length);
+
+ret_code_t nrf_ringbuf_get(nrf_ringbuf_t const * p_ringbuf, uint8_t * * pp_data, size_t * p_length, bool start);
+
+ret_code_t nrf_ringbuf_free(nrf_ringbuf_t const * p_ringbuf, size_t length);
+
+ret_code_t nrf_ringbuf_cpy_get(nrf_ringbuf_t const * p_ringbuf,
+                               uint8_t * p_data,
+                               size_t * p_length);
+
+#endif /* NRF_RINGBUF_H */
@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Latest-value-wins coalescing of continuous controllers, see APP_USBD_MIDI_CONFIG_CC_SLOTS.
+ *
+ * Every case starts with one control change that the device starts sending right away, so
+ * the writes after it wait in the TX buffer behind an IN transfer in flight.
+ */
+#include "midi_host.h"
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, 1024, 4, 64);
+
+static void write(uint8_t status, uint8_t data1, uint8_t data2)
+{
+    uint8_t msg[3] = { status, data1, data2 };
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 0, msg, ((status & 0xE0) == 0xC0) ? 2 : 3));
+}
+
+/**
+ * @brief Put a control change in flight and return the coalesced count.
+ */
+static uint32_t start(void)
+{
+    app_usbd_midi_stats_t stats;
+
+    write(0xB0, 10, 1);
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPIN1));
+    app_usbd_midi_stats_get(&m_midi, &stats);
+    return stats.tx_coalesced;
+}
+
+/**
+ * @brief Read everything the device sends and compare the messages with @p p_expect.
+ *
+ * @param[in] p_expect  Status and data bytes, three per message, after the one in flight.
+ * @param[in] count     Number of messages expected.
+ * @param[in] coalesced Number of overwritten values expected since @ref start.
+ * @param[in] base      Return value of @ref start.
+ */
+static void check(uint8_t const (* p_expect)[3], size_t count, uint32_t coalesced, uint32_t base)
+{
+    uint8_t               buf[256];
+    size_t                len = 0;
+    size_t                n;
+    app_usbd_midi_stats_t stats;
+
+    while ((n = vhost_in(&buf[len], sizeof(buf) - len)) > 0)
+    {
+        len += n;
+    }
+    MIDI_HOST_CHECK(len == (count + 1) * 4);
+    MIDI_HOST_CHECK(memcmp(&buf[1], (uint8_t const[]){ 0xB0, 10, 1 }, 3) == 0);
+    for (size_t i = 0; i < count; i++)
+    {
+        MIDI_HOST_CHECK(memcmp(&buf[((i + 1) * 4) + 1], p_expect[i], 3) == 0);
+    }
+    app_usbd_midi_stats_get(&m_midi, &stats);
+    MIDI_HOST_CHECK(stats.tx_coalesced - base == coalesced);
+}
+
+/**
+ * @brief Queued values of controllers, pitch bend and pressure are overwritten in place.
+ *
+ * The controls map to different slots, a control sharing the slot of another one is queued.
+ */
+static void test_overwrite(void)
+{
+    static const uint8_t expect[][3] =
+    {
+        { 0xB0, 11, 3 },
+        { 0xE0, 0x00, 0x30 },
+        { 0xB1, 11, 7 },
+        { 0xB0, 12, 9 },
+        { 0xA0, 0x3C, 0x12 },
+    };
+    uint32_t base = start();
+
+    write(0xB0, 11, 1);
+    write(0xE0, 0x00, 0x10);
+    write(0xB1, 11, 7);
+    write(0xB0, 11, 2);
+    write(0xB0, 12, 8);
+    write(0xA0, 0x3C, 0x11);
+    write(0xE0, 0x00, 0x30);
+    write(0xB0, 11, 3);
+    write(0xB0, 12, 9);
+    write(0xA0, 0x3C, 0x12);
+    check(expect, ARRAY_SIZE(expect), 5, base);
+}
+
+/**
+ * @brief Controllers whose meaning depends on order are all sent.
+ */
+static void test_ordered(void)
+{
+    static const uint8_t ctrl[] = { 0, 6, 32, 33, 38, 63, 64, 69, 96, 101, 120, 127 };
+    uint8_t              expect[ARRAY_SIZE(ctrl) * 2][3];
+    uint32_t             base = start();
+
+    for (size_t i = 0; i < ARRAY_SIZE(ctrl) * 2; i++)
+    {
+        expect[i][0] = 0xB0;
+        expect[i][1] = ctrl[i % ARRAY_SIZE(ctrl)];
+        expect[i][2] = (uint8_t)i;
+        write(0xB0, expect[i][1], expect[i][2]);
+    }
+    check((uint8_t const (*)[3])expect, ARRAY_SIZE(expect), 0, base);
+}
+
+/**
+ * @brief An LSB stays behind the MSB it was written after.
+ *
+ * The host resets the LSB on every MSB, so 7:11 then 39:6 has to arrive in that order,
+ * and a new MSB may not overtake the LSB of the previous one.
+ */
+static void test_msb_lsb(void)
+{
+    static const uint8_t pair[][3] =
+    {
+        { 0xB0, 7,  10 },
+        { 0xB0, 39, 5  },
+        { 0xB0, 7,  11 },
+        { 0xB0, 39, 6  },
+    };
+    static const uint8_t msb_only[][3] =
+    {
+        { 0xB0, 7,  10 },
+        { 0xB0, 39, 5  },
+        { 0xB0, 7,  12 },
+    };
+    uint32_t base = start();
+
+    for (size_t i = 0; i < ARRAY_SIZE(pair); i++)
+    {
+        write(pair[i][0], pair[i][1], pair[i][2]);
+    }
+    check(pair, ARRAY_SIZE(pair), 0, base);
+
+    base = start();
+    write(0xB0, 7, 10);
+    write(0xB0, 39, 5);
+    write(0xB0, 7, 11);
+    write(0xB0, 7, 12);
+    check(msb_only, ARRAY_SIZE(msb_only), 1, base);
+}
+
+int main(void)
+{
+    midi_host_open(&m_midi);
+    app_usbd_midi_tx_coalesce_set(&m_midi, UINT16_MAX);
+    test_overwrite();
+    test_ordered();
+    test_msb_lsb();
+    printf("cc: ok\n");
+    return 0;
+}
@@ -0,0 +1,449 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Loopback through the virtual host: enumeration, IN packets of the write functions
+ * and parsing of OUT packets.
+ */
+#include "midi_host.h"
+
+#define RX_MAX 128
+
+typedef struct
+{
+    uint8_t cable;
+    uint8_t len;
+    uint8_t data[16];
+    bool    sysex;
+} rx_msg_t;
+
+static rx_msg_t m_rx[RX_MAX];
+static size_t   m_rx_count;
+static uint8_t  m_sysex_buf[64];
+static uint32_t m_port_open;
+static uint32_t m_sysex_tx_done;
+static uint32_t m_sysex_tx_aborted;
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+    switch (event)
+    {
+        case APP_USBD_MIDI_USER_EVT_PORT_OPEN:
+            m_port_open++;
+            break;
+        case APP_USBD_MIDI_USER_EVT_SYSEX_TX_DONE:
+            m_sysex_tx_done++;
+            break;
+        case APP_USBD_MIDI_USER_EVT_SYSEX_TX_ABORTED:
+            m_sysex_tx_aborted++;
+            break;
+        default:
+            break;
+    }
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg);
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, 1024, 4, 64);
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+    rx_msg_t * p_rx = &m_rx[m_rx_count];
+
+    switch (event)
+    {
+        case APP_USBD_MIDI_SYSEX_BUF_REQ:
+            p_msg->p_data = m_sysex_buf;
+            p_msg->len    = sizeof(m_sysex_buf);
+            return;
+
+        case APP_USBD_MIDI_SYSEX_RX_DONE:
+            MIDI_HOST_CHECK(m_rx_count < RX_MAX);
+            p_rx->cable = cable;
+            p_rx->sysex = true;
+            p_rx->len   = 0;
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL
+            if (p_msg->p_chain != NULL)
+            {
+                for (app_usbd_midi_sysex_block_t * p_block = p_msg->p_chain;
+                     p_block != NULL;
+                     p_block = p_block->p_next)
+                {
+                    MIDI_HOST_CHECK(p_rx->len + p_block->len <= sizeof(p_rx->data));
+                    memcpy(&p_rx->data[p_rx->len], p_block->data, p_block->len);
+                    p_rx->len += p_block->len;
+                }
+                app_usbd_midi_sysex_free(&m_midi, p_msg->p_chain);
+                m_rx_count++;
+                return;
+            }
+#endif
+            MIDI_HOST_CHECK(p_msg->len <= sizeof(p_rx->data));
+            memcpy(p_rx->data, p_msg->p_data, p_msg->len);
+            p_rx->len = (uint8_t)p_msg->len;
+            m_rx_count++;
+            return;
+
+        case APP_USBD_MIDI_RX_DONE:
+            MIDI_HOST_CHECK(m_rx_count < RX_MAX);
+            MIDI_HOST_CHECK(p_msg->len <= sizeof(p_rx->data));
+            p_rx->cable = cable;
+            p_rx->sysex = false;
+            p_rx->len   = (uint8_t)p_msg->len;
+            memcpy(p_rx->data, p_msg->p_data, p_msg->len);
+            m_rx_count++;
+            return;
+
+        default:
+            return;
+    }
+}
+
+/**
+ * @brief Read IN packets until the device has nothing left, with SOFs in between
+ *        for configurations that hold packets until the frame ends.
+ */
+static size_t drain(uint8_t * p_buf, size_t size)
+{
+    size_t len = 0;
+
+    for (uint8_t idle = 0; idle < 3; )
+    {
+        size_t n = vhost_in(p_buf + len, size - len);
+
+        len += n;
+        if (n == 0)
+        {
+            idle++;
+            vhost_sof();
+        }
+        else
+        {
+            idle = 0;
+        }
+    }
+    return len;
+}
+
+static void test_enumerate(void)
+{
+    vhost_dev_t const * p_dev = vhost_dev_get();
+
+    MIDI_HOST_CHECK(p_dev->stream_iface == 1);
+    MIDI_HOST_CHECK(p_dev->ep_in == NRF_DRV_USBD_EPIN1);
+    MIDI_HOST_CHECK(p_dev->ep_out == NRF_DRV_USBD_EPOUT1);
+    MIDI_HOST_CHECK(p_dev->alt_count == 1);
+    MIDI_HOST_CHECK(m_port_open == 2);
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+}
+
+static void test_write(void)
+{
+    uint8_t       buf[256];
+    uint8_t       note_on[]  = { 0x90, 0x3C, 0x7F };
+    uint8_t       note_off[] = { 0x80, 0x3C, 0x00 };
+    uint8_t       pgm[]      = { 0xC5, 0x12 };
+    uint8_t const expect[]   = { 0x29, 0x90, 0x3C, 0x7F,
+                                 0x28, 0x80, 0x3C, 0x00,
+                                 0x0C, 0xC5, 0x12, 0x00 };
+
+    MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == 0);
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 2, note_on, sizeof(note_on)));
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 2, note_off, sizeof(note_off)));
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 0, pgm, sizeof(pgm)));
+    MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == sizeof(expect));
+    MIDI_HOST_CHECK(memcmp(buf, expect, sizeof(expect)) == 0);
+
+    MIDI_HOST_CHECK(app_usbd_midi_write(&m_midi, 16, note_on, sizeof(note_on)) == NRF_ERROR_INVALID_PARAM);
+    MIDI_HOST_CHECK(app_usbd_midi_write(&m_midi, 0, note_on, 0) == NRF_ERROR_INVALID_DATA);
+}
+
+static void test_write_batch(void)
+{
+    static uint8_t      buf[2048];
+    uint8_t             note_on[]  = { 0x91, 0x3C, 0x7F };
+    uint8_t             note_off[] = { 0x81, 0x3C, 0x00 };
+    uint8_t             pgm[]      = { 0xC1, 0x12 };
+    app_usbd_midi_msg_t msgs[]     =
+    {
+        { .p_data = note_on,  .len = sizeof(note_on)  },
+        { .p_data = pgm,      .len = sizeof(pgm)      },
+        { .p_data = note_off, .len = sizeof(note_off) },
+    };
+    uint8_t const       expect[]   = { 0xF9, 0x91, 0x3C, 0x7F,
+                                       0xFC, 0xC1, 0x12, 0x00,
+                                       0xF8, 0x81, 0x3C, 0x00 };
+    size_t              len;
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write_batch(&m_midi, 15, msgs, ARRAY_SIZE(msgs)));
+    MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == sizeof(expect));
+    MIDI_HOST_CHECK(memcmp(buf, expect, sizeof(expect)) == 0);
+
+    MIDI_HOST_CHECK(app_usbd_midi_write_batch(&m_midi, 16, msgs, ARRAY_SIZE(msgs)) ==
+                    NRF_ERROR_INVALID_PARAM);
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write_batch(&m_midi, 0, msgs, 0));
+
+    /* A bad message cancels the batch, nothing of it is sent and the TX buffer is free again. */
+    msgs[1].len = 0;
+    MIDI_HOST_CHECK(app_usbd_midi_write_batch(&m_midi, 0, msgs, ARRAY_SIZE(msgs)) ==
+                    NRF_ERROR_INVALID_DATA);
+    msgs[1].len = 4;
+    MIDI_HOST_CHECK(app_usbd_midi_write_batch(&m_midi, 0, msgs, ARRAY_SIZE(msgs)) ==
+                    NRF_ERROR_INVALID_DATA);
+    msgs[1].len = sizeof(pgm);
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write_batch(&m_midi, 15, msgs, ARRAY_SIZE(msgs)));
+    MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == sizeof(expect));
+    MIDI_HOST_CHECK(memcmp(buf, expect, sizeof(expect)) == 0);
+
+    /* A batch one event packet too large for the rest of the TX buffer queues nothing. */
+    for (len = 0; len < 1024 - 4; len += 4)
+    {
+        MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 0, note_on, sizeof(note_on)));
+    }
+    MIDI_HOST_CHECK(app_usbd_midi_write_batch(&m_midi, 0, msgs, 2) == NRF_ERROR_NO_MEM);
+    MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == len);
+    for (size_t i = 0; i < len; i += 4)
+    {
+        MIDI_HOST_CHECK(buf[i] == 0x09);
+    }
+}
+
+static void test_sysex_write(void)
+{
+    uint8_t       buf[256];
+    uint8_t const msg[]    = { 0xF0, 0x7E, 0x7F, 0x06, 0x01, 0xF7 };
+    uint8_t const expect[] = { 0x14, 0xF0, 0x7E, 0x7F,
+                               0x17, 0x06, 0x01, 0xF7 };
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_sysex_write(&m_midi, 1, msg, 4));
+    MIDI_HOST_CHECK_OK(app_usbd_midi_sysex_write(&m_midi, 1, &msg[4], 2));
+    MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == sizeof(expect));
+    MIDI_HOST_CHECK(memcmp(buf, expect, sizeof(expect)) == 0);
+}
+
+static void test_send_raw(void)
+{
+    uint8_t       buf[256];
+    uint8_t const raw[] = { 0x3B, 0xB0, 0x07, 0x64,
+                            0x3E, 0xE0, 0x00, 0x40 };
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_send_raw(&m_midi, raw, sizeof(raw)));
+    MIDI_HOST_CHECK(app_usbd_midi_send_raw(&m_midi, raw, 3) == NRF_ERROR_INVALID_LENGTH);
+    MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == sizeof(raw));
+    MIDI_HOST_CHECK(memcmp(buf, raw, sizeof(raw)) == 0);
+}
+
+static void test_large(void)
+{
+    static uint8_t buf[2048];
+    uint8_t        msg[3];
+    size_t         len;
+
+    /* More than one transfer worth of events, received in order. */
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        msg[0] = 0x90;
+        msg[1] = (uint8_t)(i & 0x7F);
+        msg[2] = 0x40;
+        MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 0, msg, sizeof(msg)));
+    }
+    len = drain(buf, sizeof(buf));
+    MIDI_HOST_CHECK(len == 200 * 4);
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        MIDI_HOST_CHECK(buf[(i * 4) + 0] == 0x09);
+        MIDI_HOST_CHECK(buf[(i * 4) + 2] == (uint8_t)(i & 0x7F));
+    }
+}
+
+static void test_rx(void)
+{
+    uint8_t const packet[] = { 0x39, 0x93, 0x40, 0x50,
+                               0x3B, 0xB3, 0x01, 0x02,
+                               0x0F, 0xF8, 0x00, 0x00 };
+
+    m_rx_count = 0;
+    MIDI_HOST_CHECK(vhost_out(packet, sizeof(packet)) == sizeof(packet));
+    app_usbd_midi_process(&m_midi, SIZE_MAX);
+
+    MIDI_HOST_CHECK(m_rx_count == 3);
+    MIDI_HOST_CHECK((m_rx[0].cable == 3) && (m_rx[0].len == 3) && (m_rx[0].data[0] == 0x93) &&
+                    (m_rx[0].data[2] == 0x50));
+    MIDI_HOST_CHECK((m_rx[1].cable == 3) && (m_rx[1].len == 3) && (m_rx[1].data[0] == 0xB3));
+    MIDI_HOST_CHECK((m_rx[2].cable == 0) && (m_rx[2].len == 1) && (m_rx[2].data[0] == 0xF8));
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+}
+
+static void test_rx_sysex(void)
+{
+    uint8_t const packets[] = { 0x24, 0xF0, 0x01, 0x02,
+                                0x27, 0x03, 0x04, 0xF7 };
+    uint8_t const expect[]  = { 0xF0, 0x01, 0x02, 0x03, 0x04, 0xF7 };
+
+    m_rx_count = 0;
+    MIDI_HOST_CHECK(vhost_out(packets, sizeof(packets)) == sizeof(packets));
+    app_usbd_midi_process(&m_midi, SIZE_MAX);
+
+    MIDI_HOST_CHECK(m_rx_count == 1);
+    MIDI_HOST_CHECK(m_rx[0].sysex && (m_rx[0].cable == 2));
+    MIDI_HOST_CHECK((m_rx[0].len == sizeof(expect)) && (memcmp(m_rx[0].data, expect, sizeof(expect)) == 0));
+}
+
+static void test_rx_full_packets(void)
+{
+    uint8_t packets[NRF_DRV_USBD_EPSIZE * 4];
+
+    /* Whole packets, every one fills an RX buffer and ends its transfer. */
+    for (size_t i = 0; i < sizeof(packets); i += 4)
+    {
+        packets[i + 0] = 0x09;
+        packets[i + 1] = 0x90;
+        packets[i + 2] = (uint8_t)((i / 4) & 0x7F);
+        packets[i + 3] = 0x7F;
+    }
+    m_rx_count = 0;
+    for (size_t i = 0; i < sizeof(packets); i += NRF_DRV_USBD_EPSIZE)
+    {
+        MIDI_HOST_CHECK(vhost_out_packet(&packets[i], NRF_DRV_USBD_EPSIZE) == NRF_DRV_USBD_EPSIZE);
+        app_usbd_midi_process(&m_midi, SIZE_MAX);
+    }
+    MIDI_HOST_CHECK(m_rx_count == sizeof(packets) / 4);
+    for (size_t i = 0; i < m_rx_count; i++)
+    {
+        MIDI_HOST_CHECK(m_rx[i].data[1] == (uint8_t)(i & 0x7F));
+    }
+}
+
+static void test_reselect(void)
+{
+    uint8_t buf[64];
+
+    /* Selecting the setting again restarts the port. */
+    MIDI_HOST_CHECK_OK(vhost_alt_select(0));
+    MIDI_HOST_CHECK(m_port_open == 3);
+    MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == 0);
+    MIDI_HOST_CHECK(vhost_alt_select(2) != NRF_SUCCESS);
+}
+
+static void test_sysex_send_abort(void)
+{
+    static uint8_t msg[4096];
+    uint8_t        buf[256];
+    uint8_t const  short_msg[] = { 0xF0, 0x01, 0x02, 0xF7 };
+    uint8_t const  expect[]    = { 0x04, 0xF0, 0x01, 0x02,
+                                   0x05, 0xF7, 0x00, 0x00 };
+
+    memset(msg, 0x55, sizeof(msg));
+    msg[0]               = 0xF0;
+    msg[sizeof(msg) - 1] = 0xF7;
+    m_sysex_tx_done      = 0;
+    m_sysex_tx_aborted   = 0;
+
+    /* The host restarts the port while most of the message still waits to be encoded. */
+    MIDI_HOST_CHECK_OK(app_usbd_midi_sysex_send(&m_midi, 0, msg, sizeof(msg)));
+    MIDI_HOST_CHECK(app_usbd_midi_sysex_send(&m_midi, 0, msg, sizeof(msg)) == NRF_ERROR_BUSY);
+    MIDI_HOST_CHECK_OK(vhost_alt_select(0));
+    MIDI_HOST_CHECK(m_sysex_tx_aborted == 1);
+    MIDI_HOST_CHECK(m_sysex_tx_done == 0);
+    MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == 0);
+
+    /* Nothing is pending any more, the next message goes out whole. */
+    MIDI_HOST_CHECK_OK(app_usbd_midi_sysex_send(&m_midi, 0, short_msg, sizeof(short_msg)));
+    MIDI_HOST_CHECK(m_sysex_tx_done == 1);
+    MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == sizeof(expect));
+    MIDI_HOST_CHECK(memcmp(buf, expect, sizeof(expect)) == 0);
+    MIDI_HOST_CHECK(m_sysex_tx_aborted == 1);
+}
+
+#if APP_USBD_MIDI_CONFIG_TRACE_SIZE
+static void test_trace(void)
+{
+    uint8_t       buf[64];
+    uint8_t const raw[]  = { 0x09, 0x90, 0x3C, 0x7F };
+    uint32_t      start  = app_usbd_midi_trace.idx;
+    uint32_t      seen   = 0;
+    uint32_t      cycles = 0;
+
+    /* Records carry the cycle counter, running from the host clock off target. */
+    MIDI_HOST_CHECK_OK(app_usbd_midi_send_raw(&m_midi, raw, sizeof(raw)));
+    MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == sizeof(raw));
+    MIDI_HOST_CHECK(app_usbd_midi_trace.idx - start <= APP_USBD_MIDI_CONFIG_TRACE_SIZE);
+    for (uint32_t idx = start; idx != app_usbd_midi_trace.idx; idx++)
+    {
+        app_usbd_midi_trace_rec_t const * p_rec =
+            &app_usbd_midi_trace.rec[idx & (APP_USBD_MIDI_CONFIG_TRACE_SIZE - 1)];
+
+        MIDI_HOST_CHECK(p_rec->cycles >= cycles);
+        cycles = p_rec->cycles;
+        seen  |= 1U << p_rec->id;
+    }
+    MIDI_HOST_CHECK(cycles != 0);
+    MIDI_HOST_CHECK(seen & (1U << APP_USBD_MIDI_TRACE_SEND_RAW_ENTER));
+    MIDI_HOST_CHECK(seen & (1U << APP_USBD_MIDI_TRACE_SEND_RAW_EXIT));
+    MIDI_HOST_CHECK(seen & (1U << APP_USBD_MIDI_TRACE_TX_START));
+    MIDI_HOST_CHECK(seen & (1U << APP_USBD_MIDI_TRACE_IN_DONE));
+}
+#endif
+
+int main(void)
+{
+    midi_host_open(&m_midi);
+    test_enumerate();
+    test_write();
+    test_write_batch();
+    test_sysex_write();
+    test_send_raw();
+    test_large();
+    test_rx();
+    test_rx_sysex();
+    test_rx_full_packets();
+    test_reselect();
+    test_sysex_send_abort();
+#if APP_USBD_MIDI_CONFIG_TRACE_SIZE
+    test_trace();
+#endif
+    printf("loopback: ok\n");
+    return 0;
+}
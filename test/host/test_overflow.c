@@ -0,0 +1,415 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Overflow policies and watermarks of the TX buffer, see app_usbd_midi_overflow_set and
+ * app_usbd_midi_watermarks_set.
+ *
+ * The 256 byte TX buffer holds 64 event packets. It is filled behind an IN transfer in
+ * flight and written once more, the policy decides what gives way. Compaction moves the
+ * unsent data down, so the coalescing SOF mark and the lane probe index have to follow it.
+ */
+#include "midi_host.h"
+
+#define EVENT_SIZE      4       /**< Size of an event packet. */
+#define TX_BUFFER_SIZE  256
+#define TX_PACKETS      (TX_BUFFER_SIZE / EVENT_SIZE)
+#define SYSEX_PACKETS   16
+
+static uint32_t m_wm_high;
+static uint32_t m_wm_low;
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+    switch (event)
+    {
+        case APP_USBD_MIDI_USER_EVT_TX_HIGH_WATERMARK:
+            m_wm_high++;
+            break;
+        case APP_USBD_MIDI_USER_EVT_TX_LOW_WATERMARK:
+            m_wm_low++;
+            break;
+        default:
+            break;
+    }
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, TX_BUFFER_SIZE, 4, 64);
+
+/**
+ * @brief Build a channel voice event packet on cable 0.
+ */
+static void ev_set(uint8_t * p_ev, uint8_t status, uint8_t data1, uint8_t data2)
+{
+    p_ev[0] = status >> 4;
+    p_ev[1] = status;
+    p_ev[2] = data1;
+    p_ev[3] = data2;
+}
+
+/**
+ * @brief Build a sysex message of @ref SYSEX_PACKETS event packets on cable 0.
+ */
+static void sysex_set(uint8_t * p_ev)
+{
+    for (size_t i = 0; i < SYSEX_PACKETS; i++, p_ev += EVENT_SIZE)
+    {
+        p_ev[0] = (i == SYSEX_PACKETS - 1) ? APP_USBD_MIDI_CIN_SYSEX_END_3 :
+                                             APP_USBD_MIDI_CIN_SYSEX;
+        p_ev[1] = (i == 0) ? 0xF0 : (uint8_t)i;
+        p_ev[2] = 0x55;
+        p_ev[3] = (i == SYSEX_PACKETS - 1) ? 0xF7 : 0x2A;
+    }
+}
+
+static ret_code_t put(uint8_t status, uint8_t data1, uint8_t data2)
+{
+    uint8_t ev[EVENT_SIZE];
+
+    ev_set(ev, status, data1, data2);
+    return app_usbd_midi_send_raw(&m_midi, ev, sizeof(ev));
+}
+
+static void stats_get(app_usbd_midi_stats_t * p_stats)
+{
+    app_usbd_midi_stats_get(&m_midi, p_stats);
+}
+
+/**
+ * @brief Read everything the device sends and compare it with @p p_expect.
+ */
+static void check_in(uint8_t const * p_expect, size_t len)
+{
+    uint8_t buf[2 * TX_BUFFER_SIZE];
+
+    MIDI_HOST_CHECK(vhost_in(buf, sizeof(buf)) == len);
+    MIDI_HOST_CHECK(memcmp(buf, p_expect, len) == 0);
+}
+
+/**
+ * @brief A write that does not fit fails and nothing queued is lost.
+ */
+static void test_reject(void)
+{
+    uint8_t               expect[TX_BUFFER_SIZE];
+    app_usbd_midi_stats_t before;
+    app_usbd_midi_stats_t after;
+
+    app_usbd_midi_overflow_set(&m_midi, APP_USBD_MIDI_OVERFLOW_REJECT);
+    stats_get(&before);
+
+    for (uint8_t i = 0; i < TX_PACKETS; i++)
+    {
+        ev_set(&expect[i * EVENT_SIZE], 0x90, i, 0x40);
+        MIDI_HOST_CHECK_OK(put(0x90, i, 0x40));
+    }
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPIN1));
+    MIDI_HOST_CHECK(put(0x80, 0, 0) == NRF_ERROR_NO_MEM);
+
+    stats_get(&after);
+    MIDI_HOST_CHECK(after.tx_rejected == before.tx_rejected + 1);
+    MIDI_HOST_CHECK(after.tx_dropped == before.tx_dropped);
+    check_in(expect, sizeof(expect));
+}
+
+/**
+ * @brief Oldest unsent messages give way: a sysex whole, note offs never.
+ *
+ * The note in flight is sent as claimed. The note off in front of the sysex survives
+ * both compactions, the sysex is dropped as one message and then the oldest note on.
+ */
+static void test_drop_oldest(void)
+{
+    uint8_t               queue[(TX_PACKETS - 1) * EVENT_SIZE];
+    uint8_t               expect[TX_BUFFER_SIZE];
+    uint8_t             * p_expect = expect;
+    app_usbd_midi_stats_t before;
+    app_usbd_midi_stats_t after;
+
+    app_usbd_midi_overflow_set(&m_midi, APP_USBD_MIDI_OVERFLOW_DROP_OLDEST);
+    stats_get(&before);
+
+    /* Note in flight, then a note off, the sysex and 46 note ons fill the buffer. */
+    MIDI_HOST_CHECK_OK(put(0x90, 0x7F, 0x40));
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPIN1));
+    ev_set(queue, 0x80, 0x7F, 0x00);
+    sysex_set(&queue[EVENT_SIZE]);
+    for (uint8_t i = 0; i < TX_PACKETS - 2 - SYSEX_PACKETS; i++)
+    {
+        ev_set(&queue[(1 + SYSEX_PACKETS + i) * EVENT_SIZE], 0x90, i, 0x40);
+    }
+    MIDI_HOST_CHECK_OK(app_usbd_midi_send_raw(&m_midi, queue, sizeof(queue)));
+
+    /* The sysex makes room for 16 more note ons, the one after them drops a note on. */
+    for (uint8_t i = 0; i < SYSEX_PACKETS + 1; i++)
+    {
+        MIDI_HOST_CHECK_OK(put(0x90, 0x60 + i, 0x40));
+    }
+
+    stats_get(&after);
+    MIDI_HOST_CHECK(after.tx_dropped == before.tx_dropped + SYSEX_PACKETS + 1);
+    MIDI_HOST_CHECK(after.tx_rejected == before.tx_rejected);
+
+    ev_set(p_expect, 0x90, 0x7F, 0x40);
+    p_expect += EVENT_SIZE;
+    ev_set(p_expect, 0x80, 0x7F, 0x00);
+    p_expect += EVENT_SIZE;
+    for (uint8_t i = 1; i < TX_PACKETS - 2 - SYSEX_PACKETS; i++, p_expect += EVENT_SIZE)
+    {
+        ev_set(p_expect, 0x90, i, 0x40);
+    }
+    for (uint8_t i = 0; i < SYSEX_PACKETS + 1; i++, p_expect += EVENT_SIZE)
+    {
+        ev_set(p_expect, 0x90, 0x60 + i, 0x40);
+    }
+    check_in(expect, p_expect - expect);
+}
+
+/**
+ * @brief Only controllers give way, once none is left the write fails.
+ *
+ * Controllers alternate with note ons. Each controller has its own key, so none is
+ * replaced by a newer one.
+ */
+static void test_drop_low(void)
+{
+    uint8_t               expect[TX_BUFFER_SIZE];
+    uint8_t             * p_expect = expect;
+    uint8_t               notes    = 0;
+    uint8_t               ccs      = 0;
+    app_usbd_midi_stats_t before;
+    app_usbd_midi_stats_t after;
+
+    app_usbd_midi_overflow_set(&m_midi, APP_USBD_MIDI_OVERFLOW_DROP_LOW);
+    stats_get(&before);
+
+    for (uint8_t i = 0; i < TX_PACKETS; i++)
+    {
+        if ((i % 2) == 0)
+        {
+            MIDI_HOST_CHECK_OK(put(0x90, notes++, 0x40));
+        }
+        else
+        {
+            MIDI_HOST_CHECK_OK(put(0xB0 | (ccs & 0x0F), (ccs < 16) ? 7 : 10, 0x40));
+            ccs++;
+        }
+    }
+
+    /* Every controller makes room for one more note on. */
+    for (uint8_t i = 0; i < ccs; i++)
+    {
+        MIDI_HOST_CHECK_OK(put(0x90, 0x40 + i, 0x40));
+    }
+    MIDI_HOST_CHECK(put(0x90, 0x7F, 0x40) == NRF_ERROR_NO_MEM);
+
+    stats_get(&after);
+    MIDI_HOST_CHECK(after.tx_dropped == before.tx_dropped + ccs);
+    MIDI_HOST_CHECK(after.tx_rejected == before.tx_rejected + 1);
+
+    for (uint8_t i = 0; i < notes; i++, p_expect += EVENT_SIZE)
+    {
+        ev_set(p_expect, 0x90, i, 0x40);
+    }
+    for (uint8_t i = 0; i < ccs; i++, p_expect += EVENT_SIZE)
+    {
+        ev_set(p_expect, 0x90, 0x40 + i, 0x40);
+    }
+    check_in(expect, p_expect - expect);
+}
+
+/**
+ * @brief Compaction behind a claimed IN transfer keeps the coalescing SOF mark.
+ *
+ * Every write is coalesced. The buffer is filled behind a full packet in flight and
+ * a SOF marks all of it as due. The sysex dropped for one more note moves the mark
+ * down with the data, so the new note waits for the next SOF like any other.
+ */
+static void test_compact_sof(void)
+{
+    uint8_t               queue[(TX_PACKETS - SYSEX_PACKETS) * EVENT_SIZE];
+    uint8_t               buf[NRF_DRV_USBD_EPSIZE];
+    app_usbd_midi_stats_t before;
+    app_usbd_midi_stats_t after;
+
+    app_usbd_midi_overflow_set(&m_midi, APP_USBD_MIDI_OVERFLOW_REJECT);
+    app_usbd_midi_tx_coalesce_set(&m_midi, 0);
+    stats_get(&before);
+    vhost_sof();
+
+    /* A full packet is sent at once, the sysex and 32 notes queue behind it. */
+    for (uint8_t i = 0; i < ARRAY_SIZE(queue) / EVENT_SIZE; i++)
+    {
+        ev_set(&queue[i * EVENT_SIZE], 0x90, i, 0x40);
+    }
+    MIDI_HOST_CHECK_OK(app_usbd_midi_send_raw(&m_midi, queue, NRF_DRV_USBD_EPSIZE));
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPIN1));
+    sysex_set(buf);
+    MIDI_HOST_CHECK_OK(app_usbd_midi_send_raw(&m_midi, buf, sizeof(buf)));
+    MIDI_HOST_CHECK_OK(app_usbd_midi_send_raw(&m_midi,
+                                              &queue[NRF_DRV_USBD_EPSIZE],
+                                              sizeof(queue) - NRF_DRV_USBD_EPSIZE));
+    vhost_sof();
+
+    app_usbd_midi_overflow_set(&m_midi, APP_USBD_MIDI_OVERFLOW_DROP_OLDEST);
+    MIDI_HOST_CHECK_OK(put(0x90, 0x7F, 0x40));
+    stats_get(&after);
+    MIDI_HOST_CHECK(after.tx_dropped == before.tx_dropped + SYSEX_PACKETS);
+
+    for (size_t i = 0; i < sizeof(queue); i += NRF_DRV_USBD_EPSIZE)
+    {
+        MIDI_HOST_CHECK(vhost_in_packet(buf) == NRF_DRV_USBD_EPSIZE);
+        MIDI_HOST_CHECK(memcmp(buf, &queue[i], NRF_DRV_USBD_EPSIZE) == 0);
+    }
+    MIDI_HOST_CHECK(vhost_in_packet(buf) == USBD_SIM_NAK);
+    vhost_sof();
+    MIDI_HOST_CHECK(vhost_in_packet(buf) == EVENT_SIZE);
+    MIDI_HOST_CHECK((buf[1] == 0x90) && (buf[2] == 0x7F));
+
+    app_usbd_midi_tx_coalesce_set(&m_midi, UINT16_MAX);
+}
+
+/**
+ * @brief Compaction keeps the lane probe on the data it measures.
+ *
+ * A clock in flight on the real-time lane holds the normal lane back, so the whole
+ * buffer is written unclaimed at once and the probe is armed at its end. After the
+ * sysex is dropped the probe has to complete when the rest is sent.
+ */
+static void test_compact_probe(void)
+{
+    static uint8_t             clock = 0xF8;
+    uint8_t                    queue[TX_BUFFER_SIZE];
+    uint8_t                    expect[EVENT_SIZE + TX_BUFFER_SIZE] =
+    {
+        APP_USBD_MIDI_CIN_SINGLE_BYTE, 0xF8, 0x00, 0x00
+    };
+    app_usbd_midi_lane_stats_t before;
+    app_usbd_midi_lane_stats_t after;
+
+    app_usbd_midi_overflow_set(&m_midi, APP_USBD_MIDI_OVERFLOW_DROP_OLDEST);
+    MIDI_HOST_CHECK_OK(app_usbd_midi_lane_stats_get(&m_midi, APP_USBD_MIDI_LANE_NORMAL, &before));
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 0, &clock, 1));
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPIN1));
+    sysex_set(queue);
+    for (uint8_t i = 0; i < TX_PACKETS - SYSEX_PACKETS; i++)
+    {
+        ev_set(&queue[(SYSEX_PACKETS + i) * EVENT_SIZE], 0x90, i, 0x40);
+    }
+    MIDI_HOST_CHECK_OK(app_usbd_midi_send_raw(&m_midi, queue, sizeof(queue)));
+    MIDI_HOST_CHECK_OK(put(0x90, 0x7F, 0x40));
+
+    memcpy(&expect[EVENT_SIZE],
+           &queue[SYSEX_PACKETS * EVENT_SIZE],
+           (TX_PACKETS - SYSEX_PACKETS) * EVENT_SIZE);
+    ev_set(&expect[(1 + TX_PACKETS - SYSEX_PACKETS) * EVENT_SIZE], 0x90, 0x7F, 0x40);
+    check_in(expect, (2 + TX_PACKETS - SYSEX_PACKETS) * EVENT_SIZE);
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_lane_stats_get(&m_midi, APP_USBD_MIDI_LANE_NORMAL, &after));
+    MIDI_HOST_CHECK(after.count == before.count + 1);
+}
+
+/**
+ * @brief Watermark checks and events while the buffer fills up and drains.
+ */
+static void test_watermarks(void)
+{
+    uint8_t buf[NRF_DRV_USBD_EPSIZE];
+    size_t  queued = 0;
+    int     len;
+
+    MIDI_HOST_CHECK(app_usbd_midi_watermarks_set(&m_midi, 64, 64) == NRF_ERROR_INVALID_PARAM);
+    MIDI_HOST_CHECK(app_usbd_midi_watermarks_set(&m_midi, 192, 64) == NRF_ERROR_INVALID_PARAM);
+    MIDI_HOST_CHECK(app_usbd_midi_watermarks_set(&m_midi, 64, 2 * TX_BUFFER_SIZE) ==
+                    NRF_ERROR_INVALID_PARAM);
+    MIDI_HOST_CHECK_OK(app_usbd_midi_watermarks_set(&m_midi, 64, 192));
+    app_usbd_midi_overflow_set(&m_midi, APP_USBD_MIDI_OVERFLOW_REJECT);
+    m_wm_high = 0;
+    m_wm_low  = 0;
+
+    for (uint8_t i = 0; i < TX_PACKETS; i++)
+    {
+        MIDI_HOST_CHECK_OK(put(0x90, i, 0x40));
+        queued += EVENT_SIZE;
+        MIDI_HOST_CHECK(m_wm_high == ((queued >= 192) ? 1 : 0));
+    }
+
+    /* The data queued counts the IN transfer in flight until it is done. */
+    while ((len = vhost_in_packet(buf)) > 0)
+    {
+        queued -= len;
+        MIDI_HOST_CHECK(m_wm_low == ((queued <= 64) ? 1 : 0));
+    }
+    MIDI_HOST_CHECK(queued == 0);
+    MIDI_HOST_CHECK(m_wm_high == 1);
+
+    /* Armed again, the next fill raises it again. */
+    for (uint8_t i = 0; i < TX_PACKETS; i++)
+    {
+        MIDI_HOST_CHECK_OK(put(0x90, i, 0x40));
+    }
+    MIDI_HOST_CHECK(m_wm_high == 2);
+    while (vhost_in_packet(buf) > 0)
+    {
+    }
+    MIDI_HOST_CHECK(m_wm_low == 2);
+    MIDI_HOST_CHECK_OK(app_usbd_midi_watermarks_set(&m_midi, 0, 0));
+}
+
+int main(void)
+{
+    midi_host_open(&m_midi);
+    app_usbd_midi_tx_coalesce_set(&m_midi, UINT16_MAX);
+    test_reject();
+    test_drop_oldest();
+    test_drop_low();
+    test_compact_sof();
+    test_compact_probe();
+    test_watermarks();
+    printf("overflow: ok\n");
+    return 0;
+}
@@ -0,0 +1,268 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Replay of a usbmon capture: a capture is written with the traffic of a MIDI device
+ * mixed with records the replay must leave alone, replayed, and the saved replay is
+ * read back and compared with the capture.
+ */
+#include "midi_host.h"
+#include "replay.h"
+
+#define BUS             1
+#define DEV             5
+#define EP_OUT          0x01
+#define EP_IN           0x81
+#define T0_US           1700000000000000ULL /**< Capture time of the first record. */
+
+#define NOTE_COUNT      40      /**< Single note OUT transfers. */
+#define IN_COUNT        20      /**< IN transfers, two events and a padding packet each. */
+#define MAX_TIMING_US   200     /**< Allowed delay of a replayed OUT submission on an idle bus. */
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, replay_rx_handler, 1024, 4, 64);
+
+/**
+ * @brief Expected traffic, filled while the capture is written.
+ */
+typedef struct
+{
+    uint8_t  out[4096];         //!< Data of all OUT transfers
+    size_t   out_len;
+    uint64_t out_ts[64];        //!< Capture times of the OUT transfers
+    uint32_t out_urbs;
+    uint8_t  in[1024];          //!< Events of all IN transfers, padding left out
+    size_t   in_len;
+    uint32_t skipped;           //!< Records the replay must skip
+    uint32_t messages;          //!< Messages the rx handler must get
+} expect_t;
+
+static expect_t     m_expect;
+static usbmon_rec_t m_rec;
+
+static void rec_write(usbmon_file_t * p_file, uint8_t type, uint8_t dev, uint8_t ep, uint8_t xfer,
+                      uint64_t ts_us, uint8_t const * p_data, size_t len)
+{
+    memset(&m_rec, 0, sizeof(m_rec));
+    m_rec.id        = ts_us;
+    m_rec.type      = type;
+    m_rec.xfer_type = xfer;
+    m_rec.ep        = ep;
+    m_rec.devnum    = dev;
+    m_rec.busnum    = BUS;
+    m_rec.length    = (uint32_t)len;
+    m_rec.ts_us     = T0_US + ts_us;
+    if (p_data != NULL)
+    {
+        m_rec.len_cap = (uint32_t)len;
+        memcpy(m_rec.data, p_data, len);
+    }
+    MIDI_HOST_CHECK_OK(usbmon_write(p_file, &m_rec));
+}
+
+static void out_write(usbmon_file_t * p_file, uint64_t ts_us, uint8_t const * p_data, size_t len,
+                      uint32_t messages)
+{
+    rec_write(p_file, USBMON_SUBMIT, DEV, EP_OUT, USBMON_XFER_BULK, ts_us, p_data, len);
+    memcpy(&m_expect.out[m_expect.out_len], p_data, len);
+    m_expect.out_len += len;
+    m_expect.out_ts[m_expect.out_urbs++] = T0_US + ts_us;
+    m_expect.messages += messages;
+
+    /* The completion carries no data. */
+    rec_write(p_file, USBMON_COMPLETE, DEV, EP_OUT, USBMON_XFER_BULK, ts_us + 200, NULL, len);
+    m_expect.skipped++;
+}
+
+static void capture_make(char const * p_path, uint32_t linktype)
+{
+    static const uint8_t sysex[] =
+    {
+        0x04, 0xF0, 0x01, 0x02, 0x04, 0x03, 0x04, 0x05,
+        0x04, 0x06, 0x07, 0x08, 0x06, 0x09, 0xF7, 0x00,
+    };
+    static const uint8_t desc_req[8] = { 0x80, 0x06, 0x00, 0x01, 0x00, 0x00, 0x12, 0x00 };
+    usbmon_file_t file;
+    uint8_t       buf[128];
+
+    memset(&m_expect, 0, sizeof(m_expect));
+    MIDI_HOST_CHECK_OK(usbmon_create(&file, p_path, linktype));
+
+    /* Control traffic of the device. */
+    rec_write(&file, USBMON_SUBMIT, DEV, 0x80, 2, 0, desc_req, sizeof(desc_req));
+    rec_write(&file, USBMON_COMPLETE, DEV, 0x80, 2, 100, NULL, 0);
+    m_expect.skipped += 2;
+
+    for (uint8_t i = 0; i < NOTE_COUNT; i++)
+    {
+        uint8_t note[4] = { 0x09, 0x90, i, 0x64 };
+
+        out_write(&file, 1000 + (i * 2500), note, sizeof(note), 1);
+    }
+    for (uint8_t i = 0; i < IN_COUNT; i++)
+    {
+        uint8_t in[12] = { 0x08, 0x80, i, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0xB0, 0x07, i };
+
+        /* The submission of an IN transfer carries no data. */
+        rec_write(&file, USBMON_SUBMIT, DEV, EP_IN, USBMON_XFER_BULK, 1500 + (i * 3000), NULL, 64);
+        rec_write(&file, USBMON_COMPLETE, DEV, EP_IN, USBMON_XFER_BULK, 2000 + (i * 3000), in, sizeof(in));
+        memcpy(&m_expect.in[m_expect.in_len], &in[0], 4);
+        memcpy(&m_expect.in[m_expect.in_len + 4], &in[8], 4);
+        m_expect.in_len  += 8;
+        m_expect.skipped += 1;
+    }
+
+    /* A sysex message, a full packet and two full packets of control changes. */
+    out_write(&file, 110000, sysex, sizeof(sysex), 1);
+    for (uint8_t i = 0; i < 32; i++)
+    {
+        buf[(i * 4) + 0] = 0x09;
+        buf[(i * 4) + 1] = 0x91;
+        buf[(i * 4) + 2] = i;
+        buf[(i * 4) + 3] = 0x40;
+    }
+    out_write(&file, 120000, buf, 64, 16);
+    for (uint8_t i = 0; i < 32; i++)
+    {
+        buf[(i * 4) + 0] = 0x0B;
+        buf[(i * 4) + 1] = 0xB0;
+        buf[(i * 4) + 2] = 0x01;
+        buf[(i * 4) + 3] = i;
+    }
+    out_write(&file, 120500, buf, 128, 32);
+
+    /* Bulk traffic of another device on the bus. */
+    rec_write(&file, USBMON_SUBMIT, DEV + 1, EP_OUT, USBMON_XFER_BULK, 121000, buf, 32);
+    m_expect.skipped++;
+
+    usbmon_close(&file);
+}
+
+static void replay_check(char const * p_path)
+{
+    usbmon_file_t file;
+    size_t        out_len = 0;
+    size_t        in_len  = 0;
+    uint32_t      out_urbs = 0;
+    uint32_t      out_done = 0;
+    uint64_t      ts      = 0;
+    ret_code_t    ret;
+
+    MIDI_HOST_CHECK_OK(usbmon_open(&file, p_path));
+    MIDI_HOST_CHECK(file.linktype == USBMON_LINKTYPE_MMAPPED);
+    while ((ret = usbmon_read(&file, &m_rec)) == NRF_SUCCESS)
+    {
+        MIDI_HOST_CHECK(m_rec.ts_us >= ts);
+        MIDI_HOST_CHECK((m_rec.busnum == BUS) && (m_rec.devnum == DEV));
+        ts = m_rec.ts_us;
+        if ((m_rec.ep == EP_OUT) && (m_rec.type == USBMON_SUBMIT))
+        {
+            /* Submitted at the captured time, give or take a transaction. */
+            MIDI_HOST_CHECK(m_rec.ts_us >= m_expect.out_ts[out_urbs]);
+            MIDI_HOST_CHECK(m_rec.ts_us < m_expect.out_ts[out_urbs] + MAX_TIMING_US);
+            MIDI_HOST_CHECK(memcmp(m_rec.data, &m_expect.out[out_len], m_rec.len_cap) == 0);
+            out_len += m_rec.len_cap;
+            out_urbs++;
+        }
+        else if ((m_rec.ep == EP_OUT) && (m_rec.type == USBMON_COMPLETE))
+        {
+            MIDI_HOST_CHECK(m_rec.len_cap == 0);
+            out_done++;
+        }
+        else
+        {
+            MIDI_HOST_CHECK((m_rec.ep == EP_IN) && (m_rec.type == USBMON_COMPLETE));
+            MIDI_HOST_CHECK(in_len + m_rec.len_cap <= m_expect.in_len);
+            MIDI_HOST_CHECK(memcmp(m_rec.data, &m_expect.in[in_len], m_rec.len_cap) == 0);
+            in_len += m_rec.len_cap;
+        }
+    }
+    MIDI_HOST_CHECK(ret == NRF_ERROR_NOT_FOUND);
+    usbmon_close(&file);
+
+    MIDI_HOST_CHECK(out_urbs == m_expect.out_urbs);
+    MIDI_HOST_CHECK(out_done == m_expect.out_urbs);
+    MIDI_HOST_CHECK(out_len == m_expect.out_len);
+    MIDI_HOST_CHECK(in_len == m_expect.in_len);
+}
+
+static void test_replay(uint32_t linktype)
+{
+    static replay_result_t res;
+    replay_cfg_t           cfg = REPLAY_CFG_DEFAULT;
+    char                   in[64];
+    char                   out[64];
+
+    snprintf(in, sizeof(in), "test_replay_%u.pcap", (unsigned)linktype);
+    snprintf(out, sizeof(out), "test_replay_%u_out.pcap", (unsigned)linktype);
+    capture_make(in, linktype);
+
+    MIDI_HOST_CHECK_OK(replay_run(&m_midi, &cfg, in, out, &res));
+    MIDI_HOST_CHECK((res.busnum == BUS) && (res.devnum == DEV));
+    MIDI_HOST_CHECK(res.skipped == m_expect.skipped);
+    MIDI_HOST_CHECK(res.out_urbs == m_expect.out_urbs);
+    MIDI_HOST_CHECK(res.out_bytes == m_expect.out_len);
+    MIDI_HOST_CHECK(res.rx_messages == m_expect.messages);
+    MIDI_HOST_CHECK(res.in_urbs == IN_COUNT);
+    MIDI_HOST_CHECK(res.in_events == m_expect.in_len / 4);
+    MIDI_HOST_CHECK(res.in_received == res.in_events);
+    MIDI_HOST_CHECK(res.out_lat.count == m_expect.out_urbs);
+    MIDI_HOST_CHECK(res.in_lat.count == res.in_events);
+    MIDI_HOST_CHECK(latency_percentile(&res.out_lat, 1000) < 1000);
+    replay_check(out);
+
+    /* The other device and a device that is not there. */
+    cfg.devnum = DEV + 1;
+    MIDI_HOST_CHECK_OK(replay_run(&m_midi, &cfg, in, NULL, &res));
+    MIDI_HOST_CHECK((res.out_urbs == 1) && (res.out_bytes == 32));
+    cfg.devnum = DEV + 2;
+    MIDI_HOST_CHECK(replay_run(&m_midi, &cfg, in, NULL, &res) == NRF_ERROR_NOT_FOUND);
+}
+
+int main(void)
+{
+    midi_host_open(&m_midi);
+    test_replay(USBMON_LINKTYPE_MMAPPED);
+    test_replay(USBMON_LINKTYPE);
+    printf("replay: ok\n");
+    return 0;
+}
@@ -0,0 +1,267 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Routes of received messages, see app_usbd_midi_routes_set.
+ *
+ * Event packets are matched by cable, Code Index Number and channel. Handler routes get
+ * the messages in route order, thru routes forward the event packets to their cable and
+ * event packets no route takes are left to the rx handler of the instance.
+ */
+#include "midi_host.h"
+
+#define LOG_MAX 32
+
+/**
+ * @brief Message passed to one of the handlers.
+ */
+typedef struct
+{
+    char    handler;    //!< 'A' or 'B' for the routes, 'R' for the rx handler
+    uint8_t cable;      //!< Cable number
+    uint8_t len;        //!< Message length
+    uint8_t data[3];    //!< Message
+} logged_t;
+
+static logged_t m_log[LOG_MAX];
+static size_t   m_log_count;
+
+static void log_add(char handler, uint8_t cable, app_usbd_midi_msg_t const * p_msg)
+{
+    logged_t * p_log = &m_log[m_log_count++];
+
+    MIDI_HOST_CHECK(m_log_count <= LOG_MAX);
+    MIDI_HOST_CHECK(p_msg->len <= sizeof(p_log->data));
+    p_log->handler = handler;
+    p_log->cable   = cable;
+    p_log->len     = (uint8_t)p_msg->len;
+    memset(p_log->data, 0, sizeof(p_log->data));
+    memcpy(p_log->data, p_msg->p_data, p_msg->len);
+}
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+    /* No buffer is given for sysex, its parts are not logged. */
+    if (event == APP_USBD_MIDI_RX_DONE)
+    {
+        log_add('R', cable, p_msg);
+    }
+}
+
+static void route_a(app_usbd_class_inst_t const * p_inst,
+                    enum app_usbd_midi_rx_event_e event,
+                    uint8_t                       cable,
+                    app_usbd_midi_msg_t         * p_msg)
+{
+    MIDI_HOST_CHECK(event == APP_USBD_MIDI_RX_DONE);
+    log_add('A', cable, p_msg);
+}
+
+static void route_b(app_usbd_class_inst_t const * p_inst,
+                    enum app_usbd_midi_rx_event_e event,
+                    uint8_t                       cable,
+                    app_usbd_midi_msg_t         * p_msg)
+{
+    MIDI_HOST_CHECK(event == APP_USBD_MIDI_RX_DONE);
+    log_add('B', cable, p_msg);
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, 1024, 4, 64);
+
+static const app_usbd_midi_route_t m_routes[] =
+{
+    /* Channels 0 and 1 of cable 0. */
+    {
+        .cables   = APP_USBD_MIDI_ROUTE_CABLE(0),
+        .cins     = APP_USBD_MIDI_ROUTE_CIN_VOICE,
+        .channels = APP_USBD_MIDI_ROUTE_CHANNEL(0) | APP_USBD_MIDI_ROUTE_CHANNEL(1),
+        .handler  = route_a,
+    },
+    /* Note ons of cables 0 and 1. */
+    {
+        .cables   = APP_USBD_MIDI_ROUTE_CABLE(0) | APP_USBD_MIDI_ROUTE_CABLE(1),
+        .cins     = APP_USBD_MIDI_ROUTE_CIN(APP_USBD_MIDI_CIN_NOTE_ON),
+        .channels = APP_USBD_MIDI_ROUTE_ALL,
+        .handler  = route_b,
+    },
+    /* Sysex of cable 2 to cable 5, its other messages are left to the rx handler. */
+    {
+        .cables     = APP_USBD_MIDI_ROUTE_CABLE(2),
+        .cins       = APP_USBD_MIDI_ROUTE_CIN_SYSEX,
+        .channels   = APP_USBD_MIDI_ROUTE_ALL,
+        .thru_cable = 5,
+    },
+    /* Channel 9 of cable 3 to cables 0 and 6 and to a handler, the rest to the handler. */
+    {
+        .cables     = APP_USBD_MIDI_ROUTE_CABLE(3),
+        .cins       = APP_USBD_MIDI_ROUTE_CIN_VOICE,
+        .channels   = APP_USBD_MIDI_ROUTE_CHANNEL(9),
+        .thru_cable = 0,
+    },
+    {
+        .cables     = APP_USBD_MIDI_ROUTE_CABLE(3),
+        .cins       = APP_USBD_MIDI_ROUTE_CIN_VOICE,
+        .channels   = APP_USBD_MIDI_ROUTE_CHANNEL(9),
+        .thru_cable = 6,
+    },
+    {
+        .cables   = APP_USBD_MIDI_ROUTE_CABLE(3),
+        .cins     = APP_USBD_MIDI_ROUTE_CIN_VOICE,
+        .channels = APP_USBD_MIDI_ROUTE_ALL,
+        .handler  = route_b,
+    },
+};
+
+static const uint8_t m_out[] =
+{
+    0x09, 0x90, 0x3C, 0x40,     /* A, B */
+    0x0B, 0xB1, 0x07, 0x64,     /* A */
+    0x0B, 0xB5, 0x07, 0x64,     /* rx handler, channel not routed */
+    0x19, 0x95, 0x3D, 0x40,     /* B */
+    0x1C, 0xC0, 0x05, 0x00,     /* rx handler, CIN not routed */
+    0x24, 0xF0, 0x01, 0x02,     /* to cable 5 */
+    0x27, 0x03, 0x04, 0xF7,
+    0x29, 0x90, 0x3E, 0x40,     /* rx handler */
+    0x39, 0x99, 0x24, 0x7F,     /* to cables 0 and 6, B */
+    0x39, 0x92, 0x24, 0x7F,     /* B */
+};
+
+/**
+ * @brief Compare a logged message.
+ */
+static void check_log(size_t idx, char handler, uint8_t cable, uint8_t const * p_ev)
+{
+    uint8_t len = ((p_ev[1] & 0xF0) == 0xC0) ? 2 : 3;
+
+    MIDI_HOST_CHECK(m_log[idx].handler == handler);
+    MIDI_HOST_CHECK(m_log[idx].cable == cable);
+    MIDI_HOST_CHECK(m_log[idx].len == len);
+    MIDI_HOST_CHECK(memcmp(m_log[idx].data, &p_ev[1], len) == 0);
+}
+
+/**
+ * @brief Route table checks.
+ */
+static void test_set(void)
+{
+    app_usbd_midi_route_t routes[9];
+
+    memset(routes, 0, sizeof(routes));
+    MIDI_HOST_CHECK(app_usbd_midi_routes_set(&m_midi, routes, ARRAY_SIZE(routes)) == NRF_ERROR_NO_MEM);
+
+    routes[0].thru_cable = 16;
+    MIDI_HOST_CHECK(app_usbd_midi_routes_set(&m_midi, routes, 1) == NRF_ERROR_INVALID_PARAM);
+
+    routes[0].handler = route_a;
+    routes[0].cins    = APP_USBD_MIDI_ROUTE_CIN(APP_USBD_MIDI_CIN_SYSEX);
+    MIDI_HOST_CHECK(app_usbd_midi_routes_set(&m_midi, routes, 1) == NRF_ERROR_INVALID_PARAM);
+
+    /* Single-byte system common messages share the CIN of a sysex end. */
+    routes[0].cins = APP_USBD_MIDI_ROUTE_CIN(APP_USBD_MIDI_CIN_SYSEX_END_1);
+    MIDI_HOST_CHECK_OK(app_usbd_midi_routes_set(&m_midi, routes, 1));
+    MIDI_HOST_CHECK_OK(app_usbd_midi_routes_set(&m_midi, NULL, 0));
+}
+
+/**
+ * @brief Each event packet goes to the matching routes in order, or to the rx handler.
+ */
+static void test_dispatch(void)
+{
+    static const uint8_t expect[] =
+    {
+        0x54, 0xF0, 0x01, 0x02,
+        0x57, 0x03, 0x04, 0xF7,
+        0x09, 0x99, 0x24, 0x7F,
+        0x69, 0x99, 0x24, 0x7F,
+    };
+    uint8_t buf[4 * NRF_DRV_USBD_EPSIZE];
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_routes_set(&m_midi, m_routes, ARRAY_SIZE(m_routes)));
+
+    m_log_count = 0;
+    MIDI_HOST_CHECK(vhost_out(m_out, sizeof(m_out)) == sizeof(m_out));
+    MIDI_HOST_CHECK(m_log_count == 9);
+    check_log(0, 'A', 0, &m_out[0]);
+    check_log(1, 'B', 0, &m_out[0]);
+    check_log(2, 'A', 0, &m_out[4]);
+    check_log(3, 'R', 0, &m_out[8]);
+    check_log(4, 'B', 1, &m_out[12]);
+    check_log(5, 'R', 1, &m_out[16]);
+    check_log(6, 'R', 2, &m_out[28]);
+    check_log(7, 'B', 3, &m_out[32]);
+    check_log(8, 'B', 3, &m_out[36]);
+
+    MIDI_HOST_CHECK(vhost_in(buf, sizeof(buf)) == sizeof(expect));
+    MIDI_HOST_CHECK(memcmp(buf, expect, sizeof(expect)) == 0);
+}
+
+/**
+ * @brief Without routes everything goes to the rx handler and nothing is forwarded.
+ */
+static void test_clear(void)
+{
+    uint8_t buf[4 * NRF_DRV_USBD_EPSIZE];
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_routes_set(&m_midi, NULL, 0));
+
+    m_log_count = 0;
+    MIDI_HOST_CHECK(vhost_out(m_out, sizeof(m_out)) == sizeof(m_out));
+    MIDI_HOST_CHECK(m_log_count == 8);
+    check_log(0, 'R', 0, &m_out[0]);
+    check_log(7, 'R', 3, &m_out[36]);
+    MIDI_HOST_CHECK(vhost_in(buf, sizeof(buf)) == 0);
+}
+
+int main(void)
+{
+    midi_host_open(&m_midi);
+    app_usbd_midi_tx_coalesce_set(&m_midi, UINT16_MAX);
+    test_set();
+    test_dispatch();
+    test_clear();
+    printf("routes: ok\n");
+    return 0;
+}
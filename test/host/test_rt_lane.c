@@ -0,0 +1,277 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Real-time lane of the TX path.
+ *
+ * A timing clock written behind queued system exclusive data has to overtake it and
+ * reach the host in the next IN transfer, between the event packets of the sysex.
+ * Under a flood of 4 KB sysex dumps, run with the frame timing of vhost_frame, the
+ * clock delay and jitter have to stay within a few bulk transactions, well below the
+ * most of a frame the TX buffer alone holds, and the lane statistics of the class
+ * have to agree with what the host saw.
+ */
+#include "midi_host.h"
+#include "latency.h"
+
+#define TX_BUFFER_SIZE  1024
+#define RX_BUFFER_COUNT 4
+#define RX_BUFFER_SIZE  64
+
+#define CLOCK_PERIOD_US 5208    /**< 24 clocks per quarter note at 480 BPM. */
+#define CLOCK_QUEUE     64      /**< Clocks in flight the host can match. */
+#define DUMP_SIZE       4096    /**< Size of one sysex dump. */
+#define FLOOD_FRAMES    4000    /**< Frames the clock and the flood run for. */
+#define DRAIN_FRAMES    64      /**< Frames run after sending stops. */
+#define DELAY_MAX_US    250     /**< Allowed clock delay and jitter. */
+
+/**
+ * @brief State of the flood run.
+ */
+typedef struct
+{
+    bool      sending;                  //!< Clock and flood still running
+    uint32_t  next_clock_us;            //!< Time the next clock is due
+    uint32_t  clocks_sent;
+    uint32_t  clocks_received;
+    uint32_t  due_us[CLOCK_QUEUE];      //!< Due time by clock number
+    uint32_t  dumps;                    //!< Sysex dumps started
+    uint32_t  sysex_bytes;              //!< Sysex bytes received by the host
+    uint32_t  sysex_tail;               //!< Sysex bytes since the last 0xF0 at the host
+    latency_t lat;
+} flood_t;
+
+static flood_t m_flood;
+static uint8_t m_dump[DUMP_SIZE];
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, TX_BUFFER_SIZE, RX_BUFFER_COUNT, RX_BUFFER_SIZE);
+
+/**
+ * @brief Number of sysex bytes an event packet carries, 0 if it is not sysex.
+ */
+static uint8_t sysex_len(uint8_t const * p_ev)
+{
+    switch (p_ev[0] & 0x0F)
+    {
+        case APP_USBD_MIDI_CIN_SYSEX:
+        case APP_USBD_MIDI_CIN_SYSEX_END_3:
+            return 3;
+        case APP_USBD_MIDI_CIN_SYSEX_END_2:
+            return 2;
+        case APP_USBD_MIDI_CIN_SYSEX_END_1:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static bool is_clock(uint8_t const * p_ev)
+{
+    return ((p_ev[0] & 0x0F) == APP_USBD_MIDI_CIN_SINGLE_BYTE) && (p_ev[1] == 0xF8);
+}
+
+/**
+ * @brief Application main loop: clock on time, a new dump as soon as the last is queued.
+ */
+static void app_tick(uint32_t now_us, void * p_context)
+{
+    if (!m_flood.sending)
+    {
+        return;
+    }
+    if (app_usbd_midi_sysex_send(&m_midi, 0, m_dump, sizeof(m_dump)) == NRF_SUCCESS)
+    {
+        m_flood.dumps++;
+    }
+    while ((int32_t)(now_us - m_flood.next_clock_us) >= 0)
+    {
+        uint8_t clock = 0xF8;
+
+        MIDI_HOST_CHECK(m_flood.clocks_sent - m_flood.clocks_received < CLOCK_QUEUE);
+        MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 0, &clock, 1));
+        m_flood.due_us[m_flood.clocks_sent % CLOCK_QUEUE] = m_flood.next_clock_us;
+        m_flood.clocks_sent++;
+        m_flood.next_clock_us += CLOCK_PERIOD_US;
+    }
+}
+
+static void host_in(uint8_t const * p_data, size_t len, uint32_t now_us, void * p_context)
+{
+    for (size_t i = 0; i + 4 <= len; i += 4)
+    {
+        uint8_t const * p_ev = &p_data[i];
+
+        if (is_clock(p_ev))
+        {
+            MIDI_HOST_CHECK(m_flood.clocks_received < m_flood.clocks_sent);
+            latency_add(&m_flood.lat, now_us - m_flood.due_us[m_flood.clocks_received % CLOCK_QUEUE]);
+            m_flood.clocks_received++;
+        }
+        m_flood.sysex_bytes += sysex_len(p_ev);
+    }
+}
+
+/**
+ * @brief Clock delay and jitter stay small during a sysex flood.
+ */
+static void test_flood(void)
+{
+    static const vhost_frame_handlers_t handlers = { .app = app_tick, .in = host_in };
+    vhost_frame_cfg_t                   cfg      = VHOST_FRAME_CFG_DEFAULT;
+    app_usbd_midi_lane_stats_t          rt;
+    app_usbd_midi_lane_stats_t          normal;
+    uint32_t                            min_us;
+    uint32_t                            max_us;
+
+    m_dump[0] = 0xF0;
+    for (size_t i = 1; i < sizeof(m_dump) - 1; i++)
+    {
+        m_dump[i] = (uint8_t)(i & 0x7F);
+    }
+    m_dump[sizeof(m_dump) - 1] = 0xF7;
+
+    memset(&m_flood, 0, offsetof(flood_t, lat));
+    latency_reset(&m_flood.lat);
+    m_flood.next_clock_us = usbd_sim_time_us() + 1437;
+    vhost_frame_init(&cfg, &handlers);
+
+    m_flood.sending = true;
+    for (uint32_t f = 0; f < FLOOD_FRAMES + DRAIN_FRAMES; f++)
+    {
+        m_flood.sending = (f < FLOOD_FRAMES);
+        vhost_frame();
+    }
+
+    MIDI_HOST_CHECK(m_flood.clocks_sent > 0);
+    MIDI_HOST_CHECK(m_flood.clocks_received == m_flood.clocks_sent);
+    MIDI_HOST_CHECK(m_flood.sysex_bytes == m_flood.dumps * DUMP_SIZE);
+    latency_print("clock during sysex flood", &m_flood.lat);
+    printf("%-40s %u dumps, %u sysex bytes/s\n", "",
+           (unsigned)m_flood.dumps, (unsigned)(((uint64_t)m_flood.sysex_bytes * 1000) / FLOOD_FRAMES));
+
+    min_us = latency_percentile(&m_flood.lat, 0);
+    max_us = latency_percentile(&m_flood.lat, 1000);
+    MIDI_HOST_CHECK(max_us < DELAY_MAX_US);
+    MIDI_HOST_CHECK(max_us - min_us < DELAY_MAX_US);
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_lane_stats_get(&m_midi, APP_USBD_MIDI_LANE_RT, &rt));
+    MIDI_HOST_CHECK_OK(app_usbd_midi_lane_stats_get(&m_midi, APP_USBD_MIDI_LANE_NORMAL, &normal));
+    printf("%-40s rt lane %u packets, mean %u max %u us; normal lane mean %u max %u us\n", "",
+           (unsigned)rt.count, (unsigned)(rt.total_us / MAX(rt.count, 1)), (unsigned)rt.max_us,
+           (unsigned)(normal.total_us / MAX(normal.count, 1)), (unsigned)normal.max_us);
+    MIDI_HOST_CHECK(rt.count == m_flood.clocks_sent);
+    MIDI_HOST_CHECK(rt.max_us <= max_us);
+    MIDI_HOST_CHECK(normal.max_us > rt.max_us);
+    MIDI_HOST_CHECK(app_usbd_midi_lane_stats_get(&m_midi, APP_USBD_MIDI_LANE_COUNT, &rt) ==
+                    NRF_ERROR_INVALID_PARAM);
+}
+
+/**
+ * @brief A clock written behind queued sysex goes out in the next IN transfer.
+ */
+static void test_overtake(void)
+{
+    static const uint8_t clock = 0xF8;
+    uint8_t              sysex[600];
+    uint8_t              buf[TX_BUFFER_SIZE * 2];
+    uint8_t              rebuilt[sizeof(sysex)];
+    size_t               len = 0;
+    size_t               rebuilt_len = 0;
+    size_t               clock_at = SIZE_MAX;
+    size_t               n;
+
+#if APP_USBD_MIDI_CONFIG_TX_COALESCE
+    app_usbd_midi_tx_coalesce_set(&m_midi, UINT16_MAX);
+#endif
+    sysex[0] = 0xF0;
+    for (size_t i = 1; i < sizeof(sysex) - 1; i++)
+    {
+        sysex[i] = (uint8_t)((i * 7) & 0x7F);
+    }
+    sysex[sizeof(sysex) - 1] = 0xF7;
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_sysex_write(&m_midi, 0, sysex, sizeof(sysex)));
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 0, (uint8_t *)&clock, 1));
+    while ((n = vhost_in(&buf[len], sizeof(buf) - len)) > 0)
+    {
+        len += n;
+    }
+
+    for (size_t i = 0; i + 4 <= len; i += 4)
+    {
+        uint8_t n_sysex = sysex_len(&buf[i]);
+
+        if (is_clock(&buf[i]))
+        {
+            MIDI_HOST_CHECK(clock_at == SIZE_MAX);
+            clock_at = i;
+        }
+        MIDI_HOST_CHECK(rebuilt_len + n_sysex <= sizeof(rebuilt));
+        memcpy(&rebuilt[rebuilt_len], &buf[i + 1], n_sysex);
+        rebuilt_len += n_sysex;
+    }
+
+    /* The first IN transfer was claimed by the sysex before the clock was written. */
+    MIDI_HOST_CHECK(clock_at == NRF_DRV_USBD_EPSIZE);
+    MIDI_HOST_CHECK(sysex_len(&buf[clock_at - 4]) == 3);
+    MIDI_HOST_CHECK(sysex_len(&buf[clock_at + 4]) == 3);
+    MIDI_HOST_CHECK(rebuilt_len == sizeof(sysex));
+    MIDI_HOST_CHECK(memcmp(rebuilt, sysex, sizeof(sysex)) == 0);
+}
+
+int main(void)
+{
+    midi_host_open(&m_midi);
+    app_usbd_midi_time_source_set(&m_midi, usbd_sim_ticks_get, 1000);
+    test_flood();
+    test_overtake();
+    printf("rt lane: ok\n");
+    return 0;
+}
@@ -0,0 +1,214 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Scheduled transmission, see app_usbd_midi_schedule.
+ *
+ * Messages scheduled out of order reach the host in time order, run with the frame
+ * timing of vhost_frame. Each one arrives in the frame its time falls in, not before
+ * the lead of APP_USBD_MIDI_CONFIG_SCHED_LEAD_US and not a frame after its time.
+ */
+#include "midi_host.h"
+
+#define SCHED_SIZE  16      /**< APP_USBD_MIDI_CONFIG_SCHED_SIZE of the midi_full build. */
+#define ARRIVED_MAX 64
+
+/**
+ * @brief Note on received by the host.
+ */
+typedef struct
+{
+    uint8_t  key;       //!< Key number
+    uint32_t time;      //!< Time of arrival on the time base of the class
+} arrived_t;
+
+static arrived_t m_arrived[ARRIVED_MAX];
+static size_t    m_arrived_count;
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, 1024, 4, 64);
+
+static void host_in(uint8_t const * p_data, size_t len, uint32_t now_us, void * p_context)
+{
+    for (size_t i = 0; i + 4 <= len; i += 4)
+    {
+        MIDI_HOST_CHECK(m_arrived_count < ARRIVED_MAX);
+        MIDI_HOST_CHECK(p_data[i + 1] == 0x90);
+        m_arrived[m_arrived_count].key  = p_data[i + 2];
+        m_arrived[m_arrived_count].time = app_usbd_midi_time_get(&m_midi);
+        m_arrived_count++;
+    }
+}
+
+/**
+ * @brief Run frames until @p count note ons arrived or @p frames frames passed.
+ */
+static void frames_run(size_t count, uint32_t frames)
+{
+    static const vhost_frame_handlers_t handlers = { .in = host_in };
+    vhost_frame_cfg_t                   cfg      = VHOST_FRAME_CFG_DEFAULT;
+
+    vhost_frame_init(&cfg, &handlers);
+    m_arrived_count = 0;
+    while ((m_arrived_count < count) && (frames-- > 0))
+    {
+        vhost_frame();
+    }
+}
+
+static ret_code_t schedule(uint32_t time, uint8_t key)
+{
+    uint8_t msg[] = { 0x90, key, 0x40 };
+
+    return app_usbd_midi_schedule(&m_midi, time, 0, msg, sizeof(msg));
+}
+
+/**
+ * @brief Messages scheduled out of order arrive in time order, each in its frame.
+ *
+ * The key of each note is its rank in time. The two notes sharing a time keep the
+ * order they were scheduled in.
+ */
+static void test_order(void)
+{
+    static const uint16_t offsets[] = { 4700, 1300, 9100, 2500, 2500, 6800, 3900, 1700 };
+    static const uint8_t  keys[]    = {    5,    0,    7,    2,    3,    6,    4,    1 };
+    uint32_t              now       = app_usbd_midi_time_get(&m_midi);
+
+    for (size_t i = 0; i < ARRAY_SIZE(offsets); i++)
+    {
+        MIDI_HOST_CHECK_OK(schedule(now + offsets[i], keys[i]));
+    }
+    frames_run(ARRAY_SIZE(offsets), 20);
+    MIDI_HOST_CHECK(m_arrived_count == ARRAY_SIZE(offsets));
+
+    for (size_t i = 0; i < m_arrived_count; i++)
+    {
+        uint32_t time = 0;
+
+        MIDI_HOST_CHECK(m_arrived[i].key == i);
+        for (size_t j = 0; j < ARRAY_SIZE(keys); j++)
+        {
+            time = (keys[j] == i) ? now + offsets[j] : time;
+        }
+        MIDI_HOST_CHECK((int32_t)(m_arrived[i].time + APP_USBD_MIDI_CONFIG_SCHED_LEAD_US - time) >= 0);
+        MIDI_HOST_CHECK((int32_t)(m_arrived[i].time - time) <= 1000);
+    }
+}
+
+/**
+ * @brief A message already due is sent right away.
+ */
+static void test_due(void)
+{
+    uint8_t buf[NRF_DRV_USBD_EPSIZE];
+
+    MIDI_HOST_CHECK_OK(schedule(app_usbd_midi_time_get(&m_midi) - 100, 0x30));
+    MIDI_HOST_CHECK(vhost_in(buf, sizeof(buf)) == 4);
+    MIDI_HOST_CHECK((buf[1] == 0x90) && (buf[2] == 0x30));
+}
+
+/**
+ * @brief A full scheduler rejects the message and keeps the scheduled ones.
+ */
+static void test_full(void)
+{
+    uint32_t time = app_usbd_midi_time_get(&m_midi) + 3000;
+
+    for (uint8_t i = 0; i < SCHED_SIZE; i++)
+    {
+        MIDI_HOST_CHECK_OK(schedule(time, i));
+    }
+    MIDI_HOST_CHECK(schedule(time, SCHED_SIZE) == NRF_ERROR_NO_MEM);
+
+    frames_run(SCHED_SIZE + 1, 10);
+    MIDI_HOST_CHECK(m_arrived_count == SCHED_SIZE);
+    for (uint8_t i = 0; i < SCHED_SIZE; i++)
+    {
+        MIDI_HOST_CHECK(m_arrived[i].key == i);
+    }
+    MIDI_HOST_CHECK_OK(schedule(time, SCHED_SIZE));
+    frames_run(1, 2);
+    MIDI_HOST_CHECK((m_arrived_count == 1) && (m_arrived[0].key == SCHED_SIZE));
+}
+
+/**
+ * @brief Messages whose length does not match their status byte, and bad cables.
+ */
+static void test_invalid(void)
+{
+    static const uint8_t note[]    = { 0x90, 0x40, 0x7F, 0x00 };
+    static const uint8_t program[] = { 0xC0, 0x05, 0x00 };
+    static const uint8_t data[]    = { 0x40 };
+    uint32_t             time      = app_usbd_midi_time_get(&m_midi);
+
+    MIDI_HOST_CHECK(app_usbd_midi_schedule(&m_midi, time, 0, note, 0) == NRF_ERROR_INVALID_DATA);
+    MIDI_HOST_CHECK(app_usbd_midi_schedule(&m_midi, time, 0, note, 2) == NRF_ERROR_INVALID_DATA);
+    MIDI_HOST_CHECK(app_usbd_midi_schedule(&m_midi, time, 0, note, 4) == NRF_ERROR_INVALID_DATA);
+    MIDI_HOST_CHECK(app_usbd_midi_schedule(&m_midi, time, 0, program, 3) == NRF_ERROR_INVALID_DATA);
+    MIDI_HOST_CHECK(app_usbd_midi_schedule(&m_midi, time, 0, data, 1) == NRF_ERROR_INVALID_DATA);
+    MIDI_HOST_CHECK(app_usbd_midi_schedule(&m_midi, time, 16, note, 3) == NRF_ERROR_INVALID_PARAM);
+
+    frames_run(1, 3);
+    MIDI_HOST_CHECK(m_arrived_count == 0);
+}
+
+int main(void)
+{
+    midi_host_open(&m_midi);
+    app_usbd_midi_tx_coalesce_set(&m_midi, UINT16_MAX);
+    app_usbd_midi_time_source_set(&m_midi, usbd_sim_ticks_get, 1000);
+    vhost_sof();
+    test_order();
+    test_due();
+    test_full();
+    test_invalid();
+    printf("sched: ok\n");
+    return 0;
+}
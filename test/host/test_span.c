@@ -0,0 +1,240 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Zero-copy sysex reception, see app_usbd_midi_sysex_span_handler_set.
+ *
+ * Spans reference the RX buffers in place and end at the end of every OUT packet. A span
+ * kept by the application pins its RX buffer: the data stays intact while later OUT
+ * packets are received into the other buffers, and since buffers are reused in order the
+ * host gets NAKs once all of them wait behind the oldest pinned one.
+ */
+#include "midi_host.h"
+
+#define RX_BUFFER_COUNT 4
+#define SPAN_MAX        8
+
+static app_usbd_midi_sysex_span_t m_spans[SPAN_MAX];
+static size_t                     m_span_count;
+static uint8_t                    m_bytes[256];
+static size_t                     m_bytes_len;
+static bool                       m_keep;
+static uint32_t                   m_rx_count;
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+    MIDI_HOST_CHECK(event == APP_USBD_MIDI_RX_DONE);
+    m_rx_count++;
+}
+
+static bool span_handler(app_usbd_class_inst_t const *      p_inst,
+                         uint8_t                            cable,
+                         app_usbd_midi_sysex_span_t const * p_span)
+{
+    MIDI_HOST_CHECK(m_span_count < SPAN_MAX);
+    MIDI_HOST_CHECK(m_bytes_len + p_span->len <= sizeof(m_bytes));
+
+    /* The span passed in is reused by the class, a kept one is copied. */
+    m_spans[m_span_count++] = *p_span;
+    m_bytes_len += app_usbd_midi_sysex_span_copy(p_span, &m_bytes[m_bytes_len]);
+    return m_keep;
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, 1024, RX_BUFFER_COUNT, 64);
+
+/**
+ * @brief Pack a sysex message into event packets of cable 0.
+ *
+ * @return Number of bytes of event packets.
+ */
+static size_t sysex_pack(uint8_t const * p_msg, size_t len, uint8_t * p_ev)
+{
+    size_t size = 0;
+
+    for (size_t i = 0; i < len; i += 3, size += 4)
+    {
+        size_t n = MIN(len - i, 3);
+
+        p_ev[size]     = (len - i > 3) ? APP_USBD_MIDI_CIN_SYSEX :
+                                         (uint8_t)(APP_USBD_MIDI_CIN_SYSEX_END_1 + n - 1);
+        p_ev[size + 1] = 0;
+        p_ev[size + 2] = 0;
+        p_ev[size + 3] = 0;
+        memcpy(&p_ev[size + 1], &p_msg[i], n);
+    }
+    return size;
+}
+
+static void sysex_make(uint8_t * p_msg, size_t len, uint8_t seed)
+{
+    p_msg[0] = 0xF0;
+    for (size_t i = 1; i < len - 1; i++)
+    {
+        p_msg[i] = (uint8_t)((i * 5 + seed) & 0x7F);
+    }
+    p_msg[len - 1] = 0xF7;
+}
+
+/**
+ * @brief Send event packets one OUT packet at a time.
+ *
+ * @return Number of bytes accepted before the first NAK.
+ */
+static size_t out_packets(uint8_t const * p_data, size_t len)
+{
+    size_t pos = 0;
+
+    while (pos < len)
+    {
+        size_t chunk = MIN(len - pos, NRF_DRV_USBD_EPSIZE);
+
+        if (vhost_out_packet(&p_data[pos], chunk) == USBD_SIM_NAK)
+        {
+            break;
+        }
+        pos += chunk;
+    }
+    return pos;
+}
+
+static void spans_reset(bool keep)
+{
+    m_span_count = 0;
+    m_bytes_len  = 0;
+    m_keep       = keep;
+}
+
+/**
+ * @brief Spans not kept: one per OUT packet, copied back to the whole message.
+ */
+static void test_copy(void)
+{
+    uint8_t msg[100];
+    uint8_t ev[4 * sizeof(msg) / 3 + 4];
+    size_t  size;
+
+    sysex_make(msg, sizeof(msg), 0);
+    size = sysex_pack(msg, sizeof(msg), ev);
+    spans_reset(false);
+
+    MIDI_HOST_CHECK(out_packets(ev, size) == size);
+    MIDI_HOST_CHECK(m_span_count == 3);
+    MIDI_HOST_CHECK((m_spans[0].count == 16) && !m_spans[0].end);
+    MIDI_HOST_CHECK((m_spans[1].count == 16) && !m_spans[1].end);
+    MIDI_HOST_CHECK((m_spans[2].count == 2) && m_spans[2].end);
+    MIDI_HOST_CHECK(m_bytes_len == sizeof(msg));
+    MIDI_HOST_CHECK(memcmp(m_bytes, msg, sizeof(msg)) == 0);
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+}
+
+/**
+ * @brief Kept spans pin their RX buffers until released, in order.
+ *
+ * A message of two OUT packets is kept. Two more OUT packets fill the other RX buffers,
+ * the next one is NAKed. Releasing the second span frees nothing, as the first RX buffer
+ * is still pinned. Releasing the first one opens the OUT endpoint again.
+ */
+static void test_hold(void)
+{
+    static const uint8_t notes[] =
+    {
+        0x09, 0x90, 0x3C, 0x40,
+        0x08, 0x80, 0x3C, 0x00,
+    };
+    uint8_t                    msg[96];
+    uint8_t                    ev[2 * NRF_DRV_USBD_EPSIZE];
+    uint8_t                    copy[sizeof(msg)];
+    app_usbd_midi_sysex_span_t spans[2];
+    size_t                     len;
+
+    sysex_make(msg, sizeof(msg), 3);
+    MIDI_HOST_CHECK(sysex_pack(msg, sizeof(msg), ev) == sizeof(ev));
+    spans_reset(true);
+    m_rx_count = 0;
+
+    MIDI_HOST_CHECK(out_packets(ev, sizeof(ev)) == sizeof(ev));
+    MIDI_HOST_CHECK(m_span_count == 2);
+    memcpy(spans, m_spans, sizeof(spans));
+    MIDI_HOST_CHECK(spans[0].buf != spans[1].buf);
+
+    /* The other RX buffers still take OUT packets, then the host gets NAKs. */
+    for (uint8_t i = 0; i < RX_BUFFER_COUNT - 2; i++)
+    {
+        MIDI_HOST_CHECK(vhost_out_packet(notes, sizeof(notes)) == sizeof(notes));
+    }
+    MIDI_HOST_CHECK(m_rx_count == 2 * (RX_BUFFER_COUNT - 2));
+    MIDI_HOST_CHECK(!usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+    MIDI_HOST_CHECK(vhost_out_packet(notes, sizeof(notes)) == USBD_SIM_NAK);
+
+    /* Kept spans were not overwritten. */
+    len  = app_usbd_midi_sysex_span_copy(&spans[0], copy);
+    len += app_usbd_midi_sysex_span_copy(&spans[1], &copy[len]);
+    MIDI_HOST_CHECK(len == sizeof(msg));
+    MIDI_HOST_CHECK(memcmp(copy, msg, sizeof(msg)) == 0);
+
+    app_usbd_midi_sysex_release(&m_midi, &spans[1]);
+    MIDI_HOST_CHECK(!usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+    MIDI_HOST_CHECK(vhost_out_packet(notes, sizeof(notes)) == USBD_SIM_NAK);
+
+    app_usbd_midi_sysex_release(&m_midi, &spans[0]);
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+    for (uint8_t i = 0; i < RX_BUFFER_COUNT; i++)
+    {
+        MIDI_HOST_CHECK(vhost_out_packet(notes, sizeof(notes)) == sizeof(notes));
+    }
+    MIDI_HOST_CHECK(m_rx_count == 2 * (2 * RX_BUFFER_COUNT - 2));
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+}
+
+int main(void)
+{
+    midi_host_open(&m_midi);
+    app_usbd_midi_sysex_span_handler_set(&m_midi, span_handler);
+    test_copy();
+    test_hold();
+    printf("span: ok\n");
+    return 0;
+}
@@ -0,0 +1,368 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Status byte and Code Index Number tables of the class against the specifications.
+ *
+ * Every status byte is written through the message and byte stream encoders and
+ * received through the event packet parser, and the event packets and messages are
+ * compared with Universal Serial Bus Device Class Definition for MIDI Devices,
+ * Release 1.0, table 4-1, and the message lengths of the MIDI 1.0 specification.
+ */
+#include "midi_host.h"
+
+#define RX_MAX 8
+
+/**
+ * @brief Status byte as the specifications define it.
+ */
+typedef struct
+{
+    uint8_t cin;    //!< Code Index Number of the event packet carrying the message
+    uint8_t len;    //!< Length of the message, 0 for data bytes, sysex and undefined status
+} spec_t;
+
+typedef struct
+{
+    enum app_usbd_midi_rx_event_e event;
+    uint8_t                       cable;
+    uint8_t                       len;
+    uint8_t                       data[16];
+} rx_msg_t;
+
+static rx_msg_t m_rx[RX_MAX];
+static size_t   m_rx_count;
+static uint8_t  m_sysex_buf[64];
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg);
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, 1024, 4, 64);
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+    rx_msg_t * p_rx = &m_rx[m_rx_count];
+
+    if (event == APP_USBD_MIDI_SYSEX_BUF_REQ)
+    {
+        p_msg->p_data = m_sysex_buf;
+        p_msg->len    = sizeof(m_sysex_buf);
+        return;
+    }
+
+    MIDI_HOST_CHECK(m_rx_count < RX_MAX);
+    p_rx->event = event;
+    p_rx->cable = cable;
+    p_rx->len   = 0;
+#if APP_USBD_MIDI_CONFIG_SYSEX_POOL
+    if (p_msg->p_chain != NULL)
+    {
+        for (app_usbd_midi_sysex_block_t * p_block = p_msg->p_chain; p_block != NULL; p_block = p_block->p_next)
+        {
+            MIDI_HOST_CHECK(p_rx->len + p_block->len <= sizeof(p_rx->data));
+            memcpy(&p_rx->data[p_rx->len], p_block->data, p_block->len);
+            p_rx->len += p_block->len;
+        }
+        app_usbd_midi_sysex_free(&m_midi, p_msg->p_chain);
+        m_rx_count++;
+        return;
+    }
+#endif
+    MIDI_HOST_CHECK(p_msg->len <= sizeof(p_rx->data));
+    memcpy(p_rx->data, p_msg->p_data, p_msg->len);
+    p_rx->len = (uint8_t)p_msg->len;
+    m_rx_count++;
+}
+
+/**
+ * @brief Code Index Number and message length of a status byte.
+ *
+ * USB-MIDI 1.0 table 4-1: channel messages use the upper nibble of the status as CIN,
+ * two and three byte system common messages use CIN 0x2 and 0x3, single byte system
+ * common messages CIN 0x5 and real-time messages, undefined ones included, CIN 0xF.
+ */
+static spec_t spec_get(uint8_t status)
+{
+    spec_t spec = { 0, 0 };
+
+    if (status < 0x80)
+    {
+        return spec;
+    }
+    if (status < 0xF0)
+    {
+        spec.cin = status >> 4;
+        spec.len = ((spec.cin == 0xC) || (spec.cin == 0xD)) ? 2 : 3;
+        return spec;
+    }
+    switch (status)
+    {
+        case 0xF0:  /* System exclusive, no fixed length. */
+            spec.cin = 0x4;
+            break;
+        case 0xF1:  /* MIDI time code quarter frame. */
+        case 0xF3:  /* Song select. */
+            spec.cin = 0x2;
+            spec.len = 2;
+            break;
+        case 0xF2:  /* Song position pointer. */
+            spec.cin = 0x3;
+            spec.len = 3;
+            break;
+        case 0xF6:  /* Tune request. */
+            spec.cin = 0x5;
+            spec.len = 1;
+            break;
+        case 0xF4:  /* Undefined. */
+        case 0xF5:
+        case 0xF7:  /* End of exclusive, only valid inside system exclusive. */
+            break;
+        default:    /* Real-time. */
+            spec.cin = 0xF;
+            spec.len = 1;
+            break;
+    }
+    return spec;
+}
+
+/**
+ * @brief Read IN packets until the device has nothing left, with SOFs in between
+ *        for configurations that hold packets until the frame ends.
+ */
+static size_t drain(uint8_t * p_buf, size_t size)
+{
+    size_t len = 0;
+
+    for (uint8_t idle = 0; idle < 3; )
+    {
+        size_t n = vhost_in(p_buf + len, size - len);
+
+        len += n;
+        if (n == 0)
+        {
+            idle++;
+            vhost_sof();
+        }
+        else
+        {
+            idle = 0;
+        }
+    }
+    return len;
+}
+
+/**
+ * @brief Check one event packet read by the host.
+ */
+static void event_check(uint8_t const * p_ev, uint8_t cable, spec_t spec, uint8_t status,
+                        uint8_t d1, uint8_t d2)
+{
+    MIDI_HOST_CHECK(p_ev[0] == (uint8_t)((cable << 4) | spec.cin));
+    MIDI_HOST_CHECK(p_ev[1] == status);
+    MIDI_HOST_CHECK(p_ev[2] == ((spec.len > 1) ? d1 : 0));
+    MIDI_HOST_CHECK(p_ev[3] == ((spec.len > 2) ? d2 : 0));
+}
+
+/**
+ * @brief Every message written whole goes out with the CIN of its status.
+ */
+static void test_write(void)
+{
+    uint8_t buf[64];
+
+    for (unsigned s = 0x80; s <= 0xFF; s++)
+    {
+        spec_t  spec   = spec_get((uint8_t)s);
+        uint8_t cable  = s & 0x0F;
+        uint8_t msg[3] = { (uint8_t)s, 0x11, 0x22 };
+
+        if (spec.len == 0)
+        {
+            continue;
+        }
+        MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, cable, msg, spec.len));
+        MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == 4);
+        event_check(buf, cable, spec, (uint8_t)s, 0x11, 0x22);
+    }
+}
+
+/**
+ * @brief The byte stream encoder takes message lengths and CINs from the status.
+ *
+ * Each status byte follows 0xF4, an undefined status that clears running status, and
+ * is followed by two data bytes. Complete messages go out, data bytes that do not
+ * belong to a message are dropped and running status repeats two byte channel messages.
+ */
+static void test_stream(void)
+{
+    uint8_t buf[64];
+
+    for (unsigned s = 0x00; s <= 0xFF; s++)
+    {
+        spec_t  spec      = spec_get((uint8_t)s);
+        uint8_t cable     = s & 0x0F;
+        uint8_t stream[4] = { 0xF4, (uint8_t)s, 0x11, 0x22 };
+        size_t  consumed  = 0;
+        size_t  len;
+
+        if (s == 0xF0)
+        {
+            continue;
+        }
+        MIDI_HOST_CHECK_OK(app_usbd_midi_stream_write(&m_midi, cable, stream, sizeof(stream), &consumed));
+        MIDI_HOST_CHECK(consumed == sizeof(stream));
+        len = drain(buf, sizeof(buf));
+
+        if (spec.len == 0)
+        {
+            MIDI_HOST_CHECK(len == 0);
+        }
+        else if ((s < 0xF0) && (spec.len == 2))
+        {
+            MIDI_HOST_CHECK(len == 8);
+            event_check(&buf[0], cable, spec, (uint8_t)s, 0x11, 0);
+            event_check(&buf[4], cable, spec, (uint8_t)s, 0x22, 0);
+        }
+        else
+        {
+            MIDI_HOST_CHECK(len == 4);
+            event_check(buf, cable, spec, (uint8_t)s, 0x11, 0x22);
+        }
+    }
+}
+
+/**
+ * @brief System exclusive of every length at its end goes out with CIN 0x4 to 0x7.
+ */
+static void test_stream_sysex(void)
+{
+    uint8_t buf[64];
+
+    for (uint8_t tail = 0; tail < 3; tail++)
+    {
+        uint8_t stream[8] = { 0xF0, 0x11, 0x22, 0x33, 0x44 };
+        size_t  len       = 3 + tail;
+
+        stream[len++] = 0xF7;
+        MIDI_HOST_CHECK_OK(app_usbd_midi_stream_write(&m_midi, 0, stream, len, NULL));
+        MIDI_HOST_CHECK(drain(buf, sizeof(buf)) == 8);
+        MIDI_HOST_CHECK(memcmp(buf, (uint8_t const[]){ 0x04, 0xF0, 0x11, 0x22 }, 4) == 0);
+        MIDI_HOST_CHECK(buf[4] == APP_USBD_MIDI_CIN_SYSEX_END_1 + tail);
+        MIDI_HOST_CHECK(memcmp(&buf[5], &stream[3], tail + 1) == 0);
+        MIDI_HOST_CHECK((tail == 2) || (buf[5 + tail + 1] == 0));
+    }
+}
+
+static void rx_push(uint8_t const * p_ev, size_t len)
+{
+    m_rx_count = 0;
+    MIDI_HOST_CHECK(vhost_out(p_ev, len) == len);
+    while (app_usbd_midi_process(&m_midi, SIZE_MAX))
+    {
+    }
+}
+
+/**
+ * @brief Every message received in an event packet reaches the rx handler whole.
+ */
+static void test_rx(void)
+{
+    for (unsigned s = 0x00; s <= 0xFF; s++)
+    {
+        spec_t  spec  = spec_get((uint8_t)s);
+        uint8_t cable = s & 0x0F;
+        uint8_t ev[4] = { (uint8_t)((cable << 4) | spec.cin), (uint8_t)s, 0x11, 0x22 };
+
+        if (spec.len == 0)
+        {
+            continue;
+        }
+        rx_push(ev, sizeof(ev));
+        MIDI_HOST_CHECK(m_rx_count == 1);
+        MIDI_HOST_CHECK(m_rx[0].event == APP_USBD_MIDI_RX_DONE);
+        MIDI_HOST_CHECK(m_rx[0].cable == cable);
+        MIDI_HOST_CHECK(m_rx[0].len == spec.len);
+        MIDI_HOST_CHECK(memcmp(m_rx[0].data, &ev[1], spec.len) == 0);
+    }
+}
+
+/**
+ * @brief Reserved CINs are ignored and the sysex CINs carry 3, 1, 2 and 3 bytes.
+ */
+static void test_rx_cin(void)
+{
+    uint8_t reserved[8] = { 0x00, 0x90, 0x11, 0x22, 0x01, 0x90, 0x11, 0x22 };
+
+    rx_push(reserved, sizeof(reserved));
+    MIDI_HOST_CHECK(m_rx_count == 0);
+
+    for (uint8_t tail = 0; tail < 3; tail++)
+    {
+        uint8_t ev[8] = { 0x04, 0xF0, 0x11, 0x22, (uint8_t)(APP_USBD_MIDI_CIN_SYSEX_END_1 + tail), 0x33, 0x44, 0x55 };
+
+        ev[5 + tail] = 0xF7;
+        rx_push(ev, sizeof(ev));
+        MIDI_HOST_CHECK(m_rx_count == 1);
+        MIDI_HOST_CHECK(m_rx[0].event == APP_USBD_MIDI_SYSEX_RX_DONE);
+        MIDI_HOST_CHECK(m_rx[0].len == 3 + tail + 1);
+        MIDI_HOST_CHECK(memcmp(m_rx[0].data, &ev[1], 3) == 0);
+        MIDI_HOST_CHECK(memcmp(&m_rx[0].data[3], &ev[5], tail + 1) == 0);
+    }
+}
+
+int main(void)
+{
+    midi_host_open(&m_midi);
+    test_write();
+    test_stream();
+    test_stream_sysex();
+    test_rx();
+    test_rx_cin();
+    printf("tables: ok\n");
+    return 0;
+}
@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Thru, see app_usbd_midi_thru_set.
+ *
+ * Received event packets are forwarded to the host with their cable replaced by the map.
+ * An OUT packet that arrives while a main loop writer holds the TX buffer is held back,
+ * the host gets NAKs, and it is forwarded in order once the writer is done. Only an
+ * OUT packet the TX buffer has no room for is dropped.
+ */
+#include "midi_host.h"
+#include "nrf_ringbuf.h"
+
+static uint32_t m_rx_count;
+static uint32_t m_thru_dropped;
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+    if (event == APP_USBD_MIDI_USER_EVT_THRU_DROPPED)
+    {
+        m_thru_dropped++;
+    }
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+    if (event == APP_USBD_MIDI_RX_DONE)
+    {
+        m_rx_count++;
+    }
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, 1024, 4, 64);
+
+/** @brief Note on of each of the cables 0, 1 and 2. */
+static const uint8_t m_notes[] =
+{
+    0x09, 0x90, 0x3C, 0x40,
+    0x19, 0x91, 0x3D, 0x41,
+    0x29, 0x92, 0x3E, 0x42,
+};
+
+/**
+ * @brief Read everything the device sends and compare it with @p p_expect.
+ */
+static void check_in(uint8_t const * p_expect, size_t len)
+{
+    uint8_t buf[256];
+
+    MIDI_HOST_CHECK(vhost_in(buf, sizeof(buf)) == len);
+    MIDI_HOST_CHECK(memcmp(buf, p_expect, len) == 0);
+}
+
+/**
+ * @brief Take the TX buffer write lock the way a writer preempted by the USB interrupt holds it.
+ */
+static void writer_lock(void)
+{
+    uint8_t * p_data;
+    size_t    len = 4;
+
+    MIDI_HOST_CHECK_OK(nrf_ringbuf_alloc(m_midi.specific.inst.p_in_buf, &p_data, &len, true));
+}
+
+/**
+ * @brief Give back the write lock without writing, no class function is called.
+ */
+static void writer_unlock(void)
+{
+    MIDI_HOST_CHECK_OK(nrf_ringbuf_put(m_midi.specific.inst.p_in_buf, 0));
+}
+
+static uint32_t thru_dropped(void)
+{
+    app_usbd_midi_stats_t stats;
+
+    app_usbd_midi_stats_get(&m_midi, &stats);
+    return stats.thru_dropped;
+}
+
+/**
+ * @brief Cable map checks and disabling thru.
+ */
+static void test_set(void)
+{
+    uint8_t map[16];
+    uint8_t buf[NRF_DRV_USBD_EPSIZE];
+
+    for (uint8_t cable = 0; cable < 16; cable++)
+    {
+        map[cable] = cable;
+    }
+    map[5] = 16;
+    MIDI_HOST_CHECK(app_usbd_midi_thru_set(&m_midi, map) == NRF_ERROR_INVALID_PARAM);
+    map[5] = APP_USBD_MIDI_THRU_NONE;
+    MIDI_HOST_CHECK_OK(app_usbd_midi_thru_set(&m_midi, map));
+    MIDI_HOST_CHECK_OK(app_usbd_midi_thru_set(&m_midi, NULL));
+
+    m_rx_count = 0;
+    MIDI_HOST_CHECK(vhost_out(m_notes, sizeof(m_notes)) == sizeof(m_notes));
+    MIDI_HOST_CHECK(vhost_in(buf, sizeof(buf)) == 0);
+    MIDI_HOST_CHECK(m_rx_count == 3);
+}
+
+/**
+ * @brief Every cable mapped to itself, the packet is forwarded unchanged.
+ */
+static void test_identity(void)
+{
+    uint8_t map[16];
+
+    for (uint8_t cable = 0; cable < 16; cable++)
+    {
+        map[cable] = cable;
+    }
+    MIDI_HOST_CHECK_OK(app_usbd_midi_thru_set(&m_midi, map));
+
+    m_rx_count = 0;
+    MIDI_HOST_CHECK(vhost_out(m_notes, sizeof(m_notes)) == sizeof(m_notes));
+    check_in(m_notes, sizeof(m_notes));
+    MIDI_HOST_CHECK(m_rx_count == 3);
+}
+
+/**
+ * @brief Cables are replaced, unmapped cables are not forwarded but still received.
+ */
+static void test_remap(void)
+{
+    static const uint8_t expect[] =
+    {
+        0x79, 0x90, 0x3C, 0x40,
+        0x09, 0x92, 0x3E, 0x42,
+    };
+    uint8_t map[16];
+
+    memset(map, APP_USBD_MIDI_THRU_NONE, sizeof(map));
+    map[0] = 7;
+    map[2] = 0;
+    MIDI_HOST_CHECK_OK(app_usbd_midi_thru_set(&m_midi, map));
+
+    m_rx_count = 0;
+    MIDI_HOST_CHECK(vhost_out(m_notes, sizeof(m_notes)) == sizeof(m_notes));
+    check_in(expect, sizeof(expect));
+    MIDI_HOST_CHECK(m_rx_count == 3);
+}
+
+/**
+ * @brief A writer holding the TX buffer back-pressures the host instead of losing packets.
+ *
+ * The held OUT packet is still parsed. It is forwarded when the writer commits, or when
+ * the IN transfer in flight completes after the writer gave up.
+ */
+static void test_busy(void)
+{
+    static uint8_t       note[] = { 0x90, 0x40, 0x7F };
+    uint8_t              expect[4 + sizeof(m_notes)] = { 0x09, 0x90, 0x40, 0x7F };
+    uint8_t              buf[NRF_DRV_USBD_EPSIZE];
+    uint32_t             dropped = thru_dropped();
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_thru_set(&m_midi, NULL));
+    MIDI_HOST_CHECK_OK(app_usbd_midi_thru_set(&m_midi,
+        (uint8_t const[16]){ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 }));
+    memcpy(&expect[4], m_notes, sizeof(m_notes));
+
+    /* Forwarded by the commit of the writer. */
+    m_rx_count = 0;
+    writer_lock();
+    MIDI_HOST_CHECK(vhost_out(m_notes, sizeof(m_notes)) == sizeof(m_notes));
+    MIDI_HOST_CHECK(m_rx_count == 3);
+    MIDI_HOST_CHECK(!usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+    MIDI_HOST_CHECK(vhost_out(m_notes, sizeof(m_notes)) == 0);
+    writer_unlock();
+    MIDI_HOST_CHECK(!usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 0, note, sizeof(note)));
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+    check_in(expect, sizeof(expect));
+
+    /* Forwarded by the completion of the IN transfer in flight. */
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 0, note, sizeof(note)));
+    writer_lock();
+    MIDI_HOST_CHECK(vhost_out(m_notes, sizeof(m_notes)) == sizeof(m_notes));
+    writer_unlock();
+    MIDI_HOST_CHECK(!usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+    MIDI_HOST_CHECK(vhost_in_packet(buf) == 4);
+    MIDI_HOST_CHECK(memcmp(buf, expect, 4) == 0);
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+    check_in(m_notes, sizeof(m_notes));
+
+    MIDI_HOST_CHECK(thru_dropped() == dropped);
+    MIDI_HOST_CHECK(m_thru_dropped == 0);
+}
+
+/**
+ * @brief An OUT packet the full TX buffer has no room for is dropped and reported.
+ */
+static void test_full(void)
+{
+    static uint8_t       note[] = { 0x90, 0x40, 0x7F };
+    uint8_t              buf[256];
+    uint32_t             dropped = thru_dropped();
+    size_t               written = 0;
+    size_t               read    = 0;
+    size_t               n;
+
+    app_usbd_midi_overflow_set(&m_midi, APP_USBD_MIDI_OVERFLOW_REJECT);
+    while (app_usbd_midi_write(&m_midi, 0, note, sizeof(note)) == NRF_SUCCESS)
+    {
+        written++;
+    }
+
+    MIDI_HOST_CHECK(vhost_out(m_notes, sizeof(m_notes)) == sizeof(m_notes));
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+    MIDI_HOST_CHECK(thru_dropped() - dropped == 3);
+    MIDI_HOST_CHECK(m_thru_dropped == 1);
+
+    while ((n = vhost_in(buf, sizeof(buf))) > 0)
+    {
+        read += n;
+    }
+    MIDI_HOST_CHECK(read == written * 4);
+}
+
+int main(void)
+{
+    midi_host_open(&m_midi);
+    app_usbd_midi_tx_coalesce_set(&m_midi, UINT16_MAX);
+    test_set();
+    test_identity();
+    test_remap();
+    test_busy();
+    test_full();
+    printf("thru: ok\n");
+    return 0;
+}
@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Timestamps of received messages.
+ *
+ * Messages are sent at known times within USB frames, across the wrap of the 11-bit
+ * frame number and across lost SOFs. Their timestamps must never go back, and must
+ * match the simulated time to the resolution of the time base: 1 us with the
+ * simulator tick counter as time source, one frame without a time source.
+ */
+#include "midi_host.h"
+
+#define FRAMES      64      /**< Frames sent per run, the frame number wraps half way. */
+#define FRAME_FIRST 0x7E0   /**< Frame number of the first SOF. */
+
+static uint32_t m_stamp;    /**< Timestamp of the last received message. */
+static size_t   m_rx_count;
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+    MIDI_HOST_CHECK(event == APP_USBD_MIDI_RX_DONE);
+    m_stamp = p_msg->timestamp;
+    m_rx_count++;
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, 1024, 4, 64);
+
+/**
+ * @brief Time base under test.
+ */
+typedef struct
+{
+    uint32_t resolution;    //!< Resolution in microseconds
+    uint32_t start_us;      //!< Simulated time at the reference SOF
+    uint32_t start_stamp;   //!< Timestamp at the reference SOF
+    uint32_t last_stamp;    //!< Last timestamp seen
+} ts_run_t;
+
+/**
+ * @brief Send a note now and check its timestamp.
+ */
+static void check_rx(ts_run_t * p_run)
+{
+    static uint8_t const ev[4] = { 0x09, 0x90, 0x3C, 0x40 };
+    uint32_t             ideal = usbd_sim_time_us() - p_run->start_us;
+    uint32_t             stamp;
+
+    m_rx_count = 0;
+    MIDI_HOST_CHECK(vhost_out(ev, sizeof(ev)) == sizeof(ev));
+    MIDI_HOST_CHECK(m_rx_count == 1);
+
+    stamp = m_stamp - p_run->start_stamp;
+    MIDI_HOST_CHECK((int32_t)(m_stamp - p_run->last_stamp) >= 0);
+    MIDI_HOST_CHECK(stamp <= ideal);
+    MIDI_HOST_CHECK(ideal - stamp < p_run->resolution);
+    MIDI_HOST_CHECK(stamp % p_run->resolution == 0);
+    p_run->last_stamp = m_stamp;
+}
+
+/**
+ * @brief Take the reference at the SOF that was just sent.
+ */
+static void ref_take(ts_run_t * p_run)
+{
+    p_run->start_us    = usbd_sim_time_us();
+    p_run->start_stamp = app_usbd_midi_time_get(&m_midi);
+    MIDI_HOST_CHECK((int32_t)(p_run->start_stamp - p_run->last_stamp) >= 0);
+    p_run->last_stamp  = p_run->start_stamp;
+}
+
+/**
+ * @brief Check the time base with or without a sub-frame time source.
+ *
+ * @param time_get  Time source, NULL for frame resolution.
+ */
+static void test_time_base(app_usbd_midi_time_get_t time_get)
+{
+    static uint32_t const offsets[] = { 0, 1, 137, 500, 998, 999 };
+    ts_run_t              run;
+
+    app_usbd_midi_time_source_set(&m_midi, time_get, 1000);
+    run.resolution = (time_get != NULL) ? 1 : 1000;
+
+    usbd_sim_framecnt_set(FRAME_FIRST - 1);
+    vhost_sof();
+    run.last_stamp = app_usbd_midi_time_get(&m_midi);
+    ref_take(&run);
+
+    for (uint32_t f = 0; f < FRAMES; f++)
+    {
+        uint32_t frame_us = usbd_sim_time_us();
+
+        for (size_t i = 0; i < ARRAY_SIZE(offsets); i++)
+        {
+            usbd_sim_time_advance(frame_us + offsets[i] - usbd_sim_time_us());
+            check_rx(&run);
+        }
+        vhost_sof();
+    }
+    MIDI_HOST_CHECK(usbd_sim_framecnt_get() == ((FRAME_FIRST + FRAMES) & 0x7FF));
+
+    /* Past the end of the frame without SOF the time holds at the last microsecond
+     * of the frame instead of running into the next one. */
+    usbd_sim_time_advance(1200);
+    m_rx_count = 0;
+    MIDI_HOST_CHECK(vhost_out((uint8_t const[]){ 0x09, 0x90, 0x3C, 0x40 }, 4) == 4);
+    MIDI_HOST_CHECK(m_rx_count == 1);
+    MIDI_HOST_CHECK(m_stamp == run.start_stamp + (FRAMES * 1000) + (999 / run.resolution) * run.resolution);
+    MIDI_HOST_CHECK(app_usbd_midi_time_get(&m_midi) == m_stamp);
+    run.last_stamp = m_stamp;
+    vhost_sof();
+    ref_take(&run);
+    check_rx(&run);
+
+    /* SOFs of frames 0x000 and 0x001 are lost, the wrap still counts three frames. */
+    usbd_sim_framecnt_set(0x7FE);
+    vhost_sof();
+    ref_take(&run);
+    check_rx(&run);
+    usbd_sim_time_advance(2000);
+    usbd_sim_framecnt_set(0x001);
+    vhost_sof();
+    MIDI_HOST_CHECK(usbd_sim_framecnt_get() == 0x002);
+    check_rx(&run);
+    usbd_sim_time_advance(321);
+    check_rx(&run);
+    MIDI_HOST_CHECK(m_stamp - run.start_stamp == 3000 + ((321 / run.resolution) * run.resolution));
+}
+
+int main(void)
+{
+    midi_host_open(&m_midi);
+    test_time_base(NULL);
+    test_time_base(usbd_sim_ticks_get);
+    printf("timestamp: ok\n");
+    return 0;
+}
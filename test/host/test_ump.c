@@ -0,0 +1,229 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * USB-MIDI 2.0 on alternate setting 1, see app_usbd_midi_ump_descriptors_set.
+ *
+ * The host reads the Group Terminal Blocks, selects alternate setting 1 and exchanges
+ * Universal MIDI Packets. Switching settings with transfers in flight leaves ABORTED
+ * events queued behind the new transfers, they must not release them.
+ */
+#include "midi_host.h"
+
+#define UMP_MAX 8   /**< Received packets kept by the handler. */
+
+static uint32_t m_ump[UMP_MAX][4];
+static uint8_t  m_ump_words[UMP_MAX];
+static size_t   m_ump_count;
+
+static void ev_handler(app_usbd_class_inst_t const * p_inst, app_usbd_midi_user_event_t event)
+{
+}
+
+static void rx_handler(app_usbd_class_inst_t const * p_inst,
+                       enum app_usbd_midi_rx_event_e event,
+                       uint8_t                       cable,
+                       app_usbd_midi_msg_t         * p_msg)
+{
+}
+
+static void ump_handler(app_usbd_class_inst_t const * p_inst,
+                        uint32_t const *              p_ump,
+                        uint8_t                       words,
+                        uint32_t                      timestamp)
+{
+    MIDI_HOST_CHECK(m_ump_count < UMP_MAX);
+    memcpy(m_ump[m_ump_count], p_ump, words * sizeof(uint32_t));
+    m_ump_words[m_ump_count] = words;
+    m_ump_count++;
+}
+
+MIDI_HOST_DEF(m_midi, ev_handler, rx_handler, 1024, 4, 64);
+
+APP_USBD_MIDI_DESCRIPTOR(m_midi2_desc,
+                         APP_USBD_AUDIO_MIDI2_CS_MIDI_STREAMING_INTERFACE_DSC,
+                         APP_USBD_AUDIO_MIDI2_STANDARD_BULK_OUT_ENDPOINT_DSC,
+                         APP_USBD_AUDIO_MIDI2_BULK_OUT_ENDPOINT_DSC,
+                         APP_USBD_AUDIO_MIDI2_STANDARD_BULK_IN_ENDPOINT_DSC,
+                         APP_USBD_AUDIO_MIDI2_BULK_IN_ENDPOINT_DSC);
+
+APP_USBD_MIDI_DESCRIPTOR(m_midi2_gtb_desc,
+                         APP_USBD_AUDIO_MIDI2_GTB_HEADER_DSC,
+                         APP_USBD_AUDIO_MIDI2_GTB_DSC);
+
+/**
+ * @brief Read the Group Terminal Blocks of an alternate setting.
+ */
+static ret_code_t gtb_get(uint8_t alt, uint8_t * p_buf, size_t * p_len)
+{
+    app_usbd_setup_t setup = { 0 };
+
+    setup.bmRequestType = app_usbd_setup_req_val(APP_USBD_SETUP_REQREC_INTERFACE,
+                                                 APP_USBD_SETUP_REQTYPE_STD,
+                                                 APP_USBD_SETUP_REQDIR_IN);
+    setup.bRequest   = APP_USBD_SETUP_STDREQ_GET_DESCRIPTOR;
+    setup.wValue.hb  = 0x26;
+    setup.wValue.lb  = alt;
+    setup.wIndex.lb  = vhost_dev_get()->stream_iface;
+    setup.wLength.w  = (uint16_t)*p_len;
+    return usbd_sim_setup(&setup, p_buf, p_len);
+}
+
+/**
+ * @brief Alternate setting 1 is offered and its Group Terminal Blocks can be read.
+ */
+static void test_descriptors(void)
+{
+    static const uint8_t gtb[] = { APP_USBD_AUDIO_MIDI2_GTB_HEADER_DSC, APP_USBD_AUDIO_MIDI2_GTB_DSC };
+    uint8_t              buf[64];
+    size_t               len = sizeof(buf);
+
+    MIDI_HOST_CHECK(vhost_dev_get()->alt_count == 2);
+    MIDI_HOST_CHECK_OK(gtb_get(1, buf, &len));
+    MIDI_HOST_CHECK(len == sizeof(gtb));
+    MIDI_HOST_CHECK(memcmp(buf, gtb, sizeof(gtb)) == 0);
+
+    len = sizeof(buf);
+    MIDI_HOST_CHECK(gtb_get(0, buf, &len) != NRF_SUCCESS);
+}
+
+/**
+ * @brief Selecting a setting with transfers in flight in both directions.
+ *
+ * The ABORTED events of the old transfers arrive after the new setting armed OUT and
+ * the first UMP write armed IN, and must leave the new transfers alone.
+ */
+static void test_select(void)
+{
+    static uint8_t        note[] = { 0x90, 0x3C, 0x40 };
+    uint32_t              ump[2];
+    uint32_t              clock  = 0x10F80000UL;
+    uint32_t              clocks = 0;
+    uint8_t               buf[1024 + 64];
+    size_t                len = 0;
+    size_t                n;
+    app_usbd_midi_stats_t stats;
+    app_usbd_midi_stats_t before;
+
+    MIDI_HOST_CHECK(!app_usbd_midi_ump_active(&m_midi));
+    app_usbd_midi_ump_cv2_pack(ump, 0, APP_USBD_MIDI_UMP_CV2_NOTE_ON, 0, 0x3C00, 0x80000000UL);
+    MIDI_HOST_CHECK(app_usbd_midi_ump_write(&m_midi, ump, 2) == NRF_ERROR_INVALID_STATE);
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_write(&m_midi, 0, note, sizeof(note)));
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPIN1));
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+    app_usbd_midi_stats_get(&m_midi, &before);
+
+    MIDI_HOST_CHECK_OK(vhost_alt_select(1));
+    MIDI_HOST_CHECK(app_usbd_midi_ump_active(&m_midi));
+    MIDI_HOST_CHECK(app_usbd_midi_write(&m_midi, 0, note, sizeof(note)) == NRF_ERROR_INVALID_STATE);
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+
+    MIDI_HOST_CHECK_OK(app_usbd_midi_ump_write(&m_midi, ump, 2));
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPIN1));
+    MIDI_HOST_CHECK(app_usbd_event_queue_process());
+
+    app_usbd_midi_stats_get(&m_midi, &stats);
+    MIDI_HOST_CHECK(stats.tx_aborted - before.tx_aborted == 1);
+    MIDI_HOST_CHECK(stats.rx_aborted - before.rx_aborted == 1);
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPIN1));
+    MIDI_HOST_CHECK(usbd_sim_ep_armed(NRF_DRV_USBD_EPOUT1));
+
+    /* The span of the transfer in flight is still owned by it and not free for writes. */
+    while (app_usbd_midi_ump_write(&m_midi, &clock, 1) == NRF_SUCCESS)
+    {
+        clocks++;
+    }
+    MIDI_HOST_CHECK(clocks == (1024 - 8) / 4);
+    while ((n = vhost_in(&buf[len], sizeof(buf) - len)) > 0)
+    {
+        len += n;
+    }
+    MIDI_HOST_CHECK(len == 1024);
+    MIDI_HOST_CHECK(memcmp(buf, ump, 8) == 0);
+    for (size_t pos = 8; pos < len; pos += 4)
+    {
+        MIDI_HOST_CHECK(memcmp(&buf[pos], &clock, 4) == 0);
+    }
+}
+
+/**
+ * @brief Packet checks of app_usbd_midi_ump_write and received packets.
+ */
+static void test_packets(void)
+{
+    static const uint32_t out[] =
+    {
+        0x20903C40UL,                                   /* MIDI 1.0 note on */
+        0x40903C00UL, 0xFFFF0000UL,                     /* MIDI 2.0 note on */
+        0x50010000UL, 0x11223344UL, 0x55667788UL, 0x99AABBCCUL,
+    };
+    uint32_t ump[2];
+
+    app_usbd_midi_ump_cv2_pack(ump, 0, APP_USBD_MIDI_UMP_CV2_NOTE_OFF, 0, 0x3C00, 0);
+    MIDI_HOST_CHECK(app_usbd_midi_ump_write(&m_midi, ump, 0) == NRF_ERROR_INVALID_LENGTH);
+    MIDI_HOST_CHECK(app_usbd_midi_ump_write(&m_midi, ump, 1) == NRF_ERROR_INVALID_LENGTH);
+    MIDI_HOST_CHECK(!usbd_sim_ep_armed(NRF_DRV_USBD_EPIN1));
+
+    m_ump_count = 0;
+    MIDI_HOST_CHECK(vhost_out((uint8_t const *)out, sizeof(out)) == sizeof(out));
+    MIDI_HOST_CHECK(m_ump_count == 3);
+    MIDI_HOST_CHECK((m_ump_words[0] == 1) && (m_ump[0][0] == out[0]));
+    MIDI_HOST_CHECK((m_ump_words[1] == 2) && (memcmp(m_ump[1], &out[1], 8) == 0));
+    MIDI_HOST_CHECK((m_ump_words[2] == 4) && (memcmp(m_ump[2], &out[3], 16) == 0));
+
+    /* Back to MIDI 1.0, the same packet is taken as an event packet again. */
+    MIDI_HOST_CHECK_OK(vhost_alt_select(0));
+    MIDI_HOST_CHECK(!app_usbd_midi_ump_active(&m_midi));
+    MIDI_HOST_CHECK(vhost_out((uint8_t const *)out, 4) == 4);
+    MIDI_HOST_CHECK(m_ump_count == 3);
+}
+
+int main(void)
+{
+    app_usbd_midi_ump_descriptors_set(&m_midi, &m_midi2_desc, &m_midi2_gtb_desc);
+    app_usbd_midi_ump_handler_set(&m_midi, ump_handler);
+    midi_host_open(&m_midi);
+    app_usbd_midi_tx_coalesce_set(&m_midi, UINT16_MAX);
+    test_descriptors();
+    test_select();
+    test_packets();
+    printf("ump: ok\n");
+    return 0;
+}
@@ -0,0 +1,782 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "usbd_sim.h"
+#include "app_usbd_descriptor.h"
+
+/**
+ * @brief State of one endpoint.
+ */
+typedef struct
+{
+    bool                        enabled;    //!< Endpoint enabled by the class
+    bool                        busy;       //!< Transfer armed
+    bool                        handled;    //!< Transfer runs through a feeder or consumer
+    bool                        zlp;        //!< Zero-length packet still to be sent
+    nrf_drv_usbd_ep_transfer_t  transfer;   //!< Rest of a plain transfer
+    nrf_drv_usbd_handler_desc_t handler;    //!< Consumer of a handled transfer
+} usbd_sim_ep_t;
+
+typedef struct
+{
+    app_usbd_class_inst_t const * p_inst[USBD_SIM_MAX_CLASS];   //!< Appended classes
+    uint8_t                       count;                        //!< Number of appended classes
+    uint8_t                       sof_mask;                     //!< Classes registered for SOF
+    usbd_sim_ep_t                 ep_in[NRF_USBD_EP_COUNT];
+    usbd_sim_ep_t                 ep_out[NRF_USBD_EP_COUNT];
+    uint16_t                      framecnt;                     //!< Frame number of the last SOF
+    uint32_t                      time_us;                      //!< Simulated time
+    uint32_t                      stall_until_us;               //!< End of the time the USBD interrupt is kept busy
+    uint8_t                       isr_depth;                    //!< Nesting of class event handler calls
+    nrf_drv_usbd_ep_t             aborted[2 * NRF_USBD_EP_COUNT]; //!< Endpoints with an ABORTED event queued
+    uint8_t                       aborted_count;                //!< Number of queued ABORTED events
+    uint8_t                       setup_buf[USBD_SIM_EP0_SIZE]; //!< Control transfer buffer
+    uint8_t const *               p_rsp;                        //!< Data of the IN data stage
+    size_t                        rsp_len;                      //!< Length of the IN data stage
+    app_usbd_core_setup_data_handler_desc_t setup_data;         //!< Handler of the OUT data stage
+    usbd_sim_stats_t              stats;
+} usbd_sim_t;
+
+static usbd_sim_t m_sim;
+
+static usbd_sim_ep_t * ep_get(nrf_drv_usbd_ep_t ep)
+{
+    uint8_t nr = NRF_USBD_EP_NR_GET(ep);
+
+    ASSERT(nr < NRF_USBD_EP_COUNT);
+    return NRF_USBD_EPIN_CHECK(ep) ? &m_sim.ep_in[nr] : &m_sim.ep_out[nr];
+}
+
+/**
+ * @brief Find the class instance owning an interface or an endpoint.
+ *
+ * @param[in] iface Interface number, ignored if @p by_ep is set.
+ * @param[in] ep    Endpoint address.
+ * @param[in] by_ep Search by endpoint.
+ * @param[out] p_iface_idx Index of the interface inside the class, may be NULL.
+ */
+static app_usbd_class_inst_t const * class_find(uint8_t           iface,
+                                                nrf_drv_usbd_ep_t ep,
+                                                bool              by_ep,
+                                                uint8_t         * p_iface_idx)
+{
+    for (uint8_t c = 0; c < m_sim.count; c++)
+    {
+        app_usbd_class_inst_t const * p_inst = m_sim.p_inst[c];
+
+        for (uint8_t i = 0; i < app_usbd_class_iface_count_get(p_inst); i++)
+        {
+            app_usbd_class_iface_conf_t const * p_iface = app_usbd_class_iface_get(p_inst, i);
+            bool                                match   = false;
+
+            if (!by_ep)
+            {
+                match = (app_usbd_class_iface_number_get(p_iface) == iface);
+            }
+            for (uint8_t e = 0; by_ep && (e < app_usbd_class_iface_ep_count_get(p_iface)); e++)
+            {
+                match = match ||
+                        (app_usbd_class_ep_address_get(app_usbd_class_iface_ep_get(p_iface, e)) == ep);
+            }
+            if (match)
+            {
+                if (p_iface_idx != NULL)
+                {
+                    *p_iface_idx = i;
+                }
+                return p_inst;
+            }
+        }
+    }
+    return NULL;
+}
+
+static ret_code_t class_event(app_usbd_class_inst_t const * p_inst, app_usbd_complex_evt_t const * p_event)
+{
+    ret_code_t ret;
+
+    m_sim.isr_depth++;
+    ret = p_inst->p_class_methods->event_handler(p_inst, p_event);
+    m_sim.isr_depth--;
+    return ret;
+}
+
+/**
+ * @brief Check if an endpoint takes part in a transaction.
+ *
+ * The endpoint needs an armed transfer and an interrupt free to handle it.
+ */
+static bool ep_ready(usbd_sim_ep_t const * p_ep)
+{
+    return p_ep->enabled && p_ep->busy && !usbd_sim_isr_stalled();
+}
+
+/**
+ * @brief Report the end of a transfer to the class owning the endpoint.
+ */
+static void ep_event(nrf_drv_usbd_ep_t ep, nrf_drv_usbd_ep_status_t status)
+{
+    app_usbd_class_inst_t const * p_inst = class_find(0, ep, true, NULL);
+    app_usbd_complex_evt_t        evt;
+
+    if (ep == NRF_DRV_USBD_EPOUT0)
+    {
+        /* Data stage of a control OUT request. */
+        if (m_sim.setup_data.handler != NULL)
+        {
+            UNUSED_RETURN_VALUE(m_sim.setup_data.handler(status, m_sim.setup_data.p_context));
+        }
+        return;
+    }
+    if (p_inst == NULL)
+    {
+        return;
+    }
+    memset(&evt, 0, sizeof(evt));
+    evt.drv_evt.type                   = NRF_DRV_USBD_EVT_EPTRANSFER;
+    evt.drv_evt.data.eptransfer.ep     = ep;
+    evt.drv_evt.data.eptransfer.status = status;
+    UNUSED_RETURN_VALUE(class_event(p_inst, &evt));
+}
+
+/**
+ * @brief Deliver the queued ABORTED events, like app_usbd processing its event queue.
+ *
+ * @retval true  Events were delivered.
+ * @retval false Nothing was queued.
+ */
+static bool events_flush(void)
+{
+    uint8_t count = m_sim.aborted_count;
+
+    for (uint8_t i = 0; i < m_sim.aborted_count; i++)
+    {
+        /* Handlers may abort again, those events are delivered in this loop too. */
+        ep_event(m_sim.aborted[i], NRF_USBD_EP_ABORTED);
+    }
+    m_sim.aborted_count = 0;
+    return count > 0;
+}
+
+void usbd_sim_init(void)
+{
+    memset(&m_sim, 0, sizeof(m_sim));
+    m_sim.ep_in[0].enabled  = true;
+    m_sim.ep_out[0].enabled = true;
+}
+
+void usbd_sim_reset(void)
+{
+    app_usbd_complex_evt_t evt;
+
+    for (uint8_t nr = 1; nr < NRF_USBD_EP_COUNT; nr++)
+    {
+        app_usbd_ep_disable(NRF_USBD_EPIN(nr));
+        app_usbd_ep_disable(NRF_USBD_EPOUT(nr));
+    }
+    UNUSED_RETURN_VALUE(events_flush());
+    memset(&evt, 0, sizeof(evt));
+    evt.app_evt.type = APP_USBD_EVT_DRV_RESET;
+    for (uint8_t c = 0; c < m_sim.count; c++)
+    {
+        UNUSED_RETURN_VALUE(class_event(m_sim.p_inst[c], &evt));
+    }
+}
+
+void usbd_sim_sof(void)
+{
+    app_usbd_complex_evt_t evt;
+
+    UNUSED_RETURN_VALUE(events_flush());
+
+    /* SOF comes at the start of the frame, the time moves to the next frame boundary. */
+    m_sim.time_us  = (m_sim.time_us - (m_sim.time_us % 1000)) + 1000;
+    m_sim.framecnt = (m_sim.framecnt + 1) & 0x7FF;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.drv_evt.type               = NRF_DRV_USBD_EVT_SOF;
+    evt.drv_evt.data.sof.framecnt  = m_sim.framecnt;
+    for (uint8_t c = 0; c < m_sim.count; c++)
+    {
+        if (m_sim.sof_mask & (1U << c))
+        {
+            UNUSED_RETURN_VALUE(class_event(m_sim.p_inst[c], &evt));
+        }
+    }
+}
+
+uint16_t usbd_sim_framecnt_get(void)
+{
+    return m_sim.framecnt;
+}
+
+void usbd_sim_framecnt_set(uint16_t framecnt)
+{
+    m_sim.framecnt = framecnt & 0x7FF;
+}
+
+uint32_t usbd_sim_time_us(void)
+{
+    return m_sim.time_us;
+}
+
+void usbd_sim_time_advance(uint32_t us)
+{
+    m_sim.time_us += us;
+}
+
+uint32_t usbd_sim_ticks_get(void)
+{
+    return m_sim.time_us;
+}
+
+bool usbd_sim_in_isr(void)
+{
+    return m_sim.isr_depth > 0;
+}
+
+uint32_t usbd_sim_isr_stall(uint32_t us)
+{
+    uint32_t start = usbd_sim_isr_stalled() ? m_sim.stall_until_us : m_sim.time_us;
+
+    m_sim.stall_until_us = start + us;
+    return start;
+}
+
+bool usbd_sim_isr_stalled(void)
+{
+    return (int32_t)(m_sim.stall_until_us - m_sim.time_us) > 0;
+}
+
+int usbd_sim_in_poll(nrf_drv_usbd_ep_t ep, uint8_t * p_buf)
+{
+    usbd_sim_ep_t * p_ep = ep_get(ep);
+    size_t          len;
+
+    ASSERT(NRF_USBD_EPIN_CHECK(ep));
+    UNUSED_RETURN_VALUE(events_flush());
+    if (!ep_ready(p_ep))
+    {
+        m_sim.stats.naks++;
+        return USBD_SIM_NAK;
+    }
+
+    len = MIN(p_ep->transfer.size, (size_t)NRF_DRV_USBD_EPSIZE);
+    memcpy(p_buf, p_ep->transfer.p_data.tx, len);
+    p_ep->transfer.p_data.tx = (uint8_t const *)p_ep->transfer.p_data.tx + len;
+    p_ep->transfer.size     -= len;
+    m_sim.stats.in_packets++;
+    m_sim.stats.in_bytes += len;
+
+    if (p_ep->zlp)
+    {
+        p_ep->zlp = false;
+    }
+    else if (p_ep->transfer.size == 0)
+    {
+        /* A transfer of whole packets asking for it ends with a zero-length packet. */
+        p_ep->zlp = (len == NRF_DRV_USBD_EPSIZE) &&
+                    ((p_ep->transfer.flags & NRF_DRV_USBD_TRANSFER_ZLP_FLAG) != 0);
+    }
+    if ((p_ep->transfer.size == 0) && !p_ep->zlp)
+    {
+        p_ep->busy = false;
+        m_sim.stats.in_transfers++;
+        ep_event(ep, NRF_USBD_EP_OK);
+    }
+    return (int)len;
+}
+
+int usbd_sim_in_peek(nrf_drv_usbd_ep_t ep)
+{
+    usbd_sim_ep_t const * p_ep = ep_get(ep);
+
+    ASSERT(NRF_USBD_EPIN_CHECK(ep));
+    if (!ep_ready(p_ep))
+    {
+        return USBD_SIM_NAK;
+    }
+    return (int)MIN(p_ep->transfer.size, (size_t)NRF_DRV_USBD_EPSIZE);
+}
+
+int usbd_sim_out_push(nrf_drv_usbd_ep_t ep, uint8_t const * p_data, size_t len)
+{
+    usbd_sim_ep_t * p_ep = ep_get(ep);
+    bool            more;
+
+    ASSERT(NRF_USBD_EPOUT_CHECK(ep));
+    ASSERT(len <= NRF_DRV_USBD_EPSIZE);
+    if (ep != NRF_DRV_USBD_EPOUT0)
+    {
+        UNUSED_RETURN_VALUE(events_flush());
+    }
+    if (!ep_ready(p_ep))
+    {
+        m_sim.stats.naks++;
+        return USBD_SIM_NAK;
+    }
+
+    m_sim.stats.out_packets++;
+    m_sim.stats.out_bytes += len;
+    if (p_ep->handled)
+    {
+        nrf_drv_usbd_ep_transfer_t next = { .p_data = { .rx = NULL }, .size = 0, .flags = 0 };
+
+        more = p_ep->handler.handler.consumer(&next, p_ep->handler.p_context, NRF_DRV_USBD_EPSIZE, len);
+        ASSERT(next.size >= len);
+        memcpy(next.p_data.rx, p_data, len);
+    }
+    else
+    {
+        ASSERT(p_ep->transfer.size >= len);
+        memcpy(p_ep->transfer.p_data.rx, p_data, len);
+        p_ep->transfer.p_data.rx = (uint8_t *)p_ep->transfer.p_data.rx + len;
+        p_ep->transfer.size     -= len;
+        more = (p_ep->transfer.size > 0);
+    }
+
+    if (!more || (len < NRF_DRV_USBD_EPSIZE))
+    {
+        p_ep->busy = false;
+        m_sim.stats.out_transfers++;
+        ep_event(ep, NRF_USBD_EP_OK);
+    }
+    return (int)len;
+}
+
+bool usbd_sim_ep_armed(nrf_drv_usbd_ep_t ep)
+{
+    usbd_sim_ep_t const * p_ep = ep_get(ep);
+
+    return p_ep->enabled && p_ep->busy;
+}
+
+/**
+ * @brief Feed all descriptors of a class.
+ *
+ * The buffer is handed over in small pieces to exercise resuming of the feeding function.
+ */
+static size_t class_descriptors_get(app_usbd_class_inst_t const * p_inst, uint8_t * p_buf, size_t size)
+{
+    app_usbd_class_descriptor_ctx_t ctx = APP_USBD_CLASS_DESCRIPTOR_INIT();
+    size_t                          len = 0;
+    bool                            more;
+
+    do
+    {
+        size_t chunk = MIN((size_t)7, size - len);
+
+        more = p_inst->p_class_methods->feed_descriptors(&ctx, p_inst, p_buf + len, chunk);
+        len += ctx.size;
+        ASSERT(!more || (len < size));
+    } while (more);
+    return len;
+}
+
+ret_code_t app_usbd_class_descriptor_find(app_usbd_class_inst_t const * const p_inst,
+                                          uint8_t                             desc_type,
+                                          uint8_t                             desc_index,
+                                          uint8_t                           * p_desc,
+                                          size_t                            * p_desc_len)
+{
+    static uint8_t buf[1024];
+    size_t         len = class_descriptors_get(p_inst, buf, sizeof(buf));
+
+    for (size_t pos = 0; (pos + 1) < len; pos += buf[pos])
+    {
+        ASSERT(buf[pos] != 0);
+        if ((buf[pos + 1] == desc_type) && (desc_index-- == 0))
+        {
+            if (p_desc != NULL)
+            {
+                memcpy(p_desc, &buf[pos], buf[pos]);
+            }
+            *p_desc_len = buf[pos];
+            return NRF_SUCCESS;
+        }
+    }
+    return NRF_ERROR_NOT_FOUND;
+}
+
+ret_code_t usbd_sim_config_descriptor_get(uint8_t * p_buf, size_t * p_len)
+{
+    static uint8_t buf[1024];
+    size_t         len    = 9;
+    uint8_t        ifaces = 0;
+
+    for (uint8_t c = 0; c < m_sim.count; c++)
+    {
+        len    += class_descriptors_get(m_sim.p_inst[c], &buf[len], sizeof(buf) - len);
+        ifaces += app_usbd_class_iface_count_get(m_sim.p_inst[c]);
+    }
+    buf[0] = 9;
+    buf[1] = APP_USBD_DESCRIPTOR_CONFIGURATION;
+    buf[2] = LSB_16(len);
+    buf[3] = MSB_16(len);
+    buf[4] = ifaces;
+    buf[5] = 1;     // bConfigurationValue
+    buf[6] = 0;     // iConfiguration
+    buf[7] = 0xC0;  // bmAttributes, self powered
+    buf[8] = 50;    // bMaxPower, 100 mA
+
+    if (*p_len < len)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    memcpy(p_buf, buf, len);
+    *p_len = len;
+    return NRF_SUCCESS;
+}
+
+/**
+ * @brief Standard device and interface requests handled by the core.
+ */
+static ret_code_t setup_std(app_usbd_setup_t const * p_setup, uint8_t * p_data, size_t * p_len)
+{
+    app_usbd_class_inst_t const * p_inst;
+    uint8_t                       iface_idx;
+
+    switch (p_setup->bRequest)
+    {
+        case APP_USBD_SETUP_STDREQ_GET_DESCRIPTOR:
+            if ((app_usbd_setup_req_rec(p_setup->bmRequestType) == APP_USBD_SETUP_REQREC_DEVICE) &&
+                (p_setup->wValue.hb == APP_USBD_DESCRIPTOR_CONFIGURATION))
+            {
+                static uint8_t buf[1024];
+                size_t         len = sizeof(buf);
+                ret_code_t     ret = usbd_sim_config_descriptor_get(buf, &len);
+
+                if (ret == NRF_SUCCESS)
+                {
+                    *p_len = MIN(MIN(len, *p_len), (size_t)p_setup->wLength.w);
+                    memcpy(p_data, buf, *p_len);
+                }
+                return ret;
+            }
+            if (app_usbd_setup_req_rec(p_setup->bmRequestType) == APP_USBD_SETUP_REQREC_INTERFACE)
+            {
+                /* Class-specific descriptors of an interface, answered by its class. */
+                return NRF_ERROR_NOT_SUPPORTED;
+            }
+            return NRF_ERROR_NOT_FOUND;
+
+        case APP_USBD_SETUP_STDREQ_SET_CONFIGURATION:
+            /* Configure every interface with its default setting. */
+            for (uint8_t c = 0; c < m_sim.count; c++)
+            {
+                p_inst = m_sim.p_inst[c];
+                for (uint8_t i = 0; i < app_usbd_class_iface_count_get(p_inst); i++)
+                {
+                    ret_code_t ret = p_inst->p_class_methods->iface_select(p_inst, i, 0);
+
+                    if ((ret != NRF_SUCCESS) && (ret != NRF_ERROR_NOT_SUPPORTED))
+                    {
+                        return ret;
+                    }
+                }
+            }
+            *p_len = 0;
+            return NRF_SUCCESS;
+
+        case APP_USBD_SETUP_STDREQ_SET_INTERFACE:
+            p_inst = class_find(p_setup->wIndex.lb, NRF_DRV_USBD_EPOUT0, false, &iface_idx);
+            if (p_inst == NULL)
+            {
+                return NRF_ERROR_NOT_FOUND;
+            }
+            *p_len = 0;
+            return p_inst->p_class_methods->iface_select(p_inst, iface_idx, p_setup->wValue.lb);
+
+        case APP_USBD_SETUP_STDREQ_GET_INTERFACE:
+            p_inst = class_find(p_setup->wIndex.lb, NRF_DRV_USBD_EPOUT0, false, &iface_idx);
+            if ((p_inst == NULL) || (*p_len < 1))
+            {
+                return NRF_ERROR_NOT_FOUND;
+            }
+            p_data[0] = p_inst->p_class_methods->iface_selection_get(p_inst, iface_idx);
+            *p_len    = 1;
+            return NRF_SUCCESS;
+
+        default:
+            return NRF_ERROR_NOT_SUPPORTED;
+    }
+}
+
+/**
+ * @brief Run a control transfer, see @ref usbd_sim_setup.
+ */
+static ret_code_t setup_run(app_usbd_setup_t const * p_setup, uint8_t * p_data, size_t * p_len)
+{
+    app_usbd_class_inst_t const * p_inst;
+    app_usbd_setup_evt_t          evt;
+    ret_code_t                    ret;
+    bool                          dir_in = (app_usbd_setup_req_dir(p_setup->bmRequestType) ==
+                                            APP_USBD_SETUP_REQDIR_IN);
+
+    if (app_usbd_setup_req_typ(p_setup->bmRequestType) == APP_USBD_SETUP_REQTYPE_STD)
+    {
+        ret = setup_std(p_setup, p_data, p_len);
+        if (ret != NRF_ERROR_NOT_SUPPORTED)
+        {
+            return ret;
+        }
+    }
+
+    p_inst = class_find(p_setup->wIndex.lb, NRF_DRV_USBD_EPOUT0, false, NULL);
+    if (p_inst == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    m_sim.p_rsp              = NULL;
+    m_sim.rsp_len            = 0;
+    m_sim.setup_data.handler = NULL;
+    memset(&evt, 0, sizeof(evt));
+    evt.type  = APP_USBD_EVT_DRV_SETUP;
+    evt.setup = *p_setup;
+    ret = class_event(p_inst, (app_usbd_complex_evt_t const *)&evt);
+    if (ret != NRF_SUCCESS)
+    {
+        return ret;
+    }
+
+    if (dir_in)
+    {
+        *p_len = MIN(MIN(m_sim.rsp_len, *p_len), (size_t)p_setup->wLength.w);
+        memcpy(p_data, m_sim.p_rsp, *p_len);
+        return NRF_SUCCESS;
+    }
+
+    /* Data stage of an OUT request, packet by packet to the transfer armed on EP0. */
+    for (size_t pos = 0; pos < p_setup->wLength.w; pos += USBD_SIM_EP0_SIZE)
+    {
+        size_t len = MIN((size_t)USBD_SIM_EP0_SIZE, (size_t)p_setup->wLength.w - pos);
+
+        if (usbd_sim_out_push(NRF_DRV_USBD_EPOUT0, p_data + pos, len) == USBD_SIM_NAK)
+        {
+            return NRF_ERROR_INVALID_STATE;
+        }
+    }
+    *p_len = 0;
+    return NRF_SUCCESS;
+}
+
+ret_code_t usbd_sim_setup(app_usbd_setup_t const * p_setup, uint8_t * p_data, size_t * p_len)
+{
+    UNUSED_RETURN_VALUE(events_flush());
+    return setup_run(p_setup, p_data, p_len);
+}
+
+void usbd_sim_stats_get(usbd_sim_stats_t * p_stats)
+{
+    *p_stats = m_sim.stats;
+}
+
+void usbd_sim_stats_reset(void)
+{
+    memset(&m_sim.stats, 0, sizeof(m_sim.stats));
+}
+
+/* app_usbd */
+
+ret_code_t app_usbd_class_append(app_usbd_class_inst_t const * p_cinst)
+{
+    app_usbd_complex_evt_t evt;
+
+    if (m_sim.count >= USBD_SIM_MAX_CLASS)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    m_sim.p_inst[m_sim.count++] = p_cinst;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.app_evt.type = APP_USBD_EVT_INST_APPEND;
+    return class_event(p_cinst, &evt);
+}
+
+ret_code_t app_usbd_class_remove(app_usbd_class_inst_t const * p_cinst)
+{
+    for (uint8_t c = 0; c < m_sim.count; c++)
+    {
+        if (m_sim.p_inst[c] == p_cinst)
+        {
+            app_usbd_complex_evt_t evt;
+
+            memset(&evt, 0, sizeof(evt));
+            evt.app_evt.type = APP_USBD_EVT_INST_REMOVE;
+            UNUSED_RETURN_VALUE(class_event(p_cinst, &evt));
+
+            m_sim.count--;
+            memmove(&m_sim.p_inst[c], &m_sim.p_inst[c + 1], (m_sim.count - c) * sizeof(m_sim.p_inst[0]));
+            m_sim.sof_mask = (uint8_t)((m_sim.sof_mask & ((1U << c) - 1)) |
+                                       ((m_sim.sof_mask >> 1) & ~((1U << c) - 1)));
+            return NRF_SUCCESS;
+        }
+    }
+    return NRF_ERROR_NOT_FOUND;
+}
+
+ret_code_t app_usbd_class_sof_register(app_usbd_class_inst_t const * p_cinst)
+{
+    for (uint8_t c = 0; c < m_sim.count; c++)
+    {
+        if (m_sim.p_inst[c] == p_cinst)
+        {
+            m_sim.sof_mask |= (uint8_t)(1U << c);
+            return NRF_SUCCESS;
+        }
+    }
+    return NRF_ERROR_INVALID_PARAM;
+}
+
+void app_usbd_ep_enable(nrf_drv_usbd_ep_t ep)
+{
+    ep_get(ep)->enabled = true;
+}
+
+void app_usbd_ep_abort(nrf_drv_usbd_ep_t ep)
+{
+    usbd_sim_ep_t * p_ep = ep_get(ep);
+
+    /* Like app_usbd with the event queue enabled, the aborted transfer is reported later,
+     * when the endpoint may have been armed again. */
+    if (p_ep->busy)
+    {
+        p_ep->busy = false;
+        p_ep->zlp  = false;
+        ASSERT(m_sim.aborted_count < ARRAY_SIZE(m_sim.aborted));
+        m_sim.aborted[m_sim.aborted_count++] = ep;
+    }
+}
+
+
+void app_usbd_ep_disable(nrf_drv_usbd_ep_t ep)
+{
+    app_usbd_ep_abort(ep);
+    ep_get(ep)->enabled = false;
+}
+
+ret_code_t app_usbd_ep_transfer(nrf_drv_usbd_ep_t                        ep,
+                                nrf_drv_usbd_ep_transfer_t const * const p_transfer)
+{
+    usbd_sim_ep_t * p_ep = ep_get(ep);
+
+    if (!p_ep->enabled)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_ep->busy)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    p_ep->transfer = *p_transfer;
+    p_ep->handled  = false;
+    p_ep->zlp      = NRF_USBD_EPIN_CHECK(ep) && (p_transfer->size == 0);
+    p_ep->busy     = true;
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_usbd_ep_handled_transfer(nrf_drv_usbd_ep_t                         ep,
+                                        nrf_drv_usbd_handler_desc_t const * const p_handler)
+{
+    usbd_sim_ep_t * p_ep = ep_get(ep);
+
+    ASSERT(NRF_USBD_EPOUT_CHECK(ep));
+    if (!p_ep->enabled)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_ep->busy)
+    {
+        return NRF_ERROR_BUSY;
+    }
+    p_ep->handler = *p_handler;
+    p_ep->handled = true;
+    p_ep->busy    = true;
+    return NRF_SUCCESS;
+}
+
+bool app_usbd_event_queue_process(void)
+{
+    /* Transfer and setup events are delivered from the bus functions, only ABORTED is queued. */
+    return events_flush();
+}
+
+/* app_usbd_core */
+
+uint8_t * app_usbd_core_setup_transfer_buff_get(size_t * p_size)
+{
+    *p_size = sizeof(m_sim.setup_buf);
+    return m_sim.setup_buf;
+}
+
+ret_code_t app_usbd_core_setup_rsp(app_usbd_setup_t const * p_setup,
+                                   void const *             p_data,
+                                   size_t                   size)
+{
+    UNUSED_PARAMETER(p_setup);
+    m_sim.p_rsp   = p_data;
+    m_sim.rsp_len = size;
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_usbd_core_setup_data_handler_set(nrf_drv_usbd_ep_t                                     ep,
+                                                app_usbd_core_setup_data_handler_desc_t const * const p_handler_desc)
+{
+    ASSERT(ep == NRF_DRV_USBD_EPOUT0);
+    m_sim.setup_data = *p_handler_desc;
+    return NRF_SUCCESS;
+}
+
+/* nrf_drv_usbd */
+
+bool nrf_drv_usbd_is_enabled(void)
+{
+    return true;
+}
+
+uint32_t nrf_drv_usbd_framecntr_get(void)
+{
+    return m_sim.framecnt;
+}
+
+bool nrf_drv_usbd_ep_is_busy(nrf_drv_usbd_ep_t ep)
+{
+    return ep_get(ep)->busy;
+}
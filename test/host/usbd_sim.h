@@ -0,0 +1,225 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef USBD_SIM_H__
+#define USBD_SIM_H__
+
+#include "app_usbd.h"
+#include "app_usbd_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup usbd_sim Simulated USB device peripheral
+ * @brief Host build of the USBD peripheral and the parts of app_usbd the classes use.
+ *
+ * The bus side functions play the role of the host controller. They complete
+ * transfers packet by packet and call the class event handlers the way the USBD
+ * interrupt does on target, so class code runs unchanged on the host.
+ * ABORTED events are queued, as with the app_usbd event queue, and delivered by
+ * @ref app_usbd_event_queue_process or before the next bus function.
+ * @{
+ */
+
+#define USBD_SIM_NAK        (-1)    /**< Endpoint not armed, the packet was refused. */
+#define USBD_SIM_MAX_CLASS  4       /**< Maximum number of appended class instances. */
+#define USBD_SIM_EP0_SIZE   64      /**< Size of control endpoint packets. */
+
+/**
+ * @brief Bus counters.
+ */
+typedef struct
+{
+    uint32_t in_packets;    //!< IN packets delivered to the host
+    uint32_t in_bytes;      //!< Bytes of IN packets
+    uint32_t out_packets;   //!< OUT packets accepted by the device
+    uint32_t out_bytes;     //!< Bytes of OUT packets
+    uint32_t naks;          //!< Packets refused with NAK in either direction
+    uint32_t in_transfers;  //!< IN transfers completed
+    uint32_t out_transfers; //!< OUT transfers completed
+} usbd_sim_stats_t;
+
+/**
+ * @brief Forget all class instances and endpoint states.
+ */
+void usbd_sim_init(void);
+
+/**
+ * @brief Bus reset, every endpoint but EP0 is disabled.
+ */
+void usbd_sim_reset(void);
+
+/**
+ * @brief Start of frame, advances the frame counter and the simulated time by 1 ms.
+ */
+void usbd_sim_sof(void);
+
+/**
+ * @brief Current 11-bit frame number.
+ */
+uint16_t usbd_sim_framecnt_get(void);
+
+/**
+ * @brief Set the frame number the next SOF follows.
+ *
+ * @param[in] framecnt Frame number, 0 to 0x7FF.
+ */
+void usbd_sim_framecnt_set(uint16_t framecnt);
+
+/**
+ * @brief Simulated time in microseconds, advanced by SOF and @ref usbd_sim_time_advance.
+ */
+uint32_t usbd_sim_time_us(void);
+
+/**
+ * @brief Advance the simulated time inside a frame.
+ *
+ * @param[in] us Microseconds.
+ */
+void usbd_sim_time_advance(uint32_t us);
+
+/**
+ * @brief Time source for @ref app_usbd_midi_time_source_set, 1 tick per microsecond.
+ */
+uint32_t usbd_sim_ticks_get(void);
+
+/**
+ * @brief Check if the caller runs in a class event handler, the USBD interrupt on target.
+ */
+bool usbd_sim_in_isr(void);
+
+/**
+ * @brief Keep the USBD interrupt busy, for example with a slow user handler.
+ *
+ * Until the time has passed the peripheral answers every bulk transaction with NAK,
+ * as the interrupt that arms the next transfer has not run yet. Stalls add up.
+ *
+ * @param[in] us Microseconds of interrupt time.
+ *
+ * @return Time the stall starts, after the stalls already pending.
+ */
+uint32_t usbd_sim_isr_stall(uint32_t us);
+
+/**
+ * @brief Check if the USBD interrupt is still busy, see @ref usbd_sim_isr_stall.
+ */
+bool usbd_sim_isr_stalled(void);
+
+/**
+ * @brief Take an IN packet from an endpoint.
+ *
+ * @param[in]  ep       IN endpoint.
+ * @param[out] p_buf    Buffer of at least @ref NRF_DRV_USBD_EPSIZE bytes.
+ *
+ * @return Length of the packet, @ref USBD_SIM_NAK if no transfer is armed or the
+ *         interrupt is stalled.
+ */
+int usbd_sim_in_poll(nrf_drv_usbd_ep_t ep, uint8_t * p_buf);
+
+/**
+ * @brief Length of the next IN packet of an endpoint, without taking it.
+ *
+ * @param[in] ep IN endpoint.
+ *
+ * @return Length the next @ref usbd_sim_in_poll returns, @ref USBD_SIM_NAK if no transfer is armed.
+ */
+int usbd_sim_in_peek(nrf_drv_usbd_ep_t ep);
+
+/**
+ * @brief Give an OUT packet to an endpoint.
+ *
+ * @param[in] ep        OUT endpoint.
+ * @param[in] p_data    Packet data.
+ * @param[in] len       Packet length, up to @ref NRF_DRV_USBD_EPSIZE.
+ *
+ * @return @p len if the packet was accepted, @ref USBD_SIM_NAK if no transfer is armed or
+ *         the interrupt is stalled.
+ */
+int usbd_sim_out_push(nrf_drv_usbd_ep_t ep, uint8_t const * p_data, size_t len);
+
+/**
+ * @brief Check if an endpoint has a transfer armed.
+ */
+bool usbd_sim_ep_armed(nrf_drv_usbd_ep_t ep);
+
+/**
+ * @brief Run a control transfer.
+ *
+ * Standard device requests are answered by the simulated core, other requests go to
+ * the class owning the interface in wIndex.
+ *
+ * @param[in]     p_setup   Setup packet.
+ * @param[in,out] p_data    Data stage, written for IN requests and read for OUT requests.
+ * @param[in,out] p_len     Size of @p p_data, set to the length of the IN data stage.
+ *
+ * @retval NRF_SUCCESS  Request handled.
+ * @return Error code of the handler, the request is stalled.
+ */
+ret_code_t usbd_sim_setup(app_usbd_setup_t const * p_setup, uint8_t * p_data, size_t * p_len);
+
+/**
+ * @brief Build the configuration descriptor of all appended classes.
+ *
+ * @param[out]    p_buf Buffer.
+ * @param[in,out] p_len Size of the buffer, set to the descriptor length.
+ *
+ * @retval NRF_SUCCESS      Descriptor built.
+ * @retval NRF_ERROR_NO_MEM Buffer is too small.
+ */
+ret_code_t usbd_sim_config_descriptor_get(uint8_t * p_buf, size_t * p_len);
+
+/**
+ * @brief Get the bus counters.
+ */
+void usbd_sim_stats_get(usbd_sim_stats_t * p_stats);
+
+/**
+ * @brief Clear the bus counters.
+ */
+void usbd_sim_stats_reset(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USBD_SIM_H__ */
@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <string.h>
+
+#include "usbmon.h"
+#include "sdk_common.h"
+
+#define PCAP_MAGIC_US       0xA1B2C3D4  /**< pcap file, microsecond timestamps. */
+#define PCAP_MAGIC_NS       0xA1B23C4D  /**< pcap file, nanosecond timestamps. */
+#define PCAP_HDR_SIZE       24          /**< Size of the file header. */
+#define PCAP_REC_HDR_SIZE   16          /**< Size of a record header. */
+#define PCAP_SNAPLEN        65535       /**< Record size limit of created files. */
+
+#define USBMON_HDR_SIZE         48      /**< Size of the LINKTYPE_USB_LINUX header. */
+#define USBMON_HDR_SIZE_MMAPPED 64      /**< Size of the LINKTYPE_USB_LINUX_MMAPPED header. */
+#define USBMON_ISO_DESC_SIZE    16      /**< Size of an isochronous descriptor following the header. */
+
+static uint32_t swap32(uint32_t v)
+{
+    return ((v & 0xFF) << 24) | ((v & 0xFF00) << 8) | ((v >> 8) & 0xFF00) | (v >> 24);
+}
+
+/**
+ * @brief Get a value of @p size bytes, little endian or big endian for swapped files.
+ */
+static uint64_t field_get(usbmon_file_t const * p_file, uint8_t const * p, size_t size)
+{
+    uint64_t v = 0;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        size_t byte = p_file->swap ? i : (size - 1 - i);
+
+        v = (v << 8) | p[byte];
+    }
+    return v;
+}
+
+/**
+ * @brief Put a little endian value of @p size bytes.
+ */
+static void field_put(uint8_t * p, uint64_t v, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static size_t hdr_size(uint32_t linktype)
+{
+    return (linktype == USBMON_LINKTYPE_MMAPPED) ? USBMON_HDR_SIZE_MMAPPED : USBMON_HDR_SIZE;
+}
+
+ret_code_t usbmon_open(usbmon_file_t * p_file, char const * p_path)
+{
+    uint8_t  hdr[PCAP_HDR_SIZE];
+    uint32_t magic;
+
+    memset(p_file, 0, sizeof(*p_file));
+    p_file->p_file = fopen(p_path, "rb");
+    if (p_file->p_file == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    if (fread(hdr, sizeof(hdr), 1, p_file->p_file) != 1)
+    {
+        usbmon_close(p_file);
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    magic = (uint32_t)field_get(p_file, hdr, 4);
+    if ((swap32(magic) == PCAP_MAGIC_US) || (swap32(magic) == PCAP_MAGIC_NS))
+    {
+        p_file->swap = true;
+        magic        = swap32(magic);
+    }
+    if ((magic != PCAP_MAGIC_US) && (magic != PCAP_MAGIC_NS))
+    {
+        usbmon_close(p_file);
+        return NRF_ERROR_INVALID_DATA;
+    }
+    p_file->nsec     = (magic == PCAP_MAGIC_NS);
+    p_file->linktype = (uint32_t)field_get(p_file, &hdr[20], 4) & 0x0FFFFFFF;
+    if ((p_file->linktype != USBMON_LINKTYPE) && (p_file->linktype != USBMON_LINKTYPE_MMAPPED))
+    {
+        usbmon_close(p_file);
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+    return NRF_SUCCESS;
+}
+
+ret_code_t usbmon_read(usbmon_file_t * p_file, usbmon_rec_t * p_rec)
+{
+    uint8_t  rec_hdr[PCAP_REC_HDR_SIZE];
+    uint8_t  hdr[USBMON_HDR_SIZE_MMAPPED];
+    size_t   hsize = hdr_size(p_file->linktype);
+    uint32_t incl_len;
+    uint32_t skip  = 0;
+
+    if (fread(rec_hdr, sizeof(rec_hdr), 1, p_file->p_file) != 1)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    incl_len = (uint32_t)field_get(p_file, &rec_hdr[8], 4);
+    if ((incl_len < hsize) || (fread(hdr, hsize, 1, p_file->p_file) != 1))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    memset(p_rec, 0, offsetof(usbmon_rec_t, data));
+    p_rec->ts_us = (field_get(p_file, &rec_hdr[0], 4) * 1000000) +
+                   (field_get(p_file, &rec_hdr[4], 4) / (p_file->nsec ? 1000 : 1));
+    p_rec->id        = field_get(p_file, &hdr[0], 8);
+    p_rec->type      = hdr[8];
+    p_rec->xfer_type = hdr[9];
+    p_rec->ep        = hdr[10];
+    p_rec->devnum    = hdr[11];
+    p_rec->busnum    = (uint16_t)field_get(p_file, &hdr[12], 2);
+    p_rec->status    = (int32_t)field_get(p_file, &hdr[28], 4);
+    p_rec->length    = (uint32_t)field_get(p_file, &hdr[32], 4);
+
+    incl_len -= (uint32_t)hsize;
+    if ((p_file->linktype == USBMON_LINKTYPE_MMAPPED) && (p_rec->xfer_type == 0))
+    {
+        /* Isochronous descriptors come before the data. */
+        skip = MIN(incl_len, (uint32_t)field_get(p_file, &hdr[60], 4) * USBMON_ISO_DESC_SIZE);
+    }
+    if ((skip != 0) && (fseek(p_file->p_file, skip, SEEK_CUR) != 0))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+    incl_len      -= skip;
+    p_rec->len_cap = MIN(incl_len, (uint32_t)USBMON_DATA_MAX);
+    if ((p_rec->len_cap != 0) && (fread(p_rec->data, p_rec->len_cap, 1, p_file->p_file) != 1))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+    if ((incl_len > p_rec->len_cap) && (fseek(p_file->p_file, incl_len - p_rec->len_cap, SEEK_CUR) != 0))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+    return NRF_SUCCESS;
+}
+
+ret_code_t usbmon_create(usbmon_file_t * p_file, char const * p_path, uint32_t linktype)
+{
+    uint8_t hdr[PCAP_HDR_SIZE];
+
+    memset(p_file, 0, sizeof(*p_file));
+    if ((linktype != USBMON_LINKTYPE) && (linktype != USBMON_LINKTYPE_MMAPPED))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    p_file->linktype = linktype;
+    p_file->p_file   = fopen(p_path, "wb");
+    if (p_file->p_file == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    memset(hdr, 0, sizeof(hdr));
+    field_put(&hdr[0], PCAP_MAGIC_US, 4);
+    field_put(&hdr[4], 2, 2);               /* Version 2.4. */
+    field_put(&hdr[6], 4, 2);
+    field_put(&hdr[16], PCAP_SNAPLEN, 4);
+    field_put(&hdr[20], linktype, 4);
+    if (fwrite(hdr, sizeof(hdr), 1, p_file->p_file) != 1)
+    {
+        usbmon_close(p_file);
+        return NRF_ERROR_NOT_FOUND;
+    }
+    return NRF_SUCCESS;
+}
+
+ret_code_t usbmon_write(usbmon_file_t * p_file, usbmon_rec_t const * p_rec)
+{
+    uint8_t rec_hdr[PCAP_REC_HDR_SIZE];
+    uint8_t hdr[USBMON_HDR_SIZE_MMAPPED];
+    size_t  hsize = hdr_size(p_file->linktype);
+    bool    in    = (p_rec->ep & 0x80) != 0;
+
+    memset(hdr, 0, sizeof(hdr));
+    field_put(&hdr[0], p_rec->id, 8);
+    hdr[8]  = p_rec->type;
+    hdr[9]  = p_rec->xfer_type;
+    hdr[10] = p_rec->ep;
+    hdr[11] = p_rec->devnum;
+    field_put(&hdr[12], p_rec->busnum, 2);
+    hdr[14] = '-';                          /* No setup packet. */
+    if (p_rec->len_cap == 0)
+    {
+        /* Tells why there is no data: an IN submission or an OUT completion. */
+        hdr[15] = in ? '<' : '>';
+    }
+    field_put(&hdr[16], p_rec->ts_us / 1000000, 8);
+    field_put(&hdr[24], p_rec->ts_us % 1000000, 4);
+    field_put(&hdr[28], (uint32_t)p_rec->status, 4);
+    field_put(&hdr[32], p_rec->length, 4);
+    field_put(&hdr[36], p_rec->len_cap, 4);
+
+    field_put(&rec_hdr[0], p_rec->ts_us / 1000000, 4);
+    field_put(&rec_hdr[4], p_rec->ts_us % 1000000, 4);
+    field_put(&rec_hdr[8], hsize + p_rec->len_cap, 4);
+    field_put(&rec_hdr[12], hsize + p_rec->len_cap, 4);
+
+    if ((fwrite(rec_hdr, sizeof(rec_hdr), 1, p_file->p_file) != 1) ||
+        (fwrite(hdr, hsize, 1, p_file->p_file) != 1) ||
+        ((p_rec->len_cap != 0) && (fwrite(p_rec->data, p_rec->len_cap, 1, p_file->p_file) != 1)))
+    {
+        return NRF_ERROR_INTERNAL;
+    }
+    return NRF_SUCCESS;
+}
+
+void usbmon_close(usbmon_file_t * p_file)
+{
+    if (p_file->p_file != NULL)
+    {
+        fclose(p_file->p_file);
+        p_file->p_file = NULL;
+    }
+}
@@ -0,0 +1,163 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef USBMON_H__
+#define USBMON_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sdk_errors.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup usbmon Linux usbmon captures
+ * @brief Read and write pcap files of the Linux usbmon binary interface.
+ *
+ * Both link types written by libpcap for usbmon are supported: LINKTYPE_USB_LINUX with
+ * the 48-byte packet header and LINKTYPE_USB_LINUX_MMAPPED with the 64-byte one. The
+ * usbmon header is taken to be in the byte order of the pcap file, which holds for
+ * captures made and saved on the same machine.
+ * @{
+ */
+
+#define USBMON_LINKTYPE         189     /**< LINKTYPE_USB_LINUX, 48-byte header. */
+#define USBMON_LINKTYPE_MMAPPED 220     /**< LINKTYPE_USB_LINUX_MMAPPED, 64-byte header. */
+#define USBMON_DATA_MAX         4096    /**< Data bytes kept of a record. */
+
+#define USBMON_SUBMIT           'S'     /**< URB submitted. */
+#define USBMON_COMPLETE         'C'     /**< URB completed. */
+#define USBMON_XFER_BULK        3       /**< Transfer type of bulk URBs. */
+
+/**
+ * @brief One usbmon record.
+ */
+typedef struct
+{
+    uint64_t id;                        //!< URB tag, the same for its submission and completion
+    uint8_t  type;                      //!< @ref USBMON_SUBMIT, @ref USBMON_COMPLETE or 'E'
+    uint8_t  xfer_type;                 //!< 0 isochronous, 1 interrupt, 2 control, 3 bulk
+    uint8_t  ep;                        //!< Endpoint address, bit 7 set for IN
+    uint8_t  devnum;                    //!< Device address
+    uint16_t busnum;                    //!< Bus number
+    int32_t  status;                    //!< URB status
+    uint32_t length;                    //!< URB length, requested or transferred
+    uint64_t ts_us;                     //!< Capture time in microseconds
+    uint32_t len_cap;                   //!< Data bytes in @ref data
+    uint8_t  data[USBMON_DATA_MAX];     //!< Data captured with the record
+} usbmon_rec_t;
+
+/**
+ * @brief Open capture file.
+ */
+typedef struct
+{
+    FILE *   p_file;
+    uint32_t linktype;  //!< @ref USBMON_LINKTYPE or @ref USBMON_LINKTYPE_MMAPPED
+    bool     swap;      //!< File is big endian
+    bool     nsec;      //!< Timestamps have nanosecond resolution
+} usbmon_file_t;
+
+/**
+ * @brief Open a capture for reading.
+ *
+ * @param[out] p_file   Capture.
+ * @param[in]  p_path   File name.
+ *
+ * @retval NRF_SUCCESS              Capture open.
+ * @retval NRF_ERROR_NOT_FOUND      File cannot be opened.
+ * @retval NRF_ERROR_INVALID_DATA   Not a pcap file.
+ * @retval NRF_ERROR_NOT_SUPPORTED  Not a usbmon capture.
+ */
+ret_code_t usbmon_open(usbmon_file_t * p_file, char const * p_path);
+
+/**
+ * @brief Read the next record.
+ *
+ * Data beyond @ref USBMON_DATA_MAX bytes is skipped.
+ *
+ * @param[in]  p_file   Capture.
+ * @param[out] p_rec    Record.
+ *
+ * @retval NRF_SUCCESS              Record read.
+ * @retval NRF_ERROR_NOT_FOUND      End of the capture.
+ * @retval NRF_ERROR_INVALID_DATA   Truncated or malformed record.
+ */
+ret_code_t usbmon_read(usbmon_file_t * p_file, usbmon_rec_t * p_rec);
+
+/**
+ * @brief Create a little endian capture with microsecond timestamps.
+ *
+ * @param[out] p_file   Capture.
+ * @param[in]  p_path   File name.
+ * @param[in]  linktype @ref USBMON_LINKTYPE or @ref USBMON_LINKTYPE_MMAPPED.
+ *
+ * @retval NRF_SUCCESS              Capture created.
+ * @retval NRF_ERROR_INVALID_PARAM  Unknown link type.
+ * @retval NRF_ERROR_NOT_FOUND      File cannot be created.
+ */
+ret_code_t usbmon_create(usbmon_file_t * p_file, char const * p_path, uint32_t linktype);
+
+/**
+ * @brief Append a record.
+ *
+ * @param[in] p_file    Capture.
+ * @param[in] p_rec     Record.
+ *
+ * @retval NRF_SUCCESS          Record written.
+ * @retval NRF_ERROR_INTERNAL   Write failed.
+ */
+ret_code_t usbmon_write(usbmon_file_t * p_file, usbmon_rec_t const * p_rec);
+
+/**
+ * @brief Close a capture.
+ */
+void usbmon_close(usbmon_file_t * p_file);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USBMON_H__ */
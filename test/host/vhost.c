@@ -0,0 +1,405 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "vhost.h"
+#include "app_usbd_descriptor.h"
+#include "app_usbd_audio_types.h"
+
+static vhost_dev_t m_dev;
+
+ret_code_t vhost_init(app_usbd_class_inst_t const * p_inst)
+{
+    usbd_sim_init();
+    memset(&m_dev, 0, sizeof(m_dev));
+    return app_usbd_class_append(p_inst);
+}
+
+/**
+ * @brief Find the MIDI streaming interface and its endpoints in a configuration descriptor.
+ */
+static ret_code_t config_parse(uint8_t const * p_desc, size_t len)
+{
+    bool in_stream = false;
+    bool found     = false;
+
+    for (size_t pos = 0; pos + 1 < len; pos += p_desc[pos])
+    {
+        uint8_t const * p = &p_desc[pos];
+
+        if ((p[0] < 2) || (pos + p[0] > len))
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+        if (p[1] == APP_USBD_DESCRIPTOR_INTERFACE)
+        {
+            in_stream = (p[5] == APP_USBD_AUDIO_CLASS) &&
+                        (p[6] == APP_USBD_AUDIO_SUBCLASS_MIDISTREAMING) &&
+                        (!found || (p[2] == m_dev.stream_iface));
+            if (in_stream)
+            {
+                m_dev.stream_iface = p[2];
+                m_dev.alt_count    = (uint8_t)MAX(m_dev.alt_count, p[3] + 1);
+                found              = true;
+            }
+        }
+        else if ((p[1] == APP_USBD_DESCRIPTOR_ENDPOINT) && in_stream &&
+                 ((p[3] & 0x03) == APP_USBD_DESCRIPTOR_EP_ATTR_TYPE_BULK))
+        {
+            if (NRF_USBD_EPIN_CHECK(p[2]))
+            {
+                m_dev.ep_in = (nrf_drv_usbd_ep_t)p[2];
+            }
+            else
+            {
+                m_dev.ep_out = (nrf_drv_usbd_ep_t)p[2];
+            }
+        }
+    }
+    return (found && (m_dev.ep_in != 0) && (m_dev.ep_out != 0)) ? NRF_SUCCESS : NRF_ERROR_NOT_FOUND;
+}
+
+ret_code_t vhost_enumerate(void)
+{
+    static uint8_t   desc[1024];
+    size_t           len   = sizeof(desc);
+    app_usbd_setup_t setup = { 0 };
+    ret_code_t       ret;
+
+    usbd_sim_reset();
+
+    setup.bmRequestType = app_usbd_setup_req_val(APP_USBD_SETUP_REQREC_DEVICE,
+                                                 APP_USBD_SETUP_REQTYPE_STD,
+                                                 APP_USBD_SETUP_REQDIR_IN);
+    setup.bRequest   = APP_USBD_SETUP_STDREQ_GET_DESCRIPTOR;
+    setup.wValue.hb  = APP_USBD_DESCRIPTOR_CONFIGURATION;
+    setup.wLength.w  = sizeof(desc);
+    ret = usbd_sim_setup(&setup, desc, &len);
+    if (ret != NRF_SUCCESS)
+    {
+        return ret;
+    }
+    if ((len < 9) || ((size_t)(desc[2] | (desc[3] << 8)) != len))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+    m_dev.config_len = len;
+    ret = config_parse(desc, len);
+    if (ret != NRF_SUCCESS)
+    {
+        return ret;
+    }
+
+    memset(&setup, 0, sizeof(setup));
+    setup.bmRequestType = app_usbd_setup_req_val(APP_USBD_SETUP_REQREC_DEVICE,
+                                                 APP_USBD_SETUP_REQTYPE_STD,
+                                                 APP_USBD_SETUP_REQDIR_OUT);
+    setup.bRequest  = APP_USBD_SETUP_STDREQ_SET_CONFIGURATION;
+    setup.wValue.lb = desc[5];
+    len = 0;
+    return usbd_sim_setup(&setup, NULL, &len);
+}
+
+vhost_dev_t const * vhost_dev_get(void)
+{
+    return &m_dev;
+}
+
+ret_code_t vhost_alt_select(uint8_t alt)
+{
+    app_usbd_setup_t setup = { 0 };
+    size_t           len   = 0;
+
+    setup.bmRequestType = app_usbd_setup_req_val(APP_USBD_SETUP_REQREC_INTERFACE,
+                                                 APP_USBD_SETUP_REQTYPE_STD,
+                                                 APP_USBD_SETUP_REQDIR_OUT);
+    setup.bRequest  = APP_USBD_SETUP_STDREQ_SET_INTERFACE;
+    setup.wValue.lb = alt;
+    setup.wIndex.lb = m_dev.stream_iface;
+    return usbd_sim_setup(&setup, NULL, &len);
+}
+
+int vhost_out_packet(uint8_t const * p_data, size_t len)
+{
+    return usbd_sim_out_push(m_dev.ep_out, p_data, len);
+}
+
+int vhost_in_packet(uint8_t * p_buf)
+{
+    return usbd_sim_in_poll(m_dev.ep_in, p_buf);
+}
+
+size_t vhost_out(uint8_t const * p_data, size_t len)
+{
+    size_t pos = 0;
+
+    do
+    {
+        size_t chunk = MIN(len - pos, (size_t)NRF_DRV_USBD_EPSIZE);
+
+        if (vhost_out_packet(p_data + pos, chunk) == USBD_SIM_NAK)
+        {
+            break;
+        }
+        pos += chunk;
+        if (chunk < NRF_DRV_USBD_EPSIZE)
+        {
+            break;
+        }
+    } while (true);
+    return pos;
+}
+
+size_t vhost_in(uint8_t * p_buf, size_t size)
+{
+    size_t pos = 0;
+
+    while (size - pos >= NRF_DRV_USBD_EPSIZE)
+    {
+        int len = vhost_in_packet(p_buf + pos);
+
+        if (len == USBD_SIM_NAK)
+        {
+            break;
+        }
+        pos += (size_t)len;
+    }
+    return pos;
+}
+
+void vhost_sof(void)
+{
+    usbd_sim_sof();
+}
+
+/**
+ * @brief OUT transfer waiting at the host.
+ */
+typedef struct
+{
+    uint8_t  data[VHOST_OUT_TRANSFER_MAX];
+    uint16_t len;   //!< Length of the transfer
+    uint16_t pos;   //!< Bytes accepted by the device
+} vhost_out_t;
+
+/**
+ * @brief Frame scheduler state.
+ */
+typedef struct
+{
+    vhost_frame_cfg_t      cfg;
+    vhost_frame_handlers_t handlers;
+    vhost_frame_stats_t    stats;
+    vhost_out_t            out[VHOST_OUT_QUEUE_SIZE];
+    size_t                 out_rd;  //!< Free running index of the transfer being sent
+    size_t                 out_wr;  //!< Free running index of the next free entry
+    uint8_t                turn;    //!< Position in the polling order, kept across frames
+    uint32_t               ns;      //!< Time into the current frame
+} vhost_frame_t;
+
+static vhost_frame_t m_frame;
+
+void vhost_frame_init(vhost_frame_cfg_t const * p_cfg, vhost_frame_handlers_t const * p_handlers)
+{
+    memset(&m_frame, 0, sizeof(m_frame));
+    m_frame.cfg = *p_cfg;
+    if (p_handlers != NULL)
+    {
+        m_frame.handlers = *p_handlers;
+    }
+}
+
+ret_code_t vhost_out_queue(uint8_t const * p_data, size_t len)
+{
+    vhost_out_t * p_out;
+
+    if (len > VHOST_OUT_TRANSFER_MAX)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (m_frame.out_wr - m_frame.out_rd >= VHOST_OUT_QUEUE_SIZE)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    p_out      = &m_frame.out[m_frame.out_wr % VHOST_OUT_QUEUE_SIZE];
+    memcpy(p_out->data, p_data, len);
+    p_out->len = (uint16_t)len;
+    p_out->pos = 0;
+    m_frame.out_wr++;
+    return NRF_SUCCESS;
+}
+
+size_t vhost_out_pending(void)
+{
+    return m_frame.out_wr - m_frame.out_rd;
+}
+
+uint32_t vhost_xact_ns(size_t len)
+{
+    /* Host delay and handshake, then 83.54 ns per bit of the token overhead and data. */
+    return 9107 + (8354 * (3 + 8 * (uint32_t)len)) / 100;
+}
+
+/**
+ * @brief Let a transaction take its time on the bus.
+ */
+static void frame_time_use(uint32_t ns)
+{
+    uint32_t us = m_frame.ns / 1000;
+
+    m_frame.ns += ns;
+    usbd_sim_time_advance((m_frame.ns / 1000) - us);
+}
+
+/**
+ * @brief Visit the bulk IN pipe of the device.
+ *
+ * @return True if a packet moved.
+ */
+static bool frame_in(void)
+{
+    uint8_t buf[NRF_DRV_USBD_EPSIZE];
+    int     len = usbd_sim_in_peek(m_dev.ep_in);
+
+    frame_time_use(vhost_xact_ns((len == USBD_SIM_NAK) ? 0 : (size_t)len));
+    len = vhost_in_packet(buf);
+    if (len == USBD_SIM_NAK)
+    {
+        m_frame.stats.in_naks++;
+        return false;
+    }
+    m_frame.stats.in_packets++;
+    if (m_frame.handlers.in != NULL)
+    {
+        m_frame.handlers.in(buf, (size_t)len, usbd_sim_time_us(), m_frame.handlers.p_context);
+    }
+    return true;
+}
+
+/**
+ * @brief Visit the bulk OUT pipe of the device.
+ *
+ * @return True if a packet moved.
+ */
+static bool frame_out(void)
+{
+    vhost_out_t * p_out = &m_frame.out[m_frame.out_rd % VHOST_OUT_QUEUE_SIZE];
+    size_t        chunk = MIN((size_t)(p_out->len - p_out->pos), (size_t)NRF_DRV_USBD_EPSIZE);
+
+    frame_time_use(vhost_xact_ns((usbd_sim_ep_armed(m_dev.ep_out) && !usbd_sim_isr_stalled()) ? chunk : 0));
+    if (vhost_out_packet(&p_out->data[p_out->pos], chunk) == USBD_SIM_NAK)
+    {
+        m_frame.stats.out_naks++;
+        return false;
+    }
+    m_frame.stats.out_packets++;
+    p_out->pos += (uint16_t)chunk;
+    if (chunk < NRF_DRV_USBD_EPSIZE)
+    {
+        /* A short packet, or the zero-length one after whole packets, ends the transfer. */
+        m_frame.out_rd++;
+        if (m_frame.handlers.out != NULL)
+        {
+            m_frame.handlers.out(p_out->len, usbd_sim_time_us(), m_frame.handlers.p_context);
+        }
+    }
+    return true;
+}
+
+void vhost_frame(void)
+{
+    uint8_t packets = 0;
+    uint8_t other   = m_frame.cfg.other_packets;
+
+    usbd_sim_sof();
+    m_frame.ns = 0;
+    m_frame.stats.frames++;
+
+    /* The host only starts a transaction a full packet still fits behind. */
+    while (m_frame.ns + vhost_xact_ns(NRF_DRV_USBD_EPSIZE) <= VHOST_FRAME_NS)
+    {
+        vhost_pipe_t pipe = m_frame.cfg.order[m_frame.turn];
+
+        if (packets >= m_frame.cfg.bulk_cap)
+        {
+            m_frame.stats.capped_frames++;
+            break;
+        }
+        m_frame.turn = (uint8_t)((m_frame.turn + 1) % VHOST_PIPE_COUNT);
+
+        if (pipe == VHOST_PIPE_OTHER)
+        {
+            if (other > 0)
+            {
+                other--;
+                packets++;
+                m_frame.stats.other_packets++;
+                frame_time_use(vhost_xact_ns(NRF_DRV_USBD_EPSIZE));
+            }
+            continue;
+        }
+        if ((pipe == VHOST_PIPE_OUT) && (vhost_out_pending() == 0))
+        {
+            continue;
+        }
+
+        if (m_frame.handlers.app != NULL)
+        {
+            m_frame.handlers.app(usbd_sim_time_us(), m_frame.handlers.p_context);
+        }
+        if ((pipe == VHOST_PIPE_IN) ? frame_in() : frame_out())
+        {
+            packets++;
+        }
+    }
+
+    /* Rest of the frame is idle, the application runs once more just before the next SOF. */
+    if (m_frame.ns < VHOST_FRAME_NS - 1000)
+    {
+        frame_time_use(VHOST_FRAME_NS - 1000 - m_frame.ns);
+    }
+    if (m_frame.handlers.app != NULL)
+    {
+        m_frame.handlers.app(usbd_sim_time_us(), m_frame.handlers.p_context);
+    }
+}
+
+void vhost_frame_stats_get(vhost_frame_stats_t * p_stats)
+{
+    *p_stats = m_frame.stats;
+}
@@ -0,0 +1,286 @@
+/**
+ * Copyright (c) 2016 - 2020, Nordic Semiconductor ASA
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form, except as embedded into a Nordic
+ *    Semiconductor ASA integrated circuit in a product or a software update for
+ *    such product, must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other
+ *    materials provided with the distribution.
+ *
+ * 3. Neither the name of Nordic Semiconductor ASA nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * 4. This software, with or without modification, must only be used with a
+ *    Nordic Semiconductor ASA integrated circuit.
+ *
+ * 5. Any software provided in binary form under this license must not be reverse
+ *    engineered, decompiled, modified and/or disassembled.
+ *
+ * THIS SOFTWARE IS PROVIDED BY NORDIC SEMICONDUCTOR ASA "AS IS" AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, NONINFRINGEMENT, AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL NORDIC SEMICONDUCTOR ASA OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef VHOST_H__
+#define VHOST_H__
+
+#include "usbd_sim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup vhost Virtual USB host
+ * @brief Scripted host driving a MIDI class instance on the simulated peripheral.
+ *
+ * The host enumerates the device from its configuration descriptor and talks to the
+ * first MIDI streaming interface it finds.
+ * @{
+ */
+
+/**
+ * @brief Device as seen by the host after enumeration.
+ */
+typedef struct
+{
+    uint8_t           stream_iface; //!< Interface number of MIDI streaming
+    uint8_t           alt_count;    //!< Number of alternate settings of the streaming interface
+    nrf_drv_usbd_ep_t ep_in;        //!< Bulk IN endpoint
+    nrf_drv_usbd_ep_t ep_out;       //!< Bulk OUT endpoint
+    size_t            config_len;   //!< Length of the configuration descriptor
+} vhost_dev_t;
+
+/**
+ * @brief Start with a fresh bus and append a class instance.
+ *
+ * @param[in] p_inst Class instance.
+ *
+ * @return Result of @ref app_usbd_class_append.
+ */
+ret_code_t vhost_init(app_usbd_class_inst_t const * p_inst);
+
+/**
+ * @brief Reset the bus, read the configuration descriptor and set the configuration.
+ *
+ * Setting the configuration selects alternate setting 0 of every interface.
+ *
+ * @retval NRF_SUCCESS          Device configured.
+ * @retval NRF_ERROR_NOT_FOUND  No MIDI streaming interface with bulk endpoints.
+ * @return Other error code of the control transfers.
+ */
+ret_code_t vhost_enumerate(void);
+
+/**
+ * @brief Get the device found by @ref vhost_enumerate.
+ */
+vhost_dev_t const * vhost_dev_get(void);
+
+/**
+ * @brief Select an alternate setting of the streaming interface.
+ *
+ * @param[in] alt Alternate setting.
+ *
+ * @return Result of the SET_INTERFACE request.
+ */
+ret_code_t vhost_alt_select(uint8_t alt);
+
+/**
+ * @brief Send a bulk OUT transfer.
+ *
+ * The transfer is split in packets and ends with a zero-length packet if its length
+ * is a multiple of the packet size. Sending stops at the first NAK.
+ *
+ * @param[in] p_data    Data.
+ * @param[in] len       Length.
+ *
+ * @return Number of bytes accepted by the device.
+ */
+size_t vhost_out(uint8_t const * p_data, size_t len);
+
+/**
+ * @brief Read bulk IN packets until the device NAKs or the buffer is full.
+ *
+ * @param[out] p_buf    Buffer.
+ * @param[in]  size     Size of the buffer, packets are only read while a whole
+ *                      packet fits.
+ *
+ * @return Number of bytes read.
+ */
+size_t vhost_in(uint8_t * p_buf, size_t size);
+
+/**
+ * @brief Read one bulk IN packet.
+ *
+ * @param[out] p_buf Buffer of at least @ref NRF_DRV_USBD_EPSIZE bytes.
+ *
+ * @return Length of the packet, @ref USBD_SIM_NAK if the device has nothing to send.
+ */
+int vhost_in_packet(uint8_t * p_buf);
+
+/**
+ * @brief Send one bulk OUT packet.
+ *
+ * @param[in] p_data    Packet data.
+ * @param[in] len       Packet length, up to @ref NRF_DRV_USBD_EPSIZE.
+ *
+ * @return @p len if accepted, @ref USBD_SIM_NAK otherwise.
+ */
+int vhost_out_packet(uint8_t const * p_data, size_t len);
+
+/**
+ * @brief Start a new frame.
+ */
+void vhost_sof(void);
+
+/**
+ * @defgroup vhost_frame Frame scheduler
+ * @brief Full-speed frame timing of the host controller.
+ *
+ * Every frame starts with SOF. The host then visits its bulk pipes in a fixed order,
+ * one transaction per visit, until the frame is out of time or out of bulk packets.
+ * A pipe with nothing to move is skipped, a visit the device answers with NAK costs
+ * the handshake only and the host moves on to the next pipe. Transaction times follow
+ * the full-speed bulk formula of the USB 2.0 specification, chapter 5.11.3, without
+ * bit stuffing, and the simulated time moves with every transaction so the class sees
+ * its events at the time the transaction ends.
+ * @{
+ */
+
+#define VHOST_FRAME_NS          1000000 /**< Length of a full-speed frame in nanoseconds. */
+#define VHOST_BULK_CAP_DEFAULT  19      /**< Bulk packets of 64 bytes fitting in a frame. */
+#define VHOST_OUT_QUEUE_SIZE    64      /**< OUT transfers the host can hold. */
+#define VHOST_OUT_TRANSFER_MAX  4096    /**< Size of the largest OUT transfer. */
+
+/**
+ * @brief Bulk pipes of the host schedule.
+ */
+typedef enum
+{
+    VHOST_PIPE_IN,      //!< Bulk IN endpoint of the device, always polled
+    VHOST_PIPE_OUT,     //!< Bulk OUT endpoint of the device, visited while transfers are queued
+    VHOST_PIPE_OTHER,   //!< Endpoints of other devices sharing the bus
+    VHOST_PIPE_COUNT
+} vhost_pipe_t;
+
+/**
+ * @brief Host controller settings.
+ */
+typedef struct
+{
+    uint8_t      bulk_cap;                  //!< Bulk packets per frame, all pipes together
+    uint8_t      other_packets;             //!< Packets of 64 bytes other endpoints move every frame
+    vhost_pipe_t order[VHOST_PIPE_COUNT];   //!< Order the host visits the pipes in
+} vhost_frame_cfg_t;
+
+/**
+ * @brief Default settings, a host with the bus to itself polling IN first.
+ */
+#define VHOST_FRAME_CFG_DEFAULT                                             \
+    {                                                                       \
+        .bulk_cap      = VHOST_BULK_CAP_DEFAULT,                            \
+        .other_packets = 0,                                                 \
+        .order         = { VHOST_PIPE_IN, VHOST_PIPE_OUT, VHOST_PIPE_OTHER }, \
+    }
+
+/**
+ * @brief Hooks called by the frame scheduler.
+ *
+ * Every member can be NULL.
+ */
+typedef struct
+{
+    /** Application work, called before every transaction with the current time. */
+    void (* app)(uint32_t now_us, void * p_context);
+    /** IN packet received by the host at the end of its transaction. */
+    void (* in)(uint8_t const * p_data, size_t len, uint32_t now_us, void * p_context);
+    /** OUT transfer fully accepted by the device. */
+    void (* out)(size_t len, uint32_t now_us, void * p_context);
+    void *  p_context;  //!< Context of the hooks
+} vhost_frame_handlers_t;
+
+/**
+ * @brief Frame scheduler counters.
+ */
+typedef struct
+{
+    uint32_t frames;        //!< Frames run
+    uint32_t in_packets;    //!< IN packets received
+    uint32_t in_naks;       //!< IN visits answered with NAK
+    uint32_t out_packets;   //!< OUT packets accepted
+    uint32_t out_naks;      //!< OUT visits answered with NAK
+    uint32_t other_packets; //!< Packets of other endpoints
+    uint32_t capped_frames; //!< Frames that used up their bulk packets
+} vhost_frame_stats_t;
+
+/**
+ * @brief Set up the frame scheduler and clear its counters and OUT queue.
+ *
+ * @param[in] p_cfg         Host controller settings.
+ * @param[in] p_handlers    Hooks, copied.
+ */
+void vhost_frame_init(vhost_frame_cfg_t const * p_cfg, vhost_frame_handlers_t const * p_handlers);
+
+/**
+ * @brief Queue a bulk OUT transfer, sent packet by packet in the coming frames.
+ *
+ * A transfer of whole packets ends with a zero-length packet.
+ *
+ * @param[in] p_data    Data.
+ * @param[in] len       Length, up to @ref VHOST_OUT_TRANSFER_MAX.
+ *
+ * @retval NRF_SUCCESS              Transfer queued.
+ * @retval NRF_ERROR_INVALID_LENGTH Transfer too long.
+ * @retval NRF_ERROR_NO_MEM         Queue full.
+ */
+ret_code_t vhost_out_queue(uint8_t const * p_data, size_t len);
+
+/**
+ * @brief Number of OUT transfers not yet fully accepted.
+ */
+size_t vhost_out_pending(void);
+
+/**
+ * @brief Run one frame.
+ */
+void vhost_frame(void);
+
+/**
+ * @brief Time of a bulk transaction.
+ *
+ * @param[in] len Data bytes, 0 for a NAK.
+ *
+ * @return Nanoseconds on the bus.
+ */
+uint32_t vhost_xact_ns(size_t len);
+
+/**
+ * @brief Get the frame scheduler counters.
+ */
+void vhost_frame_stats_get(vhost_frame_stats_t * p_stats);
+
+/** @} */
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VHOST_H__ */